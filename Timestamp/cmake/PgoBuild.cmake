@@ -0,0 +1,45 @@
+# profile guided build of the project, run from the project directory as
+#
+#   cmake -DBINARY_DIR=build-pgo [-DLTO=ON] -P cmake/PgoBuild.cmake
+#
+# which configures BINARY_DIR for TIMESTAMP_PGO=GENERATE, builds it and runs
+# the pgo-train target, then reconfigures the same directory for
+# TIMESTAMP_PGO=USE and rebuilds it on the profiles just gathered; the
+# result is the release-pgo (or release-lto-pgo) profile, whose gains over
+# plain release the bench target finally records
+cmake_minimum_required(VERSION 3.9 FATAL_ERROR)
+
+if(NOT BINARY_DIR)
+	message(FATAL_ERROR "Usage: cmake -DBINARY_DIR=DIR [-DLTO=ON] "
+		"-P cmake/PgoBuild.cmake")
+endif()
+if(NOT LTO)
+	set(LTO OFF)
+endif()
+get_filename_component(SOURCE_DIR ${CMAKE_CURRENT_LIST_DIR} DIRECTORY)
+get_filename_component(BINARY_DIR ${BINARY_DIR} ABSOLUTE)
+file(MAKE_DIRECTORY ${BINARY_DIR})
+# stale profiles of a previous cycle would be merged into the new ones
+file(REMOVE_RECURSE ${BINARY_DIR}/pgo)
+
+# runs a command in BINARY_DIR and gives up on the first failure
+function(pgo_step)
+	execute_process(COMMAND ${ARGN}
+		WORKING_DIRECTORY ${BINARY_DIR}
+		RESULT_VARIABLE status)
+	if(NOT status EQUAL 0)
+		message(FATAL_ERROR "Failed: ${ARGN}")
+	endif()
+endfunction()
+
+foreach(stage GENERATE USE)
+	message(STATUS "Profile guided build: ${stage}")
+	pgo_step(${CMAKE_COMMAND} ${SOURCE_DIR} -DCMAKE_BUILD_TYPE=Release
+		-DTIMESTAMP_LTO=${LTO} -DTIMESTAMP_PGO=${stage}
+		-DTIMESTAMP_PGO_DIR=${BINARY_DIR}/pgo)
+	pgo_step(${CMAKE_COMMAND} --build .)
+	if(stage STREQUAL "GENERATE")
+		pgo_step(${CMAKE_COMMAND} --build . --target pgo-train)
+	endif()
+endforeach()
+pgo_step(${CMAKE_COMMAND} --build . --target bench)
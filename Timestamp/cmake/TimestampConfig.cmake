@@ -0,0 +1,6 @@
+# package configuration of the timestamp library: provides the imported
+# targets Timestamp::timestamp (static) and Timestamp::timestamp_shared,
+# both of which come with the include directory of libtimestamp.h
+set(CMAKE_THREAD_PREFER_PTHREAD ON)
+find_package(Threads REQUIRED)
+include(${CMAKE_CURRENT_LIST_DIR}/TimestampTargets.cmake)
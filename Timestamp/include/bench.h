@@ -0,0 +1,140 @@
+/**
+ * @file bench.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Header declaration of the Bench class; it times every stage of the hot
+ * path of ts on its own, from reading a clock to whole frames through a
+ * pipe, so that a change to any of them can be judged by numbers.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct BenchOption {
+        BenchOption();
+
+        /* Measurements per benchmark, of which the median is reported. */
+        size_t              repeat;
+        /* Each measurement runs for at least this many milliseconds. */
+        uint64_t            min_ms;
+        /* Padding sizes of the benchmarks that depend on one. */
+        std::vector<size_t> pads;
+        /* Frames of every loopback run. */
+        size_t              count;
+        /* Only benchmarks whose name contains this run, if non-NULL. */
+        const char         *filter;
+        /*
+         * A baseline file of "name ns tolerance" lines, see
+         * Bench::run(); if non-NULL only the benchmarks it lists run, and
+         * each is judged against its line.
+         */
+        const char         *baseline;
+        /* Whether a regression against the baseline fails the run. */
+        bool                strict;
+        /*
+         * A file of "name reference ratio" lines, see Bench::run(); if
+         * non-NULL only the benchmarks it names run too, and each 'name'
+         * is judged against its 'reference' of the same run.
+         */
+        const char         *ratios;
+        /* Where to write the results as a baseline file, if non-NULL. */
+        const char         *save;
+};
+
+class Bench final {
+public:
+        Bench()                                  = delete;
+        Bench(const Bench &)                     = delete;
+        Bench(const Bench &&)                    = delete;
+        explicit Bench(const BenchOption &option);
+        ~Bench()                                 = default;
+
+        /*
+         * Runs every benchmark and prints one "name value..." line for each
+         * to 'stream', followed by the verdict on each baseline line if
+         * there is a baseline: a result more than 'tolerance' percent above
+         * that of the baseline is a regression.  With ratios, a 'name'
+         * taking more than 'ratio' times its 'reference' is one too, which
+         * unlike a baseline holds on any machine.  Returns -1 if anything
+         * failed or regressed, 0 otherwise.
+         * Throws runtime_error if the baseline or the ratios cannot be read
+         * or the results saved.
+         */
+        int run(FILE *stream);
+
+        Bench &operator =(const Bench &)         = delete;
+        Bench &operator =(const Bench &&)        = delete;
+
+private:
+        struct Baseline_ {
+                double ns;
+                double tolerance;
+        };
+        struct Ratio_ {
+                std::string name;
+                std::string reference;
+                double      limit;
+        };
+
+        /* data */
+        BenchOption                      option_;
+        FILE                            *stream_;
+        int                              status_;
+        std::map<std::string, Baseline_> baseline_;
+        std::vector<Ratio_>              ratios_;
+        /* Result of every benchmark that ran, as a baseline judges it. */
+        std::vector<std::pair<std::string, double>> judged_;
+
+        bool selected_(const std::string &name) const;
+        template<typename Body>
+        void measure_(const std::string &name,
+                      size_t             ops,
+                      size_t             bytes,
+                      Body               body);
+        void report_(const std::string &name,
+                     std::vector<double> ns,
+                     size_t              bytes);
+        void clock_();
+        void diff_();
+        void log_();
+        void base64_(size_t pad);
+        void write_(size_t pad);
+        void loopback_(size_t pad);
+        void impair_();
+        void startup_();
+        void load_();
+        void load_ratios_();
+        void judge_();
+        void judge_ratios_();
+        bool measured_(const std::string &name, double *ns) const;
+        void save_() const;
+};
+
+#endif /* BENCH_H */
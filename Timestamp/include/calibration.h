@@ -0,0 +1,97 @@
+/**
+ * @file calibration.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Header declaration of the Calibration structure; the measurement floor
+ * of ts on one host as recorded by timestamp_engine_calibrate(), which a
+ * receiver may take off the latencies it reports.
+ */
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <time.h> /* clockid_t */
+
+#ifdef __cplusplus
+}
+#endif
+
+/*
+ * A calibration file holds "key value" lines, '#' starting a comment; the
+ * first two keys below are what a receiver takes off its latencies, the
+ * other three what they were measured with, and the rest of the file
+ * merely tells where they came from.
+ */
+#define CALIBRATION_FLOOR      "floor"
+#define CALIBRATION_RESOLUTION "resolution"
+#define CALIBRATION_CLOCK      "clock"
+#define CALIBRATION_CODEC      "codec"
+#define CALIBRATION_PAD        "pad"
+
+struct Calibration {
+        Calibration();
+
+        /* Whether there is anything to take off the latencies. */
+        bool    active() const;
+        /*
+         * Reads a calibration file, leaving the fields alone unless both
+         * CALIBRATION_FLOOR and CALIBRATION_RESOLUTION are there.
+         * Throws invalid_argument naming the first line it cannot read.
+         */
+        void    load(FILE *stream);
+        /*
+         * The key of the first of CALIBRATION_CLOCK, CALIBRATION_CODEC and
+         * CALIBRATION_PAD the floor was measured with another value of than
+         * a run with these arguments has, or NULL if none; a key the file
+         * did not have matches anything.
+         */
+        const char *mismatch(clockid_t clock,
+                             bool      raw,
+                             bool      crc,
+                             size_t    pad) const;
+
+        /* How the values of the setup keys are written. */
+        static const char *clock_name(clockid_t clock);
+        static const char *codec_name(bool raw, bool crc);
+
+        /* The latency of a frame that crossed no link at all. */
+        int64_t floor;
+        /*
+         * How close to 'floor' a latency may come before it says more
+         * about the clock than about the link.
+         */
+        int64_t resolution;
+        /* What the floor was measured with, empty where the file is mute. */
+        std::string clock;
+        std::string codec;
+        std::string pad;
+};
+
+#endif /* CALIBRATION_H */
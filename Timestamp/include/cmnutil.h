@@ -89,6 +89,7 @@
 */
 
 #include <cerrno>    /* errno */
+#include <cstdint>   /* uint64_t */
 #include <cstdio>    /* fprintf() */
 #include <cstdlib>   /* abort() */
 #include <cstring>   /* strerror() */
@@ -98,6 +99,8 @@
 extern "C" {
 #endif
 
+#include <sys/uio.h> /* struct iovec */
+#include <time.h>    /* struct timespec */
 #include <unistd.h>
 
 #ifdef __cplusplus
@@ -112,6 +115,12 @@ extern "C" {
 #define ANSI_COLOR_CYAN    "\x1b[36m"
 #define ANSI_COLOR_RESET   "\x1b[0m"
 
+/*
+ * Size of a cache line on every x86-64 and most aarch64 parts; used to keep
+ * data written by different threads from sharing a line.
+ */
+#define CMNUTIL_CACHE_LINE 64
+
 #define CMNUTIL_ERRABRT(expr) \
         do { \
                 int status__ = 0; \
@@ -163,8 +172,45 @@ extern "C" {
                             |Function Declarations|
                             +---------------------+
 */
+/*
+ * Once cmnutil_interrupt() ran, which is async-signal-safe, the functions
+ * below as well as FdReader and ShmRing give up on the next EINTR rather
+ * than retry; that is how a signal handler stops a run blocked in I/O.
+ */
+void    cmnutil_interrupt();
+bool    cmnutil_interrupted();
+/*
+ * All of the following retry on EINTR and wait with poll() on EAGAIN, so they
+ * work on both blocking and non-blocking descriptors.
+ * bseq_read() returns less than 'count' only if end of file is reached.
+ * bseq_writev() advances the entries of 'iov' as it goes, so their content
+ * is clobbered on return.
+ */
 ssize_t bseq_read(int fd, void *seq, size_t count);
 ssize_t bseq_write(int fd, const void *seq, size_t count);
+ssize_t bseq_writev(int fd, struct iovec *iov, int iovcnt);
+int     bseq_wait(int fd, short events);
+/*
+ * bseq_wait() with limits: fails with ETIMEDOUT once 'fd' stayed idle for
+ * 'idle_ms' milliseconds (0 for no limit) or once CLOCK_MONOTONIC passes
+ * 'deadline' (NULL for no limit), whichever comes first.
+ */
+int     bseq_wait_until(int                    fd,
+                        short                  events,
+                        uint64_t               idle_ms,
+                        const struct timespec *deadline);
+/* The CLOCK_MONOTONIC time 'ms' milliseconds from now. */
+struct timespec cmnutil_deadline(uint64_t ms);
+/* Milliseconds left until 'deadline' (as above), 0 once it passed. */
+int     cmnutil_remaining(const struct timespec &deadline);
+/*
+ * Zero-copy counterparts for pipes: bseq_vmsplice() maps 'count' bytes of
+ * 'seq' into the pipe 'fd' by reference, so those bytes must NOT change
+ * until the reader consumes them; bseq_splice() moves 'count' bytes from the
+ * pipe 'fd_in' to 'fd_out' without passing through user space.
+ */
+ssize_t bseq_vmsplice(int fd, const void *seq, size_t count);
+ssize_t bseq_splice(int fd_in, int fd_out, size_t count);
 
 /*
                         +-----------------------------+
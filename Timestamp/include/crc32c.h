@@ -0,0 +1,46 @@
+/**
+ * @file crc32c.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Header declaration of the CRC32C (Castagnoli) checksum protecting frames
+ * against corruption; the SSE4.2 instruction computes it where the CPU has
+ * it, slicing-by-8 tables elsewhere.
+ */
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+/* Bytes of the checksum trailer a protected frame ends with. */
+#define CRC32C_SIZE 4U
+
+/*
+ * CRC32C of the 'len' bytes at 'data', continuing from 'crc', the result
+ * of the bytes before them (0 to start with).
+ */
+uint32_t crc32c(uint32_t crc, const void *data, size_t len);
+/* Whether crc32c() runs on the SSE4.2 instruction. */
+bool     crc32c_accelerated();
+
+#endif /* CRC32C_H */
@@ -0,0 +1,130 @@
+/**
+ * @file daemon.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Header declaration of the TimeStampDaemon class; a resident ts that runs
+ * the sender or the receiver on request, so that back to back runs pay
+ * neither for starting a process nor for warming one up.
+ *
+ * A client connects to the Unix stream socket of the daemon and writes one
+ * line, the options of the run (see DaemonRequest::parse()).  From then on
+ * the connection carries the frames of that run, to the daemon for "-r" and
+ * from it for "-s".  Once the run is over the daemon writes its summary if
+ * "-S" asked for one, then a last line of either "ok" or "error: " and
+ * why, and closes the connection.  A client that does not send its line
+ * within DAEMON_REQUEST_MS is turned away.
+ */
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "timestamp.h"
+
+/* Bytes a request line may take, its newline included. */
+#define DAEMON_REQUEST_MAX 1024U
+/* Milliseconds a client has to send its request line in. */
+#define DAEMON_REQUEST_MS  5000U
+/* The --idle-timeout of a receive request that sets no limit of its own. */
+#define DAEMON_IDLE_MS     10000U
+
+struct DaemonRequest {
+        explicit DaemonRequest(const TimeStampOption &defaults);
+
+        /*
+         * Reads the whitespace separated options of 'line' as ts would:
+         * exactly one of -r and -s, -c COUNT, -b PAD, -S, --raw, --crc,
+         * --rate, --clock, --payload, and for the receiver --reorder,
+         * --timeout, --idle-timeout and "--log FILE" in place of
+         * TIMESTAMP_OUTPUT; a receiver without it keeps no log, and one
+         * without either timeout gets DAEMON_IDLE_MS as --idle-timeout.
+         * Throws invalid_argument naming what it cannot take.
+         */
+        void            parse(const char *line);
+
+        bool            send;
+        size_t          pad;
+        size_t          count;
+        bool            stats;
+        std::string     log;
+        /* The options of the daemon, with those of the request on top. */
+        TimeStampOption option;
+};
+
+class TimeStampDaemon final {
+public:
+        TimeStampDaemon()                                    = delete;
+        TimeStampDaemon(const TimeStampDaemon &)             = delete;
+        TimeStampDaemon(const TimeStampDaemon &&)            = delete;
+        /*
+         * Listens at 'path', in the abstract namespace if it starts with
+         * '@', replacing a socket file no daemon listens at any more; every
+         * request starts from 'defaults', which the engine has to cover.
+         * Throws runtime_error if the socket cannot be set up.
+         */
+        TimeStampDaemon(const char *path, const TimeStampOption &defaults);
+        /*
+         * Shuts the connections of the runs in progress down, so that no
+         * client holds the daemon up, waits for those runs to end, then
+         * removes the socket file.
+         */
+        ~TimeStampDaemon();
+
+        /*
+         * Warms the engine and the heap up, then serves every connection
+         * on a thread of its own until stop() or cmnutil_interrupted();
+         * -1 if accepting connections failed otherwise.
+         * SIGPIPE is ignored from then on, so that a client going away only
+         * fails its own run.
+         */
+        int      serve();
+        /* Makes serve() return; any thread may call it. */
+        void     stop();
+        /* Runs served so far, failed ones included. */
+        uint64_t served() const;
+
+        TimeStampDaemon &operator =(const TimeStampDaemon &)  = delete;
+        TimeStampDaemon &operator =(const TimeStampDaemon &&) = delete;
+
+private:
+        /* data */
+        std::string             path_;
+        TimeStampOption         defaults_;
+        int                     listener_;
+        std::atomic<bool>       stopping_;
+        std::atomic<uint64_t>   served_;
+        std::mutex              mutex_;
+        std::condition_variable idle_;
+        /* Connections of the runs in progress; guarded by 'mutex_'. */
+        std::set<int>           active_;
+
+        void run_(int connection);
+};
+
+#endif /* DAEMON_H */
@@ -0,0 +1,126 @@
+/**
+ * @file engine.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Entry points of the compile-time specialized TimeStampEngine: they pick
+ * the instantiation of timestamp_tmp.h matching a run time configuration,
+ * so only engine.cpp pays for compiling all of them.
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <cstddef>
+#include <cstdio>
+
+#include "logfile.h"
+#include "timestamp.h"
+#include "traffic.h"
+
+/*
+ * Whether the engine covers 'option'; pipelining, batching and splicing
+ * are left to the TimeStamp class.
+ */
+bool timestamp_engine_supports(const TimeStampOption &option);
+/*
+ * Counterparts of TimeStamp::operator >>() and TimeStamp::operator <<()
+ * over the descriptor 'fd' (unused with 'option.shm'), logging to 'log';
+ * both throw runtime_error unless all of 'count' frames made it, or the
+ * run streams (see TimeStampOption::stream) and was cut short.
+ * Given the 'traffic' model the frames were sent by, the receiver draws
+ * the same departures again and reports the load they offered next to the
+ * one it saw to 'option.stats'; its frames are then as large as the model
+ * makes them, whatever 'pad' says.
+ * Note neither takes ownership of 'fd' or 'log'.
+ */
+void timestamp_engine_send(size_t                 pad,
+                           size_t                 count,
+                           int                    fd,
+                           const TimeStampOption &option);
+void timestamp_engine_receive(size_t                 pad,
+                              size_t                 count,
+                              int                    fd,
+                              FILE                  *log,
+                              const TimeStampOption &option,
+                              const TrafficSpec     *traffic = NULL);
+/* Same, but with a log that a streaming run rotates and reopens. */
+void timestamp_engine_receive(size_t                 pad,
+                              size_t                 count,
+                              int                    fd,
+                              LogFile               &log,
+                              const TimeStampOption &option,
+                              const TrafficSpec     *traffic = NULL);
+/*
+ * Both of the above at once, for a peer doing the same: frames go out
+ * through 'out' on a thread of their own while those of the peer come in
+ * through 'in'.  'option.stats' gets how long each direction took ahead
+ * of the summaries of both, one after the other; as the receiver here
+ * sees the peer's direction and the peer's this one, a single run of the
+ * two measures both directions of a link.
+ * Throws runtime_error once both directions are done if either failed.
+ * Note it takes ownership of neither 'in', 'out' nor 'log'.
+ */
+void timestamp_engine_duplex(size_t                 pad,
+                             size_t                 count,
+                             int                    in,
+                             int                    out,
+                             LogFile               &log,
+                             const TimeStampOption &option);
+/*
+ * Sends the frames of the schedule file at 'path' (see schedule.h) at the
+ * times and sizes it gives, only its first 'count' records unless 'count'
+ * is 0, and reports how far the departures strayed from the plan to
+ * 'option.stats'; 'option.rate' is ignored.
+ * Throws runtime_error if the schedule is unusable or not every frame of
+ * it made it.
+ */
+void timestamp_engine_replay(const char            *path,
+                             size_t                 count,
+                             int                    fd,
+                             const TimeStampOption &option);
+/*
+ * Same as timestamp_engine_replay(), but the departures are the first
+ * 'count' ones drawn from the traffic model 'spec' (see traffic.h), with
+ * 'pad' bytes of padding unless it models the frame sizes.
+ * Throws runtime_error if 'spec' is unusable, 'count' is 0 or not every
+ * frame made it.
+ */
+void timestamp_engine_model(const TrafficSpec     &spec,
+                            size_t                 pad,
+                            size_t                 count,
+                            int                    fd,
+                            const TimeStampOption &option);
+/*
+ * Measures the floor of the engine on this host: 'count' frames of 'pad'
+ * bytes are stamped, encoded and written to a pipe and read, decoded and
+ * stamped right back within this process, as 'option' says, so nothing
+ * but ts itself lies between the two stamps.  The cost of every step and
+ * the resulting Calibration go to 'out' (see calibration.h).
+ * Throws runtime_error if a frame does not fit into a pipe or a step
+ * fails.
+ */
+void timestamp_engine_calibrate(size_t                 pad,
+                                size_t                 count,
+                                FILE                  *out,
+                                const TimeStampOption &option);
+
+#endif /* ENGINE_H */
@@ -0,0 +1,112 @@
+/**
+ * @file fdreader.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Header declaration of the FdReader class; a buffered reader working on a
+ * raw file descriptor that hands out frames as pointers into its own page
+ * aligned buffer, so neither stdio nor BIO copies sit on the receive path.
+ */
+
+#ifndef FDREADER_H
+#define FDREADER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h> /* ssize_t */
+#include <time.h>      /* struct timespec */
+
+#ifdef __cplusplus
+}
+#endif
+
+class FdReader final {
+public:
+        /*
+         * Prohibits compiler-generated default/copy/move constructors to avoid
+         * double free.
+         * Note the class does NOT take ownership of 'fd'.
+         */
+        FdReader()                                   = delete;
+        FdReader(const FdReader &)                   = delete;
+        FdReader(const FdReader &&)                  = delete;
+        FdReader(int fd, size_t capacity = 1U << 20);
+        ~FdReader();
+
+        /*
+         * Returns 'len' contiguous bytes read from the descriptor, or NULL on
+         * error or if end of file is reached before 'len' bytes arrive;
+         * the pointer stays valid until the next call.
+         */
+        const void *next(size_t len);
+
+        /*
+         * Non-blocking counterparts of next() for event loops:
+         * fill() issues a single read() (returning its result as is, so -1
+         * with EAGAIN means nothing is available yet), peek() returns 'len'
+         * buffered bytes or NULL without reading, skip() consumes them.
+         */
+        ssize_t     fill();
+        const void *peek(size_t len);
+        void        skip(size_t len);
+        /*
+         * Every byte buffered, waiting for at least one if there is none;
+         * NULL at end of file or on error.  For parsers that take input in
+         * whatever pieces it comes, skip() what they have consumed.
+         */
+        const void *some(size_t *len);
+
+        int         fd() const;
+        /*
+         * From now on next() and some() give up waiting as bseq_wait_until()
+         * does and timed_out() tells so; the descriptor is switched to
+         * non-blocking mode until destruction.  'deadline' is copied.
+         */
+        void        limit(uint64_t idle_ms, const struct timespec *deadline);
+        bool        timed_out() const;
+
+        FdReader &operator =(const FdReader &other)  = delete;
+        FdReader &operator =(const FdReader &&other) = delete;
+
+private:
+        /* data */
+        int              fd_;
+        size_t           capacity_;
+        size_t           begin_;
+        size_t           end_;
+        char            *buffer_;
+        /* Descriptor flags to restore, -1 if limit() never changed them. */
+        int              flags_;
+        uint64_t         idle_ms_;
+        bool             limited_;
+        bool             timed_out_;
+        struct timespec  deadline_;
+
+        int              reserve_(size_t len);
+        int              wait_();
+};
+
+#endif /* FDREADER_H */
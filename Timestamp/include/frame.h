@@ -0,0 +1,72 @@
+/**
+ * @file frame.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Wire format of a frame, shared by ts and every tool that relays or
+ * inspects its frames: a fixed header followed by 'length' padding bytes.
+ * All fields are in host byte order, so both ends must share an ABI.
+ */
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <cstdint>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <time.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+/*
+ * The frame is a placeholder for one a relay dropped on purpose, so that
+ * the receiver can account for it without waiting; it carries no padding.
+ */
+#define FRAME_FLAG_LOST 0x1U
+/*
+ * The last 4 bytes of the padding, counted in 'length', are a CRC32C of the
+ * header and the rest of the padding (see crc32c.h).
+ */
+#define FRAME_FLAG_CRC  0x2U
+
+/*
+ * Largest 'length' a receiver takes on trust unless its own padding is
+ * longer: a header damaged in transit must not have it allocate and wait
+ * for gigabytes.  Longer frames, e.g. of a schedule, need that much -b.
+ */
+#define FRAME_LENGTH_MAX (64U << 20)
+
+struct FrameHeader {
+        /* Position of the frame within its run, starting from 0. */
+        uint64_t        seq;
+        /* CLOCK_REALTIME reading of the sender right before sending. */
+        struct timespec timespec;
+        /* Number of padding bytes following the header. */
+        uint32_t        length;
+        uint32_t        flags;
+};
+
+#endif /* FRAME_H */
@@ -0,0 +1,84 @@
+/**
+ * @file histogram.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Header declaration of the Histogram class; a fixed-size log-linear
+ * histogram of nanosecond values, so recording a sample is O(1) and the
+ * memory footprint does not depend on how many samples are recorded.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+
+class Histogram final {
+public:
+        /*
+         * Each power of two is split into 2 ^ (SUB_BITS - 1) linear
+         * sub-buckets, so the relative error of any reported value is
+         * bounded by 1 / 2 ^ (SUB_BITS - 1), which is about 1.6%.
+         */
+        static const unsigned SUB_BITS     = 7U;
+        static const size_t   BUCKET_COUNT = (64U - SUB_BITS + 2U) <<
+                                             (SUB_BITS - 1U);
+
+        Histogram();
+
+        void     clear();
+        void     merge(const Histogram &other);
+        /* Negative values (clock skew between hosts) are counted apart. */
+        void     record(int64_t value);
+
+        uint64_t count() const;
+        uint64_t negative() const;
+        int64_t  min() const;
+        int64_t  max() const;
+        double   mean() const;
+        /* 'quantile' is within [0, 1]; returns 0 if nothing is recorded. */
+        int64_t  percentile(double quantile) const;
+        /*
+         * The 1-based nearest rank ceil(quantile * count), tolerant of the
+         * rounding of the product so that 0.07 * 100 ranks 7 rather than 8.
+         */
+        static uint64_t rank(double quantile, uint64_t count);
+        /*
+         * Values recorded below 'value', to the resolution of the buckets:
+         * those sharing its bucket are not counted.
+         */
+        uint64_t count_below(int64_t value) const;
+
+private:
+        /* data */
+        uint64_t count_;
+        uint64_t negative_;
+        int64_t  min_;
+        int64_t  max_;
+        double   sum_;
+        uint64_t bucket_[BUCKET_COUNT];
+
+        static size_t   index_(uint64_t value);
+        static uint64_t upper_(size_t index);
+};
+
+#endif /* HISTOGRAM_H */
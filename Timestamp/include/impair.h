@@ -0,0 +1,143 @@
+/**
+ * @file impair.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Header declaration of the Impairment class; a frame-aware relay that
+ * emulates what tc/netem does to a link (delay, jitter, loss, reordering
+ * and a rate limit) between a ts sender and a ts receiver on one host.
+ */
+
+#ifndef IMPAIR_H
+#define IMPAIR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+struct ImpairOption {
+        ImpairOption();
+
+        /* Fixed one-way delay and the half width of the uniform jitter. */
+        uint64_t delay_ns;
+        uint64_t jitter_ns;
+        /* Probabilities within [0, 1]. */
+        double   loss;
+        double   reorder;
+        /*
+         * In the default stream mode frames leave in the order they came,
+         * like over TCP: a lost frame is retransmitted 'rto_ns' later and
+         * holds back every frame behind it.  In datagram mode a lost frame
+         * is replaced by a FRAME_FLAG_LOST placeholder, and jitter as well
+         * as 'reorder' let frames overtake each other.
+         */
+        bool     datagram;
+        uint64_t rto_ns;
+        /* Token bucket; a 'rate_bps' of 0 leaves the rate unlimited. */
+        uint64_t rate_bps;
+        uint64_t burst;
+        /* Frames held at most; reading stops while the relay is full. */
+        size_t   queue;
+        uint64_t seed;
+};
+
+class Impairment final {
+public:
+        Impairment()                                     = delete;
+        Impairment(const Impairment &)                   = delete;
+        Impairment(const Impairment &&)                  = delete;
+        explicit Impairment(const ImpairOption &option);
+        ~Impairment();
+
+        /*
+         * Relays frames from 'in_fd' to 'out_fd' until end of file is reached
+         * on 'in_fd' and every frame held has left; 'in_fd' is switched to
+         * non-blocking mode.  Returns 0 on success, -1 on error.
+         */
+        int  run(int in_fd, int out_fd);
+        /* Prints the counters as "key value" lines. */
+        void report(FILE *stream) const;
+
+        Impairment &operator =(const Impairment &)       = delete;
+        Impairment &operator =(const Impairment &&)      = delete;
+
+private:
+        static const uint32_t NIL        = UINT32_MAX;
+        /* A tick of the wheel is 2 ^ TICK_SHIFT ns, about 8 microseconds. */
+        static const unsigned TICK_SHIFT = 13U;
+        static const size_t   SLOTS      = 1U << 14;
+        static const size_t   WORDS      = SLOTS / 64U;
+
+        /* A frame held by the relay; linked into a wheel slot or 'ready_'. */
+        struct Packet_ {
+                uint64_t tick;
+                char    *data;
+                uint32_t size;
+                uint32_t klass;
+                uint32_t next;
+        };
+        struct List_ {
+                uint32_t head;
+                uint32_t tail;
+        };
+        struct Counter_ {
+                uint64_t in;
+                uint64_t out;
+                uint64_t lost;
+                uint64_t retransmitted;
+                uint64_t reordered;
+                uint64_t throttled;
+                uint64_t writes;
+                size_t   held_max;
+        };
+
+        /* data */
+        ImpairOption               option_;
+        std::vector<Packet_>       packet_;
+        std::vector<uint32_t>      free_;
+        /* Recycled frame buffers, one free list per power of two size. */
+        std::vector<std::vector<char *>> bucket_;
+        std::vector<List_>         wheel_;
+        /* A bit per slot of 'wheel_' holding any frame. */
+        std::vector<uint64_t>      occupied_;
+        /* Frames overdue by more than a rotation, see advance_(). */
+        std::vector<uint32_t>      overdue_;
+        List_                      ready_;
+        uint64_t                   tick_;
+        size_t                     held_;
+        size_t                     wheeled_;
+        uint64_t                   last_release_;
+        double                     tokens_;
+        uint64_t                   token_time_;
+        uint64_t                   rng_[2];
+        Counter_                   counter_;
+
+        int      admit_(const char *frame, size_t size, uint64_t now);
+        void     advance_(uint64_t now);
+        int      flush_(int out_fd);
+        uint64_t next_due_() const;
+        void     append_(List_ *list, uint32_t index);
+        char    *allocate_(size_t size, uint32_t *klass);
+        double   uniform_();
+};
+
+#endif /* IMPAIR_H */
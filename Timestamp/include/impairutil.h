@@ -0,0 +1,77 @@
+/**
+ * @file impairutil.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Private header containing headers, and functions with internal linkages
+ * used by tsimpair.cpp.
+ */
+
+#if !defined(IMPAIRUTIL_H) && defined(TSIMPAIRONLY)
+#define IMPAIRUTIL_H
+
+#include <cerrno>    /* errno */
+#include <cinttypes> /* strtoumax() */
+#include <cstddef>   /* NULL */
+#include <cstdint>   /* uintmax_t */
+#include <cstdio>    /* fprintf() */
+#include <cstdlib>   /* EXIT_FAILURE EXIT_SUCCESS strtod() */
+#include <cstring>   /* strcmp() */
+#include <string>
+#include <stdexcept> /* runtime_error */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <getopt.h>  /* getopt_long() */
+#include <unistd.h>  /* STDIN_FILENO STDOUT_FILENO */
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "cmnutil.h"
+#include "impair.h"
+
+/* Values returned by getopt_long() for the options without a short form. */
+#define OPT_BURST    0x100
+#define OPT_DATAGRAM 0x101
+#define OPT_RTO      0x102
+#define OPT_SEED     0x103
+
+struct ImpairArgument {
+        bool          stats;
+        ImpairOption  option;
+};
+
+static ImpairArgument argument_parse(int argc, char *argv[]);
+static bool           number_validate(const char *const candidate,
+                                      uintmax_t *result);
+static bool           percent_validate(const char *const candidate,
+                                       double *result);
+static bool           rate_validate(const char *const candidate,
+                                    uint64_t *result);
+static void           usage(const char *name,
+                            int status,
+                            const char *msg = NULL);
+
+#endif /* IMPAIRUTIL_H */
@@ -0,0 +1,90 @@
+/**
+ * @file jitter.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Header declaration of the Jitter class; the delay variation metrics of a
+ * receiver, kept online with O(1) work per frame: the interarrival jitter
+ * of RFC 3550, the gaps between arrivals, and the IP packet delay
+ * variation of RFC 3393 between consecutive frames.
+ */
+
+#ifndef JITTER_H
+#define JITTER_H
+
+#include <cstdint>
+
+#include "histogram.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <time.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+class Jitter final {
+public:
+        Jitter();
+
+        /*
+         * Forgets the statistics, but neither the last frame nor the running
+         * jitter, so consecutive periods of one run line up.
+         */
+        void     clear();
+        /*
+         * A frame with a one-way delay of 'transit' nanoseconds arrived at
+         * 'received'; frames are taken in the order they arrived.
+         */
+        void     record(const struct timespec &received, int64_t transit);
+
+        /* The smoothed jitter J of RFC 3550 section 6.4.1, in nanoseconds. */
+        double   jitter() const;
+        /* Gaps between consecutive arrivals. */
+        int64_t  interarrival_min() const;
+        double   interarrival_mean() const;
+        int64_t  interarrival_max() const;
+        /* Magnitudes of the delay variation between consecutive frames. */
+        const Histogram &ipdv() const;
+        /* The delay variation itself, the sign included. */
+        int64_t  ipdv_min() const;
+        int64_t  ipdv_max() const;
+
+private:
+        /* data */
+        bool      started_;
+        /* Arrival of the last frame before the first gap counted. */
+        int64_t   first_;
+        int64_t   arrival_;
+        int64_t   transit_;
+        /* Scaled by 16 as in appendix A.8 of RFC 3550. */
+        int64_t   jitter_;
+        int64_t   gap_min_;
+        int64_t   gap_max_;
+        int64_t   ipdv_min_;
+        int64_t   ipdv_max_;
+        Histogram ipdv_;
+};
+
+#endif /* JITTER_H */
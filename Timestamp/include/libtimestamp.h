@@ -0,0 +1,137 @@
+/**
+ * @file libtimestamp.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * C interface of the timestamp library, for programs that want to emit or
+ * consume ts compatible frames in-process instead of through a ts process.
+ * Everything but the frame header is opaque, so the layout of the objects
+ * behind the handles may change without breaking callers; declarations are
+ * only ever added, any incompatible change bumps TS_API_VERSION.
+ */
+
+#ifndef LIBTIMESTAMP_H
+#define LIBTIMESTAMP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define TS_API __attribute__((visibility("default")))
+#else
+#define TS_API
+#endif
+
+#define TS_API_VERSION 1
+
+/*
+ * Wire format of a frame, the same as FrameHeader of frame.h: the header is
+ * followed by 'length' padding bytes, all fields in host byte order.
+ */
+#define TS_FRAME_FLAG_LOST 0x1U
+/* The padding ends in a CRC32C trailer, as sent by 'ts --crc'. */
+#define TS_FRAME_FLAG_CRC  0x2U
+
+struct ts_frame_header {
+        uint64_t        seq;
+        /* Wall clock reading of the sender right before sending. */
+        struct timespec stamp;
+        uint32_t        length;
+        uint32_t        flags;
+};
+
+/* Flags of ts_sender_open() and ts_receiver_open(). */
+/* Binary frames as with 'ts --raw', rather than base64. */
+#define TS_RAW          0x1U
+/* Stamps with CLOCK_REALTIME_COARSE as with 'ts --clock coarse'. */
+#define TS_COARSE_CLOCK 0x2U
+
+/* Latency statistics, kept the way 'ts -r -S' keeps them. */
+typedef struct ts_stats    ts_stats;
+typedef struct ts_sender   ts_sender;
+typedef struct ts_receiver ts_receiver;
+
+/* TS_API_VERSION of the library actually loaded. */
+TS_API unsigned  ts_api_version(void);
+
+/* NULL if out of memory. */
+TS_API ts_stats *ts_stats_new(void);
+TS_API void      ts_stats_free(ts_stats *stats);
+TS_API void      ts_stats_record(ts_stats *stats, int64_t latency_ns);
+/* Records the latency of a frame received at 'received', or its loss. */
+TS_API void      ts_stats_record_frame(ts_stats                     *stats,
+                                       const struct ts_frame_header *header,
+                                       const struct timespec        *received);
+TS_API uint64_t  ts_stats_count(const ts_stats *stats);
+TS_API uint64_t  ts_stats_lost(const ts_stats *stats);
+TS_API uint64_t  ts_stats_negative(const ts_stats *stats);
+TS_API int64_t   ts_stats_min(const ts_stats *stats);
+TS_API int64_t   ts_stats_max(const ts_stats *stats);
+TS_API double    ts_stats_mean(const ts_stats *stats);
+/* 'quantile' is within [0, 1]; 0 if nothing is recorded. */
+TS_API int64_t   ts_stats_percentile(const ts_stats *stats, double quantile);
+/*
+ * The interarrival jitter of RFC 3550 in nanoseconds; only frames recorded
+ * through ts_stats_record_frame() carry the arrival times it needs.
+ */
+TS_API double    ts_stats_jitter(const ts_stats *stats);
+/* Prints the summary of 'ts -r -S' to 'stream'; -1 on error. */
+TS_API int       ts_stats_report(const ts_stats *stats, FILE *stream);
+
+/*
+ * A sender writes frames numbered from 0 to the descriptor 'fd', which it
+ * does NOT take ownership of; NULL on error.
+ */
+TS_API ts_sender *ts_sender_open(int fd, unsigned flags);
+/*
+ * Stamps and sends one frame padded with the 'len' bytes of 'padding', or
+ * with zeros if it is NULL; -1 on error.
+ */
+TS_API int        ts_sender_send(ts_sender  *sender,
+                                 const void *padding,
+                                 size_t      len);
+/* Flushes what the encoding still holds back and frees 'sender'. */
+TS_API int        ts_sender_close(ts_sender *sender);
+
+/* A receiver reads frames from 'fd', which it does NOT take ownership of. */
+TS_API ts_receiver    *ts_receiver_open(int fd, unsigned flags);
+/*
+ * Waits for the next frame and stamps its arrival in 'received'; either
+ * may be NULL.  Returns 1 for a frame and 0 at end of stream or on error.
+ * The padding is skipped; every frame is recorded in the statistics.
+ */
+TS_API int             ts_receiver_next(ts_receiver            *receiver,
+                                        struct ts_frame_header *header,
+                                        struct timespec        *received);
+TS_API const ts_stats *ts_receiver_stats(const ts_receiver *receiver);
+TS_API void            ts_receiver_close(ts_receiver *receiver);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBTIMESTAMP_H */
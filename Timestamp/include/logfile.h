@@ -0,0 +1,84 @@
+/**
+ * @file logfile.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Header declaration of the LogFile class; the per frame log of a receiver
+ * that may run for days, rotated by size or age and reopened on request.
+ */
+
+#ifndef LOGFILE_H
+#define LOGFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+class LogFile final {
+public:
+        LogFile()                                    = delete;
+        LogFile(const LogFile &)                     = delete;
+        LogFile(const LogFile &&)                    = delete;
+        /* Logs to 'stream', which is never rotated nor closed. */
+        explicit LogFile(FILE *stream);
+        /*
+         * Logs to a file created at 'path', which rotate() renames to
+         * "PATH.1" (shifting "PATH.1" to "PATH.2" and so on, the oldest
+         * of 'keep' of them dropped) once it holds 'bytes' bytes or is
+         * 'seconds' seconds old, either being 0 for no limit.
+         * Throws runtime_error if the file cannot be created.
+         */
+        LogFile(const char *path,
+                uint64_t    bytes,
+                uint64_t    seconds,
+                unsigned    keep);
+        ~LogFile();
+
+        FILE     *get() const;
+        /* Limits of the file, both 0 for a stream or a file kept whole. */
+        uint64_t  bytes() const;
+        uint64_t  seconds() const;
+        /*
+         * Both close the file and open a new one at the same path,
+         * rotate() after moving the old one out of the way, reopen()
+         * appending to whatever is there now, i.e. after logrotate moved
+         * it; the stream is left as it is.  They return the file to go
+         * on with and throw runtime_error if there is none.
+         */
+        FILE     *rotate();
+        FILE     *reopen();
+
+        LogFile &operator =(const LogFile &)         = delete;
+        LogFile &operator =(const LogFile &&)        = delete;
+
+private:
+        /* data */
+        FILE        *file_;
+        std::string  path_;
+        uint64_t     bytes_;
+        uint64_t     seconds_;
+        unsigned     keep_;
+
+        FILE *open_(const char *mode);
+};
+
+#endif /* LOGFILE_H */
@@ -0,0 +1,96 @@
+/**
+ * @file payload.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Header declaration of the PayloadGenerator class; it produces the padding
+ * that follows each stamp, optionally refreshed for every frame so that
+ * compressing transports cannot shrink the messages.
+ */
+
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum class PayloadMode : int {
+        /* Left as allocated, which is what ts always did. */
+        NONE,
+        ZERO,
+        /* A fixed 0x00 - 0xff byte ramp, handy when inspecting a capture. */
+        PATTERN,
+        /* Every byte of every frame regenerated. */
+        RANDOM,
+        /*
+         * Frames are consecutive windows of a random pool much larger than
+         * the window of common compressors, and only a sixteenth of a frame
+         * worth of the pool is regenerated per frame.
+         */
+        SLIDING
+};
+
+class PayloadGenerator final {
+public:
+        /*
+         * Prohibits compiler-generated default/copy/move constructors to avoid
+         * double free.
+         * 'slots' is the number of frames whose padding has to stay intact
+         * at the same time, e.g. the frames of one batch.
+         */
+        PayloadGenerator()                                          = delete;
+        PayloadGenerator(const PayloadGenerator &)                  = delete;
+        PayloadGenerator(const PayloadGenerator &&)                 = delete;
+        PayloadGenerator(PayloadMode mode,
+                         size_t      size,
+                         size_t      slots = 1U,
+                         uint64_t    seed  = 0x5eed5eed5eed5eedULL);
+        ~PayloadGenerator();
+
+        /* Padding of the next frame; 'size' bytes, valid for 'slots' calls. */
+        const char *next();
+
+        /* Returns false if 'name' is not one of the modes. */
+        static bool parse(const char *name, PayloadMode *mode);
+
+        PayloadGenerator &operator =(const PayloadGenerator &)      = delete;
+        PayloadGenerator &operator =(const PayloadGenerator &&)     = delete;
+
+private:
+        /* Independent xorshift128+ streams, interleaved word by word. */
+        static const unsigned LANES = 8U;
+
+        /* data */
+        PayloadMode  mode_;
+        size_t       size_;
+        size_t       stride_;
+        size_t       slots_;
+        size_t       slot_;
+        size_t       pool_;
+        size_t       offset_;
+        char        *buffer_;
+        uint64_t     s0_[LANES];
+        uint64_t     s1_[LANES];
+
+        void random_(char *data, size_t len);
+};
+
+#endif /* PAYLOAD_H */
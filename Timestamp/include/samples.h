@@ -0,0 +1,105 @@
+/**
+ * @file samples.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Header declaration of the SampleArray class and of the batch statistics
+ * over it; a whole receiver log held in memory as one column per field,
+ * summarized by every allowed CPU at once.
+ */
+
+#ifndef SAMPLES_H
+#define SAMPLES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/* The column heading a receiver log starts with. */
+#define SAMPLES_HEADING "DELTA,NORMALIZED"
+
+/*
+ * The samples of "DELTA,NORMALIZED" logs, in milliseconds; a struct of
+ * arrays so that each statistic streams through just the column it needs.
+ */
+class SampleArray final {
+public:
+        SampleArray();
+        SampleArray(const SampleArray &)                = delete;
+        SampleArray(const SampleArray &&)               = delete;
+
+        /*
+         * Appends the samples of a log, skipping any column heading; the
+         * parts of a rotated log can be loaded one after the other.
+         * Throws invalid_argument naming the first line it cannot read,
+         * which includes a field of a magnitude of 2^49 or more.
+         */
+        void                        load(FILE *stream);
+        void                        append(int64_t delta, int64_t normalized);
+        void                        clear();
+
+        size_t                      size() const;
+        const std::vector<int64_t> &delta() const;
+        const std::vector<int64_t> &normalized() const;
+
+        SampleArray &operator =(const SampleArray &)    = delete;
+        SampleArray &operator =(const SampleArray &&)   = delete;
+
+private:
+        /* Parses the complete lines of 'data', returning where they end. */
+        const char *parse_(const char *data, const char *end);
+
+        /* data */
+        std::vector<int64_t> delta_;
+        std::vector<int64_t> normalized_;
+        size_t               line_;
+};
+
+struct SampleSummary {
+        uint64_t              count;
+        int64_t               min;
+        int64_t               max;
+        double                mean;
+        /* Population standard deviation. */
+        double                stddev;
+        /*
+         * Exact nearest-rank percentiles, the same definition as
+         * Histogram::percentile(), in the order the quantiles were given.
+         */
+        std::vector<int64_t>  percentile;
+};
+
+/*
+ * Summarizes the 'count' values at 'data' on 'threads' threads, 0 for one
+ * per allowed CPU; every value stays below 2^49 in magnitude, as those of
+ * a loaded log do.  Each quantile lies within [0, 1].
+ */
+SampleSummary sample_summarize(const int64_t             *data,
+                               size_t                     count,
+                               const std::vector<double> &quantiles,
+                               unsigned                   threads = 0U);
+/* The CPUs the calling thread may run on, at least 1. */
+unsigned      sample_threads();
+/* Whether the moments run on AVX2 vectors. */
+bool          sample_accelerated();
+
+#endif /* SAMPLES_H */
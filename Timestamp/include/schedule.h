@@ -0,0 +1,83 @@
+/**
+ * @file schedule.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Header declaration of the Schedule class; a departure schedule, one
+ * "INTERVAL_NS FRAME_BYTES" record per line, read straight out of a memory
+ * mapping so that a trace of any size replays without being loaded.
+ */
+
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <cstddef>
+#include <cstdint>
+
+class Schedule final {
+public:
+        Schedule()                                   = delete;
+        Schedule(const Schedule &)                   = delete;
+        Schedule(const Schedule &&)                  = delete;
+        /*
+         * Maps the file at 'path' and checks every record up front, so that
+         * a replay never stops halfway on a typo.  Each record is the time
+         * since the previous departure (the start of the replay for the
+         * first one) in nanoseconds and the size of the frame in bytes,
+         * header included; '#' starts a comment.
+         * Throws runtime_error if the file cannot be mapped, has no records
+         * or a malformed one.
+         */
+        explicit Schedule(const char *path);
+        ~Schedule();
+
+        /* The next record, as the padding it leaves; false past the last. */
+        bool     next(uint64_t *interval, size_t *pad);
+        /* Starts over from the first record. */
+        void     rewind();
+
+        size_t   count() const;
+        /* Largest padding of any record. */
+        size_t   max_pad() const;
+
+        Schedule &operator =(const Schedule &)       = delete;
+        Schedule &operator =(const Schedule &&)      = delete;
+
+private:
+        /* data */
+        const char *begin_;
+        const char *end_;
+        const char *cursor_;
+        /* Where the pages handed back to the kernel end, see release_(). */
+        const char *released_;
+        size_t      length_;
+        size_t      count_;
+        size_t      max_pad_;
+
+        void               release_();
+        static const char *parse_(const char *cursor,
+                                  const char *end,
+                                  uint64_t   *interval,
+                                  size_t     *pad,
+                                  int        *kind);
+};
+
+#endif /* SCHEDULE_H */
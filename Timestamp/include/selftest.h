@@ -0,0 +1,138 @@
+/**
+ * @file selftest.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Header declaration of the SelfTest class; it forks a ts sender and a ts
+ * receiver connected by a local channel and measures what ts itself can
+ * sustain, without any real network in between.
+ */
+
+#ifndef SELFTEST_H
+#define SELFTEST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <vector>
+
+#include "impair.h"
+#include "timestamp.h"
+
+enum class SelfTestChannel : int {
+        PIPE,
+        SOCKETPAIR,
+        TCP,
+        UDP,
+        /* A ShmRing, no descriptors involved. */
+        SHM
+};
+
+struct SelfTestOption {
+        SelfTestOption();
+
+        SelfTestChannel       channel;
+        /* CPUs the two ends are pinned to; -1 leaves it to the scheduler. */
+        int                   send_cpu;
+        int                   recv_cpu;
+        /*
+         * With 'impair' set the frames pass through an Impairment relay of
+         * their own, running in a third process on 'relay_cpu'; both of its
+         * sides use 'channel'.
+         */
+        bool                  impair;
+        ImpairOption          impairment;
+        int                   relay_cpu;
+        /* Frames sent for every point of the sweep. */
+        size_t                count;
+        /* The sweep covers every combination of the two. */
+        std::vector<size_t>   pads;
+        std::vector<uint64_t> rates;
+        /* Passed on to both ends; 'raw' is always turned on. */
+        TimeStampOption       timestamp;
+
+        static bool parse(const char *name, SelfTestChannel *channel);
+        static const char *name(SelfTestChannel channel);
+};
+
+/* Outcome of one point of the sweep; latencies are in nanoseconds. */
+struct SelfTestResult {
+        enum class Status : int {
+                OK,
+                /* The receiver gave up or had to be killed. */
+                INCOMPLETE,
+                /* The point cannot be run over the channel. */
+                SKIPPED,
+                FAILED
+        };
+
+        size_t   pad;
+        uint64_t rate;
+        Status   status;
+        double   elapsed;
+        uint64_t frames;
+        uint64_t lost;
+        int64_t  p50;
+        int64_t  p99;
+        int64_t  max;
+};
+
+class SelfTest final {
+public:
+        SelfTest()                                       = delete;
+        SelfTest(const SelfTest &)                       = delete;
+        SelfTest(const SelfTest &&)                      = delete;
+        explicit SelfTest(const SelfTestOption &option);
+        ~SelfTest()                                      = default;
+
+        /*
+         * Runs a single point; the caller's stdio buffers are flushed.  The
+         * children carry on without exec(), so the caller must not have any
+         * other thread running.
+         */
+        SelfTestResult run(size_t pad, uint64_t rate) const;
+        /* Runs every point of the sweep and prints the table to 'stream'. */
+        int            sweep(FILE *stream) const;
+
+        static void    print_header(FILE *stream);
+        static void    print(FILE *stream, const SelfTestResult &result);
+
+        SelfTest &operator =(const SelfTest &)           = delete;
+        SelfTest &operator =(const SelfTest &&)          = delete;
+
+private:
+        /* data */
+        SelfTestOption option_;
+
+        int  channel_(int fd[2]) const;
+        int  receive_(int         fd,
+                      const char *shm,
+                      int         result_fd,
+                      size_t      pad) const;
+        int  send_(int fd, const char *shm, size_t pad, uint64_t rate) const;
+        int  relay_(int in_fd, int out_fd) const;
+        static bool pin_(int cpu);
+        static void isolate_(std::initializer_list<int> keep);
+        static void parse_(const char *summary, SelfTestResult *result);
+};
+
+#endif /* SELFTEST_H */
@@ -0,0 +1,130 @@
+/**
+ * @file shmring.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Header declaration of the ShmRing class; a single producer single
+ * consumer ring of fixed size frame slots living in a POSIX shared memory
+ * segment, the cheapest channel two processes on one host can have.
+ */
+
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "cmnutil.h"
+
+enum class ShmRingRole : int {
+        /* Creates the segment and removes it again when done. */
+        CONSUMER,
+        /* Waits for the consumer to create the segment. */
+        PRODUCER
+};
+
+class ShmRing final {
+public:
+        ShmRing()                                    = delete;
+        ShmRing(const ShmRing &)                     = delete;
+        ShmRing(const ShmRing &&)                    = delete;
+        /*
+         * 'name' follows the rules of shm_open(); 'frame' is the largest
+         * frame to be carried.  With 'spin' set an idle side busy waits,
+         * otherwise it spins briefly and then sleeps on a futex.
+         * Throws runtime_error if the segment cannot be set up.
+         */
+        ShmRing(const char *name, size_t frame, ShmRingRole role, bool spin);
+        /* A producer marks the end of the stream on destruction. */
+        ~ShmRing();
+
+        /* Producer: a free slot to fill, or NULL if the consumer is gone. */
+        void       *reserve();
+        /* Producer: publishes the slot returned by the last reserve(). */
+        void        commit();
+        /* Consumer: the oldest filled slot, or NULL at end of stream. */
+        const void *acquire();
+        /* Consumer: hands the slot returned by the last acquire() back. */
+        void        release();
+
+        size_t      slots() const;
+        /* Bytes a slot holds, at least the 'frame' it was created for. */
+        size_t      slot_size() const;
+        /* Times this side went to sleep on the futex. */
+        uint64_t    sleeps() const;
+        /*
+         * From now on a side gives up waiting once the ring stayed idle for
+         * 'idle_ms' milliseconds (0 for no limit) or once CLOCK_MONOTONIC
+         * passes 'deadline' (NULL for no limit) and timed_out() tells so;
+         * both are checked at least every 100 milliseconds.
+         */
+        void        limit(uint64_t idle_ms, const struct timespec *deadline);
+        bool        timed_out() const;
+
+        ShmRing &operator =(const ShmRing &)         = delete;
+        ShmRing &operator =(const ShmRing &&)        = delete;
+
+private:
+        /*
+         * Both indexes wrap around at 2^32 and are futex words in their
+         * own right; each side only ever writes its own cache line.
+         */
+        struct Control_ {
+                std::atomic<uint32_t> ready;
+                uint32_t              slot_size;
+                uint32_t              slot_count;
+                int32_t               consumer;
+                std::atomic<int32_t>  producer;
+                alignas(CMNUTIL_CACHE_LINE)
+                std::atomic<uint32_t> head;
+                std::atomic<uint32_t> head_waiter;
+                std::atomic<uint32_t> closed;
+                alignas(CMNUTIL_CACHE_LINE)
+                std::atomic<uint32_t> tail;
+                std::atomic<uint32_t> tail_waiter;
+        };
+
+        /* data */
+        const char        *name_;
+        ShmRingRole        role_;
+        bool               spin_;
+        Control_          *control_;
+        char              *slot_;
+        size_t             length_;
+        uint32_t           mask_;
+        uint32_t           slot_size_;
+        /* Private copies of the indexes, saving a shared load per frame. */
+        uint32_t           head_;
+        uint32_t           tail_;
+        uint64_t           sleeps_;
+        uint64_t           idle_ms_;
+        bool               limited_;
+        bool               timed_out_;
+        struct timespec    deadline_;
+
+        bool wait_(std::atomic<uint32_t> *word,
+                   std::atomic<uint32_t> *waiter,
+                   uint32_t               stale,
+                   int32_t                peer);
+};
+
+#endif /* SHMRING_H */
@@ -0,0 +1,74 @@
+/**
+ * @file statsutil.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Private header containing headers, and functions with internal linkages
+ * used by tsstats.cpp.
+ */
+
+#if !defined(STATSUTIL_H) && defined(TSSTATSONLY)
+#define STATSUTIL_H
+
+#include <cerrno>    /* errno */
+#include <cinttypes> /* PRId64 PRIu64 strtoumax() */
+#include <cstddef>   /* NULL */
+#include <cstdint>   /* uintmax_t */
+#include <cstdio>    /* fopen() fprintf() */
+#include <cstdlib>   /* EXIT_FAILURE EXIT_SUCCESS strtod() */
+#include <cstring>   /* strcmp() */
+#include <string>
+#include <stdexcept> /* invalid_argument runtime_error */
+#include <vector>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <getopt.h>  /* getopt_long() */
+#include <time.h>    /* clock_gettime() */
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "cmnutil.h"
+#include "samples.h"
+
+struct StatsArgument {
+        unsigned                  threads;
+        /* The percentiles as given, which also name them in the summary. */
+        std::vector<std::string>  percentiles;
+        std::vector<double>       quantiles;
+        std::vector<const char *> logs;
+};
+
+static StatsArgument argument_parse(int argc, char *argv[]);
+static double        elapsed(const struct timespec &start);
+static bool          number_validate(const char *const candidate,
+                                     uintmax_t *result);
+static bool          percentiles_validate(const char *const candidate,
+                                          StatsArgument *argument);
+static void          usage(const char *name,
+                           int status,
+                           const char *msg = NULL);
+
+#endif /* STATSUTIL_H */
@@ -0,0 +1,121 @@
+/**
+ * @file sweep.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Header declaration of the Sweep class; it runs every point of a matrix of
+ * padding sizes, rates and link impairments several times, several points
+ * at once on disjoint sets of CPUs, and summarizes each point with a 95%
+ * confidence interval.
+ */
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "selftest.h"
+
+/*
+ * The matrix to sweep; every list is a dimension and each combination of
+ * their values is a point.  A spec file holds one "key value[,value...]"
+ * line per setting, see load().
+ */
+struct SweepSpec {
+        SweepSpec();
+
+        SelfTestChannel       channel;
+        size_t                count;
+        size_t                repeat;
+        /* Experiments run at once; 0 picks one per disjoint CPU set. */
+        size_t                jobs;
+        /* CPUs to spread the experiments over; empty for all allowed. */
+        std::vector<int>      cpus;
+        std::vector<uint64_t> pads;
+        std::vector<uint64_t> rates;
+        /* Impairments, in microseconds and percent respectively. */
+        std::vector<uint64_t> delays;
+        std::vector<uint64_t> jitters;
+        std::vector<double>   losses;
+        std::vector<double>   reorders;
+        bool                  datagram;
+        uint64_t              rto;
+        /* Passed on to the sender and the receiver of every experiment. */
+        TimeStampOption       timestamp;
+
+        /*
+         * Reads settings from 'stream', overriding the defaults above;
+         * blank lines and '#' comments are skipped.
+         * Throws invalid_argument naming the offending line.
+         */
+        void load(FILE *stream);
+};
+
+class Sweep final {
+public:
+        Sweep()                                  = delete;
+        Sweep(const Sweep &)                     = delete;
+        Sweep(const Sweep &&)                    = delete;
+        explicit Sweep(const SweepSpec &spec);
+        ~Sweep()                                 = default;
+
+        /*
+         * Runs the whole matrix and prints one line per point to 'stream';
+         * returns -1 if any run did not complete, 0 otherwise.
+         */
+        int run(FILE *stream);
+
+        Sweep &operator =(const Sweep &)         = delete;
+        Sweep &operator =(const Sweep &&)        = delete;
+
+private:
+        struct Point_ {
+                uint64_t pad;
+                uint64_t rate;
+                uint64_t delay;
+                uint64_t jitter;
+                double   loss;
+                double   reorder;
+        };
+
+        /* data */
+        SweepSpec                   spec_;
+        std::vector<Point_>         point_;
+        /* Whether frames go through an Impairment relay at all. */
+        bool                        impair_;
+        /* CPUs each experiment takes, and how many such sets there are. */
+        size_t                      width_;
+        size_t                      sets_;
+        size_t                      jobs_;
+        std::vector<SelfTestResult> result_;
+
+        void          work_(size_t               slot,
+                            std::atomic<size_t> *next,
+                            SelfTestResult      *result) const;
+        void          print_(FILE *stream, size_t index) const;
+        static double t95_(size_t samples);
+};
+
+#endif /* SWEEP_H */
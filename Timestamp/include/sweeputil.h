@@ -0,0 +1,63 @@
+/**
+ * @file sweeputil.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Private header containing headers, and functions with internal linkages
+ * used by tssweep.cpp.
+ */
+
+#if !defined(SWEEPUTIL_H) && defined(TSSWEEPONLY)
+#define SWEEPUTIL_H
+
+#include <cerrno>    /* errno */
+#include <cinttypes> /* strtoumax() */
+#include <cstddef>   /* NULL */
+#include <cstdint>   /* uintmax_t */
+#include <cstdio>    /* fopen() fprintf() */
+#include <cstdlib>   /* EXIT_FAILURE EXIT_SUCCESS */
+#include <cstring>   /* strcmp() */
+#include <string>
+#include <stdexcept> /* invalid_argument runtime_error */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <getopt.h>  /* getopt_long() */
+#include <unistd.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "cmnutil.h"
+#include "sweep.h"
+
+/* Values returned by getopt_long() for the options without a short form. */
+#define OPT_CPUS     0x100
+
+static SweepSpec argument_parse(int argc, char *argv[]);
+static bool      number_validate(const char *const candidate,
+                                 uintmax_t *result);
+static void      usage(const char *name, int status, const char *msg = NULL);
+
+#endif /* SWEEPUTIL_H */
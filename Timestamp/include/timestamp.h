@@ -27,6 +27,7 @@
 #ifndef TIMESTAMP_H
 #define TIMESTAMP_H
 
+#include <cstdint>
 #include <cstdio>
 
 #ifdef __cplusplus
@@ -39,13 +40,158 @@ extern "C" {
 }
 #endif
 
+#include "calibration.h"
+#include "frame.h"
+#include "histogram.h"
+#include "jitter.h"
+#include "payload.h"
+
 enum class TimeStampMode : int {
         RECEIVE,
         SEND
 };
 
+/*
+ * Optional knobs of the TimeStamp class; a default constructed instance
+ * reproduces the original single-threaded behavior without any summary.
+ */
+struct TimeStampOption {
+        TimeStampOption();
+
+        /*
+         * Receiver only: the calling thread merely reads and stamps frames
+         * while a second thread takes care of the statistics and the log.
+         */
+        bool    pipeline;
+        /*
+         * Frames go straight through the file descriptors in binary, rather
+         * than base64 encoded through stdio; both ends have to agree on it.
+         */
+        bool    raw;
+        /* Number of samples the pipeline ring holds; a power of two. */
+        size_t  ring_size;
+        /*
+         * Sender in raw mode only: the padding is mapped once and handed to
+         * the pipe or socket by reference, so only the stamp is copied.
+         */
+        bool    splice;
+        /* Sender only: what goes into the padding of each frame. */
+        PayloadMode payload;
+        /*
+         * Sender in raw mode only: coalesces up to 'batch' frames into one
+         * writev(), or fewer once the oldest pending frame has waited for
+         * 'batch_usec' microseconds (0 for no time limit); every frame is
+         * still stamped when it is created rather than when it is written.
+         */
+        size_t  batch;
+        size_t  batch_usec;
+        /*
+         * Sender only: frames per second, each one due at a fixed offset
+         * from the start of the run so late frames catch up; 0 for as fast
+         * as possible.
+         */
+        uint64_t rate;
+        /*
+         * Frames go through the shared memory ring of this name instead of
+         * the file descriptors if non-NULL; the receiver creates it, the
+         * sender waits for it.  'shm_spin' makes an idle side busy wait
+         * rather than sleep on a futex.
+         */
+        const char *shm;
+        bool    shm_spin;
+        /*
+         * Clock the frames are stamped with on both ends, CLOCK_REALTIME or
+         * the cheaper but tick-grained CLOCK_REALTIME_COARSE.
+         */
+        clockid_t clock;
+        /* Receiver only: whether the per frame log is written at all. */
+        bool    log;
+        /*
+         * Lets callers that can choose (ts and its self-test) run supported
+         * configurations on the compile-time specialized TimeStampEngine of
+         * timestamp_tmp.h; the TimeStamp class itself ignores it.
+         */
+        bool    engine;
+        /* Summary of the run goes here if non-NULL; NOT owned by TimeStamp. */
+        FILE   *stats;
+        /*
+         * Engine only: a 'count' of 0 means no limit, and a run cut short by
+         * cmnutil_interrupt() (see timestamp_signal_install()) ends cleanly
+         * instead of failing; the receiver also summarizes every 'interval'
+         * seconds (0 for never) to 'stats'.
+         */
+        bool    stream;
+        uint64_t interval;
+        /*
+         * Receiver only: gives up once the whole run took 'timeout' or the
+         * input stayed idle for 'idle_timeout' milliseconds (0 for never),
+         * counting the frames still missing as lost instead of failing.
+         */
+        uint64_t timeout;
+        uint64_t idle_timeout;
+        /*
+         * Engine only, on both ends: every frame carries a CRC32C trailer
+         * and the receiver drops those failing the check as lost.
+         */
+        bool    crc;
+        /*
+         * Engine receiver only: frames go on to the statistics and the log
+         * in the order they were sent, through a ReorderSink window of this
+         * many frames, a power of two; 0 takes them as they arrive.
+         */
+        size_t  reorder;
+        /*
+         * Receiver only: the measurement floor taken off the latencies of
+         * the summary, if active(); the log keeps them as they were.
+         */
+        Calibration calibration;
+};
+
+/*
+ * Sleeps until frame 'i' of a run that started at 'start' (as of
+ * CLOCK_MONOTONIC) is due at 'rate' frames per second; the deadline is
+ * absolute, so time lost on one frame is made up on the following ones.
+ */
+void timestamp_pace(const struct timespec &start, uint64_t rate, size_t i);
+/* Sleeps until 'offset' nanoseconds past 'start' (as of CLOCK_MONOTONIC). */
+void timestamp_sleep_until(const struct timespec &start, uint64_t offset);
+/*
+ * Prints the latency summary of a receiver to 'stats' as "key value" lines;
+ * whatever else the receiver has to say follows it.  'what' names the
+ * summary in its heading, e.g. "interval" for the periodic ones.  The
+ * latencies go without the floor of 'calibration' if it is active().
+ */
+void timestamp_report(FILE              *stats,
+                      const Histogram   &delta,
+                      uint64_t           lost,
+                      const char        *what        = "receiver",
+                      const Calibration &calibration = Calibration());
+/* The delay variation of a receiver, printed after its latency summary. */
+void timestamp_report_jitter(FILE *stats, const Jitter &jitter);
+/*
+ * Lets a streaming run end cleanly: SIGTERM, SIGINT and SIGALRM (so that
+ * alarm() bounds a run) call cmnutil_interrupt(), and SIGHUP asks for the
+ * logs to be reopened, which timestamp_hangup() tells once.
+ */
+void timestamp_signal_install();
+bool timestamp_hangup();
+
+/*
+ * Writes 'size' timespecs as one comma separated line of milliseconds to
+ * 'log' and flushes it; -1 on error.
+ */
+int      timestamp_log_dump(FILE           *log,
+                            const timespec  timespec_array[],
+                            const size_t    size);
+/* 'end' - 'start', with tv_nsec always within [0, 1000000000). */
+timespec timestamp_diff(const timespec *end, const timespec *start);
+
 /* Only forward declaration needed in this header file. */
+class Base64Codec;
 class BIOWrapper;
+class FdReader;
+class FdTransport;
+class ShmRing;
 
 class TimeStamp final {
 public:
@@ -65,10 +211,11 @@ public:
          * parameters passed-in, so the caller DOES NOT need to
          * worry about freeing them.
          */
-        TimeStamp(size_t  pad_size  = 0,
-                  FILE   *input     = NULL,
-                  FILE   *output    = NULL,
-                  FILE   *log       = NULL);
+        TimeStamp(size_t                 pad_size = 0,
+                  FILE                  *input    = NULL,
+                  FILE                  *output   = NULL,
+                  FILE                  *log      = NULL,
+                  const TimeStampOption &option   = TimeStampOption());
         TimeStamp(const TimeStamp &)               = delete;
         TimeStamp(const TimeStamp &&)              = delete;
         TimeStamp &operator = (const TimeStamp &)  = delete;
@@ -83,24 +230,93 @@ public:
 private:
         /* data */
         struct Stamp_ {
-                struct timespec timespec;
+                FrameHeader     header;
                 char            padding[];
         };
+        /* What the reading side hands over to the logging side. */
+        struct Sample_ {
+                uint64_t        seq;
+                struct timespec sent;
+                struct timespec received;
+                uint32_t        flags;
+        };
+        /* Backpressure counters of the pipelined receiver. */
+        struct Pipeline_ {
+                uint64_t        full;
+                uint64_t        stall_ns;
+        };
+        /* Shape of the shared memory ring and how often the reader slept. */
+        struct Shm_ {
+                size_t          slots;
+                uint64_t        sleeps;
+        };
+        /* Counters of the sender; 'hold' is how long frames wait to go. */
+        struct Batch_ {
+                uint64_t        frames;
+                uint64_t        writes;
+                Histogram       hold;
+        };
         enum class LogSwitch_ : int {
                 OFF = 0,
                 ON
         };
-        size_t        pad_size_;
-        size_t        tot_size_;
-        FILE         *input_;
-        FILE         *output_;
-        FILE         *log_;
-        Stamp_       *stamp_;
-        BIOWrapper   *bio_base64_;
+        size_t           pad_size_;
+        size_t           tot_size_;
+        /* Padding the receive buffer of the base64 path can hold. */
+        size_t           pad_capacity_;
+        /* Longest padding a received frame may claim, see frame.h. */
+        size_t           length_max_;
+        FILE            *input_;
+        FILE            *output_;
+        FILE            *log_;
+        Stamp_          *stamp_;
+        BIOWrapper      *bio_base64_;
+        /* Only valid while receiving in raw mode. */
+        FdReader        *fd_input_;
+        /* Only valid while receiving through 'option_.shm'. */
+        ShmRing         *shm_input_;
+        /*
+         * Only valid while receiving base64 with 'option_.timeout' or
+         * 'option_.idle_timeout', see operator <<().
+         */
+        FdTransport     *base64_input_;
+        Base64Codec     *base64_codec_;
+        TimeStampOption  option_;
+        struct timespec  initial_;
+        uint64_t         consumed_;
+        uint64_t         lost_;
+        Histogram        delta_;
+        Jitter           jitter_;
+        Pipeline_        pipeline_;
+        Shm_             shm_;
+        Batch_           batch_;
+        /* Start of the run as of CLOCK_MONOTONIC; see 'option_.rate'. */
+        struct timespec  pace_start_;
+        /* End of the run as of CLOCK_MONOTONIC; see 'option_.timeout'. */
+        struct timespec  deadline_;
+        bool             timed_out_;
+        /* A frame claimed more than 'length_max_', the rest is unreadable. */
+        bool             overrun_;
+        uint64_t         missing_;
 
         void     io_control_(LogSwitch_ flip);
-        int      log_dump_(const timespec timespec_array[], const size_t size);
-        timespec timespec_diff_(const timespec *end, const timespec *start);
+        bool     read_sample_(Sample_ *sample);
+        bool     bio_read_full_(void *data, size_t len);
+        int      pad_reserve_(size_t len);
+        int      consume_(const Sample_ &sample);
+        size_t   receive_serial_(const size_t count);
+        size_t   receive_pipeline_(const size_t count);
+        size_t   send_base64_(const size_t count, PayloadGenerator &payload);
+        size_t   send_raw_(int               fd,
+                           const size_t      count,
+                           PayloadGenerator &payload);
+        size_t   send_splice_(int               fd,
+                              const size_t      count,
+                              PayloadGenerator &payload);
+        size_t   send_shm_(const size_t count, PayloadGenerator &payload);
+        void     pace_(const size_t i) const;
+        void     report_() const;
+        void     report_send_() const;
 };
 
 #endif /* TIMESTAMP_H */
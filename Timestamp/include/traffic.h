@@ -0,0 +1,154 @@
+/**
+ * @file traffic.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Header declaration of the TrafficModel class; a seeded stochastic source
+ * of departures, Poisson or on/off arrivals of fixed, Pareto or lognormal
+ * sized frames, handing out the same records a Schedule reads from a file.
+ */
+
+#ifndef TRAFFIC_H
+#define TRAFFIC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class ArrivalModel : int {
+        /* Evenly spaced at 'rate', or back to back if it is 0. */
+        CONSTANT,
+        /* Exponentially distributed gaps with a mean of 1 / 'rate'. */
+        POISSON,
+        /*
+         * Poisson at 'rate' while on, silent while off; both periods are
+         * exponentially distributed, with means of 'on_usec' and
+         * 'off_usec' (a two state Markov modulated Poisson process).
+         */
+        ONOFF
+};
+
+enum class SizeModel : int {
+        /* Every frame carries the same padding. */
+        FIXED,
+        /* Bounded Pareto frame sizes, of shape 'shape' from 'low' up. */
+        PARETO,
+        /* Lognormal frame sizes of median 'low', cut off at 'high'. */
+        LOGNORMAL
+};
+
+/* Frame sizes are in bytes and include the header, as in a Schedule. */
+struct TrafficSpec {
+        TrafficSpec();
+
+        /* Whether anything but evenly spaced, fixed size frames is asked. */
+        bool         active() const;
+
+        ArrivalModel arrival;
+        double       rate;
+        double       on_usec;
+        double       off_usec;
+        SizeModel    size;
+        double       shape;
+        double       low;
+        double       high;
+        uint64_t     seed;
+};
+
+class TrafficModel final {
+public:
+        TrafficModel()                                       = delete;
+        TrafficModel(const TrafficModel &)                   = delete;
+        TrafficModel(const TrafficModel &&)                  = delete;
+        /*
+         * 'count' departures of 'spec', frames of 'pad' bytes of padding
+         * if it has FIXED sizes.  The first million or so are drawn right
+         * here into a buffer allocated once, any others whenever it runs
+         * dry, so that the random number generator never runs between the
+         * stamp and the write of a frame.
+         * Throws runtime_error if 'spec' cannot be satisfied.
+         */
+        TrafficModel(const TrafficSpec &spec, size_t pad, size_t count);
+
+        /* Same as Schedule::next(). */
+        bool     next(uint64_t *interval, size_t *pad);
+        /* Starts over, from the seed, with the first departure. */
+        void     rewind();
+
+        size_t   count() const;
+        /* Largest padding the model can ever hand out. */
+        size_t   max_pad() const;
+        /* Long run average gap between departures, in nanoseconds. */
+        double   mean_interval() const;
+
+        /*
+         * Parse "poisson:RATE" and "onoff:RATE,ON_USEC,OFF_USEC", and
+         * "pareto:SHAPE,MIN,MAX" and "lognormal:MEDIAN,SIGMA,MAX"
+         * respectively into 'spec'; false if 'text' is none of them.
+         */
+        static bool parse_arrival(const char *text, TrafficSpec *spec);
+        static bool parse_size(const char *text, TrafficSpec *spec);
+
+        TrafficModel &operator =(const TrafficModel &)       = delete;
+        TrafficModel &operator =(const TrafficModel &&)      = delete;
+
+private:
+        struct Record_ {
+                uint64_t interval;
+                size_t   pad;
+        };
+
+        /* data */
+        TrafficSpec           spec_;
+        size_t                pad_;
+        size_t                count_;
+        size_t                max_pad_;
+        /* Departures drawn so far; 'cursor_' of the last 'filled_' left. */
+        size_t                drawn_;
+        std::vector<Record_>  buffer_;
+        size_t                cursor_;
+        size_t                filled_;
+        /*
+         * Model time of the last departure drawn, and the sum of the
+         * intervals handed out for it, which are rounded to nanoseconds
+         * without the rounding errors adding up.
+         */
+        double                elapsed_;
+        uint64_t              planned_;
+        /* xorshift128+ */
+        uint64_t              s0_;
+        uint64_t              s1_;
+        /* Whether the on/off source is on, and for how much longer. */
+        bool                  on_;
+        double                left_;
+        /* The second value of the last Box-Muller pair, if not NaN. */
+        double                spare_;
+
+        void     fill_();
+        void     seed_();
+        double   uniform_();
+        double   exponential_(double mean);
+        double   normal_();
+        double   gap_();
+        size_t   pad_of_();
+};
+
+#endif /* TRAFFIC_H */
@@ -34,14 +34,17 @@
 #include <cstdint>   /* uintmax_t */
 #include <cstdio>    /* fprintf() */
 #include <cstdlib>   /* EXIT_FAILURE EXIT_SUCCESS */
+#include <cstring>   /* strcmp() */
 #include <string>
-#include <stdexcept> /* runtime_error */
+#include <stdexcept> /* invalid_argument runtime_error */
+#include <vector>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #include <getopt.h>  /* getopt_long() */
+#include <sched.h>   /* CPU_SETSIZE */
 #include <sys/utsname.h> /* uname() */
 #include <unistd.h>
 
@@ -50,7 +53,12 @@ extern "C" {
 #endif
 
 #include "cmnutil.h"
+#include "daemon.h"
+#include "engine.h"
+#include "logfile.h"
+#include "selftest.h"
 #include "timestamp.h"
+#include "traffic.h"
 
 /**
  * @def ENV_TIMESTAMP_OUTPUT
@@ -59,14 +67,73 @@ extern "C" {
  */
 #define ENV_TIMESTAMP_OUTPUT "TIMESTAMP_OUTPUT"
 
+/*
+ * Values returned by getopt_long() for the options without a short form;
+ * they start past the range of 'unsigned char' so they can never collide
+ * with a short option character.
+ */
+#define OPT_RING_SIZE 0x100
+#define OPT_RAW       0x101
+#define OPT_BATCH     0x102
+#define OPT_BATCH_US  0x103
+#define OPT_SPLICE    0x104
+#define OPT_PAYLOAD   0x105
+#define OPT_SELF_TEST 0x106
+#define OPT_CHANNEL   0x107
+#define OPT_CPU       0x108
+#define OPT_PADS      0x109
+#define OPT_RATES     0x10a
+#define OPT_RATE      0x10b
+#define OPT_SHM       0x10c
+#define OPT_SHM_SPIN  0x10d
+#define OPT_CLOCK     0x10e
+#define OPT_NO_LOG    0x10f
+#define OPT_LEGACY    0x110
+#define OPT_SCHEDULE  0x111
+#define OPT_TRAFFIC   0x112
+#define OPT_SIZES     0x113
+#define OPT_SEED      0x114
+#define OPT_DURATION  0x115
+#define OPT_INTERVAL  0x116
+#define OPT_ROT_SIZE  0x117
+#define OPT_ROT_TIME  0x118
+#define OPT_ROT_KEEP  0x119
+#define OPT_TIMEOUT   0x11a
+#define OPT_IDLE      0x11b
+#define OPT_CRC       0x11c
+#define OPT_CALIBRATE 0x11d
+#define OPT_CALIB_IN  0x11e
+#define OPT_REORDER   0x11f
+#define OPT_DUPLEX    0x120
+#define OPT_DAEMON    0x121
+
 struct Argument {
-        size_t      block;
-        size_t      count;
-        const char *env_output_file;
+        size_t           block;
+        size_t           count;
+        const char      *env_output_file;
+        /* Sender only: the schedule file to replay, if non-NULL. */
+        const char      *schedule;
+        /*
+         * The traffic model to send by, or on the receiver the one the
+         * sender used, if active().
+         */
+        TrafficSpec      traffic;
+        TimeStampOption  option;
+        SelfTestOption   self_test;
+        /* Seconds a streaming run lasts, 0 for as long as it is fed. */
+        unsigned         duration;
+        /* Receiver only: see LogFile. */
+        uint64_t         rotate_bytes;
+        uint64_t         rotate_seconds;
+        unsigned         rotate_keep;
+        /* Daemon only: the socket it listens at. */
+        const char      *socket;
 };
 
 static Argument argument_parse(int *operating_mode, int argc, char *argv[]);
 static size_t   number_validate(const char *const candidate);
+static bool     list_validate(const char *const     candidate,
+                              std::vector<uint64_t> *result);
 static void     usage(const char *name, int status, const char *msg = NULL);
 
 #endif /* TSUTIL_H */
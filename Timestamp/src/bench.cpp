@@ -0,0 +1,1086 @@
+/**
+ * @file bench.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation source file of the Bench class.
+ * Every benchmark is calibrated first, doubling its amount of work until it
+ * takes a tenth of the minimum duration, which doubles as the warm-up; the
+ * calibrated amount is then timed 'repeat' times on CLOCK_MONOTONIC.
+ * A baseline file holds one "name ns tolerance" line per benchmark, '#'
+ * starting a comment.  The minimum of the runs is judged since interference
+ * from the rest of the machine only ever adds time.  --save writes the same
+ * format, so recording a baseline on a new machine means running ts-bench
+ * once.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "bench.h"
+#include "biowrapper.h"
+#include "cmnutil.h"
+#include "daemon.h"
+#include "impair.h"
+#include "selftest.h"
+#include "timestamp.h"
+#include "timestamp_tmp.h"
+
+#include <algorithm> /* sort() */
+#include <cinttypes> /* PRIu64 */
+#include <cstring>   /* memcmp() memset() strchr() strrchr() strstr() */
+#include <stdexcept> /* runtime_error */
+#include <thread>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <fcntl.h>      /* fcntl() open() */
+#include <sys/socket.h> /* connect() socket() */
+#include <sys/un.h>     /* struct sockaddr_un */
+#include <sys/wait.h>   /* waitpid() */
+#include <time.h>       /* clock_gettime() */
+#include <unistd.h>     /* access() execl() fork() pipe2() readlink() */
+
+#ifdef __cplusplus
+}
+#endif
+
+/* Frames worth of encoded data each pass of a decoding benchmark reads. */
+#define BENCH_PASS_BYTES (1U << 20)
+/*
+ * Tolerances in percent --save gives every benchmark; on a shared machine
+ * even the best of several runs varies twofold from one invocation to the
+ * next, so these only catch what is beyond that.  Quieter machines can
+ * tighten them line by line in the baseline.
+ */
+#define BENCH_TOLERANCE          150.0
+#define BENCH_TOLERANCE_P99      300.0
+/*
+ * Frames per second of the latency runs; an unpaced run would only measure
+ * how long frames queue in a full pipe.
+ */
+#define BENCH_P99_RATE           40000U
+
+/* Whether 'name' is a latency percentile rather than a time per operation. */
+static bool bench_latency(const std::string &name)
+{
+        return name.size() > 4U &&
+               0 == name.compare(name.size() - 4U, 4U, ".p99");
+}
+
+/* Keeps the optimizer from dropping the work that produced 'data'. */
+static inline void bench_keep(const void *data)
+{
+        __asm__ __volatile__("" : : "g"(data) : "memory");
+}
+
+/* Reads all of 'len' bytes from 'bio', which may return short. */
+static bool bench_read(const BIOWrapper &bio, void *data, size_t len)
+{
+        char *buffer = static_cast<char *>(data);
+        int   got    = 0;
+
+        while (0U != len) {
+                got = bio.read(buffer, narrow_cast<int, size_t>(len));
+                if (0 >= got) {
+                        return false;
+                }
+                buffer += got;
+                len    -= static_cast<size_t>(got);
+        }
+        return true;
+}
+
+static uint64_t bench_now()
+{
+        struct timespec now = { };
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return static_cast<uint64_t>(now.tv_sec) * 1000000000U +
+               static_cast<uint64_t>(now.tv_nsec);
+}
+
+/* A byte stream kept in memory, the transport of the codec benchmarks. */
+class BenchTransport final {
+public:
+        static constexpr bool STREAM = true;
+
+        BenchTransport()
+                :
+                data_{},
+                offset_{0U}
+        {
+        }
+
+        bool write(const char *data, size_t len)
+        {
+                data_.insert(data_.end(), data, data + len);
+                return true;
+        }
+
+        const char *read_some(size_t *len)
+        {
+                if (data_.size() == offset_) {
+                        return NULL;
+                }
+                *len = data_.size() - offset_;
+                return data_.data() + offset_;
+        }
+
+        void consume(size_t len)
+        {
+                offset_ += len;
+        }
+
+        void rewind()
+        {
+                offset_ = 0U;
+        }
+
+        void clear()
+        {
+                data_.clear();
+                offset_ = 0U;
+        }
+
+        size_t size() const
+        {
+                return data_.size();
+        }
+
+private:
+        /* data */
+        std::vector<char> data_;
+        size_t            offset_;
+};
+
+BenchOption::BenchOption()
+        :
+        repeat{5U},
+        min_ms{50U},
+        pads{0U, 64U, 1024U, 16384U},
+        count{100000U},
+        filter{NULL},
+        baseline{NULL},
+        strict{true},
+        ratios{NULL},
+        save{NULL}
+{
+}
+
+Bench::Bench(const BenchOption &option)
+        :
+        option_(option),
+        stream_{NULL},
+        status_{0}
+{
+        if (0U == option_.repeat) {
+                option_.repeat = 1U;
+        }
+}
+
+int Bench::run(FILE *stream)
+{
+        stream_ = stream;
+        status_ = 0;
+        judged_.clear();
+        if (NULL != option_.baseline) {
+                load_();
+        }
+        if (NULL != option_.ratios) {
+                load_ratios_();
+        }
+        fprintf(stream_,
+                "# ts-bench, median and minimum of %zu runs of at least "
+                "%" PRIu64 " ms each\n",
+                option_.repeat,
+                option_.min_ms);
+        fprintf(stream_,
+                "# %-30s %12s %12s %10s\n",
+                "name", "ns.median", "ns.min", "mb.per.s");
+        clock_();
+        diff_();
+        log_();
+        for (auto pad : option_.pads) {
+                base64_(pad);
+        }
+        for (auto pad : option_.pads) {
+                write_(pad);
+        }
+        for (auto pad : option_.pads) {
+                loopback_(pad);
+        }
+        impair_();
+        startup_();
+        if (NULL != option_.baseline) {
+                judge_();
+        }
+        if (NULL != option_.ratios) {
+                judge_ratios_();
+        }
+        if (NULL != option_.save) {
+                save_();
+        }
+        fflush(stream_);
+        return status_;
+}
+
+/* With a baseline or ratios, only what either of them names runs. */
+bool Bench::selected_(const std::string &name) const
+{
+        if (NULL != option_.filter &&
+            NULL == std::strstr(name.c_str(), option_.filter)) {
+                return false;
+        }
+        if (NULL == option_.baseline && NULL == option_.ratios) {
+                return true;
+        }
+        if (baseline_.end() != baseline_.find(name)) {
+                return true;
+        }
+        for (const auto &ratio : ratios_) {
+                if (name == ratio.name || name == ratio.reference) {
+                        return true;
+                }
+        }
+        return false;
+}
+
+/* The result 'name' got in this run, if it ran and did not fail. */
+bool Bench::measured_(const std::string &name, double *ns) const
+{
+        for (const auto &result : judged_) {
+                if (result.first == name) {
+                        *ns = result.second;
+                        return true;
+                }
+        }
+        return false;
+}
+
+/*
+ * 'body(units)' performs 'units' times 'ops' operations of 'bytes' bytes
+ * each and returns false if any of them failed.
+ */
+template<typename Body>
+void Bench::measure_(const std::string &name,
+                     size_t             ops,
+                     size_t             bytes,
+                     Body               body)
+{
+        const double        min_ns  = static_cast<double>(option_.min_ms) *
+                                      1e6;
+        size_t              units   = 1U;
+        uint64_t            elapsed = 0U;
+        std::vector<double> ns;
+
+        if (!selected_(name)) {
+                return;
+        }
+        for (;;) {
+                elapsed = bench_now();
+                if (!body(units)) {
+                        report_(name, ns, bytes);
+                        return;
+                }
+                elapsed = bench_now() - elapsed;
+                if (static_cast<double>(elapsed) * 10.0 >= min_ns ||
+                    units > SIZE_MAX / 4U) {
+                        break;
+                }
+                units *= 2U;
+        }
+        units = static_cast<size_t>(static_cast<double>(units) * min_ns /
+                                    static_cast<double>(elapsed + 1U)) + 1U;
+        for (size_t i = 0U; i < option_.repeat; ++i) {
+                elapsed = bench_now();
+                if (!body(units)) {
+                        ns.clear();
+                        break;
+                }
+                elapsed = bench_now() - elapsed;
+                ns.push_back(static_cast<double>(elapsed) /
+                             static_cast<double>(units * ops));
+        }
+        report_(name, ns, bytes);
+}
+
+/* An empty 'ns' marks a benchmark that failed. */
+void Bench::report_(const std::string &name,
+                    std::vector<double> ns,
+                    size_t              bytes)
+{
+        double median = 0.0;
+
+        if (ns.empty()) {
+                fprintf(stream_, "%-32s %12s %12s %10s\n",
+                        name.c_str(), "failed", "-", "-");
+                status_ = -1;
+                return;
+        }
+        std::sort(ns.begin(), ns.end());
+        median = 0U == ns.size() % 2U ?
+                 (ns[ns.size() / 2U - 1U] + ns[ns.size() / 2U]) / 2.0 :
+                 ns[ns.size() / 2U];
+        judged_.emplace_back(name, ns.front());
+        if (0U == bytes) {
+                fprintf(stream_, "%-32s %12.1f %12.1f %10s\n",
+                        name.c_str(), median, ns.front(), "-");
+        } else {
+                /* Bytes per nanosecond are gigabytes per second. */
+                fprintf(stream_, "%-32s %12.1f %12.1f %10.1f\n",
+                        name.c_str(), median, ns.front(),
+                        static_cast<double>(bytes) / median * 1e3);
+        }
+        fflush(stream_);
+}
+
+void Bench::clock_()
+{
+        static const struct {
+                const char *name;
+                clockid_t   id;
+        } CLOCKS[] = {
+                {"clock.realtime",        CLOCK_REALTIME},
+                {"clock.realtime_coarse", CLOCK_REALTIME_COARSE},
+                {"clock.monotonic",       CLOCK_MONOTONIC}
+        };
+
+        for (const auto &clock : CLOCKS) {
+                measure_(clock.name, 1U, 0U, [&](size_t units) -> bool {
+                        struct timespec now = { };
+
+                        for (size_t i = 0U; i < units; ++i) {
+                                if (-1 == clock_gettime(clock.id, &now)) {
+                                        return false;
+                                }
+                                bench_keep(&now);
+                        }
+                        return true;
+                });
+        }
+}
+
+void Bench::diff_()
+{
+        /* Stamps a frame apart, a borrow from tv_sec every other time. */
+        const struct timespec pairs[4] = {
+                {1500000000, 999999000}, {1500000001,   1000},
+                {1500000001,      1000}, {1500000001, 500000}
+        };
+
+        measure_("timespec.diff", 2U, 0U, [&](size_t units) -> bool {
+                struct timespec delta = { };
+
+                for (size_t i = 0U; i < units; ++i) {
+                        delta = timestamp_diff(&pairs[1], &pairs[0]);
+                        bench_keep(&delta);
+                        delta = timestamp_diff(&pairs[3], &pairs[2]);
+                        bench_keep(&delta);
+                }
+                return true;
+        });
+}
+
+/* Both log formats, each writing to /dev/null as it would to a file. */
+void Bench::log_()
+{
+        FILE            *null       = std::fopen("/dev/null", "w");
+        struct timespec  sent       = { };
+        struct timespec  received   = { };
+        FrameHeader      header     = { };
+
+        if (NULL == null) {
+                report_("log.legacy", std::vector<double>(), 0U);
+                return;
+        }
+        clock_gettime(CLOCK_REALTIME, &sent);
+        received = sent;
+        measure_("log.legacy", 1U, 0U, [&](size_t units) -> bool {
+                struct timespec lines[2] = { };
+
+                for (size_t i = 0U; i < units; ++i) {
+                        lines[0].tv_nsec = static_cast<long>(i % 1000U) *
+                                           1000;
+                        lines[1].tv_sec  = static_cast<time_t>(i / 1000U);
+                        if (-1 == timestamp_log_dump(null, lines, 2U)) {
+                                return false;
+                        }
+                }
+                return true;
+        });
+        measure_("log.engine", 1U, 0U, [&](size_t units) -> bool {
+                LogSink sink(null);
+
+                header.timespec = sent;
+                for (size_t i = 0U; i < units; ++i) {
+                        received.tv_nsec = sent.tv_nsec +
+                                           static_cast<long>(i % 1000U);
+                        if (-1 == sink.record(header, received)) {
+                                return false;
+                        }
+                }
+                return 0 == sink.flush();
+        });
+        measure_("stats.engine", 1U, 0U, [&](size_t units) -> bool {
+                StatsSink sink(null);
+
+                header.timespec = sent;
+                for (size_t i = 0U; i < units; ++i) {
+                        received.tv_nsec = sent.tv_nsec +
+                                           static_cast<long>(i % 1000U);
+                        sink.record(header, received);
+                }
+                bench_keep(&sink.delta());
+                return true;
+        });
+        std::fclose(null);
+}
+
+/* Encoding and decoding of whole frames, through OpenSSL and the engine. */
+void Bench::base64_(size_t pad)
+{
+        const std::string  suffix  = "." + std::to_string(pad);
+        const size_t       frame   = sizeof(FrameHeader) + pad;
+        const size_t       pass    = BENCH_PASS_BYTES / frame + 1U;
+        std::vector<char>  padding(pad, 'x');
+        FrameHeader        header  = { };
+        BenchTransport     encoded;
+        const int          len     = narrow_cast<int, size_t>(pad);
+
+        if (padding.empty()) {
+                /* Room to read a frame into even without any padding. */
+                padding.resize(1U);
+        }
+
+        header.length = narrow_cast<uint32_t, size_t>(pad);
+        measure_("base64.bio.encode" + suffix, 1U, frame,
+                 [&](size_t units) -> bool {
+                BIOWrapper base64(BIOWrapper::f_base64());
+                BIOWrapper memory(const_cast<BIO_METHOD *>(BIO_s_mem()));
+
+                base64.push(memory);
+                for (size_t i = 0U; i < units; ++i) {
+                        /* The same two writes as TimeStamp::send_base64_(). */
+                        if (static_cast<int>(sizeof header) !=
+                            base64.write(&header, sizeof header) ||
+                            (0 != len &&
+                             len != base64.write(padding.data(), len))) {
+                                return false;
+                        }
+                        if (BIO_ctrl_pending(memory) > BENCH_PASS_BYTES) {
+                                BIO_reset(static_cast<BIO *>(memory));
+                        }
+                }
+                base64.flush();
+                memory.pop();
+                return true;
+        });
+        measure_("base64.engine.encode" + suffix, 1U, frame,
+                 [&](size_t units) -> bool {
+                Base64Codec    codec(frame);
+                BenchTransport sink;
+
+                for (size_t i = 0U; i < units; ++i) {
+                        if (!codec.encode(sink,
+                                          header,
+                                          padding.data(),
+                                          pad)) {
+                                return false;
+                        }
+                        if (sink.size() > BENCH_PASS_BYTES) {
+                                sink.clear();
+                        }
+                }
+                return codec.flush(sink);
+        });
+
+        /* Either decoder takes what either encoder produces. */
+        {
+                Base64Codec codec(frame);
+
+                for (size_t i = 0U; i < pass; ++i) {
+                        codec.encode(encoded, header, padding.data(), pad);
+                }
+                codec.flush(encoded);
+        }
+        measure_("base64.bio.decode" + suffix, pass, frame,
+                 [&](size_t units) -> bool {
+                const char  *data     = NULL;
+                size_t       size     = 0U;
+                bool         complete = true;
+                FrameHeader  received = { };
+
+                encoded.rewind();
+                data = encoded.read_some(&size);
+                for (size_t i = 0U; complete && i < units; ++i) {
+                        BIO        *source = BIO_new_mem_buf(
+                                        data, narrow_cast<int, size_t>(size));
+                        BIOWrapper  base64(BIOWrapper::f_base64());
+
+                        if (NULL == source) {
+                                return false;
+                        }
+                        base64.push(source);
+                        /* The same two reads as TimeStamp::read_sample_(). */
+                        for (size_t j = 0U; complete && j < pass; ++j) {
+                                complete = bench_read(base64,
+                                                      &received,
+                                                      sizeof received) &&
+                                           bench_read(base64,
+                                                      padding.data(),
+                                                      received.length);
+                        }
+                        base64.pop();
+                        BIO_free(source);
+                }
+                return complete;
+        });
+        measure_("base64.engine.decode" + suffix, pass, frame,
+                 [&](size_t units) -> bool {
+                FrameHeader received = { };
+
+                for (size_t i = 0U; i < units; ++i) {
+                        Base64Codec codec(frame);
+
+                        encoded.rewind();
+                        for (size_t j = 0U; j < pass; ++j) {
+                                if (!codec.decode(encoded, &received)) {
+                                        return false;
+                                }
+                        }
+                        bench_keep(&received);
+                }
+                return true;
+        });
+}
+
+/* One frame per operation through stdio, with and without a flush each. */
+void Bench::write_(size_t pad)
+{
+        const std::string  suffix = "." + std::to_string(pad);
+        const size_t       frame  = sizeof(FrameHeader) + pad;
+        std::vector<char>  data(frame, 'x');
+        FILE              *file   = std::fopen("/dev/null", "w");
+        int                fd     = open("/dev/null", O_WRONLY | O_CLOEXEC);
+
+        if (NULL == file || -1 == fd) {
+                report_("write" + suffix, std::vector<double>(), 0U);
+        } else {
+                measure_("write.stdio.flush" + suffix, 1U, frame,
+                         [&](size_t units) -> bool {
+                        for (size_t i = 0U; i < units; ++i) {
+                                if (frame != std::fwrite(data.data(),
+                                                         1U,
+                                                         frame,
+                                                         file) ||
+                                    0 != std::fflush(file)) {
+                                        return false;
+                                }
+                        }
+                        return true;
+                });
+                measure_("write.stdio" + suffix, 1U, frame,
+                         [&](size_t units) -> bool {
+                        for (size_t i = 0U; i < units; ++i) {
+                                if (frame != std::fwrite(data.data(),
+                                                         1U,
+                                                         frame,
+                                                         file)) {
+                                        return false;
+                                }
+                        }
+                        return 0 == std::fflush(file);
+                });
+                measure_("write.fd" + suffix, 1U, frame,
+                         [&](size_t units) -> bool {
+                        for (size_t i = 0U; i < units; ++i) {
+                                if (static_cast<ssize_t>(frame) !=
+                                    bseq_write(fd, data.data(), frame)) {
+                                        return false;
+                                }
+                        }
+                        return true;
+                });
+        }
+        if (NULL != file) {
+                std::fclose(file);
+        }
+        if (-1 != fd) {
+                close(fd);
+        }
+}
+
+/*
+ * Whole runs of raw frames between two processes over a pipe, as with
+ * 'ts --self-test', on the engine and on the TimeStamp class; these take
+ * a fixed number of frames rather than a minimum duration.  The ".p99"
+ * line of the engine carries the 99th percentile of the one-way latency of
+ * separate runs paced at BENCH_P99_RATE, in place of a time per operation;
+ * that of the TimeStamp class is left out, its flushes to the log making it
+ * too erratic to judge.
+ */
+void Bench::loopback_(size_t pad)
+{
+        const size_t frame = sizeof(FrameHeader) + pad;
+
+        for (bool engine : {true, false}) {
+                const std::string   name   = std::string("loopback.") +
+                                             (engine ? "engine." :
+                                                       "legacy.") +
+                                             std::to_string(pad);
+                SelfTestOption      option;
+                std::vector<double> ns;
+                std::vector<double> p99;
+                const bool          latency = engine &&
+                                              selected_(name + ".p99");
+
+                if (!selected_(name) && !latency) {
+                        continue;
+                }
+                option.count            = option_.count;
+                option.timestamp.engine = engine;
+                option.timestamp.log    = true;
+
+                SelfTest            test(option);
+
+                for (size_t i = 0U; selected_(name) &&
+                                    i < option_.repeat; ++i) {
+                        SelfTestResult result = test.run(pad, 0U);
+
+                        if (SelfTestResult::Status::OK != result.status ||
+                            0U == result.frames) {
+                                ns.clear();
+                                break;
+                        }
+                        ns.push_back(result.elapsed * 1e9 /
+                                     static_cast<double>(result.frames));
+                }
+                if (selected_(name)) {
+                        report_(name, ns, frame);
+                }
+                for (size_t i = 0U; latency && i < option_.repeat; ++i) {
+                        SelfTestResult result = test.run(pad,
+                                                         BENCH_P99_RATE);
+
+                        if (SelfTestResult::Status::OK != result.status ||
+                            0U == result.frames) {
+                                p99.clear();
+                                break;
+                        }
+                        p99.push_back(static_cast<double>(result.p99));
+                }
+                if (latency) {
+                        report_(name + ".p99", p99, 0U);
+                }
+        }
+}
+
+/*
+ * Header-only frames relayed by an Impairment between two pipes, fed and
+ * drained by threads of their own, with a delay and a jitter wide enough to
+ * keep thousands of them on the timer wheel at once.
+ */
+void Bench::impair_()
+{
+        static const size_t BATCH = 1024U;
+
+        measure_("impair.relay", 1U, sizeof(FrameHeader),
+                 [&](size_t units) -> bool {
+                ImpairOption     option;
+                int              in[2]   = {-1, -1};
+                int              out[2]  = {-1, -1};
+                bool             fed     = true;
+                size_t           drained = 0U;
+                int              status  = -1;
+
+                option.delay_ns  = 1000000U;
+                option.jitter_ns = 500000U;
+                option.datagram  = true;
+                if (-1 == pipe2(in, O_CLOEXEC)) {
+                        return false;
+                }
+                if (-1 == pipe2(out, O_CLOEXEC)) {
+                        close(in[0]);
+                        close(in[1]);
+                        return false;
+                }
+
+                Impairment  relay(option);
+                std::thread feeder([&]() {
+                        std::vector<FrameHeader> frames(BATCH);
+
+                        for (size_t i = 0U; fed && i < units; i += BATCH) {
+                                size_t n = units - i < BATCH ?
+                                           units - i : BATCH;
+
+                                for (size_t j = 0U; j < n; ++j) {
+                                        frames[j].seq = i + j;
+                                }
+                                fed = static_cast<ssize_t>(
+                                        n * sizeof(FrameHeader)) ==
+                                      bseq_write(in[1],
+                                                 frames.data(),
+                                                 n * sizeof(FrameHeader));
+                        }
+                        close(in[1]);
+                });
+                std::thread drainer([&]() {
+                        char    buffer[1U << 16];
+                        ssize_t got = 0;
+
+                        while (0 < (got = read(out[0],
+                                               buffer,
+                                               sizeof buffer)) ||
+                               (-1 == got && EINTR == errno)) {
+                                drained += 0 < got ?
+                                           static_cast<size_t>(got) : 0U;
+                        }
+                });
+
+                status = relay.run(in[0], out[1]);
+                close(out[1]);
+                drainer.join();
+                /* A failed relay leaves the feeder blocked on a full pipe. */
+                if (0 != status && -1 != fcntl(in[0], F_SETFL, 0)) {
+                        char rest[4096];
+
+                        while (0 < read(in[0], rest, sizeof rest)) {
+                        }
+                }
+                feeder.join();
+                close(in[0]);
+                close(out[0]);
+                return 0 == status && fed &&
+                       units * sizeof(FrameHeader) == drained;
+        });
+}
+
+/* Runs 'ts' at 'path' for a single raw frame, thrown away. */
+static bool bench_exec(const std::string &path)
+{
+        int   status = 0;
+        int   null   = -1;
+        pid_t child  = fork();
+
+        if (0 == child) {
+                null = open("/dev/null", O_WRONLY);
+                if (-1 == null || -1 == dup2(null, STDOUT_FILENO)) {
+                        _exit(EXIT_FAILURE);
+                }
+                execl(path.c_str(), "ts", "-s", "-c", "1", "--raw",
+                      static_cast<char *>(NULL));
+                _exit(EXIT_FAILURE);
+        }
+        return -1 != child && child == waitpid(child, &status, 0) &&
+               WIFEXITED(status) && EXIT_SUCCESS == WEXITSTATUS(status);
+}
+
+/* Asks the daemon in the abstract namespace at 'name' for the same. */
+static bool bench_request(const std::string &name)
+{
+        static const char   REQUEST[] = "-s -c 1 --raw\n";
+        struct sockaddr_un  address   = { };
+        char                reply[256];
+        size_t              len       = 0U;
+        ssize_t             got       = 0;
+        const int           fd        = socket(AF_UNIX,
+                                               SOCK_STREAM | SOCK_CLOEXEC,
+                                               0);
+
+        if (-1 == fd) {
+                return false;
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path + 1, name.data() + 1, name.size() - 1U);
+        if (-1 == connect(fd,
+                          reinterpret_cast<struct sockaddr *>(&address),
+                          static_cast<socklen_t>(
+                                  offsetof(struct sockaddr_un, sun_path) +
+                                  name.size())) ||
+            static_cast<ssize_t>(sizeof REQUEST - 1U) !=
+            write(fd, REQUEST, sizeof REQUEST - 1U)) {
+                close(fd);
+                return false;
+        }
+        while (len < sizeof reply &&
+               0 < (got = read(fd, reply + len, sizeof reply - len))) {
+                len += static_cast<size_t>(got);
+        }
+        close(fd);
+        return len >= 3U && 0 == std::memcmp(reply + len - 3U, "ok\n", 3U);
+}
+
+/*
+ * What a run costs before its first frame: a fresh 'ts' sending a single
+ * frame, against a request for the same to a TimeStampDaemon running in
+ * this process.  The former needs a 'ts' next to ts-bench and is skipped
+ * without one.
+ */
+void Bench::startup_()
+{
+        char        self[4096] = { };
+        ssize_t     len        = readlink("/proc/self/exe",
+                                          self,
+                                          sizeof self - 1U);
+        std::string path;
+
+        if (0 < len && NULL != std::strrchr(self, '/')) {
+                path.assign(self, std::strrchr(self, '/') + 1);
+                path += "ts";
+        }
+        if (!path.empty() && 0 == access(path.c_str(), X_OK)) {
+                measure_("startup.exec", 1U, 0U, [&](size_t units) -> bool {
+                        for (size_t i = 0U; i < units; ++i) {
+                                if (!bench_exec(path)) {
+                                        return false;
+                                }
+                        }
+                        return true;
+                });
+        }
+        if (!selected_("startup.daemon")) {
+                return;
+        }
+
+        const std::string name   = "@ts-bench." + std::to_string(getpid());
+        TimeStampDaemon   daemon(name.c_str(), TimeStampOption());
+        std::thread       server([&]() {
+                daemon.serve();
+        });
+
+        /* The first request waits out the warm up of the daemon. */
+        if (bench_request(name)) {
+                measure_("startup.daemon", 1U, 0U,
+                         [&](size_t units) -> bool {
+                        for (size_t i = 0U; i < units; ++i) {
+                                if (!bench_request(name)) {
+                                        return false;
+                                }
+                        }
+                        return true;
+                });
+        } else {
+                report_("startup.daemon", std::vector<double>(), 0U);
+        }
+        daemon.stop();
+        server.join();
+}
+
+void Bench::load_()
+{
+        using std::runtime_error;
+        using std::string;
+
+        const string  prefix    = string("Bench::load_(): ") +
+                                  option_.baseline + ": ";
+        FILE         *stream    = std::fopen(option_.baseline, "r");
+        char          line[256] = { };
+        char          name[128] = { };
+        char          extra     = '\0';
+        Baseline_     entry     = { };
+        size_t        number    = 0U;
+        int           count     = 0;
+
+        if (NULL == stream) {
+                throw runtime_error(prefix + "cannot be opened");
+        }
+        baseline_.clear();
+        while (NULL != std::fgets(line, sizeof(line), stream)) {
+                ++number;
+                if (NULL != std::strchr(line, '#')) {
+                        *std::strchr(line, '#') = '\0';
+                }
+                count = std::sscanf(line, "%127s %lf %lf %c",
+                                    name, &entry.ns, &entry.tolerance,
+                                    &extra);
+                if (EOF == count) {
+                        continue;
+                }
+                if (3 != count || 0.0 >= entry.ns || 0.0 > entry.tolerance) {
+                        std::fclose(stream);
+                        throw runtime_error(prefix + "malformed line " +
+                                            std::to_string(number));
+                }
+                baseline_[name] = entry;
+        }
+        std::fclose(stream);
+}
+
+void Bench::load_ratios_()
+{
+        using std::runtime_error;
+        using std::string;
+
+        const string  prefix         = string("Bench::load_ratios_(): ") +
+                                       option_.ratios + ": ";
+        FILE         *stream         = std::fopen(option_.ratios, "r");
+        char          line[320]      = { };
+        char          name[128]      = { };
+        char          reference[128] = { };
+        char          extra          = '\0';
+        double        limit          = 0.0;
+        size_t        number         = 0U;
+        int           count          = 0;
+
+        if (NULL == stream) {
+                throw runtime_error(prefix + "cannot be opened");
+        }
+        ratios_.clear();
+        while (NULL != std::fgets(line, sizeof(line), stream)) {
+                ++number;
+                if (NULL != std::strchr(line, '#')) {
+                        *std::strchr(line, '#') = '\0';
+                }
+                count = std::sscanf(line, "%127s %127s %lf %c",
+                                    name, reference, &limit, &extra);
+                if (EOF == count) {
+                        continue;
+                }
+                if (3 != count || 0.0 >= limit) {
+                        std::fclose(stream);
+                        throw runtime_error(prefix + "malformed line " +
+                                            std::to_string(number));
+                }
+                ratios_.push_back({name, reference, limit});
+        }
+        std::fclose(stream);
+}
+
+/*
+ * Prints one verdict per baseline line; a benchmark that did not produce a
+ * number, filtered out or failed, counts as a regression too.
+ */
+void Bench::judge_()
+{
+        double measured = 0.0;
+        double change   = 0.0;
+        bool   found    = false;
+
+        fprintf(stream_,
+                "# against %s, change and tolerance in percent\n",
+                option_.baseline);
+        fprintf(stream_,
+                "# %-30s %12s %12s %8s %8s %s\n",
+                "name", "baseline", "ns", "change", "tol",
+                "verdict");
+        for (const auto &entry : baseline_) {
+                found = false;
+                for (const auto &result : judged_) {
+                        if (result.first == entry.first) {
+                                measured = result.second;
+                                found    = true;
+                        }
+                }
+                if (NULL != option_.filter && NULL == std::strstr(
+                            entry.first.c_str(), option_.filter)) {
+                        continue;
+                }
+                if (!found) {
+                        fprintf(stream_, "%-32s %12.1f %12s %8s %8.0f %s\n",
+                                entry.first.c_str(), entry.second.ns, "-",
+                                "-", entry.second.tolerance, "MISSING");
+                        if (option_.strict) {
+                                status_ = -1;
+                        }
+                        continue;
+                }
+                change = (measured / entry.second.ns - 1.0) * 100.0;
+                fprintf(stream_, "%-32s %12.1f %12.1f %+8.1f %8.0f %s\n",
+                        entry.first.c_str(), entry.second.ns, measured,
+                        change, entry.second.tolerance,
+                        change > entry.second.tolerance ? "REGRESSED" :
+                        change < -entry.second.tolerance ? "faster" : "ok");
+                if (option_.strict && change > entry.second.tolerance) {
+                        status_ = -1;
+                }
+        }
+}
+
+/*
+ * Prints one verdict per ratio line; both sides ran back to back on the
+ * same machine, so any regression fails the run, --compare or not.  A side
+ * that did not produce a number counts as a regression too.
+ */
+void Bench::judge_ratios_()
+{
+        double measured  = 0.0;
+        double reference = 0.0;
+        double ratio     = 0.0;
+
+        fprintf(stream_,
+                "# against %s, ratio of name over reference\n",
+                option_.ratios);
+        fprintf(stream_,
+                "# %-30s %-32s %8s %8s %s\n",
+                "name", "reference", "ratio", "limit", "verdict");
+        for (const auto &entry : ratios_) {
+                if (NULL != option_.filter && NULL == std::strstr(
+                            entry.name.c_str(), option_.filter)) {
+                        continue;
+                }
+                if (!measured_(entry.name, &measured) ||
+                    !measured_(entry.reference, &reference) ||
+                    0.0 >= reference) {
+                        fprintf(stream_, "%-32s %-32s %8s %8.2f %s\n",
+                                entry.name.c_str(), entry.reference.c_str(),
+                                "-", entry.limit, "MISSING");
+                        status_ = -1;
+                        continue;
+                }
+                ratio = measured / reference;
+                fprintf(stream_, "%-32s %-32s %8.2f %8.2f %s\n",
+                        entry.name.c_str(), entry.reference.c_str(),
+                        ratio, entry.limit,
+                        ratio > entry.limit ? "REGRESSED" : "ok");
+                if (ratio > entry.limit) {
+                        status_ = -1;
+                }
+        }
+}
+
+void Bench::save_() const
+{
+        FILE *stream = std::fopen(option_.save, "w");
+
+        if (NULL == stream) {
+                throw std::runtime_error(std::string("Bench::save_(): ") +
+                                         option_.save + ": cannot be opened");
+        }
+        fprintf(stream,
+                "# ts-bench baseline, %zu runs of at least %" PRIu64
+                " ms each and %zu frames per loopback run\n"
+                "# name ns tolerance(percent)\n",
+                option_.repeat, option_.min_ms, option_.count);
+        for (const auto &result : judged_) {
+                fprintf(stream, "%-32s %12.1f %6.0f\n",
+                        result.first.c_str(), result.second,
+                        bench_latency(result.first) ? BENCH_TOLERANCE_P99 :
+                                                      BENCH_TOLERANCE);
+        }
+        if (0 != std::fclose(stream)) {
+                throw std::runtime_error(std::string("Bench::save_(): ") +
+                                         option_.save + ": write failed");
+        }
+}
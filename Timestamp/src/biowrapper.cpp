@@ -88,5 +88,9 @@ BIOWrapper::operator BIO *() const
 
 BIO_METHOD *BIOWrapper::f_base64()
 {
-        return BIO_f_base64();
+        /*
+         * OpenSSL 1.1.0 and later return a pointer to const; BIO_new() accepts
+         * both flavors, so casting it away keeps 1.0.2 building as well.
+         */
+        return const_cast<BIO_METHOD *>(BIO_f_base64());
 }
@@ -0,0 +1,153 @@
+/**
+ * @file calibration.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation source file of the Calibration structure.
+ */
+
+#include "calibration.h"
+
+#include <cerrno>    /* ERANGE errno */
+#include <cinttypes> /* strtoimax() */
+#include <cstdlib>   /* free() */
+#include <cstring>   /* strcmp() strcspn() strspn() */
+#include <stdexcept> /* invalid_argument */
+#include <string>
+
+Calibration::Calibration()
+        :
+        floor{0},
+        resolution{0},
+        clock{},
+        codec{},
+        pad{}
+{
+}
+
+bool Calibration::active() const
+{
+        return 0 != floor || 0 != resolution;
+}
+
+void Calibration::load(FILE *stream)
+{
+        using std::invalid_argument;
+        using std::to_string;
+
+        char        *line      = NULL;
+        size_t       capacity  = 0U;
+        size_t       number    = 0U;
+        unsigned     found     = 0U;
+        int64_t      fields[2] = { };
+        std::string  setup[3];
+        char        *endptr    = NULL;
+        intmax_t     value     = 0;
+
+        while (-1 != getline(&line, &capacity, stream)) {
+                char *key  = line + std::strspn(line, " \t");
+                char *end  = key + std::strcspn(key, "#\r\n");
+                char *arg  = NULL;
+                int   slot = -1;
+
+                ++number;
+                while (end != key && (' ' == end[-1] || '\t' == end[-1])) {
+                        --end;
+                }
+                *end = '\0';
+                if ('\0' == *key) {
+                        continue;
+                }
+                arg = key + std::strcspn(key, " \t");
+                if ('\0' != *arg) {
+                        *arg++ = '\0';
+                        arg   += std::strspn(arg, " \t");
+                }
+                if (0 == std::strcmp(CALIBRATION_FLOOR, key)) {
+                        slot = 0;
+                } else if (0 == std::strcmp(CALIBRATION_RESOLUTION, key)) {
+                        slot = 1;
+                } else if (0 == std::strcmp(CALIBRATION_CLOCK, key)) {
+                        setup[0] = arg;
+                        continue;
+                } else if (0 == std::strcmp(CALIBRATION_CODEC, key)) {
+                        setup[1] = arg;
+                        continue;
+                } else if (0 == std::strcmp(CALIBRATION_PAD, key)) {
+                        setup[2] = arg;
+                        continue;
+                } else {
+                        continue;
+                }
+                errno  = 0;
+                value  = strtoimax(arg, &endptr, 10);
+                if (ERANGE == errno || endptr == arg || '\0' != *endptr ||
+                    0 > value) {
+                        std::free(line);
+                        throw invalid_argument("Calibration line " +
+                                               to_string(number) +
+                                               " is not a valid number!");
+                }
+                fields[slot]  = static_cast<int64_t>(value);
+                found        |= 1U << slot;
+        }
+        std::free(line);
+        if (3U != found) {
+                throw invalid_argument("Calibration lacks \""
+                                       CALIBRATION_FLOOR "\" or \""
+                                       CALIBRATION_RESOLUTION "\"!");
+        }
+        floor      = fields[0];
+        resolution = fields[1];
+        clock      = setup[0];
+        codec      = setup[1];
+        pad        = setup[2];
+}
+
+const char *Calibration::mismatch(clockid_t clock_id,
+                                  bool      raw,
+                                  bool      crc,
+                                  size_t    pad_size) const
+{
+        if (!clock.empty() && clock != clock_name(clock_id)) {
+                return CALIBRATION_CLOCK;
+        }
+        if (!codec.empty() && codec != codec_name(raw, crc)) {
+                return CALIBRATION_CODEC;
+        }
+        if (!pad.empty() && pad != std::to_string(pad_size)) {
+                return CALIBRATION_PAD;
+        }
+        return NULL;
+}
+
+const char *Calibration::clock_name(clockid_t clock_id)
+{
+        return CLOCK_REALTIME_COARSE == clock_id ? "coarse" : "realtime";
+}
+
+const char *Calibration::codec_name(bool raw, bool crc)
+{
+        if (raw) {
+                return crc ? "raw+crc" : "raw";
+        }
+        return crc ? "base64+crc" : "base64";
+}
@@ -24,18 +24,116 @@
  * Various utility function definitions.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "cmnutil.h"
 
+#include <climits>   /* INT_MAX IOV_MAX */
+#include <csignal>   /* sig_atomic_t */
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#include <fcntl.h>   /* splice() vmsplice() */
+#include <poll.h>    /* poll() */
+#include <sys/uio.h> /* writev() */
 #include <unistd.h>
 
 #ifdef __cplusplus
 }
 #endif
 
+/* Only ever written by cmnutil_interrupt(), which signal handlers call. */
+static volatile sig_atomic_t cmnutil_stop = 0;
+
+void cmnutil_interrupt()
+{
+        cmnutil_stop = 1;
+}
+
+bool cmnutil_interrupted()
+{
+        return 0 != cmnutil_stop;
+}
+
+/*
+ * Blocks until 'fd' is ready for 'events'; only needed by non-blocking
+ * descriptors, for which read() and write() fail with EAGAIN instead.
+ */
+int bseq_wait(int fd, short events)
+{
+        return bseq_wait_until(fd, events, 0U, NULL);
+}
+
+int bseq_wait_until(int                    fd,
+                    short                  events,
+                    uint64_t               idle_ms,
+                    const struct timespec *deadline)
+{
+        struct pollfd   pfd     = { };
+        int             timeout = -1;
+        int             left    = 0;
+
+        pfd.fd     = fd;
+        pfd.events = events;
+
+        for (;;) {
+                /* An interrupted poll() starts the idle limit over. */
+                timeout = 0U == idle_ms ? -1 :
+                          idle_ms > INT_MAX ? INT_MAX :
+                          static_cast<int>(idle_ms);
+                if (NULL != deadline) {
+                        left = cmnutil_remaining(*deadline);
+                        if (-1 == timeout || left < timeout) {
+                                timeout = left;
+                        }
+                }
+                switch (poll(&pfd, 1, timeout)) {
+                case -1:
+                        if (EINTR != errno || cmnutil_interrupted()) {
+                                return -1;
+                        }
+                        break;
+                case 0:
+                        errno = ETIMEDOUT;
+                        return -1;
+                default:
+                        return 0;
+                }
+        }
+}
+
+struct timespec cmnutil_deadline(uint64_t ms)
+{
+        struct timespec result = { };
+
+        clock_gettime(CLOCK_MONOTONIC, &result);
+        result.tv_sec  += static_cast<time_t>(ms / 1000U);
+        result.tv_nsec += static_cast<long>(ms % 1000U) * 1000000L;
+        if (result.tv_nsec >= 1000000000L) {
+                result.tv_nsec -= 1000000000L;
+                ++result.tv_sec;
+        }
+        return result;
+}
+
+int cmnutil_remaining(const struct timespec &deadline)
+{
+        struct timespec now  = { };
+        int64_t         left = 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        /* Rounded up, so a poll() never wakes just short of the deadline. */
+        left = (static_cast<int64_t>(deadline.tv_sec - now.tv_sec) *
+                1000000000 + (deadline.tv_nsec - now.tv_nsec) + 999999) /
+               1000000;
+        return left <= 0 ? 0 : left > INT_MAX ? INT_MAX :
+               static_cast<int>(left);
+}
+
 ssize_t bseq_read(int fd, void *seq, size_t count)
 {
         char           *buffer      = reinterpret_cast<char *>(seq);
@@ -49,16 +147,21 @@ ssize_t bseq_read(int fd, void *seq, size_t count)
          */
         while (narrow_cast<long long, ssize_t>(bcount) <
                narrow_cast<long long, size_t>(count)) {
-                breach = read(fd, seq, count - bcount);
+                breach = read(fd, buffer, count - bcount);
 
                 switch (breach) {
                 case -1:
-                        if (EINTR == errno) {
-                                breach = 0;
-                        } else {
+                        if (EAGAIN == errno || EWOULDBLOCK == errno) {
+                                if (-1 == bseq_wait(fd, POLLIN)) {
+                                        return -1;
+                                }
+                        } else if (EINTR != errno || cmnutil_interrupted()) {
                                 return -1;
                         }
                         break;
+                case 0:
+                        /* End of file: report what has been read so far. */
+                        return bcount;
                 default:
                         bcount += breach;
                         buffer += breach;
@@ -78,13 +181,15 @@ ssize_t bseq_write(int fd, const void *seq, size_t count)
 
         while (narrow_cast<long long, ssize_t>(bcount) <
                narrow_cast<long long, size_t>(count)) {
-                breach = write(fd, seq, count - bcount);
+                breach = write(fd, buffer, count - bcount);
 
                 switch (breach) {
                 case -1:
-                        if (EINTR == errno) {
-                                breach = 0;
-                        } else {
+                        if (EAGAIN == errno || EWOULDBLOCK == errno) {
+                                if (-1 == bseq_wait(fd, POLLOUT)) {
+                                        return -1;
+                                }
+                        } else if (EINTR != errno || cmnutil_interrupted()) {
                                 return -1;
                         }
                         break;
@@ -95,3 +200,103 @@ ssize_t bseq_write(int fd, const void *seq, size_t count)
         }
         return bcount;
 }
+
+ssize_t bseq_writev(int fd, struct iovec *iov, int iovcnt)
+{
+        ssize_t         bcount      = 0;
+        ssize_t         breach      = 0;
+        size_t          remain      = 0U;
+
+        /* Skips the leading entries that are empty to begin with. */
+        while (0 < iovcnt && 0U == iov->iov_len) {
+                ++iov;
+                --iovcnt;
+        }
+        while (0 < iovcnt) {
+                breach = writev(fd, iov, iovcnt > IOV_MAX ? IOV_MAX : iovcnt);
+
+                if (-1 == breach) {
+                        if (EAGAIN == errno || EWOULDBLOCK == errno) {
+                                if (-1 == bseq_wait(fd, POLLOUT)) {
+                                        return -1;
+                                }
+                        } else if (EINTR != errno || cmnutil_interrupted()) {
+                                return -1;
+                        }
+                        continue;
+                }
+
+                /* Drops the fully written entries, trims the partial one. */
+                bcount += breach;
+                remain  = static_cast<size_t>(breach);
+                while (0 < iovcnt && remain >= iov->iov_len) {
+                        remain -= iov->iov_len;
+                        ++iov;
+                        --iovcnt;
+                }
+                if (0 < iovcnt) {
+                        iov->iov_base = reinterpret_cast<char *>(iov->iov_base)
+                                        + remain;
+                        iov->iov_len -= remain;
+                }
+        }
+        return bcount;
+}
+
+ssize_t bseq_vmsplice(int fd, const void *seq, size_t count)
+{
+        struct iovec    iov         = { };
+        ssize_t         bcount      = 0;
+        ssize_t         breach      = 0;
+
+        iov.iov_base = const_cast<void *>(seq);
+        iov.iov_len  = count;
+
+        while (0U != iov.iov_len) {
+                breach = vmsplice(fd, &iov, 1U, 0U);
+
+                if (-1 == breach) {
+                        if (EAGAIN == errno || EWOULDBLOCK == errno) {
+                                if (-1 == bseq_wait(fd, POLLOUT)) {
+                                        return -1;
+                                }
+                        } else if (EINTR != errno || cmnutil_interrupted()) {
+                                return -1;
+                        }
+                        continue;
+                }
+                bcount      += breach;
+                iov.iov_base = reinterpret_cast<char *>(iov.iov_base) + breach;
+                iov.iov_len -= static_cast<size_t>(breach);
+        }
+        return bcount;
+}
+
+ssize_t bseq_splice(int fd_in, int fd_out, size_t count)
+{
+        ssize_t         bcount      = 0;
+        ssize_t         breach      = 0;
+
+        while (narrow_cast<long long, ssize_t>(bcount) <
+               narrow_cast<long long, size_t>(count)) {
+                breach = splice(fd_in, NULL, fd_out, NULL, count - bcount,
+                                SPLICE_F_MOVE | SPLICE_F_MORE);
+
+                switch (breach) {
+                case -1:
+                        if (EAGAIN == errno || EWOULDBLOCK == errno) {
+                                if (-1 == bseq_wait(fd_out, POLLOUT)) {
+                                        return -1;
+                                }
+                        } else if (EINTR != errno || cmnutil_interrupted()) {
+                                return -1;
+                        }
+                        break;
+                case 0:
+                        return bcount;
+                default:
+                        bcount += breach;
+                }
+        }
+        return bcount;
+}
@@ -0,0 +1,522 @@
+/**
+ * @file daemon.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation source file of the TimeStampDaemon class.
+ * The runs are those of the engine, as 'ts' itself makes them; what the
+ * daemon saves is the process: its start, the loading of a static binary,
+ * and the first touch of the code and heap a run goes through, which the
+ * warm up pays for once.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "daemon.h"
+#include "cmnutil.h"
+#include "engine.h"
+#include "logfile.h"
+#include "payload.h"
+
+#include <cerrno>    /* EINTR errno */
+#include <cinttypes> /* strtoumax() */
+#include <cstdio>    /* fopen() open_memstream() */
+#include <cstdlib>   /* free() */
+#include <cstring>   /* memchr() strcmp() strncpy() */
+#include <stdexcept> /* invalid_argument runtime_error */
+#include <system_error>
+#include <thread>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <malloc.h>     /* M_MMAP_THRESHOLD M_TRIM_THRESHOLD mallopt() */
+#include <pthread.h>    /* pthread_sigmask() */
+#include <signal.h>     /* SIGPIPE signal() */
+#include <stddef.h>     /* offsetof() */
+#include <sys/socket.h> /* accept4() bind() listen() socket() */
+#include <sys/stat.h>   /* S_ISSOCK lstat() */
+#include <sys/time.h>   /* struct timeval */
+#include <sys/un.h>     /* struct sockaddr_un */
+#include <unistd.h>     /* close() geteuid() unlink() write() */
+
+#ifdef __cplusplus
+}
+#endif
+
+/* Frames of each warm up run, enough to fault in all a run touches. */
+#define DAEMON_WARM_FRAMES 4096U
+/*
+ * Freed buffers up to this size stay in the heap for the next run rather
+ * than go back to the kernel, to be faulted in anew.
+ */
+#define DAEMON_HEAP_KEEP   (64 << 20)
+
+static size_t daemon_number(const char *word, const char *value)
+{
+        char      *endptr = NULL;
+        uintmax_t  result = 0U;
+
+        if (NULL == value) {
+                throw std::invalid_argument(std::string(word) +
+                                            " lacks its value");
+        }
+        errno  = 0;
+        result = strtoumax(value, &endptr, 10);
+        if (ERANGE == errno || endptr == value || '\0' != *endptr ||
+            '-' == *value || SIZE_MAX < result) {
+                throw std::invalid_argument(std::string(word) +
+                                            " takes a number, not " + value);
+        }
+        return static_cast<size_t>(result);
+}
+
+DaemonRequest::DaemonRequest(const TimeStampOption &defaults)
+        :
+        send{false},
+        pad{0U},
+        count{0U},
+        stats{false},
+        log{},
+        option(defaults)
+{
+        option.stats = NULL;
+        option.log   = false;
+}
+
+void DaemonRequest::parse(const char *line)
+{
+        using std::invalid_argument;
+        using std::strcmp;
+        using std::string;
+
+        static const char *const SPACE   = " \t\r\n";
+        string                   copy    = line;
+        char                    *state   = NULL;
+        const char              *word    = NULL;
+        unsigned                 modes   = 0U;
+
+        for (word = strtok_r(&copy[0], SPACE, &state); NULL != word;
+             word = strtok_r(NULL, SPACE, &state)) {
+                if (0 == strcmp("-r", word) || 0 == strcmp("-s", word)) {
+                        send = 0 == strcmp("-s", word);
+                        ++modes;
+                } else if (0 == strcmp("-c", word)) {
+                        count = daemon_number(word,
+                                              strtok_r(NULL, SPACE, &state));
+                } else if (0 == strcmp("-b", word)) {
+                        pad = daemon_number(word,
+                                            strtok_r(NULL, SPACE, &state));
+                } else if (0 == strcmp("-S", word)) {
+                        stats = true;
+                } else if (0 == strcmp("--raw", word)) {
+                        option.raw = true;
+                } else if (0 == strcmp("--crc", word)) {
+                        option.crc = true;
+                } else if (0 == strcmp("--rate", word)) {
+                        option.rate = daemon_number(
+                                word, strtok_r(NULL, SPACE, &state));
+                } else if (0 == strcmp("--reorder", word)) {
+                        option.reorder = daemon_number(
+                                word, strtok_r(NULL, SPACE, &state));
+                        if (0U == option.reorder ||
+                            (1U << 20) < option.reorder ||
+                            0U != (option.reorder & (option.reorder - 1U))) {
+                                throw invalid_argument(
+                                        "--reorder takes a power of two");
+                        }
+                } else if (0 == strcmp("--timeout", word)) {
+                        option.timeout = daemon_number(
+                                word, strtok_r(NULL, SPACE, &state));
+                } else if (0 == strcmp("--idle-timeout", word)) {
+                        option.idle_timeout = daemon_number(
+                                word, strtok_r(NULL, SPACE, &state));
+                } else if (0 == strcmp("--clock", word)) {
+                        word = strtok_r(NULL, SPACE, &state);
+                        if (NULL != word && 0 == strcmp("realtime", word)) {
+                                option.clock = CLOCK_REALTIME;
+                        } else if (NULL != word &&
+                                   0 == strcmp("coarse", word)) {
+                                option.clock = CLOCK_REALTIME_COARSE;
+                        } else {
+                                throw invalid_argument(
+                                        "--clock takes realtime or coarse");
+                        }
+                } else if (0 == strcmp("--payload", word)) {
+                        word = strtok_r(NULL, SPACE, &state);
+                        if (NULL == word ||
+                            !PayloadGenerator::parse(word, &option.payload)) {
+                                throw invalid_argument(
+                                        "--payload takes none, zero, "
+                                        "pattern, random or sliding");
+                        }
+                } else if (0 == strcmp("--log", word)) {
+                        word = strtok_r(NULL, SPACE, &state);
+                        if (NULL == word) {
+                                throw invalid_argument("--log lacks its "
+                                                       "file");
+                        }
+                        log        = word;
+                        option.log = true;
+                } else {
+                        throw invalid_argument(string("there is no such "
+                                                      "option as ") + word);
+                }
+        }
+
+        if (1U != modes) {
+                throw invalid_argument("either -r or -s is required");
+        }
+        /* A run that never ends would hold its thread forever. */
+        if (0U == count) {
+                throw invalid_argument("-c is required and not 0");
+        }
+        if (send && (option.log || 0U != option.reorder ||
+                     0U != option.timeout || 0U != option.idle_timeout)) {
+                throw invalid_argument("--log, --reorder, --timeout and "
+                                       "--idle-timeout are for -r");
+        }
+        /* The length field of the header is only 32 bits wide. */
+        if (UINT32_MAX < pad) {
+                throw invalid_argument("-b is too large");
+        }
+        /* Nor would a receiver waiting on a client gone quiet. */
+        if (!send && 0U == option.timeout && 0U == option.idle_timeout) {
+                option.idle_timeout = DAEMON_IDLE_MS;
+        }
+}
+
+TimeStampDaemon::TimeStampDaemon(const char            *path,
+                                 const TimeStampOption &defaults)
+        :
+        path_{path},
+        defaults_(defaults),
+        listener_{-1},
+        stopping_{false},
+        served_{0U},
+        mutex_{},
+        idle_{},
+        active_{}
+{
+        using std::runtime_error;
+
+        struct sockaddr_un  address = { };
+        socklen_t           length  = 0U;
+        struct stat         status  = { };
+        const bool          hidden  = '@' == path_[0];
+        int                 probe   = -1;
+
+        if (path_.empty() || path_.size() >= sizeof address.sun_path ||
+            (hidden && path_.size() < 2U)) {
+                throw runtime_error("TimeStampDaemon::TimeStampDaemon() : "
+                                    "unusable socket path");
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path_.data(), path_.size());
+        if (hidden) {
+                address.sun_path[0] = '\0';
+        }
+        length = static_cast<socklen_t>(offsetof(struct sockaddr_un,
+                                                 sun_path) +
+                                        path_.size() + (hidden ? 0U : 1U));
+
+        /* Only a socket nobody accepts on any more is replaced. */
+        if (!hidden && 0 == lstat(path, &status) && S_ISSOCK(status.st_mode)) {
+                probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if (-1 != probe &&
+                    -1 == connect(probe,
+                                  reinterpret_cast<struct sockaddr *>(
+                                          &address),
+                                  length) &&
+                    ECONNREFUSED == errno) {
+                        unlink(path);
+                }
+                if (-1 != probe) {
+                        close(probe);
+                }
+        }
+
+        listener_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (-1 == listener_) {
+                throw runtime_error("TimeStampDaemon::TimeStampDaemon() : "
+                                    "socket() failed");
+        }
+        if (-1 == bind(listener_,
+                       reinterpret_cast<struct sockaddr *>(&address),
+                       length) ||
+            -1 == listen(listener_, SOMAXCONN)) {
+                close(listener_);
+                throw runtime_error("TimeStampDaemon::TimeStampDaemon() : "
+                                    "cannot listen at the socket");
+        }
+}
+
+TimeStampDaemon::~TimeStampDaemon()
+{
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        /* Their runs fail, but end right away. */
+        for (int connection : active_) {
+                shutdown(connection, SHUT_RDWR);
+        }
+        idle_.wait(lock, [this]() {
+                return active_.empty();
+        });
+        close(listener_);
+        if ('@' != path_[0]) {
+                unlink(path_.c_str());
+        }
+}
+
+int TimeStampDaemon::serve()
+{
+        TimeStampOption warm       = defaults_;
+        FILE           *null       = std::fopen("/dev/null", "w");
+        int             connection = -1;
+        sigset_t        blocked;
+        sigset_t        saved;
+
+        signal(SIGPIPE, SIG_IGN);
+        mallopt(M_MMAP_THRESHOLD, DAEMON_HEAP_KEEP);
+        mallopt(M_TRIM_THRESHOLD, DAEMON_HEAP_KEEP);
+        /* Both codecs once, so either kind of request finds them warm. */
+        if (NULL != null) {
+                for (bool raw : {true, false}) {
+                        warm.raw = raw;
+                        try {
+                                timestamp_engine_calibrate(
+                                        0U, DAEMON_WARM_FRAMES, null, warm);
+                        } catch (const std::runtime_error &) {
+                                /* A cold run is merely slower. */
+                        }
+                }
+                std::fclose(null);
+        }
+
+        /* Only this thread is to see the signals that end the daemon. */
+        sigemptyset(&blocked);
+        sigaddset(&blocked, SIGTERM);
+        sigaddset(&blocked, SIGINT);
+        sigaddset(&blocked, SIGHUP);
+        sigaddset(&blocked, SIGALRM);
+        while (!stopping_.load() && !cmnutil_interrupted()) {
+                connection = accept4(listener_, NULL, NULL, SOCK_CLOEXEC);
+                if (-1 == connection) {
+                        if (stopping_.load() || cmnutil_interrupted()) {
+                                break;
+                        }
+                        if (EINTR == errno || ECONNABORTED == errno ||
+                            EMFILE == errno || ENFILE == errno) {
+                                continue;
+                        }
+                        return -1;
+                }
+                {
+                        std::lock_guard<std::mutex> lock(mutex_);
+
+                        active_.insert(connection);
+                }
+                pthread_sigmask(SIG_BLOCK, &blocked, &saved);
+                try {
+                        std::thread(&TimeStampDaemon::run_,
+                                    this,
+                                    connection).detach();
+                } catch (const std::system_error &) {
+                        run_(connection);
+                }
+                pthread_sigmask(SIG_SETMASK, &saved, NULL);
+        }
+        return 0;
+}
+
+void TimeStampDaemon::stop()
+{
+        stopping_.store(true);
+        shutdown(listener_, SHUT_RDWR);
+}
+
+uint64_t TimeStampDaemon::served() const
+{
+        return served_.load();
+}
+
+/* Writes all of 'len' bytes, giving up on the first failure. */
+static void daemon_write(int connection, const char *data, size_t len)
+{
+        ssize_t done = 0;
+
+        while (0U != len) {
+                done = write(connection, data, len);
+                if (-1 == done && EINTR == errno) {
+                        continue;
+                }
+                if (0 >= done) {
+                        return;
+                }
+                data += done;
+                len  -= static_cast<size_t>(done);
+        }
+}
+
+/*
+ * Takes the request line off 'connection' and not a byte more, the frames
+ * following it right away: what has arrived is peeked at first and only
+ * taken up to the newline.
+ */
+static bool daemon_request(int connection, char *line)
+{
+        size_t      len     = 0U;
+        ssize_t     got     = 0;
+        const char *newline = NULL;
+        size_t      take    = 0U;
+
+        while (len < DAEMON_REQUEST_MAX) {
+                got = recv(connection, line + len, DAEMON_REQUEST_MAX - len,
+                           MSG_PEEK);
+                if (-1 == got && EINTR == errno) {
+                        continue;
+                }
+                if (0 >= got) {
+                        return false;
+                }
+                newline = static_cast<const char *>(
+                                std::memchr(line + len, '\n',
+                                            static_cast<size_t>(got)));
+                take    = NULL == newline ?
+                          static_cast<size_t>(got) :
+                          static_cast<size_t>(newline - (line + len)) + 1U;
+                if (static_cast<ssize_t>(take) !=
+                    recv(connection, line + len, take, MSG_WAITALL)) {
+                        return false;
+                }
+                len += take;
+                if (NULL != newline) {
+                        line[len - 1U] = '\0';
+                        return true;
+                }
+        }
+        return false;
+}
+
+/* Bounds how long a recv() on 'connection' blocks, 0 for no limit. */
+static void daemon_receive_limit(int connection, uint64_t ms)
+{
+        struct timeval limit = {
+                static_cast<time_t>(ms / 1000U),
+                static_cast<suseconds_t>(ms % 1000U * 1000U)
+        };
+
+        setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &limit, sizeof limit);
+}
+
+/* Whether the client at 'connection' runs as the user of the daemon. */
+static bool daemon_same_user(int connection)
+{
+        struct ucred peer   = { };
+        socklen_t    length = sizeof peer;
+
+        return 0 == getsockopt(connection, SOL_SOCKET, SO_PEERCRED,
+                               &peer, &length) &&
+               geteuid() == peer.uid;
+}
+
+void TimeStampDaemon::run_(int connection)
+{
+        char            line[DAEMON_REQUEST_MAX] = { };
+        DaemonRequest   request(defaults_);
+        char           *text                     = NULL;
+        size_t          text_len                 = 0U;
+        std::string     status                   = "ok\n";
+        const char     *mismatch                 = NULL;
+
+        try {
+                daemon_receive_limit(connection, DAEMON_REQUEST_MS);
+                if (!daemon_request(connection, line)) {
+                        throw std::invalid_argument("no request line");
+                }
+                daemon_receive_limit(connection, 0U);
+                request.parse(line);
+                /* The daemon would create or truncate it on their behalf. */
+                if (request.option.log && !daemon_same_user(connection)) {
+                        throw std::invalid_argument("--log is only for "
+                                                    "clients of the same "
+                                                    "user as the daemon");
+                }
+                if (!request.send &&
+                    request.option.calibration.active() &&
+                    NULL != (mismatch = request.option.calibration.mismatch(
+                                     request.option.clock,
+                                     request.option.raw,
+                                     request.option.crc,
+                                     request.pad))) {
+                        throw std::invalid_argument(
+                                std::string("the calibration was measured "
+                                            "with another ") + mismatch);
+                }
+                if (request.stats) {
+                        request.option.stats = open_memstream(&text,
+                                                              &text_len);
+                }
+                if (request.send) {
+                        timestamp_engine_send(request.pad,
+                                              request.count,
+                                              connection,
+                                              request.option);
+                } else if (request.option.log) {
+                        LogFile log(request.log.c_str(), 0U, 0U, 1U);
+
+                        timestamp_engine_receive(request.pad,
+                                                 request.count,
+                                                 connection,
+                                                 log,
+                                                 request.option);
+                } else {
+                        LogFile log(stderr);
+
+                        timestamp_engine_receive(request.pad,
+                                                 request.count,
+                                                 connection,
+                                                 log,
+                                                 request.option);
+                }
+        } catch (const std::exception &error) {
+                status = std::string("error: ") + error.what() + "\n";
+        }
+        if (NULL != request.option.stats) {
+                std::fclose(request.option.stats);
+                daemon_write(connection, text, text_len);
+                std::free(text);
+        }
+        daemon_write(connection, status.data(), status.size());
+        ++served_;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        /* Under the lock, lest the destructor shut a reused descriptor. */
+        active_.erase(connection);
+        close(connection);
+        if (active_.empty()) {
+                idle_.notify_all();
+        }
+}
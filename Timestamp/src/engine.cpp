@@ -0,0 +1,1105 @@
+/**
+ * @file engine.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation file of the entry points of the TimeStampEngine.
+ * Padding sizes that tsTest.py sweeps by default get an instantiation of
+ * their own, anything else runs with the padding size as a variable.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "engine.h"
+#include "timestamp_tmp.h"
+
+#include <cinttypes> /* PRId64 PRIu64 */
+#include <cstdlib>   /* free() */
+#include <exception> /* exception_ptr rethrow_exception() */
+#include <stdexcept> /* runtime_error */
+#include <string>
+#include <thread>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <fcntl.h>      /* F_GETPIPE_SZ F_SETPIPE_SZ fcntl() pipe2() */
+#include <sys/prctl.h> /* prctl() */
+#include <time.h>       /* clock_gettime() */
+#include <unistd.h>     /* close() */
+
+#ifdef __cplusplus
+}
+#endif
+
+/* 'Codec' as it is, or protected by a CrcCodec if CRC is set. */
+template<typename Codec, bool CRC>
+struct EngineCodec {
+        typedef Codec Type;
+};
+
+template<typename Codec>
+struct EngineCodec<Codec, true> {
+        typedef CrcCodec<Codec> Type;
+};
+
+/* Frames dropped by the codec of a run for failing their check. */
+template<typename Codec>
+static uint64_t engine_corrupt(const Codec &)
+{
+        return 0U;
+}
+
+template<typename Inner>
+static uint64_t engine_corrupt(const CrcCodec<Inner> &codec)
+{
+        return codec.corrupt();
+}
+
+/* Fails a run whose codec could not push out its last frames. */
+template<typename Engine>
+static size_t engine_flushed(const Engine &engine,
+                             size_t        sent,
+                             const char   *caller)
+{
+        using std::runtime_error;
+
+        if (!engine.flushed()) {
+                throw runtime_error(std::string(caller) + " : failed to "
+                                    "flush the last frames, " +
+                                    std::to_string(sent) + " sent before");
+        }
+        return sent;
+}
+
+/* Sends with the padding size fixed at compile time where it is common. */
+template<typename Transport, typename Codec, typename Clock>
+static size_t engine_send(Transport             &transport,
+                          Codec                 &codec,
+                          size_t                 pad,
+                          size_t                 count,
+                          const TimeStampOption &option)
+{
+        PayloadGenerator                         payload(option.payload, pad);
+        TimeStampEngine<Transport, Codec, Clock> engine(transport,
+                                                        codec,
+                                                        option.rate);
+        size_t                                   sent = 0U;
+
+        switch (pad) {
+        case 0U:
+                sent = engine.template send<0U>(count, pad, payload);
+                break;
+        case 2U:
+                sent = engine.template send<2U>(count, pad, payload);
+                break;
+        case 32U:
+                sent = engine.template send<32U>(count, pad, payload);
+                break;
+        case 512U:
+                sent = engine.template send<512U>(count, pad, payload);
+                break;
+        case 8192U:
+                sent = engine.template send<8192U>(count, pad, payload);
+                break;
+        default:
+                sent = engine.template send<TIMESTAMP_DYNAMIC_PAD>(count,
+                                                                   pad,
+                                                                   payload);
+                break;
+        }
+        return engine_flushed(engine, sent, "engine_send()");
+}
+
+/* Replays a Schedule or a TrafficModel, the 'Source'. */
+template<typename Transport, typename Codec, typename Clock, typename Source>
+static size_t engine_replay(Transport             &transport,
+                            Codec                 &codec,
+                            Source                &source,
+                            size_t                 count,
+                            Histogram             &late,
+                            uint64_t              *planned,
+                            const TimeStampOption &option)
+{
+        PayloadGenerator                         payload(option.payload,
+                                                         source.max_pad());
+        TimeStampEngine<Transport, Codec, Clock> engine(transport, codec, 0U);
+
+        return engine_flushed(engine,
+                              engine.replay(source,
+                                            count,
+                                            payload,
+                                            late,
+                                            planned),
+                              "engine_replay()");
+}
+
+/* Picks the transport and the codec of a replay as engine_send_clock(). */
+template<typename Clock, bool CRC, typename Source>
+static size_t engine_replay_codec(Source                &source,
+                                  size_t                 count,
+                                  int                    fd,
+                                  Histogram             &late,
+                                  uint64_t              *planned,
+                                  const TimeStampOption &option)
+{
+        typedef typename EngineCodec<RawCodec, CRC>::Type    Raw;
+        typedef typename EngineCodec<Base64Codec, CRC>::Type Base64;
+
+        const size_t frame = sizeof(FrameHeader) + source.max_pad() +
+                             (CRC ? CRC32C_SIZE : 0U);
+
+        if (NULL != option.shm) {
+                ShmTransport transport(option.shm,
+                                       frame,
+                                       ShmRingRole::PRODUCER,
+                                       option.shm_spin);
+                Raw          codec;
+
+                return engine_replay<ShmTransport, Raw, Clock>(
+                                transport, codec, source, count, late,
+                                planned, option);
+        }
+
+        FdTransport transport(fd, 0U);
+
+        if (option.raw) {
+                Raw         codec;
+
+                return engine_replay<FdTransport, Raw, Clock>(
+                                transport, codec, source, count, late,
+                                planned, option);
+        }
+
+        Base64      codec(frame);
+
+        return engine_replay<FdTransport, Base64, Clock>(
+                        transport, codec, source, count, late, planned,
+                        option);
+}
+
+template<typename Clock, typename Source>
+static size_t engine_replay_clock(Source                &source,
+                                  size_t                 count,
+                                  int                    fd,
+                                  Histogram             &late,
+                                  uint64_t              *planned,
+                                  const TimeStampOption &option)
+{
+        if (option.crc) {
+                return engine_replay_codec<Clock, true>(
+                                source, count, fd, late, planned, option);
+        }
+        return engine_replay_codec<Clock, false>(
+                        source, count, fd, late, planned, option);
+}
+
+/*
+ * Replays the first 'count' records of 'source' and reports how far the
+ * departures strayed from them; 'caller' names the entry point in errors.
+ */
+template<typename Source>
+static void engine_replay_source(Source                &source,
+                                 size_t                 count,
+                                 int                    fd,
+                                 const TimeStampOption &option,
+                                 const char            *caller)
+{
+        using std::runtime_error;
+
+        Histogram       late;
+        struct timespec start    = { };
+        struct timespec end      = { };
+        size_t          sent     = 0U;
+        uint64_t        planned  = 0U;
+        double          achieved = 0.0;
+
+        /*
+         * Sleeps otherwise overshoot by up to the default timer slack of
+         * 50 microseconds, which would dwarf the gaps within a burst.
+         */
+        prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (CLOCK_REALTIME_COARSE == option.clock) {
+                sent = engine_replay_clock<CoarseClock>(source,
+                                                        count,
+                                                        fd,
+                                                        late,
+                                                        &planned,
+                                                        option);
+        } else {
+                sent = engine_replay_clock<RealtimeClock>(source,
+                                                          count,
+                                                          fd,
+                                                          late,
+                                                          &planned,
+                                                          option);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        achieved = static_cast<double>(end.tv_sec - start.tv_sec) * 1e9 +
+                   static_cast<double>(end.tv_nsec - start.tv_nsec);
+
+        if (NULL != option.stats) {
+                fprintf(option.stats,
+                        "# ts replay summary, deviations from the schedule "
+                        "in nanoseconds\n");
+                fprintf(option.stats, "%-24s %zu\n", "frames", sent);
+                fprintf(option.stats, "%-24s %" PRIu64 "\n",
+                        "replay.planned", planned);
+                fprintf(option.stats, "%-24s %.0f\n", "replay.achieved",
+                        achieved);
+                fprintf(option.stats, "%-24s %.0f\n", "replay.late.mean",
+                        late.mean());
+                fprintf(option.stats, "%-24s %" PRId64 "\n",
+                        "replay.late.p50", late.percentile(0.50));
+                fprintf(option.stats, "%-24s %" PRId64 "\n",
+                        "replay.late.p99", late.percentile(0.99));
+                fprintf(option.stats, "%-24s %" PRId64 "\n",
+                        "replay.late.max", late.max());
+                fflush(option.stats);
+        }
+
+        if (count != sent) {
+                throw runtime_error(std::string(caller) + " : "
+                                    "failed to send required amount");
+        }
+}
+
+template<typename Clock, bool CRC>
+static size_t engine_send_codec(size_t                 pad,
+                                size_t                 count,
+                                int                    fd,
+                                const TimeStampOption &option)
+{
+        typedef typename EngineCodec<RawCodec, CRC>::Type    Raw;
+        typedef typename EngineCodec<Base64Codec, CRC>::Type Base64;
+
+        const size_t frame = sizeof(FrameHeader) + pad +
+                             (CRC ? CRC32C_SIZE : 0U);
+
+        if (NULL != option.shm) {
+                ShmTransport transport(option.shm,
+                                       frame,
+                                       ShmRingRole::PRODUCER,
+                                       option.shm_spin);
+                Raw          codec;
+
+                return engine_send<ShmTransport, Raw, Clock>(
+                                transport, codec, pad, count, option);
+        }
+
+        FdTransport transport(fd, 0U);
+
+        if (option.raw) {
+                Raw         codec;
+
+                return engine_send<FdTransport, Raw, Clock>(
+                                transport, codec, pad, count, option);
+        }
+
+        Base64      codec(frame);
+
+        return engine_send<FdTransport, Base64, Clock>(
+                        transport, codec, pad, count, option);
+}
+
+template<typename Clock>
+static size_t engine_send_clock(size_t                 pad,
+                                size_t                 count,
+                                int                    fd,
+                                const TimeStampOption &option)
+{
+        if (option.crc) {
+                return engine_send_codec<Clock, true>(pad, count, fd, option);
+        }
+        return engine_send_codec<Clock, false>(pad, count, fd, option);
+}
+
+/* Holds what a ModelSink saw against the load its model offered. */
+template<typename Sink>
+static void engine_model_report(FILE *stats, const ModelSink<Sink> &sink)
+{
+        const Histogram *histogram[] = {&sink.burst(), &sink.lull()};
+        const char      *name[]      = {"model.burst", "model.lull"};
+        const double     planned     = static_cast<double>(sink.planned());
+        const double     achieved    = static_cast<double>(sink.achieved());
+        const double     gaps        = static_cast<double>(sink.frames()) -
+                                       1.0;
+        char             key[32];
+
+        fprintf(stats,
+                "# ts model summary, offered against achieved load, "
+                "latencies in nanoseconds\n");
+        fprintf(stats, "%-24s %" PRIu64 "\n", "model.frames",
+                sink.frames());
+        fprintf(stats, "%-24s %" PRIu64 "\n", "model.mismatch",
+                sink.mismatch());
+        fprintf(stats, "%-24s %.0f\n", "model.offered.fps",
+                0.0 < planned ? gaps * 1e9 / planned : 0.0);
+        fprintf(stats, "%-24s %.0f\n", "model.achieved.fps",
+                0.0 < achieved ? gaps * 1e9 / achieved : 0.0);
+        fprintf(stats, "%-24s %.0f\n", "model.offered.bps",
+                0.0 < planned ?
+                static_cast<double>(sink.bytes()) * 8e9 / planned : 0.0);
+        fprintf(stats, "%-24s %.0f\n", "model.achieved.bps",
+                0.0 < achieved ?
+                static_cast<double>(sink.bytes()) * 8e9 / achieved : 0.0);
+        for (size_t i = 0U; i < 2U; ++i) {
+                snprintf(key, sizeof key, "%s.frames", name[i]);
+                fprintf(stats, "%-24s %" PRIu64 "\n", key,
+                        histogram[i]->count());
+                snprintf(key, sizeof key, "%s.mean", name[i]);
+                fprintf(stats, "%-24s %.0f\n", key, histogram[i]->mean());
+                snprintf(key, sizeof key, "%s.p50", name[i]);
+                fprintf(stats, "%-24s %" PRId64 "\n", key,
+                        histogram[i]->percentile(0.50));
+                snprintf(key, sizeof key, "%s.p99", name[i]);
+                fprintf(stats, "%-24s %" PRId64 "\n", key,
+                        histogram[i]->percentile(0.99));
+        }
+}
+
+/* How far out of order the frames a ReorderSink put back in order were. */
+template<typename Sink>
+static void engine_reorder_report(FILE *stats, const ReorderSink<Sink> &sink)
+{
+        fprintf(stats,
+                "# ts reorder summary, latencies in nanoseconds\n");
+        fprintf(stats, "%-24s %zu\n", "reorder.window", sink.window());
+        fprintf(stats, "%-24s %" PRIu64 "\n", "reorder.frames",
+                sink.reordered());
+        fprintf(stats, "%-24s %" PRId64 "\n", "reorder.distance.p50",
+                sink.distance().percentile(0.50));
+        fprintf(stats, "%-24s %" PRId64 "\n", "reorder.distance.p99",
+                sink.distance().percentile(0.99));
+        fprintf(stats, "%-24s %" PRId64 "\n", "reorder.distance.max",
+                sink.distance().max());
+        fprintf(stats, "%-24s %" PRId64 "\n", "reorder.late.p50",
+                sink.late().percentile(0.50));
+        fprintf(stats, "%-24s %" PRId64 "\n", "reorder.late.p99",
+                sink.late().percentile(0.99));
+        fprintf(stats, "%-24s %" PRId64 "\n", "reorder.late.max",
+                sink.late().max());
+        fprintf(stats, "%-24s %" PRIu64 "\n", "reorder.skipped",
+                sink.skipped());
+        fprintf(stats, "%-24s %" PRIu64 "\n", "reorder.duplicate",
+                sink.duplicate());
+}
+
+/*
+ * Receives into a 'Sink' and prints the same summary the TimeStamp class
+ * does; 'ring' is the shared memory ring the frames came through, if any,
+ * and 'model' the regenerated traffic model they were sent by, if any.
+ * A streaming run goes through a StreamSink instead of a ModelSink, and
+ * with 'option.reorder' the frames go through a ReorderSink.
+ * Returns the frames accounted for, which includes those still missing
+ * when the run timed out (see TimeStampOption::timeout) or stopped at a
+ * frame too long to be taken on trust (see FdTransport::overrun()).
+ */
+template<typename Sink, typename Transport, typename Codec, typename Clock>
+static size_t engine_receive(Transport             &transport,
+                             Codec                 &codec,
+                             size_t                 count,
+                             LogFile               &log,
+                             const ShmRing         *ring,
+                             TrafficModel          *model,
+                             const TimeStampOption &option)
+{
+        Sink                                     sink(log.get());
+        TimeStampEngine<Transport, Codec, Clock> engine(transport, codec, 0U);
+        size_t                                   received = 0U;
+        size_t                                   missing  = 0U;
+        bool                                     overrun  = false;
+        struct timespec                          now      = { };
+        const struct timespec                    deadline =
+                cmnutil_deadline(option.timeout);
+
+        if (0U != option.timeout || 0U != option.idle_timeout) {
+                transport.limit(option.idle_timeout,
+                                0U == option.timeout ? NULL : &deadline);
+        }
+        if (NULL != model) {
+                ModelSink<Sink> model_sink(sink, *model);
+
+                received = engine.receive(count, model_sink);
+                if (NULL != option.stats) {
+                        engine_model_report(option.stats, model_sink);
+                }
+        } else if (option.stream) {
+                StreamSink<Sink> stream_sink(sink,
+                                             log,
+                                             option.interval,
+                                             option.stats,
+                                             option.calibration);
+
+                received = engine.receive(count, stream_sink);
+                Clock::now(&now);
+                stream_sink.finish(now);
+        } else if (0U != option.reorder) {
+                ReorderSink<Sink> reorder_sink(sink, option.reorder);
+
+                received = engine.receive(count, reorder_sink);
+                if (-1 == reorder_sink.finish()) {
+                        received = 0U;
+                }
+                if (NULL != option.stats) {
+                        engine_reorder_report(option.stats, reorder_sink);
+                }
+        } else {
+                received = engine.receive(count, sink);
+        }
+        /* An unlimited stream has nothing missing. */
+        overrun = transport.overrun() || codec.overrun();
+        if ((transport.timed_out() || overrun) && SIZE_MAX != count) {
+                missing = count - received;
+        }
+        if (-1 == sink.flush()) {
+                received = 0U;
+                missing  = 0U;
+        }
+        if (NULL != option.stats) {
+                timestamp_report(option.stats,
+                                 sink.delta(),
+                                 sink.lost() + missing,
+                                 "receiver",
+                                 option.calibration);
+                timestamp_report_jitter(option.stats, sink.jitter());
+                if (0U != option.timeout || 0U != option.idle_timeout ||
+                    overrun) {
+                        fprintf(option.stats, "%-24s %zu\n",
+                                "frames.missing", missing);
+                }
+                /* The overlong frame is the one the check never got to. */
+                if (option.crc) {
+                        fprintf(option.stats, "%-24s %" PRIu64 "\n",
+                                "frames.corrupt",
+                                engine_corrupt(codec) + (overrun ? 1U : 0U));
+                }
+                if (NULL != ring) {
+                        fprintf(option.stats, "%-24s %zu\n", "shm.slots",
+                                ring->slots());
+                        fprintf(option.stats, "%-24s %" PRIu64 "\n",
+                                "shm.sleeps", ring->sleeps());
+                }
+                fflush(option.stats);
+        }
+        return received + missing;
+}
+
+template<typename Sink, typename Clock, bool CRC>
+static size_t engine_receive_codec(size_t                 pad,
+                                   size_t                 count,
+                                   int                    fd,
+                                   LogFile               &log,
+                                   TrafficModel          *model,
+                                   const TimeStampOption &option)
+{
+        typedef typename EngineCodec<RawCodec, CRC>::Type    Raw;
+        typedef typename EngineCodec<Base64Codec, CRC>::Type Base64;
+
+        const size_t frame = sizeof(FrameHeader) + pad +
+                             (CRC ? CRC32C_SIZE : 0U);
+
+        if (NULL != option.shm) {
+                ShmTransport transport(option.shm,
+                                       frame,
+                                       ShmRingRole::CONSUMER,
+                                       option.shm_spin);
+                Raw          codec;
+
+                return engine_receive<Sink, ShmTransport, Raw, Clock>(
+                                transport,
+                                codec,
+                                count,
+                                log,
+                                &transport.ring(),
+                                model,
+                                option);
+        }
+
+        /* Room for plenty of frames, but at least a whole one. */
+        FdTransport transport(fd, frame > (1U << 20) ? frame : 1U << 20);
+
+        if (option.raw) {
+                Raw         codec;
+
+                return engine_receive<Sink, FdTransport, Raw, Clock>(
+                                transport, codec, count, log, NULL, model,
+                                option);
+        }
+
+        Base64      codec(frame);
+
+        return engine_receive<Sink, FdTransport, Base64, Clock>(
+                        transport, codec, count, log, NULL, model, option);
+}
+
+template<typename Sink, typename Clock>
+static size_t engine_receive_clock(size_t                 pad,
+                                   size_t                 count,
+                                   int                    fd,
+                                   LogFile               &log,
+                                   TrafficModel          *model,
+                                   const TimeStampOption &option)
+{
+        if (option.crc) {
+                return engine_receive_codec<Sink, Clock, true>(
+                                pad, count, fd, log, model, option);
+        }
+        return engine_receive_codec<Sink, Clock, false>(
+                        pad, count, fd, log, model, option);
+}
+
+template<typename Sink>
+static size_t engine_receive_sink(size_t                 pad,
+                                  size_t                 count,
+                                  int                    fd,
+                                  LogFile               &log,
+                                  TrafficModel          *model,
+                                  const TimeStampOption &option)
+{
+        if (CLOCK_REALTIME_COARSE == option.clock) {
+                return engine_receive_clock<Sink, CoarseClock>(
+                                pad, count, fd, log, model, option);
+        }
+        return engine_receive_clock<Sink, RealtimeClock>(
+                        pad, count, fd, log, model, option);
+}
+
+/* Picks the sink, one writing the per frame log or one that does not. */
+static size_t engine_receive_log(size_t                 pad,
+                                 size_t                 count,
+                                 int                    fd,
+                                 LogFile               &log,
+                                 TrafficModel          *model,
+                                 const TimeStampOption &option)
+{
+        narrow_cast<uint32_t, size_t>(pad);
+        if (option.log) {
+                return engine_receive_sink<LogSink>(pad,
+                                                    count,
+                                                    fd,
+                                                    log,
+                                                    model,
+                                                    option);
+        }
+        return engine_receive_sink<StatsSink>(pad,
+                                              count,
+                                              fd,
+                                              log,
+                                              model,
+                                              option);
+}
+
+/* Nanoseconds from 'start' to 'end'. */
+static int64_t engine_elapsed(const struct timespec &start,
+                              const struct timespec &end)
+{
+        return static_cast<int64_t>(end.tv_sec - start.tv_sec) * 1000000000 +
+               (end.tv_nsec - start.tv_nsec);
+}
+
+/* One step of the calibration as "key value" lines. */
+static void engine_calibration_print(FILE            *out,
+                                     const char      *step,
+                                     const Histogram &cost)
+{
+        using std::string;
+
+        const string name(step);
+
+        fprintf(out, "%-24s %" PRId64 "\n", (name + ".min").c_str(),
+                cost.min());
+        fprintf(out, "%-24s %.0f\n",        (name + ".mean").c_str(),
+                cost.mean());
+        fprintf(out, "%-24s %" PRId64 "\n", (name + ".p50").c_str(),
+                cost.percentile(0.50));
+        fprintf(out, "%-24s %" PRId64 "\n", (name + ".p99").c_str(),
+                cost.percentile(0.99));
+        fprintf(out, "%-24s %" PRId64 "\n", (name + ".max").c_str(),
+                cost.max());
+}
+
+/*
+ * Sends every frame through the pipe 'fd' and reads it right back, timing
+ * both halves with CLOCK_MONOTONIC; the stamps in the frames themselves
+ * come from 'Clock' as in a real run.
+ */
+template<typename Codec, typename Clock>
+static void engine_calibrate(const int              fd[2],
+                             Codec                 &encoder,
+                             Codec                 &decoder,
+                             size_t                 pad,
+                             size_t                 count,
+                             FILE                  *out,
+                             const TimeStampOption &option)
+{
+        using std::runtime_error;
+
+        FdTransport                                sender(fd[1], 0U);
+        FdTransport                                receiver(fd[0], 1U << 20);
+        TimeStampEngine<FdTransport, Codec, Clock> send_engine(sender,
+                                                               encoder,
+                                                               0U);
+        TimeStampEngine<FdTransport, Codec, Clock> receive_engine(receiver,
+                                                                  decoder,
+                                                                  0U);
+        PayloadGenerator                           payload(option.payload,
+                                                           pad);
+        StatsSink                                  sink(NULL);
+        FrameHeader                                header      = { };
+        struct timespec                            start       = { };
+        struct timespec                            sent        = { };
+        struct timespec                            received    = { };
+        struct timespec                            resolution  = { };
+        Histogram                                  read;
+        Histogram                                  send;
+        Histogram                                  receive;
+        Calibration                                calibration;
+
+        /* Back to back reads, as the receiver does after every frame. */
+        for (size_t i = 0U; i < count; ++i) {
+                Clock::now(&start);
+                Clock::now(&sent);
+                read.record(engine_elapsed(start, sent));
+        }
+        for (size_t i = 0U; i < count; ++i) {
+                header.seq = i;
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                if (!send_engine.template emit<TIMESTAMP_DYNAMIC_PAD>(
+                            &header, pad, payload.next()) ||
+                    !send_engine.finish()) {
+                        throw runtime_error("timestamp_engine_calibrate() : "
+                                            "failed to send a frame");
+                }
+                clock_gettime(CLOCK_MONOTONIC, &sent);
+                if (1U != receive_engine.receive(1U, sink)) {
+                        throw runtime_error("timestamp_engine_calibrate() : "
+                                            "failed to receive a frame");
+                }
+                clock_gettime(CLOCK_MONOTONIC, &received);
+                send.record(engine_elapsed(start, sent));
+                receive.record(engine_elapsed(sent, received));
+        }
+
+        /*
+         * The fixed part of the floor is the least latency seen; anything
+         * finer than a clock tick or a clock read cannot be told apart.
+         */
+        clock_getres(option.clock, &resolution);
+        calibration.floor      = sink.delta().min();
+        calibration.resolution = engine_elapsed({0, 0}, resolution);
+        if (read.percentile(0.50) > calibration.resolution) {
+                calibration.resolution = read.percentile(0.50);
+        }
+
+        fprintf(out, "# ts calibration, costs in nanoseconds\n");
+        fprintf(out, "%-24s %s\n", CALIBRATION_CLOCK,
+                Calibration::clock_name(option.clock));
+        fprintf(out, "%-24s %s\n", CALIBRATION_CODEC,
+                Calibration::codec_name(option.raw, option.crc));
+        fprintf(out, "%-24s %zu\n", CALIBRATION_PAD, pad);
+        fprintf(out, "%-24s %zu\n", "frames", count);
+        fprintf(out, "%-24s %" PRId64 "\n", "clock.resolution",
+                engine_elapsed({0, 0}, resolution));
+        engine_calibration_print(out, "clock.read", read);
+        /* Stamp, encode and write; read, decode and stamp. */
+        engine_calibration_print(out, "send", send);
+        engine_calibration_print(out, "receive", receive);
+        /* What the receiver reports for a link that takes no time. */
+        engine_calibration_print(out, "latency", sink.delta());
+        fprintf(out, "%-24s %" PRId64 "\n", CALIBRATION_FLOOR,
+                calibration.floor);
+        fprintf(out, "%-24s %" PRId64 "\n", CALIBRATION_RESOLUTION,
+                calibration.resolution);
+}
+
+template<typename Clock, bool CRC>
+static void engine_calibrate_codec(const int              fd[2],
+                                   size_t                 pad,
+                                   size_t                 count,
+                                   FILE                  *out,
+                                   const TimeStampOption &option)
+{
+        typedef typename EngineCodec<RawCodec, CRC>::Type    Raw;
+        typedef typename EngineCodec<Base64Codec, CRC>::Type Base64;
+
+        const size_t frame = sizeof(FrameHeader) + pad +
+                             (CRC ? CRC32C_SIZE : 0U);
+
+        if (option.raw) {
+                Raw encoder;
+                Raw decoder;
+
+                engine_calibrate<Raw, Clock>(fd,
+                                             encoder,
+                                             decoder,
+                                             pad,
+                                             count,
+                                             out,
+                                             option);
+                return;
+        }
+
+        Base64 encoder(frame);
+        Base64 decoder(frame);
+
+        engine_calibrate<Base64, Clock>(fd,
+                                        encoder,
+                                        decoder,
+                                        pad,
+                                        count,
+                                        out,
+                                        option);
+}
+
+template<typename Clock>
+static void engine_calibrate_clock(const int              fd[2],
+                                   size_t                 pad,
+                                   size_t                 count,
+                                   FILE                  *out,
+                                   const TimeStampOption &option)
+{
+        if (option.crc) {
+                engine_calibrate_codec<Clock, true>(fd,
+                                                    pad,
+                                                    count,
+                                                    out,
+                                                    option);
+        } else {
+                engine_calibrate_codec<Clock, false>(fd,
+                                                     pad,
+                                                     count,
+                                                     out,
+                                                     option);
+        }
+}
+
+bool timestamp_engine_supports(const TimeStampOption &option)
+{
+        return !option.pipeline &&
+               !option.splice &&
+               1U == option.batch &&
+               0U == option.batch_usec &&
+               (CLOCK_REALTIME == option.clock ||
+                CLOCK_REALTIME_COARSE == option.clock);
+}
+
+void timestamp_engine_send(size_t                 pad,
+                           size_t                 count,
+                           int                    fd,
+                           const TimeStampOption &option)
+{
+        using std::runtime_error;
+
+        const size_t limit = option.stream && 0U == count ? SIZE_MAX : count;
+        size_t       sent  = 0U;
+
+        /* The length field of the header is only 32 bits wide. */
+        narrow_cast<uint32_t, size_t>(pad);
+        if (CLOCK_REALTIME_COARSE == option.clock) {
+                sent = engine_send_clock<CoarseClock>(pad, limit, fd, option);
+        } else {
+                sent = engine_send_clock<RealtimeClock>(pad,
+                                                        limit,
+                                                        fd,
+                                                        option);
+        }
+
+        /* Frames are never coalesced here, see TimeStamp::report_send_(). */
+        if (NULL != option.stats && option.raw) {
+                fprintf(option.stats,
+                        "# ts sender summary, latencies in nanoseconds\n");
+                fprintf(option.stats, "%-24s %zu\n", "frames", sent);
+                fprintf(option.stats, "%-24s %zu\n", "writes", sent);
+                fprintf(option.stats, "%-24s %.2f\n", "frames.per.write",
+                        0U == sent ? 0.0 : 1.0);
+                fflush(option.stats);
+        }
+
+        if (limit != sent && !(option.stream && cmnutil_interrupted())) {
+                throw runtime_error("timestamp_engine_send() : "
+                                    "failed to send required amount");
+        }
+}
+
+void timestamp_engine_receive(size_t                 pad,
+                              size_t                 count,
+                              int                    fd,
+                              FILE                  *log,
+                              const TimeStampOption &option,
+                              const TrafficSpec     *traffic)
+{
+        LogFile file(log);
+
+        timestamp_engine_receive(pad, count, fd, file, option, traffic);
+}
+
+void timestamp_engine_receive(size_t                 pad,
+                              size_t                 count,
+                              int                    fd,
+                              LogFile               &log,
+                              const TimeStampOption &option,
+                              const TrafficSpec     *traffic)
+{
+        using std::runtime_error;
+
+        const size_t limit    = option.stream && 0U == count ?
+                                SIZE_MAX : count;
+        size_t       received = 0U;
+
+        if (NULL != traffic && traffic->active()) {
+                TrafficModel model(*traffic, pad, count);
+
+                received = engine_receive_log(model.max_pad() > pad ?
+                                              model.max_pad() : pad,
+                                              limit,
+                                              fd,
+                                              log,
+                                              &model,
+                                              option);
+        } else {
+                received = engine_receive_log(pad,
+                                              limit,
+                                              fd,
+                                              log,
+                                              NULL,
+                                              option);
+        }
+
+        /* An unlimited stream ends whenever the sender stops. */
+        if (limit != received &&
+            !(option.stream && (SIZE_MAX == limit || cmnutil_interrupted()))) {
+                throw runtime_error("timestamp_engine_receive() : "
+                                    "failed to receive required amount");
+        }
+}
+
+/*
+ * Seconds on CLOCK_MONOTONIC that 'direction' took; what it threw, if
+ * anything, goes to 'error' rather than past a thread.
+ */
+template<typename Direction>
+static double engine_direction(const Direction    &direction,
+                               std::exception_ptr *error)
+{
+        struct timespec start = { };
+        struct timespec end   = { };
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        try {
+                direction();
+        } catch (...) {
+                *error = std::current_exception();
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        return static_cast<double>(engine_elapsed(start, end)) / 1e9;
+}
+
+/* How long one direction of a duplex run took, and at what rate. */
+static void engine_duplex_print(FILE       *stats,
+                                const char *what,
+                                size_t      count,
+                                double      seconds)
+{
+        const std::string key = what;
+
+        fprintf(stats, "%-24s %.6f\n", (key + ".seconds").c_str(), seconds);
+        fprintf(stats, "%-24s %.0f\n", (key + ".rate").c_str(),
+                0.0 < seconds ? static_cast<double>(count) / seconds : 0.0);
+}
+
+void timestamp_engine_duplex(size_t                 pad,
+                             size_t                 count,
+                             int                    in,
+                             int                    out,
+                             LogFile               &log,
+                             const TimeStampOption &option)
+{
+        using std::runtime_error;
+
+        TimeStampOption    send_option     = option;
+        TimeStampOption    receive_option  = option;
+        /* Each direction summarizes into memory, not to interleave. */
+        char              *send_text       = NULL;
+        char              *receive_text    = NULL;
+        size_t             send_len        = 0U;
+        size_t             receive_len     = 0U;
+        double             send_seconds    = 0.0;
+        double             receive_seconds = 0.0;
+        std::exception_ptr send_error;
+        std::exception_ptr receive_error;
+
+        if (NULL != option.stats) {
+                send_option.stats    = open_memstream(&send_text, &send_len);
+                receive_option.stats = open_memstream(&receive_text,
+                                                      &receive_len);
+                if (NULL == send_option.stats ||
+                    NULL == receive_option.stats) {
+                        if (NULL != send_option.stats) {
+                                fclose(send_option.stats);
+                        }
+                        if (NULL != receive_option.stats) {
+                                fclose(receive_option.stats);
+                        }
+                        std::free(send_text);
+                        std::free(receive_text);
+                        throw runtime_error("timestamp_engine_duplex() : "
+                                            "open_memstream() failed");
+                }
+        }
+
+        std::thread sender([&]() {
+                send_seconds = engine_direction([&]() {
+                        timestamp_engine_send(pad, count, out, send_option);
+                }, &send_error);
+        });
+
+        receive_seconds = engine_direction([&]() {
+                timestamp_engine_receive(pad,
+                                         count,
+                                         in,
+                                         log,
+                                         receive_option);
+        }, &receive_error);
+        sender.join();
+
+        if (NULL != option.stats) {
+                fclose(send_option.stats);
+                fclose(receive_option.stats);
+                fprintf(option.stats,
+                        "# ts duplex summary, rates in frames per second\n");
+                engine_duplex_print(option.stats, "send", count,
+                                    send_seconds);
+                engine_duplex_print(option.stats, "receive", count,
+                                    receive_seconds);
+                fwrite(send_text, 1U, send_len, option.stats);
+                fwrite(receive_text, 1U, receive_len, option.stats);
+                fflush(option.stats);
+                std::free(send_text);
+                std::free(receive_text);
+        }
+        if (send_error) {
+                std::rethrow_exception(send_error);
+        }
+        if (receive_error) {
+                std::rethrow_exception(receive_error);
+        }
+}
+
+void timestamp_engine_replay(const char            *path,
+                             size_t                 count,
+                             int                    fd,
+                             const TimeStampOption &option)
+{
+        using std::runtime_error;
+
+        Schedule schedule(path);
+
+        if (count > schedule.count()) {
+                throw runtime_error("timestamp_engine_replay() : " +
+                                    std::string(path) +
+                                    ": fewer records than asked for");
+        }
+        if (0U == count) {
+                count = schedule.count();
+        }
+        engine_replay_source(schedule,
+                             count,
+                             fd,
+                             option,
+                             "timestamp_engine_replay()");
+}
+
+void timestamp_engine_model(const TrafficSpec     &spec,
+                            size_t                 pad,
+                            size_t                 count,
+                            int                    fd,
+                            const TimeStampOption &option)
+{
+        TrafficModel model(spec, pad, count);
+
+        narrow_cast<uint32_t, size_t>(model.max_pad());
+        engine_replay_source(model,
+                             count,
+                             fd,
+                             option,
+                             "timestamp_engine_model()");
+}
+
+void timestamp_engine_calibrate(size_t                 pad,
+                                size_t                 count,
+                                FILE                  *out,
+                                const TimeStampOption &option)
+{
+        using std::runtime_error;
+
+        /* A base64 frame takes 4 bytes for every 3, plus line breaks. */
+        const size_t frame  = sizeof(FrameHeader) + pad + CRC32C_SIZE;
+        const size_t needed = frame / 3U * 4U + frame / 48U + 8U;
+        int          fd[2]  = {-1, -1};
+
+        narrow_cast<uint32_t, size_t>(pad);
+        if (0U == count) {
+                throw runtime_error("timestamp_engine_calibrate() : "
+                                    "no frames to calibrate with");
+        }
+        if (-1 == pipe2(fd, O_CLOEXEC)) {
+                throw runtime_error("timestamp_engine_calibrate() : "
+                                    "pipe2() failed");
+        }
+        /* Every frame sits in the pipe whole before it is read back. */
+        if (static_cast<size_t>(fcntl(fd[1], F_GETPIPE_SZ)) < needed &&
+            -1 == fcntl(fd[1], F_SETPIPE_SZ, static_cast<int>(needed))) {
+                close(fd[0]);
+                close(fd[1]);
+                throw runtime_error("timestamp_engine_calibrate() : "
+                                    "frame too large for a pipe");
+        }
+        try {
+                if (CLOCK_REALTIME_COARSE == option.clock) {
+                        engine_calibrate_clock<CoarseClock>(fd,
+                                                            pad,
+                                                            count,
+                                                            out,
+                                                            option);
+                } else {
+                        engine_calibrate_clock<RealtimeClock>(fd,
+                                                              pad,
+                                                              count,
+                                                              out,
+                                                              option);
+                }
+        } catch (...) {
+                close(fd[0]);
+                close(fd[1]);
+                throw;
+        }
+        close(fd[0]);
+        close(fd[1]);
+        if (0 != fflush(out) || ferror(out)) {
+                throw runtime_error("timestamp_engine_calibrate() : "
+                                    "failed to write the calibration");
+        }
+}
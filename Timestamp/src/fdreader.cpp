@@ -0,0 +1,241 @@
+/**
+ * @file fdreader.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation source file of the FdReader class.
+ */
+
+#include "cmnutil.h"
+#include "fdreader.h"
+
+#include <cstdlib>   /* posix_memalign() free() */
+#include <cstring>   /* memcpy() memmove() */
+#include <stdexcept> /* runtime_error */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <fcntl.h>   /* fcntl() */
+#include <poll.h>    /* POLLIN */
+#include <unistd.h>  /* read() sysconf() */
+
+#ifdef __cplusplus
+}
+#endif
+
+FdReader::FdReader(int fd, size_t capacity)
+        :
+        fd_{fd},
+        capacity_{0U},
+        begin_{0U},
+        end_{0U},
+        buffer_{NULL},
+        flags_{-1},
+        idle_ms_{0U},
+        limited_{false},
+        timed_out_{false},
+        deadline_{}
+{
+        using std::runtime_error;
+
+        if (-1 == reserve_(capacity)) {
+                throw runtime_error("FdReader(): "
+                                    "posix_memalign() call failed");
+        }
+}
+
+FdReader::~FdReader()
+{
+        if (-1 != flags_) {
+                fcntl(fd_, F_SETFL, flags_);
+        }
+        std::free(buffer_);
+}
+
+const void *FdReader::next(size_t len)
+{
+        const char *result = NULL;
+        ssize_t     breach = 0;
+
+        if (end_ - begin_ < len) {
+                /*
+                 * Moves the partial frame to the front so the rest of it can
+                 * be appended; it is shorter than a frame so this is cheap.
+                 */
+                if (0U != begin_) {
+                        std::memmove(buffer_, buffer_ + begin_, end_ - begin_);
+                        end_  -= begin_;
+                        begin_ = 0U;
+                }
+                if (len > capacity_ && -1 == reserve_(len)) {
+                        return NULL;
+                }
+        }
+
+        /* Takes whatever is available, which may well be many frames. */
+        while (end_ - begin_ < len) {
+                breach = read(fd_, buffer_ + end_, capacity_ - end_);
+
+                switch (breach) {
+                case -1:
+                        if (EAGAIN == errno || EWOULDBLOCK == errno) {
+                                if (-1 == wait_()) {
+                                        return NULL;
+                                }
+                        } else if (EINTR != errno || cmnutil_interrupted()) {
+                                return NULL;
+                        }
+                        break;
+                case 0:
+                        return NULL;
+                default:
+                        end_ += static_cast<size_t>(breach);
+                }
+        }
+
+        result  = buffer_ + begin_;
+        begin_ += len;
+        return result;
+}
+
+ssize_t FdReader::fill()
+{
+        ssize_t breach = 0;
+
+        if (0U != begin_) {
+                std::memmove(buffer_, buffer_ + begin_, end_ - begin_);
+                end_  -= begin_;
+                begin_ = 0U;
+        }
+        if (end_ == capacity_ && -1 == reserve_(2U * capacity_)) {
+                return -1;
+        }
+        do {
+                breach = read(fd_, buffer_ + end_, capacity_ - end_);
+        } while (-1 == breach && EINTR == errno && !cmnutil_interrupted());
+
+        if (0 < breach) {
+                end_ += static_cast<size_t>(breach);
+        }
+        return breach;
+}
+
+const void *FdReader::peek(size_t len)
+{
+        if (end_ - begin_ < len) {
+                /* Makes sure a later fill() can complete the frame. */
+                if (len > capacity_) {
+                        reserve_(len);
+                }
+                return NULL;
+        }
+        return buffer_ + begin_;
+}
+
+void FdReader::skip(size_t len)
+{
+        begin_ += len < end_ - begin_ ? len : end_ - begin_;
+}
+
+const void *FdReader::some(size_t *len)
+{
+        while (end_ == begin_) {
+                switch (fill()) {
+                case -1:
+                        if ((EAGAIN != errno && EWOULDBLOCK != errno) ||
+                            -1 == wait_()) {
+                                return NULL;
+                        }
+                        break;
+                case 0:
+                        return NULL;
+                default:
+                        break;
+                }
+        }
+        *len = end_ - begin_;
+        return buffer_ + begin_;
+}
+
+int FdReader::fd() const
+{
+        return fd_;
+}
+
+void FdReader::limit(uint64_t idle_ms, const struct timespec *deadline)
+{
+        const int flags = fcntl(fd_, F_GETFL);
+
+        idle_ms_ = idle_ms;
+        limited_ = NULL != deadline;
+        if (limited_) {
+                deadline_ = *deadline;
+        }
+        /* A blocking read() could not be cut short. */
+        if (-1 == flags_ && -1 != flags && 0 == (flags & O_NONBLOCK) &&
+            -1 != fcntl(fd_, F_SETFL, flags | O_NONBLOCK)) {
+                flags_ = flags;
+        }
+}
+
+bool FdReader::timed_out() const
+{
+        return timed_out_;
+}
+
+/* Grows the buffer to hold at least 'len' bytes, keeping buffered data. */
+int FdReader::reserve_(size_t len)
+{
+        const size_t page   = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t       size   = (len + page - 1U) / page * page;
+        void        *memory = NULL;
+
+        if (size <= capacity_) {
+                return 0;
+        }
+        if (0 != posix_memalign(&memory, page, size)) {
+                return -1;
+        }
+        if (NULL != buffer_) {
+                std::memcpy(memory, buffer_ + begin_, end_ - begin_);
+                end_  -= begin_;
+                begin_ = 0U;
+                std::free(buffer_);
+        }
+        buffer_   = reinterpret_cast<char *>(memory);
+        capacity_ = size;
+        return 0;
+}
+
+/* Waits for more input within the limits set by limit(), if any. */
+int FdReader::wait_()
+{
+        if (-1 == bseq_wait_until(fd_,
+                                  POLLIN,
+                                  idle_ms_,
+                                  limited_ ? &deadline_ : NULL)) {
+                timed_out_ = ETIMEDOUT == errno;
+                return -1;
+        }
+        return 0;
+}
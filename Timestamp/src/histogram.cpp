@@ -0,0 +1,200 @@
+/**
+ * @file histogram.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation source file of the Histogram class.
+ */
+
+#include "histogram.h"
+
+#include <cmath>   /* ceil() */
+#include <cstring> /* memset() */
+
+Histogram::Histogram()
+{
+        clear();
+}
+
+void Histogram::clear()
+{
+        count_    = 0U;
+        negative_ = 0U;
+        min_      = INT64_MAX;
+        max_      = INT64_MIN;
+        sum_      = 0.0;
+        std::memset(bucket_, 0, sizeof bucket_);
+}
+
+void Histogram::merge(const Histogram &other)
+{
+        if (0U == other.count_) {
+                return;
+        }
+        for (size_t i = 0U; i < BUCKET_COUNT; ++i) {
+                bucket_[i] += other.bucket_[i];
+        }
+        count_    += other.count_;
+        negative_ += other.negative_;
+        sum_      += other.sum_;
+        min_       = other.min_ < min_ ? other.min_ : min_;
+        max_       = other.max_ > max_ ? other.max_ : max_;
+}
+
+void Histogram::record(int64_t value)
+{
+        if (value < min_) {
+                min_ = value;
+        }
+        if (value > max_) {
+                max_ = value;
+        }
+        ++count_;
+        sum_ += static_cast<double>(value);
+
+        /* Clamped to the lowest bucket; 'min_' still keeps the real value. */
+        if (0 > value) {
+                ++negative_;
+                value = 0;
+        }
+        ++bucket_[index_(static_cast<uint64_t>(value))];
+}
+
+uint64_t Histogram::count() const
+{
+        return count_;
+}
+
+uint64_t Histogram::negative() const
+{
+        return negative_;
+}
+
+int64_t Histogram::min() const
+{
+        return 0U == count_ ? 0 : min_;
+}
+
+int64_t Histogram::max() const
+{
+        return 0U == count_ ? 0 : max_;
+}
+
+double Histogram::mean() const
+{
+        return 0U == count_ ? 0.0 : sum_ / static_cast<double>(count_);
+}
+
+int64_t Histogram::percentile(double quantile) const
+{
+        uint64_t rank  = 0U;
+        uint64_t seen  = 0U;
+
+        if (0U == count_) {
+                return 0;
+        }
+        if (quantile <= 0.0) {
+                return min();
+        }
+        if (quantile >= 1.0) {
+                return max();
+        }
+
+        /* Nearest-rank definition, i.e. the smallest value covering 'rank'. */
+        rank = Histogram::rank(quantile, count_);
+        for (size_t i = 0U; i < BUCKET_COUNT; ++i) {
+                seen += bucket_[i];
+                if (seen >= rank) {
+                        /* Never report beyond what was actually observed. */
+                        int64_t result = static_cast<int64_t>(upper_(i));
+
+                        return result > max_ ? max_ : result;
+                }
+        }
+        return max_;
+}
+
+uint64_t Histogram::rank(double quantile, uint64_t count)
+{
+        /*
+         * The product carries a relative error of about 1e-16; shaving off a
+         * far larger but still negligible 1e-12 keeps an exact integer from
+         * being pushed up to the next rank by that error.
+         */
+        double   exact  = quantile * static_cast<double>(count);
+        uint64_t result = static_cast<uint64_t>(std::ceil(exact *
+                                                          (1.0 - 1e-12)));
+
+        if (result < 1U) {
+                return 1U;
+        }
+        return result > count ? count : result;
+}
+
+uint64_t Histogram::count_below(int64_t value) const
+{
+        uint64_t below = 0U;
+        size_t   end   = 0U;
+
+        /* The negative values share the lowest bucket with 0. */
+        if (0 >= value) {
+                return negative_;
+        }
+        end = index_(static_cast<uint64_t>(value));
+        for (size_t i = 0U; i < end; ++i) {
+                below += bucket_[i];
+        }
+        return below;
+}
+
+/*
+ * Values below 2 ^ SUB_BITS map to themselves; above that, the exponent 'e'
+ * selects a group of 2 ^ (SUB_BITS - 1) buckets and the leading SUB_BITS bits
+ * of the value select the bucket within that group.
+ */
+size_t Histogram::index_(uint64_t value)
+{
+        const uint64_t half     = 1ULL << (SUB_BITS - 1U);
+        unsigned       msb      = 0U;
+        unsigned       exponent = 0U;
+
+        if (value < (1ULL << SUB_BITS)) {
+                return static_cast<size_t>(value);
+        }
+        msb      = 63U - static_cast<unsigned>(__builtin_clzll(value));
+        exponent = msb - SUB_BITS + 1U;
+        return static_cast<size_t>(exponent * half + (value >> exponent));
+}
+
+/* Inverse of index_(): the largest value mapping to bucket 'index'. */
+uint64_t Histogram::upper_(size_t index)
+{
+        const uint64_t half     = 1ULL << (SUB_BITS - 1U);
+        uint64_t       exponent = 0U;
+        uint64_t       mantissa = 0U;
+
+        if (index < (1ULL << SUB_BITS)) {
+                return static_cast<uint64_t>(index);
+        }
+        exponent = index / half - 1U;
+        mantissa = index - exponent * half;
+        return ((mantissa + 1U) << exponent) - 1U;
+}
@@ -0,0 +1,535 @@
+/**
+ * @file impair.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation source file of the Impairment class.
+ * Frames are scheduled on a hashed timer wheel: inserting a frame and
+ * expiring it are both O(1), the slots of one rotation are only ever walked
+ * once per tick, and a bitmap of the occupied slots finds the next one due
+ * a word of 64 slots at a time, so the cost per frame stays flat however
+ * many are held at once ('ts-bench -f impair.' measures it).
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "cmnutil.h"
+#include "fdreader.h"
+#include "frame.h"
+#include "impair.h"
+
+#include <algorithm> /* stable_sort() */
+#include <cerrno>    /* errno */
+#include <cinttypes> /* PRIu64 */
+#include <cstdlib>   /* malloc() free() */
+#include <cstring>   /* memcpy() */
+#include <stdexcept> /* invalid_argument */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <fcntl.h>   /* fcntl() */
+#include <poll.h>    /* ppoll() */
+#include <sys/uio.h> /* struct iovec */
+#include <time.h>    /* clock_gettime() */
+
+#ifdef __cplusplus
+}
+#endif
+
+/* Frames written per writev() at most when the relay catches up. */
+#define IMPAIR_IOV_BATCH 64U
+
+static uint64_t impair_now()
+{
+        struct timespec now = { };
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return static_cast<uint64_t>(now.tv_sec) * 1000000000U +
+               static_cast<uint64_t>(now.tv_nsec);
+}
+
+ImpairOption::ImpairOption()
+        :
+        delay_ns{0U},
+        jitter_ns{0U},
+        loss{0.0},
+        reorder{0.0},
+        datagram{false},
+        /* The minimum retransmission timeout of linux TCP. */
+        rto_ns{200000000U},
+        rate_bps{0U},
+        burst{1U << 16},
+        queue{1U << 16},
+        seed{0x5eed5eed5eed5eedULL}
+{
+}
+
+Impairment::Impairment(const ImpairOption &option)
+        :
+        option_(option),
+        packet_(),
+        free_(),
+        bucket_(64U),
+        wheel_(SLOTS),
+        occupied_(WORDS, 0U),
+        overdue_(),
+        ready_{NIL, NIL},
+        tick_{0U},
+        held_{0U},
+        wheeled_{0U},
+        last_release_{0U},
+        tokens_{static_cast<double>(option.burst)},
+        token_time_{0U},
+        rng_{},
+        counter_{}
+{
+        using std::invalid_argument;
+
+        uint64_t seed = option_.seed;
+
+        if (0U == option_.queue || option_.queue >= NIL) {
+                throw invalid_argument("Impairment(): invalid queue size");
+        }
+
+        packet_.resize(option_.queue);
+        free_.reserve(option_.queue);
+        for (size_t i = option_.queue; 0U != i; --i) {
+                packet_[i - 1U].data = NULL;
+                free_.push_back(static_cast<uint32_t>(i - 1U));
+        }
+        for (auto &slot : wheel_) {
+                slot.head = slot.tail = NIL;
+        }
+
+        /* splitmix64 spreads the seed over the xorshift128+ state. */
+        for (auto &word : rng_) {
+                uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+
+                z    = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                z    = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                word = z ^ (z >> 31);
+        }
+}
+
+Impairment::~Impairment()
+{
+        for (auto &packet : packet_) {
+                std::free(packet.data);
+        }
+        for (auto &bucket : bucket_) {
+                for (auto data : bucket) {
+                        std::free(data);
+                }
+        }
+}
+
+int Impairment::run(int in_fd, int out_fd)
+{
+        FdReader        reader(in_fd);
+        FrameHeader     header  = { };
+        const void     *frame   = NULL;
+        bool            eof     = false;
+        uint64_t        now     = impair_now();
+        uint64_t        due     = 0U;
+        struct pollfd   pfd     = { };
+        struct timespec timeout = { };
+        int             flags   = fcntl(in_fd, F_GETFL);
+
+        if (-1 == flags || -1 == fcntl(in_fd, F_SETFL, flags | O_NONBLOCK)) {
+                return -1;
+        }
+        tick_       = now >> TICK_SHIFT;
+        token_time_ = now;
+
+        for (;;) {
+                now = impair_now();
+                advance_(now);
+                if (-1 == flush_(out_fd)) {
+                        return -1;
+                }
+
+                /* Takes in every whole frame buffered while there is room. */
+                while (held_ < option_.queue &&
+                       NULL != (frame = reader.peek(sizeof header))) {
+                        std::memcpy(&header, frame, sizeof header);
+                        /* Nothing after a damaged header can be framed. */
+                        if (header.length > FRAME_LENGTH_MAX) {
+                                errno = EPROTO;
+                                return -1;
+                        }
+                        frame = reader.peek(sizeof header + header.length);
+                        if (NULL == frame) {
+                                break;
+                        }
+                        if (-1 == admit_(reinterpret_cast<const char *>(frame),
+                                         sizeof header + header.length,
+                                         now)) {
+                                return -1;
+                        }
+                        reader.skip(sizeof header + header.length);
+                }
+                if (held_ < option_.queue && !eof) {
+                        switch (reader.fill()) {
+                        case -1:
+                                if (EAGAIN != errno && EWOULDBLOCK != errno) {
+                                        return -1;
+                                }
+                                break;
+                        case 0:
+                                /* A trailing partial frame is dropped. */
+                                eof = true;
+                                continue;
+                        default:
+                                continue;
+                        }
+                }
+                if (eof && 0U == held_) {
+                        return 0;
+                }
+
+                /* Sleeps until input arrives or the next frame is due. */
+                pfd.fd     = in_fd;
+                pfd.events = POLLIN;
+                due        = next_due_();
+                if (UINT64_MAX != due) {
+                        due             = due > now ? due - now : 0U;
+                        timeout.tv_sec  = static_cast<time_t>(due /
+                                                              1000000000U);
+                        timeout.tv_nsec = static_cast<long>(due %
+                                                            1000000000U);
+                }
+                if (-1 == ppoll(&pfd,
+                                held_ < option_.queue && !eof ? 1U : 0U,
+                                UINT64_MAX == due ? NULL : &timeout,
+                                NULL) &&
+                    EINTR != errno) {
+                        return -1;
+                }
+        }
+}
+
+void Impairment::report(FILE *stream) const
+{
+        fprintf(stream, "# ts-impair summary\n");
+        fprintf(stream, "%-24s %" PRIu64 "\n", "relay.in", counter_.in);
+        fprintf(stream, "%-24s %" PRIu64 "\n", "relay.out", counter_.out);
+        fprintf(stream, "%-24s %" PRIu64 "\n", "relay.lost", counter_.lost);
+        fprintf(stream, "%-24s %" PRIu64 "\n", "relay.retransmitted",
+                counter_.retransmitted);
+        fprintf(stream, "%-24s %" PRIu64 "\n", "relay.reordered",
+                counter_.reordered);
+        fprintf(stream, "%-24s %" PRIu64 "\n", "relay.throttled",
+                counter_.throttled);
+        fprintf(stream, "%-24s %" PRIu64 "\n", "relay.writes",
+                counter_.writes);
+        fprintf(stream, "%-24s %zu\n", "relay.held.max", counter_.held_max);
+        fflush(stream);
+}
+
+/*
+ * Decides the fate of one incoming frame: the token bucket picks when it
+ * leaves the rate limiter, delay and jitter are added on top, and a loss
+ * either turns it into a placeholder or delays it by a retransmission.
+ */
+int Impairment::admit_(const char *frame, size_t size, uint64_t now)
+{
+        FrameHeader  header  = { };
+        Packet_     &packet  = packet_[free_.back()];
+        const bool   lost    = option_.loss > 0.0 &&
+                               uniform_() < option_.loss;
+        uint64_t     depart  = now;
+        uint64_t     release = 0U;
+        double       jitter  = 0.0;
+        size_t       slot    = 0U;
+
+        std::memcpy(&header, frame, sizeof header);
+        ++counter_.in;
+        if (lost && option_.datagram) {
+                header.flags  |= FRAME_FLAG_LOST;
+                header.length  = 0U;
+                size           = sizeof header;
+                ++counter_.lost;
+        }
+
+        if (NULL == (packet.data = allocate_(size, &packet.klass))) {
+                return -1;
+        }
+        std::memcpy(packet.data, &header, sizeof header);
+        std::memcpy(packet.data + sizeof header,
+                    frame + sizeof header,
+                    size - sizeof header);
+        packet.size = static_cast<uint32_t>(size);
+
+        if (0U != option_.rate_bps) {
+                depart       = now > token_time_ ? now : token_time_;
+                tokens_     += static_cast<double>(depart - token_time_) *
+                               static_cast<double>(option_.rate_bps) / 8e9;
+                token_time_  = depart;
+                if (tokens_ > static_cast<double>(option_.burst)) {
+                        tokens_ = static_cast<double>(option_.burst);
+                }
+                if (tokens_ >= static_cast<double>(size)) {
+                        tokens_ -= static_cast<double>(size);
+                } else {
+                        /* Waits for the missing tokens, spending them all. */
+                        depart += static_cast<uint64_t>(
+                                        (static_cast<double>(size) - tokens_) *
+                                        8e9 /
+                                        static_cast<double>(option_.rate_bps));
+                        tokens_     = 0.0;
+                        token_time_ = depart;
+                        ++counter_.throttled;
+                }
+        }
+
+        release = depart + option_.delay_ns;
+        if (0U != option_.jitter_ns) {
+                jitter = (2.0 * uniform_() - 1.0) *
+                         static_cast<double>(option_.jitter_ns);
+                if (jitter < 0.0 &&
+                    static_cast<uint64_t>(-jitter) > release - depart) {
+                        release = depart;
+                } else {
+                        release = static_cast<uint64_t>(
+                                        static_cast<double>(release) + jitter);
+                }
+        }
+        if (lost && !option_.datagram) {
+                release += option_.rto_ns;
+                ++counter_.retransmitted;
+        }
+        if (option_.datagram && option_.reorder > 0.0 &&
+            uniform_() < option_.reorder) {
+                release = depart;
+                ++counter_.reordered;
+        }
+        /* A stream never lets a frame overtake the one in front of it. */
+        if (!option_.datagram) {
+                release       = release > last_release_ ?
+                                release : last_release_;
+                last_release_ = release;
+        }
+
+        /* Rounds up, so a frame never leaves before its time. */
+        packet.tick = (release + (1U << TICK_SHIFT) - 1U) >> TICK_SHIFT;
+        packet.next = NIL;
+        if (packet.tick <= tick_) {
+                append_(&ready_, free_.back());
+        } else {
+                slot = static_cast<size_t>(packet.tick & (SLOTS - 1U));
+                append_(&wheel_[slot], free_.back());
+                occupied_[slot / 64U] |= 1ULL << (slot % 64U);
+                ++wheeled_;
+        }
+        free_.pop_back();
+        if (++held_ > counter_.held_max) {
+                counter_.held_max = held_;
+        }
+        return 0;
+}
+
+/*
+ * Moves every frame due by 'now' onto 'ready_', visiting the slots passed
+ * since the last call in order; a slot may also hold frames due in a later
+ * rotation, which simply stay where they are.  After a stall of more than
+ * a rotation a slot mixes the frames of several overdue ticks, so those are
+ * sorted by tick before they leave, lest a stream reorder them.
+ */
+void Impairment::advance_(uint64_t now)
+{
+        const uint64_t target = now >> TICK_SHIFT;
+        uint64_t       steps  = target > tick_ ? target - tick_ : 0U;
+        const bool     lapped = steps > SLOTS;
+
+        if (0U == wheeled_) {
+                tick_ = target > tick_ ? target : tick_;
+                return;
+        }
+        if (lapped) {
+                steps = SLOTS;
+        }
+
+        for (uint64_t k = 1U; k <= steps && 0U != wheeled_; ++k) {
+                const size_t  at    = static_cast<size_t>((tick_ + k) &
+                                                          (SLOTS - 1U));
+                List_        &slot  = wheel_[at];
+                uint32_t      index = slot.head;
+                uint32_t      prev  = NIL;
+
+                while (NIL != index) {
+                        Packet_  &packet = packet_[index];
+                        uint32_t  next   = packet.next;
+
+                        if (packet.tick > target) {
+                                prev  = index;
+                                index = next;
+                                continue;
+                        }
+                        if (NIL == prev) {
+                                slot.head = next;
+                        } else {
+                                packet_[prev].next = next;
+                        }
+                        if (slot.tail == index) {
+                                slot.tail = prev;
+                        }
+                        packet.next = NIL;
+                        if (lapped) {
+                                overdue_.push_back(index);
+                        } else {
+                                append_(&ready_, index);
+                        }
+                        --wheeled_;
+                        index = next;
+                }
+                if (NIL == slot.head) {
+                        occupied_[at / 64U] &= ~(1ULL << (at % 64U));
+                }
+        }
+        if (lapped) {
+                /* Stable, so frames of one tick keep their arrival order. */
+                std::stable_sort(overdue_.begin(),
+                                 overdue_.end(),
+                                 [&](uint32_t a, uint32_t b) {
+                        return packet_[a].tick < packet_[b].tick;
+                });
+                for (auto index : overdue_) {
+                        append_(&ready_, index);
+                }
+                overdue_.clear();
+        }
+        tick_ = target > tick_ ? target : tick_;
+}
+
+int Impairment::flush_(int out_fd)
+{
+        struct iovec iov[IMPAIR_IOV_BATCH];
+        uint32_t     index  = NIL;
+        size_t       count  = 0U;
+        ssize_t      length = 0;
+
+        while (NIL != ready_.head) {
+                index  = ready_.head;
+                length = 0;
+                for (count = 0U;
+                     count < IMPAIR_IOV_BATCH && NIL != index;
+                     ++count) {
+                        iov[count].iov_base = packet_[index].data;
+                        iov[count].iov_len  = packet_[index].size;
+                        length             += packet_[index].size;
+                        index               = packet_[index].next;
+                }
+                if (length != bseq_writev(out_fd,
+                                          iov,
+                                          static_cast<int>(count))) {
+                        return -1;
+                }
+                ++counter_.writes;
+
+                /* Recycles both the packet and its buffer. */
+                for (; 0U != count; --count) {
+                        Packet_ &packet = packet_[ready_.head];
+
+                        bucket_[packet.klass].push_back(packet.data);
+                        packet.data = NULL;
+                        free_.push_back(ready_.head);
+                        ready_.head = packet.next;
+                        --held_;
+                        ++counter_.out;
+                }
+        }
+        ready_.tail = NIL;
+        return 0;
+}
+
+/* Absolute time of the earliest non-empty slot, or UINT64_MAX if idle. */
+uint64_t Impairment::next_due_() const
+{
+        const size_t start = static_cast<size_t>((tick_ + 1U) &
+                                                 (SLOTS - 1U));
+        size_t       word  = start / 64U;
+        uint64_t     bits  = occupied_[word] & (~0ULL << (start % 64U));
+        size_t       slot  = 0U;
+
+        if (NIL != ready_.head) {
+                return 0U;
+        }
+        if (0U == wheeled_) {
+                return UINT64_MAX;
+        }
+        /* The word of 'start' comes round again for the slots before it. */
+        for (size_t n = 0U; n <= WORDS; ++n) {
+                if (0U != bits) {
+                        slot = word * 64U +
+                               static_cast<size_t>(__builtin_ctzll(bits));
+                        return (tick_ + 1U + ((slot - start) & (SLOTS - 1U)))
+                               << TICK_SHIFT;
+                }
+                word = word + 1U == WORDS ? 0U : word + 1U;
+                bits = occupied_[word];
+        }
+        return (tick_ + SLOTS) << TICK_SHIFT;
+}
+
+void Impairment::append_(List_ *list, uint32_t index)
+{
+        if (NIL == list->tail) {
+                list->head = index;
+        } else {
+                packet_[list->tail].next = index;
+        }
+        list->tail = index;
+}
+
+/* Buffers come in powers of two and are recycled rather than freed. */
+char *Impairment::allocate_(size_t size, uint32_t *klass)
+{
+        uint32_t  shift = 6U;
+        char     *data  = NULL;
+
+        while ((static_cast<size_t>(1U) << shift) < size) {
+                ++shift;
+        }
+        *klass = shift;
+        if (!bucket_[shift].empty()) {
+                data = bucket_[shift].back();
+                bucket_[shift].pop_back();
+                return data;
+        }
+        return reinterpret_cast<char *>(
+                        std::malloc(static_cast<size_t>(1U) << shift));
+}
+
+/* xorshift128+, scaled to [0, 1). */
+double Impairment::uniform_()
+{
+        uint64_t       x = rng_[0];
+        const uint64_t y = rng_[1];
+
+        rng_[0] = y;
+        x      ^= x << 23;
+        rng_[1] = x ^ y ^ (x >> 17) ^ (y >> 26);
+        return static_cast<double>((rng_[1] + y) >> 11) * 0x1.0p-53;
+}
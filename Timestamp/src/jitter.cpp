@@ -0,0 +1,128 @@
+/**
+ * @file jitter.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation source file of the Jitter class.
+ */
+
+#include "jitter.h"
+
+Jitter::Jitter()
+        :
+        started_{false},
+        first_{0},
+        arrival_{0},
+        transit_{0},
+        jitter_{0},
+        gap_min_{INT64_MAX},
+        gap_max_{INT64_MIN},
+        ipdv_min_{INT64_MAX},
+        ipdv_max_{INT64_MIN},
+        ipdv_{}
+{
+}
+
+void Jitter::clear()
+{
+        first_    = arrival_;
+        gap_min_  = INT64_MAX;
+        gap_max_  = INT64_MIN;
+        ipdv_min_ = INT64_MAX;
+        ipdv_max_ = INT64_MIN;
+        ipdv_.clear();
+}
+
+void Jitter::record(const struct timespec &received, int64_t transit)
+{
+        const int64_t arrival   = static_cast<int64_t>(received.tv_sec) *
+                                  1000000000 + received.tv_nsec;
+        const int64_t gap       = arrival - arrival_;
+        /* D(i-1, i) of RFC 3550, equally the IPDV of RFC 3393. */
+        int64_t       variation = transit - transit_;
+
+        arrival_ = arrival;
+        transit_ = transit;
+        if (!started_) {
+                started_ = true;
+                first_   = arrival;
+                return;
+        }
+        if (gap < gap_min_) {
+                gap_min_ = gap;
+        }
+        if (gap > gap_max_) {
+                gap_max_ = gap;
+        }
+        if (variation < ipdv_min_) {
+                ipdv_min_ = variation;
+        }
+        if (variation > ipdv_max_) {
+                ipdv_max_ = variation;
+        }
+        if (0 > variation) {
+                variation = -variation;
+        }
+        ipdv_.record(variation);
+        /*
+         * J += (|D| - J) / 16 in integer arithmetic, which keeps the update
+         * off the latency of the floating point unit.
+         */
+        jitter_ += variation - ((jitter_ + 8) >> 4);
+}
+
+double Jitter::jitter() const
+{
+        return static_cast<double>(jitter_) / 16.0;
+}
+
+int64_t Jitter::interarrival_min() const
+{
+        return 0U == ipdv_.count() ? 0 : gap_min_;
+}
+
+double Jitter::interarrival_mean() const
+{
+        /* The gaps add up to the time between the first and last arrival. */
+        return 0U == ipdv_.count() ? 0.0 :
+               static_cast<double>(arrival_ - first_) /
+               static_cast<double>(ipdv_.count());
+}
+
+int64_t Jitter::interarrival_max() const
+{
+        return 0U == ipdv_.count() ? 0 : gap_max_;
+}
+
+const Histogram &Jitter::ipdv() const
+{
+        return ipdv_;
+}
+
+int64_t Jitter::ipdv_min() const
+{
+        return 0U == ipdv_.count() ? 0 : ipdv_min_;
+}
+
+int64_t Jitter::ipdv_max() const
+{
+        return 0U == ipdv_.count() ? 0 : ipdv_max_;
+}
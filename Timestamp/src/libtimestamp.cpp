@@ -0,0 +1,345 @@
+/**
+ * @file libtimestamp.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation file of the C interface of the timestamp library, a thin
+ * layer over the TimeStampEngine with a dynamic padding size; no exception
+ * ever leaves it.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "libtimestamp.h"
+#include "timestamp_tmp.h"
+
+#include <cstddef>   /* offsetof() */
+#include <new>       /* nothrow */
+#include <vector>
+
+static_assert(sizeof(ts_frame_header) == sizeof(FrameHeader) &&
+              offsetof(ts_frame_header, seq) ==
+              offsetof(FrameHeader, seq) &&
+              offsetof(ts_frame_header, stamp) ==
+              offsetof(FrameHeader, timespec) &&
+              offsetof(ts_frame_header, length) ==
+              offsetof(FrameHeader, length) &&
+              offsetof(ts_frame_header, flags) ==
+              offsetof(FrameHeader, flags),
+              "ts_frame_header has to match FrameHeader");
+static_assert(TS_FRAME_FLAG_LOST == FRAME_FLAG_LOST &&
+              TS_FRAME_FLAG_CRC == FRAME_FLAG_CRC,
+              "ts_frame_header flags have to match FrameHeader");
+
+struct ts_stats {
+        Histogram delta;
+        Jitter    jitter;
+        uint64_t  lost;
+
+        /* Doubles as the sink of a TimeStampEngine. */
+        int record(const FrameHeader &header, const struct timespec &received)
+        {
+                int64_t ns = 0;
+
+                if (0U != (header.flags & FRAME_FLAG_LOST)) {
+                        ++lost;
+                        return 0;
+                }
+                ns = (static_cast<int64_t>(received.tv_sec) -
+                      static_cast<int64_t>(header.timespec.tv_sec)) *
+                     1000000000 +
+                     (received.tv_nsec - header.timespec.tv_nsec);
+                delta.record(ns);
+                jitter.record(received, ns);
+                return 0;
+        }
+};
+
+struct ts_sender {
+        ts_sender(int fd, unsigned flags)
+                :
+                flags{flags},
+                seq{0U},
+                transport(fd, 0U),
+                raw{},
+                base64(sizeof(FrameHeader)),
+                zero{}
+        {
+        }
+
+        unsigned          flags;
+        uint64_t          seq;
+        FdTransport       transport;
+        RawCodec          raw;
+        Base64Codec       base64;
+        /* Padding of callers that pass none. */
+        std::vector<char> zero;
+};
+
+struct ts_receiver {
+        ts_receiver(int fd, unsigned flags)
+                :
+                flags{flags},
+                transport(fd, 1U << 20),
+                raw{},
+                base64(sizeof(FrameHeader)),
+                stats{}
+        {
+        }
+
+        unsigned    flags;
+        FdTransport transport;
+        RawCodec    raw;
+        Base64Codec base64;
+        ts_stats    stats;
+};
+
+/* Hands a frame over to the caller on its way into the statistics. */
+struct CaptureSink {
+        ts_stats               *stats;
+        struct ts_frame_header *header;
+        struct timespec        *received;
+
+        int record(const FrameHeader &frame, const struct timespec &stamp)
+        {
+                if (NULL != header) {
+                        std::memcpy(header, &frame, sizeof frame);
+                }
+                if (NULL != received) {
+                        *received = stamp;
+                }
+                return stats->record(frame, stamp);
+        }
+};
+
+template<typename Codec, typename Clock>
+static int sender_send(ts_sender  *sender,
+                       Codec      &codec,
+                       const char *padding,
+                       size_t      len)
+{
+        TimeStampEngine<FdTransport, Codec, Clock> engine(sender->transport,
+                                                          codec,
+                                                          0U);
+        FrameHeader                                header = { };
+
+        header.seq = sender->seq;
+        if (!engine.template emit<TIMESTAMP_DYNAMIC_PAD>(&header,
+                                                         len,
+                                                         padding)) {
+                return -1;
+        }
+        ++sender->seq;
+        return 0;
+}
+
+template<typename Codec, typename Clock>
+static int receiver_next(ts_receiver *receiver,
+                         Codec       &codec,
+                         CaptureSink &sink)
+{
+        TimeStampEngine<FdTransport, Codec, Clock> engine(receiver->transport,
+                                                          codec,
+                                                          0U);
+
+        return 1U == engine.receive(1U, sink) ? 1 : 0;
+}
+
+unsigned ts_api_version(void)
+{
+        return TS_API_VERSION;
+}
+
+ts_stats *ts_stats_new(void)
+{
+        return new (std::nothrow) ts_stats();
+}
+
+void ts_stats_free(ts_stats *stats)
+{
+        delete stats;
+}
+
+void ts_stats_record(ts_stats *stats, int64_t latency_ns)
+{
+        stats->delta.record(latency_ns);
+}
+
+void ts_stats_record_frame(ts_stats                     *stats,
+                           const struct ts_frame_header *header,
+                           const struct timespec        *received)
+{
+        FrameHeader frame = { };
+
+        std::memcpy(&frame, header, sizeof frame);
+        stats->record(frame, *received);
+}
+
+uint64_t ts_stats_count(const ts_stats *stats)
+{
+        return stats->delta.count();
+}
+
+uint64_t ts_stats_lost(const ts_stats *stats)
+{
+        return stats->lost;
+}
+
+uint64_t ts_stats_negative(const ts_stats *stats)
+{
+        return stats->delta.negative();
+}
+
+int64_t ts_stats_min(const ts_stats *stats)
+{
+        return stats->delta.min();
+}
+
+int64_t ts_stats_max(const ts_stats *stats)
+{
+        return stats->delta.max();
+}
+
+double ts_stats_mean(const ts_stats *stats)
+{
+        return stats->delta.mean();
+}
+
+int64_t ts_stats_percentile(const ts_stats *stats, double quantile)
+{
+        return stats->delta.percentile(quantile);
+}
+
+double ts_stats_jitter(const ts_stats *stats)
+{
+        return stats->jitter.jitter();
+}
+
+int ts_stats_report(const ts_stats *stats, FILE *stream)
+{
+        timestamp_report(stream, stats->delta, stats->lost);
+        timestamp_report_jitter(stream, stats->jitter);
+        return 0 == std::fflush(stream) && !std::ferror(stream) ? 0 : -1;
+}
+
+ts_sender *ts_sender_open(int fd, unsigned flags)
+{
+        try {
+                return new ts_sender(fd, flags);
+        } catch (...) {
+                return NULL;
+        }
+}
+
+int ts_sender_send(ts_sender *sender, const void *padding, size_t len)
+{
+        const char *data = static_cast<const char *>(padding);
+        const bool  raw  = 0U != (sender->flags & TS_RAW);
+
+        try {
+                if (len > UINT32_MAX) {
+                        return -1;
+                }
+                if (NULL == data) {
+                        if (sender->zero.size() < len) {
+                                sender->zero.resize(len);
+                        }
+                        data = sender->zero.data();
+                }
+                if (0U != (sender->flags & TS_COARSE_CLOCK)) {
+                        return raw ?
+                               sender_send<RawCodec, CoarseClock>(
+                                       sender, sender->raw, data, len) :
+                               sender_send<Base64Codec, CoarseClock>(
+                                       sender, sender->base64, data, len);
+                }
+                return raw ?
+                       sender_send<RawCodec, RealtimeClock>(
+                               sender, sender->raw, data, len) :
+                       sender_send<Base64Codec, RealtimeClock>(
+                               sender, sender->base64, data, len);
+        } catch (...) {
+                return -1;
+        }
+}
+
+int ts_sender_close(ts_sender *sender)
+{
+        bool flushed = true;
+
+        if (NULL == sender) {
+                return 0;
+        }
+        try {
+                flushed = 0U != (sender->flags & TS_RAW) ||
+                          sender->base64.flush(sender->transport);
+        } catch (...) {
+                flushed = false;
+        }
+        delete sender;
+        return flushed ? 0 : -1;
+}
+
+ts_receiver *ts_receiver_open(int fd, unsigned flags)
+{
+        try {
+                return new ts_receiver(fd, flags);
+        } catch (...) {
+                return NULL;
+        }
+}
+
+int ts_receiver_next(ts_receiver            *receiver,
+                     struct ts_frame_header *header,
+                     struct timespec        *received)
+{
+        CaptureSink sink = {&receiver->stats, header, received};
+        const bool  raw  = 0U != (receiver->flags & TS_RAW);
+
+        try {
+                if (0U != (receiver->flags & TS_COARSE_CLOCK)) {
+                        return raw ?
+                               receiver_next<RawCodec, CoarseClock>(
+                                       receiver, receiver->raw, sink) :
+                               receiver_next<Base64Codec, CoarseClock>(
+                                       receiver, receiver->base64, sink);
+                }
+                return raw ?
+                       receiver_next<RawCodec, RealtimeClock>(
+                               receiver, receiver->raw, sink) :
+                       receiver_next<Base64Codec, RealtimeClock>(
+                               receiver, receiver->base64, sink);
+        } catch (...) {
+                return 0;
+        }
+}
+
+const ts_stats *ts_receiver_stats(const ts_receiver *receiver)
+{
+        return &receiver->stats;
+}
+
+void ts_receiver_close(ts_receiver *receiver)
+{
+        delete receiver;
+}
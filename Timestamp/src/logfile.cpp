@@ -0,0 +1,127 @@
+/**
+ * @file logfile.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation source file of the LogFile class.
+ */
+
+#include "logfile.h"
+
+#include <stdexcept> /* runtime_error */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>   /* rename() */
+#include <unistd.h>  /* unlink() */
+
+#ifdef __cplusplus
+}
+#endif
+
+LogFile::LogFile(FILE *stream)
+        :
+        file_{stream},
+        path_(),
+        bytes_{0U},
+        seconds_{0U},
+        keep_{0U}
+{
+}
+
+LogFile::LogFile(const char *path,
+                 uint64_t    bytes,
+                 uint64_t    seconds,
+                 unsigned    keep)
+        :
+        file_{NULL},
+        path_(path),
+        bytes_{bytes},
+        seconds_{seconds},
+        keep_{0U == keep ? 1U : keep}
+{
+        file_ = open_("w");
+}
+
+LogFile::~LogFile()
+{
+        if (!path_.empty() && NULL != file_) {
+                std::fclose(file_);
+        }
+}
+
+FILE *LogFile::get() const
+{
+        return file_;
+}
+
+uint64_t LogFile::bytes() const
+{
+        return bytes_;
+}
+
+uint64_t LogFile::seconds() const
+{
+        return seconds_;
+}
+
+FILE *LogFile::rotate()
+{
+        using std::to_string;
+
+        if (path_.empty()) {
+                return file_;
+        }
+        std::fclose(file_);
+        file_ = NULL;
+        unlink((path_ + "." + to_string(keep_)).c_str());
+        for (unsigned i = keep_ - 1U; 0U < i; --i) {
+                rename((path_ + "." + to_string(i)).c_str(),
+                       (path_ + "." + to_string(i + 1U)).c_str());
+        }
+        rename(path_.c_str(), (path_ + ".1").c_str());
+        file_ = open_("w");
+        return file_;
+}
+
+FILE *LogFile::reopen()
+{
+        if (path_.empty()) {
+                return file_;
+        }
+        std::fclose(file_);
+        file_ = NULL;
+        file_ = open_("a");
+        return file_;
+}
+
+FILE *LogFile::open_(const char *mode)
+{
+        FILE *file = std::fopen(path_.c_str(), mode);
+
+        if (NULL == file) {
+                throw std::runtime_error("LogFile(): " + path_ +
+                                         " cannot be opened");
+        }
+        return file;
+}
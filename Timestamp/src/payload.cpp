@@ -0,0 +1,248 @@
+/**
+ * @file payload.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation source file of the PayloadGenerator class.
+ */
+
+#include "cmnutil.h"
+#include "payload.h"
+
+#include <cstdlib>   /* posix_memalign() free() */
+#include <cstring>   /* memset() strcmp() */
+#include <stdexcept> /* overflow_error runtime_error */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <unistd.h>  /* sysconf() */
+
+#ifdef __cplusplus
+}
+#endif
+
+/*
+ * The pool of SLIDING mode repeats itself only every this many bytes, far
+ * beyond the 32 KiB window of deflate used by ssh compression.
+ */
+#define PAYLOAD_POOL_MIN (4U << 20)
+
+/* splitmix64, only used to spread the seed over the lanes. */
+static uint64_t payload_mix(uint64_t *state)
+{
+        uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+}
+
+PayloadGenerator::PayloadGenerator(PayloadMode mode,
+                                   size_t      size,
+                                   size_t      slots,
+                                   uint64_t    seed)
+        :
+        mode_{mode},
+        size_{size},
+        stride_{0U},
+        slots_{0U == slots ? 1U : slots},
+        slot_{0U},
+        pool_{0U},
+        offset_{0U},
+        buffer_{NULL},
+        s0_{},
+        s1_{}
+{
+        using std::overflow_error;
+        using std::runtime_error;
+
+        const size_t page   = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t       total  = 0U;
+        void        *memory = NULL;
+
+        if (size_ > SIZE_MAX / 2U - CMNUTIL_CACHE_LINE) {
+                throw overflow_error("PayloadGenerator(): size exceeds "
+                                     "maximum");
+        }
+        /* Whole cache lines keep the generator free of any tail handling. */
+        stride_ = (size_ + CMNUTIL_CACHE_LINE) / CMNUTIL_CACHE_LINE *
+                  CMNUTIL_CACHE_LINE;
+
+        switch (mode_) {
+        case PayloadMode::RANDOM:
+                if (slots_ > SIZE_MAX / stride_) {
+                        throw overflow_error("PayloadGenerator(): slots "
+                                             "exceed maximum");
+                }
+                total = stride_ * slots_;
+                break;
+        case PayloadMode::SLIDING:
+                if (slots_ > SIZE_MAX / 4U / stride_) {
+                        throw overflow_error("PayloadGenerator(): slots "
+                                             "exceed maximum");
+                }
+                /* See next() for why four times the pending windows. */
+                pool_ = 4U * stride_ * slots_ > PAYLOAD_POOL_MIN ?
+                        4U * stride_ * slots_ : PAYLOAD_POOL_MIN;
+                total = pool_;
+                break;
+        default:
+                total = stride_;
+        }
+
+        if (0 != posix_memalign(&memory, page, total)) {
+                throw runtime_error("PayloadGenerator(): "
+                                    "posix_memalign() call failed");
+        }
+        buffer_ = reinterpret_cast<char *>(memory);
+
+        for (unsigned i = 0U; i < LANES; ++i) {
+                s0_[i] = payload_mix(&seed);
+                s1_[i] = payload_mix(&seed);
+        }
+
+        switch (mode_) {
+        case PayloadMode::ZERO:
+                std::memset(buffer_, 0, total);
+                break;
+        case PayloadMode::PATTERN:
+                for (size_t i = 0U; i < total; ++i) {
+                        buffer_[i] = static_cast<char>(i & 0xffU);
+                }
+                break;
+        case PayloadMode::RANDOM:
+        case PayloadMode::SLIDING:
+                random_(buffer_, total);
+                break;
+        case PayloadMode::NONE:
+                /*
+                 * Note the padding is intentionally left un-initialized, as
+                 * it has always been in ts.
+                 */
+                break;
+        }
+}
+
+PayloadGenerator::~PayloadGenerator()
+{
+        std::free(buffer_);
+}
+
+const char *PayloadGenerator::next()
+{
+        char   *result  = buffer_;
+        size_t  refresh = 0U;
+        size_t  target  = 0U;
+
+        switch (mode_) {
+        case PayloadMode::RANDOM:
+                result = buffer_ + stride_ * slot_;
+                slot_  = slot_ + 1U == slots_ ? 0U : slot_ + 1U;
+                random_(result, stride_);
+                break;
+        case PayloadMode::SLIDING:
+                if (offset_ + stride_ > pool_) {
+                        offset_ = 0U;
+                }
+                result   = buffer_ + offset_;
+                offset_ += stride_;
+
+                /*
+                 * Half a pool away from the window just handed out.  The
+                 * 'slots' pending windows span at most a quarter of the
+                 * pool behind it, so none of them is ever touched.
+                 */
+                refresh = stride_ / 16U / CMNUTIL_CACHE_LINE *
+                          CMNUTIL_CACHE_LINE;
+                refresh = 0U == refresh ? CMNUTIL_CACHE_LINE : refresh;
+                target  = (offset_ + pool_ / 2U) % pool_ /
+                          CMNUTIL_CACHE_LINE * CMNUTIL_CACHE_LINE;
+                if (target + refresh > pool_) {
+                        refresh = pool_ - target;
+                }
+                random_(buffer_ + target, refresh);
+                break;
+        default:
+                break;
+        }
+        return result;
+}
+
+bool PayloadGenerator::parse(const char *name, PayloadMode *mode)
+{
+        using std::strcmp;
+
+        static const struct {
+                const char  *name;
+                PayloadMode  mode;
+        } MODES[] = {
+                {"none",    PayloadMode::NONE},
+                {"zero",    PayloadMode::ZERO},
+                {"pattern", PayloadMode::PATTERN},
+                {"random",  PayloadMode::RANDOM},
+                {"sliding", PayloadMode::SLIDING}
+        };
+
+        for (const auto &entry : MODES) {
+                if (0 == strcmp(entry.name, name)) {
+                        *mode = entry.mode;
+                        return true;
+                }
+        }
+        return false;
+}
+
+/*
+ * Fills 'len' bytes, a multiple of the cache line size, at the cache line
+ * aligned 'data'.  The lanes have no dependency on each other, so the inner
+ * loop maps onto vector registers once optimization is on and the fill runs
+ * close to memory bandwidth.
+ */
+void PayloadGenerator::random_(char *data, size_t len)
+{
+        static_assert(LANES * sizeof(uint64_t) == CMNUTIL_CACHE_LINE,
+                      "one round of the lanes fills exactly one cache line");
+
+        uint64_t *word  = reinterpret_cast<uint64_t *>(data);
+        size_t    count = len / sizeof(uint64_t);
+        uint64_t  s0[LANES];
+        uint64_t  s1[LANES];
+
+        std::memcpy(s0, s0_, sizeof s0);
+        std::memcpy(s1, s1_, sizeof s1);
+
+        for (size_t i = 0U; i < count; i += LANES) {
+                for (unsigned j = 0U; j < LANES; ++j) {
+                        uint64_t       x = s0[j];
+                        const uint64_t y = s1[j];
+
+                        s0[j]       = y;
+                        x          ^= x << 23;
+                        s1[j]       = x ^ y ^ (x >> 17) ^ (y >> 26);
+                        word[i + j] = s1[j] + y;
+                }
+        }
+
+        std::memcpy(s0_, s0, sizeof s0);
+        std::memcpy(s1_, s1, sizeof s1);
+}
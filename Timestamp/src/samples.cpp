@@ -0,0 +1,580 @@
+/**
+ * @file samples.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation source file of the SampleArray class and the batch
+ * statistics.
+ * Every thread takes a contiguous share of a column.  The moments come out
+ * of one pass, on AVX2 vectors where the CPU has them; the percentiles of
+ * one pass counting a histogram of at most 2^16 buckets over [min, max],
+ * exact by itself for columns as narrow as the milliseconds of a log, and
+ * otherwise of a second pass gathering the few buckets the quantiles fall
+ * into for std::nth_element() to select from.
+ */
+
+#include "samples.h"
+
+#include "histogram.h"
+
+#include <algorithm> /* nth_element() */
+#include <cmath>     /* sqrt() */
+#include <cstring>   /* memchr() memcmp() memmove() */
+#include <stdexcept> /* invalid_argument runtime_error */
+#include <string>
+#include <thread>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sched.h>   /* sched_getaffinity() */
+#include <sys/stat.h> /* fstat() */
+
+#ifdef __cplusplus
+}
+#endif
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/* Bytes read from a log at a time, also the longest line there can be. */
+#define SAMPLES_READ        (1U << 20)
+/* Values a thread is worth starting for. */
+#define SAMPLES_GRAIN       (1U << 16)
+/*
+ * Values summed in 64 bit lanes before being carried into the total; no
+ * lane overflows while the values stay below SAMPLES_MAGNITUDE.
+ */
+#define SAMPLES_BLOCK       (1U << 13)
+/* Buckets of the histogram narrowing down the percentiles, in bits. */
+#define SAMPLES_BUCKET_BITS 16U
+/* Digits of the longest field a log line may have. */
+#define SAMPLES_DIGITS      18
+/* Magnitude a field stays below, for the sums above to be exact. */
+#define SAMPLES_MAGNITUDE   (INT64_C(1) << 49)
+
+SampleArray::SampleArray()
+        :
+        delta_{},
+        normalized_{},
+        line_{0U}
+{
+}
+
+void SampleArray::load(FILE *stream)
+{
+        std::vector<char> buffer(SAMPLES_READ + 1U);
+        size_t            kept   = 0U;
+        size_t            got    = 0U;
+        const char       *end    = NULL;
+        const size_t      before = delta_.size();
+        struct stat       status = { };
+        /* Of a regular file, which tells roughly how many samples follow. */
+        size_t            length = 0U;
+
+        if (0 == fstat(fileno(stream), &status) && S_ISREG(status.st_mode)) {
+                length = static_cast<size_t>(status.st_size);
+        }
+        while (0U != (got = std::fread(&buffer[kept],
+                                       1U,
+                                       SAMPLES_READ - kept,
+                                       stream))) {
+                kept += got;
+                end   = parse_(buffer.data(), buffer.data() + kept);
+                /*
+                 * Growing the columns as they fill up would copy them over
+                 * and over; the first megabyte estimates their final size.
+                 */
+                if (0U != length && delta_.size() != before) {
+                        length = length / static_cast<size_t>(
+                                        end - buffer.data()) *
+                                 (delta_.size() - before);
+                        delta_.reserve(delta_.size() + length + length / 8U);
+                        normalized_.reserve(delta_.capacity());
+                        length = 0U;
+                }
+                kept -= static_cast<size_t>(end - buffer.data());
+                std::memmove(buffer.data(), end, kept);
+                if (SAMPLES_READ == kept) {
+                        throw std::invalid_argument(
+                                "Log line " + std::to_string(line_ + 1U) +
+                                " is too long!");
+                }
+        }
+        if (0 != std::ferror(stream)) {
+                throw std::runtime_error("SampleArray::load(): "
+                                         "fread() failed");
+        }
+        /* The last line may lack its newline. */
+        if (0U != kept) {
+                buffer[kept++] = '\n';
+                parse_(buffer.data(), buffer.data() + kept);
+        }
+        line_ = 0U;
+}
+
+void SampleArray::append(int64_t delta, int64_t normalized)
+{
+        delta_.push_back(delta);
+        normalized_.push_back(normalized);
+}
+
+void SampleArray::clear()
+{
+        delta_.clear();
+        normalized_.clear();
+}
+
+size_t SampleArray::size() const
+{
+        return delta_.size();
+}
+
+const std::vector<int64_t> &SampleArray::delta() const
+{
+        return delta_;
+}
+
+const std::vector<int64_t> &SampleArray::normalized() const
+{
+        return normalized_;
+}
+
+/*
+ * Reads an optionally negative decimal ending at 'stop', of a magnitude
+ * below SAMPLES_MAGNITUDE.
+ */
+static bool samples_field(const char **cursor,
+                          const char  *end,
+                          char         stop,
+                          int64_t     *value)
+{
+        const char *next     = *cursor;
+        const char *digits   = NULL;
+        bool        negative = false;
+        int64_t     result   = 0;
+
+        if (next != end && '-' == *next) {
+                negative = true;
+                ++next;
+        }
+        for (digits = next; next != end && '0' <= *next && *next <= '9';
+             ++next) {
+                /* Past the digits allowed it is rejected below anyway. */
+                if (next - digits < SAMPLES_DIGITS) {
+                        result = 10 * result + (*next - '0');
+                }
+        }
+        if (digits == next || next - digits > SAMPLES_DIGITS ||
+            next == end || stop != *next || result >= SAMPLES_MAGNITUDE) {
+                return false;
+        }
+        *cursor = next + 1;
+        *value  = negative ? -result : result;
+        return true;
+}
+
+const char *SampleArray::parse_(const char *data, const char *end)
+{
+        static const size_t  HEADING_LEN = sizeof SAMPLES_HEADING - 1U;
+        const char          *next        = NULL;
+        const char          *cursor      = NULL;
+        int64_t              delta       = 0;
+        int64_t              normalized  = 0;
+
+        while (NULL != (next = static_cast<const char *>(
+                                std::memchr(data, '\n',
+                                            static_cast<size_t>(end - data)))
+                       )) {
+                ++line_;
+                cursor = data;
+                if (static_cast<size_t>(next - data) == HEADING_LEN &&
+                    0 == std::memcmp(data, SAMPLES_HEADING, HEADING_LEN)) {
+                        data = next + 1;
+                        continue;
+                }
+                if (!samples_field(&cursor, next, ',', &delta) ||
+                    !samples_field(&cursor, next + 1, '\n', &normalized)) {
+                        throw std::invalid_argument(
+                                "Log line " + std::to_string(line_) +
+                                " is not a valid sample!");
+                }
+                delta_.push_back(delta);
+                normalized_.push_back(normalized);
+                data = next + 1;
+        }
+        return data;
+}
+
+struct SampleMoments {
+        int64_t  min;
+        int64_t  max;
+        __int128 sum;
+        /* Of the distances to a pivot, which keeps the squares small. */
+        double   squares;
+};
+
+static void samples_moments_generic(const int64_t *data,
+                                    size_t         count,
+                                    int64_t        pivot,
+                                    SampleMoments *moments)
+{
+        int64_t sum    = 0;
+        double  offset = 0.0;
+        size_t  end    = 0U;
+
+        for (size_t i = 0U; i < count; i = end) {
+                end = count - i < SAMPLES_BLOCK ? count : i + SAMPLES_BLOCK;
+                sum = 0;
+                for (size_t k = i; k < end; ++k) {
+                        if (data[k] < moments->min) {
+                                moments->min = data[k];
+                        }
+                        if (data[k] > moments->max) {
+                                moments->max = data[k];
+                        }
+                        sum               += data[k];
+                        offset             = static_cast<double>(
+                                                data[k] - pivot);
+                        moments->squares  += offset * offset;
+                }
+                moments->sum += sum;
+        }
+}
+
+#if defined(__x86_64__)
+/*
+ * AVX2 has neither 64 bit minimum and maximum nor a conversion to double;
+ * the former become compares and blends, the latter adds the bits of
+ * 1.5 * 2^52 so the distance, being below 2^50, lands in the mantissa.
+ */
+__attribute__((target("avx2")))
+static void samples_moments_avx2(const int64_t *data,
+                                 size_t         count,
+                                 int64_t        pivot,
+                                 SampleMoments *moments)
+{
+        const __m256i  base    = _mm256_set1_epi64x(pivot);
+        const __m256d  magic   = _mm256_set1_pd(6755399441055744.0);
+        const size_t   whole   = count & ~static_cast<size_t>(3U);
+        __m256i        low     = _mm256_set1_epi64x(moments->min);
+        __m256i        high    = _mm256_set1_epi64x(moments->max);
+        __m256d        squares = _mm256_setzero_pd();
+        __m256i        sum     = _mm256_setzero_si256();
+        __m256i        value   = _mm256_setzero_si256();
+        __m256d        offset  = _mm256_setzero_pd();
+        alignas(32) int64_t integer[4];
+        alignas(32) double  real[4];
+        size_t         i       = 0U;
+        size_t         end     = 0U;
+
+        for (; i < whole; ) {
+                end = whole - i < SAMPLES_BLOCK ? whole : i + SAMPLES_BLOCK;
+                sum = _mm256_setzero_si256();
+                for (; i < end; i += 4U) {
+                        value   = _mm256_loadu_si256(
+                                reinterpret_cast<const __m256i *>(data + i));
+                        low     = _mm256_blendv_epi8(
+                                low, value, _mm256_cmpgt_epi64(low, value));
+                        high    = _mm256_blendv_epi8(
+                                high, value, _mm256_cmpgt_epi64(value, high));
+                        sum     = _mm256_add_epi64(sum, value);
+                        offset  = _mm256_sub_pd(
+                                _mm256_castsi256_pd(_mm256_add_epi64(
+                                        _mm256_sub_epi64(value, base),
+                                        _mm256_castpd_si256(magic))),
+                                magic);
+                        squares = _mm256_add_pd(squares,
+                                                _mm256_mul_pd(offset, offset));
+                }
+                _mm256_store_si256(reinterpret_cast<__m256i *>(integer), sum);
+                moments->sum += static_cast<__int128>(integer[0] + integer[1])
+                                + (integer[2] + integer[3]);
+        }
+        _mm256_store_si256(reinterpret_cast<__m256i *>(integer), low);
+        for (unsigned lane = 0U; lane < 4U; ++lane) {
+                if (integer[lane] < moments->min) {
+                        moments->min = integer[lane];
+                }
+        }
+        _mm256_store_si256(reinterpret_cast<__m256i *>(integer), high);
+        for (unsigned lane = 0U; lane < 4U; ++lane) {
+                if (integer[lane] > moments->max) {
+                        moments->max = integer[lane];
+                }
+        }
+        _mm256_store_pd(real, squares);
+        moments->squares += (real[0] + real[1]) + (real[2] + real[3]);
+        samples_moments_generic(data + whole, count - whole, pivot, moments);
+}
+#endif
+
+static bool samples_detect()
+{
+#if defined(__x86_64__)
+        __builtin_cpu_init();
+        return 0 != __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+}
+
+static void samples_moments(const int64_t *data,
+                            size_t         count,
+                            int64_t        pivot,
+                            SampleMoments *moments)
+{
+        static const bool vector = samples_detect();
+
+#if defined(__x86_64__)
+        if (vector) {
+                samples_moments_avx2(data, count, pivot, moments);
+                return;
+        }
+#endif
+        samples_moments_generic(data, count, pivot, moments);
+}
+
+/* Runs 'job' with each of 0 to 'jobs' - 1, the first on this thread. */
+template<typename Job>
+static void samples_spread(size_t jobs, const Job &job)
+{
+        std::vector<std::thread> worker;
+
+        worker.reserve(jobs);
+        for (size_t i = 1U; i < jobs; ++i) {
+                worker.emplace_back(job, i);
+        }
+        job(0U);
+        for (std::thread &thread : worker) {
+                thread.join();
+        }
+}
+
+/* The start of the share of 'part' out of 'parts' of 'count' values. */
+static size_t samples_share(size_t count, size_t part, size_t parts)
+{
+        return static_cast<size_t>(static_cast<unsigned __int128>(count) *
+                                   part / parts);
+}
+
+static void samples_select(const int64_t             *data,
+                           size_t                     count,
+                           unsigned                   threads,
+                           const std::vector<double> &quantiles,
+                           SampleSummary             *summary)
+{
+        using std::vector;
+
+        const uint64_t           range    = static_cast<uint64_t>(
+                                                summary->max) -
+                                            static_cast<uint64_t>(
+                                                summary->min);
+        const uint64_t           origin   = static_cast<uint64_t>(
+                                                summary->min);
+        unsigned                 shift    = 0U;
+        size_t                   buckets  = 0U;
+        vector<vector<uint64_t>> counted(threads);
+        /* Per quantile: its bucket, then its index within that bucket. */
+        vector<size_t>           bucket(quantiles.size(), 0U);
+        vector<uint64_t>         within(quantiles.size(), 0U);
+        /* Per bucket to gather: where it goes, or -1 if it is not needed. */
+        vector<int32_t>          slot;
+        vector<size_t>           wanted;
+        vector<vector<vector<int64_t>>> gathered(threads);
+        vector<vector<int64_t>>  candidate;
+
+        while (0U != range >> shift >> SAMPLES_BUCKET_BITS) {
+                ++shift;
+        }
+        buckets = static_cast<size_t>(range >> shift) + 1U;
+        samples_spread(threads, [&](size_t part) {
+                const size_t      end   = samples_share(count, part + 1U,
+                                                        threads);
+                vector<uint64_t> &local = counted[part];
+
+                local.assign(buckets, 0U);
+                for (size_t i = samples_share(count, part, threads); i < end;
+                     ++i) {
+                        ++local[(static_cast<uint64_t>(data[i]) - origin) >>
+                                 shift];
+                }
+        });
+        for (unsigned part = 1U; part < threads; ++part) {
+                for (size_t i = 0U; i < buckets; ++i) {
+                        counted[0][i] += counted[part][i];
+                }
+        }
+
+        slot.assign(buckets, -1);
+        for (size_t q = 0U; q < quantiles.size(); ++q) {
+                uint64_t rank = Histogram::rank(quantiles[q], count);
+                uint64_t seen = 0U;
+                size_t   i    = 0U;
+
+                if (quantiles[q] <= 0.0) {
+                        summary->percentile[q] = summary->min;
+                        continue;
+                }
+                if (quantiles[q] >= 1.0) {
+                        summary->percentile[q] = summary->max;
+                        continue;
+                }
+                for (i = 0U; seen + counted[0][i] < rank; ++i) {
+                        seen += counted[0][i];
+                }
+                bucket[q] = i;
+                within[q] = rank - 1U - seen;
+                if (0U == shift) {
+                        summary->percentile[q] = static_cast<int64_t>(
+                                                        origin + i);
+                } else if (-1 == slot[i]) {
+                        slot[i] = static_cast<int32_t>(wanted.size());
+                        wanted.push_back(i);
+                }
+        }
+        if (wanted.empty()) {
+                return;
+        }
+
+        samples_spread(threads, [&](size_t part) {
+                const size_t                     end   = samples_share(
+                                                        count, part + 1U,
+                                                        threads);
+                vector<vector<int64_t>>         &into  = gathered[part];
+                int32_t                          index = -1;
+
+                into.resize(wanted.size());
+                for (size_t i = samples_share(count, part, threads); i < end;
+                     ++i) {
+                        index = slot[(static_cast<uint64_t>(data[i]) -
+                                      origin) >> shift];
+                        if (-1 != index) {
+                                into[index].push_back(data[i]);
+                        }
+                }
+        });
+        candidate.resize(wanted.size());
+        samples_spread(wanted.size(), [&](size_t index) {
+                vector<int64_t> &value = candidate[index];
+
+                value.reserve(counted[0][wanted[index]]);
+                for (unsigned part = 0U; part < threads; ++part) {
+                        value.insert(value.end(),
+                                     gathered[part][index].begin(),
+                                     gathered[part][index].end());
+                        vector<int64_t>().swap(gathered[part][index]);
+                }
+                for (size_t q = 0U; q < quantiles.size(); ++q) {
+                        if (bucket[q] != wanted[index] ||
+                            quantiles[q] <= 0.0 || quantiles[q] >= 1.0) {
+                                continue;
+                        }
+                        std::nth_element(value.begin(),
+                                         value.begin() + within[q],
+                                         value.end());
+                        summary->percentile[q] = value[within[q]];
+                }
+        });
+}
+
+SampleSummary sample_summarize(const int64_t             *data,
+                               size_t                     count,
+                               const std::vector<double> &quantiles,
+                               unsigned                   threads)
+{
+        SampleSummary              summary = {
+                count, 0, 0, 0.0, 0.0,
+                std::vector<int64_t>(quantiles.size(), 0)
+        };
+        const SampleMoments        initial = { INT64_MAX, INT64_MIN, 0, 0.0 };
+        std::vector<SampleMoments> part;
+        SampleMoments              total   = initial;
+        int64_t                    pivot   = 0;
+        double                     offset  = 0.0;
+        double                     spread  = 0.0;
+
+        if (0U == count) {
+                return summary;
+        }
+        if (0U == threads) {
+                threads = sample_threads();
+        }
+        if (threads > count / SAMPLES_GRAIN) {
+                threads = 0U != count / SAMPLES_GRAIN ?
+                          static_cast<unsigned>(count / SAMPLES_GRAIN) : 1U;
+        }
+
+        pivot = data[0];
+        part.assign(threads, initial);
+        samples_spread(threads, [&](size_t index) {
+                const size_t begin = samples_share(count, index, threads);
+
+                samples_moments(data + begin,
+                                samples_share(count, index + 1U, threads) -
+                                begin,
+                                pivot,
+                                &part[index]);
+        });
+        for (const SampleMoments &moments : part) {
+                total.min      = moments.min < total.min ?
+                                 moments.min : total.min;
+                total.max      = moments.max > total.max ?
+                                 moments.max : total.max;
+                total.sum     += moments.sum;
+                total.squares += moments.squares;
+        }
+
+        summary.min    = total.min;
+        summary.max    = total.max;
+        summary.mean   = static_cast<double>(total.sum) /
+                         static_cast<double>(count);
+        offset         = static_cast<double>(
+                                total.sum - static_cast<__int128>(pivot) *
+                                            static_cast<__int128>(count));
+        spread         = (total.squares -
+                          offset * offset / static_cast<double>(count)) /
+                         static_cast<double>(count);
+        summary.stddev = spread > 0.0 ? std::sqrt(spread) : 0.0;
+        if (!quantiles.empty()) {
+                samples_select(data, count, threads, quantiles, &summary);
+        }
+        return summary;
+}
+
+unsigned sample_threads()
+{
+        cpu_set_t allowed;
+
+        CPU_ZERO(&allowed);
+        if (0 == sched_getaffinity(0, sizeof allowed, &allowed) &&
+            0 < CPU_COUNT(&allowed)) {
+                return static_cast<unsigned>(CPU_COUNT(&allowed));
+        }
+        return 1U;
+}
+
+bool sample_accelerated()
+{
+        return samples_detect();
+}
@@ -0,0 +1,239 @@
+/**
+ * @file schedule.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation source file of the Schedule class.
+ * The mapping is read front to back, twice: once by the constructor to
+ * check it and once by the replay.  The kernel is told as much, and the
+ * pages the replay is done with are handed back every SCHEDULE_RELEASE
+ * bytes, so even a trace larger than memory only ever occupies a window of
+ * it.
+ */
+
+#include "frame.h"
+#include "schedule.h"
+
+#include <stdexcept> /* runtime_error */
+#include <string>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <fcntl.h>    /* open() */
+#include <sys/mman.h> /* madvise() mmap() munmap() */
+#include <sys/stat.h> /* fstat() */
+#include <unistd.h>   /* close() sysconf() */
+
+#ifdef __cplusplus
+}
+#endif
+
+/* Replayed bytes that are handed back to the kernel at a time. */
+#define SCHEDULE_RELEASE (64U << 20)
+
+/* What Schedule::parse_() found on a line. */
+#define SCHEDULE_BLANK     0
+#define SCHEDULE_RECORD    1
+#define SCHEDULE_MALFORMED -1
+
+/* Reads a decimal number into 'value'; NULL if there is none or it wraps. */
+static const char *schedule_number(const char *cursor,
+                                   const char *end,
+                                   uint64_t   *value)
+{
+        const char *start = cursor;
+
+        *value = 0U;
+        for (; cursor != end && '0' <= *cursor && '9' >= *cursor; ++cursor) {
+                if (*value > (UINT64_MAX - 9U) / 10U) {
+                        return NULL;
+                }
+                *value = *value * 10U + static_cast<uint64_t>(*cursor - '0');
+        }
+        return start == cursor ? NULL : cursor;
+}
+
+static const char *schedule_blank(const char *cursor, const char *end)
+{
+        while (cursor != end &&
+               (' ' == *cursor || '\t' == *cursor || '\r' == *cursor)) {
+                ++cursor;
+        }
+        return cursor;
+}
+
+Schedule::Schedule(const char *path)
+        :
+        begin_{NULL},
+        end_{NULL},
+        cursor_{NULL},
+        released_{NULL},
+        length_{0U},
+        count_{0U},
+        max_pad_{0U}
+{
+        using std::runtime_error;
+        using std::string;
+
+        const string  prefix   = string("Schedule(): ") + path + ": ";
+        int           fd       = open(path, O_RDONLY | O_CLOEXEC);
+        struct stat   info     = { };
+        void         *memory   = MAP_FAILED;
+        uint64_t      interval = 0U;
+        size_t        pad      = 0U;
+        size_t        line     = 0U;
+        int           kind     = SCHEDULE_BLANK;
+
+        if (-1 == fd) {
+                throw runtime_error(prefix + "cannot be opened");
+        }
+        if (-1 == fstat(fd, &info) || 0 >= info.st_size) {
+                close(fd);
+                throw runtime_error(prefix + "has no records");
+        }
+        length_ = static_cast<size_t>(info.st_size);
+        memory  = mmap(NULL, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (MAP_FAILED == memory) {
+                throw runtime_error(prefix + "mmap() failed");
+        }
+        madvise(memory, length_, MADV_SEQUENTIAL);
+        begin_    = static_cast<const char *>(memory);
+        end_      = begin_ + length_;
+        cursor_   = begin_;
+        released_ = begin_;
+
+        while (cursor_ != end_) {
+                cursor_ = parse_(cursor_, end_, &interval, &pad, &kind);
+                release_();
+                ++line;
+                if (SCHEDULE_MALFORMED == kind) {
+                        munmap(memory, length_);
+                        throw runtime_error(prefix + "malformed line " +
+                                            std::to_string(line));
+                }
+                if (SCHEDULE_RECORD == kind) {
+                        ++count_;
+                        max_pad_ = pad > max_pad_ ? pad : max_pad_;
+                }
+        }
+        if (0U == count_) {
+                munmap(memory, length_);
+                throw runtime_error(prefix + "has no records");
+        }
+        rewind();
+}
+
+Schedule::~Schedule()
+{
+        munmap(const_cast<char *>(begin_), length_);
+}
+
+bool Schedule::next(uint64_t *interval, size_t *pad)
+{
+        int kind = SCHEDULE_BLANK;
+
+        while (cursor_ != end_) {
+                cursor_ = parse_(cursor_, end_, interval, pad, &kind);
+                release_();
+                if (SCHEDULE_RECORD == kind) {
+                        return true;
+                }
+        }
+        return false;
+}
+
+void Schedule::rewind()
+{
+        cursor_   = begin_;
+        released_ = begin_;
+}
+
+size_t Schedule::count() const
+{
+        return count_;
+}
+
+size_t Schedule::max_pad() const
+{
+        return max_pad_;
+}
+
+/* Hands the pages before the cursor back once there are enough of them. */
+void Schedule::release_()
+{
+        const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const char  *done = NULL;
+
+        if (static_cast<size_t>(cursor_ - released_) < SCHEDULE_RELEASE) {
+                return;
+        }
+        /* Whole pages only, the one under the cursor is still being read. */
+        done = begin_ + static_cast<size_t>(cursor_ - begin_) / page * page;
+        madvise(const_cast<char *>(released_),
+                static_cast<size_t>(done - released_),
+                MADV_DONTNEED);
+        released_ = done;
+}
+
+/*
+ * Parses the line starting at 'cursor' and returns where the next one
+ * starts; 'kind' tells whether it held a record, which is then stored in
+ * 'interval' and 'pad', nothing but blanks and a comment or neither.
+ */
+const char *Schedule::parse_(const char *cursor,
+                             const char *end,
+                             uint64_t   *interval,
+                             size_t     *pad,
+                             int        *kind)
+{
+        const char *newline = cursor;
+        uint64_t    frame   = 0U;
+
+        while (newline != end && '\n' != *newline) {
+                ++newline;
+        }
+        cursor = schedule_blank(cursor, newline);
+        *kind  = SCHEDULE_BLANK;
+        if (cursor != newline && '#' != *cursor) {
+                *kind  = SCHEDULE_MALFORMED;
+                cursor = schedule_number(cursor, newline, interval);
+                if (NULL != cursor && cursor != newline &&
+                    (' ' == *cursor || '\t' == *cursor) &&
+                    NULL != (cursor = schedule_number(
+                                    schedule_blank(cursor, newline),
+                                    newline,
+                                    &frame)) &&
+                    frame >= sizeof(FrameHeader) &&
+                    /* The length field of the header is 32 bits wide. */
+                    frame - sizeof(FrameHeader) <= UINT32_MAX) {
+                        cursor = schedule_blank(cursor, newline);
+                        if (cursor == newline || '#' == *cursor) {
+                                *pad  = static_cast<size_t>(
+                                                frame - sizeof(FrameHeader));
+                                *kind = SCHEDULE_RECORD;
+                        }
+                }
+        }
+        return newline == end ? end : newline + 1;
+}
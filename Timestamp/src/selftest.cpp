@@ -0,0 +1,631 @@
+/**
+ * @file selftest.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation source file of the SelfTest class.
+ * Each point of the sweep forks a fresh receiver and sender, so nothing
+ * left behind by one point (page cache, socket buffers, a wedged receiver)
+ * can skew the next; the receiver hands its "key value" summary back over
+ * a pipe, exactly as 'ts -r -S' would print it.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "engine.h"
+#include "frame.h"
+#include "selftest.h"
+#include "timestamp.h"
+
+#include <cerrno>    /* errno */
+#include <cinttypes> /* PRIu64 SCNd64 */
+#include <cstdlib>   /* EXIT_FAILURE EXIT_SUCCESS strtol() */
+#include <algorithm>
+#include <atomic>
+#include <cstring>   /* memset() strcmp() */
+#include <stdexcept> /* runtime_error */
+#include <string>
+#include <vector>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <arpa/inet.h>   /* htonl() */
+#include <dirent.h>      /* dirfd() opendir() readdir() */
+#include <fcntl.h>       /* F_SETPIPE_SZ pipe2() */
+#include <netinet/in.h>  /* struct sockaddr_in */
+#include <netinet/tcp.h> /* TCP_NODELAY */
+#include <poll.h>        /* poll() */
+#include <sched.h>       /* sched_setaffinity() */
+#include <signal.h>      /* kill() */
+#include <sys/socket.h>  /* socket() socketpair() */
+#include <sys/syscall.h> /* SYS_close_range */
+#include <sys/wait.h>    /* waitpid() */
+#include <time.h>        /* clock_gettime() */
+#include <unistd.h>      /* fork() syscall() _exit() */
+
+#ifdef TIMESTAMP_PGO_GENERATE
+void __gcov_dump(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+/*
+ * How long the receiver may take to report once the sender is done; only
+ * a channel that drops frames (UDP) should ever run into it.
+ */
+#define SELFTEST_GRACE_MS 2000
+/* Largest payload of a UDP datagram over IPv4. */
+#define SELFTEST_UDP_MAX  65507U
+/* Buffer size asked for on both ends of every channel. */
+#define SELFTEST_BUFFER   (1 << 22)
+
+/*
+ * Ends a child without running the exit handlers it inherited; in a build
+ * being trained for profile guided optimization, saves its profile first,
+ * the children being where all the work is done.
+ */
+[[noreturn]] static void selftest_exit(int status)
+{
+#ifdef TIMESTAMP_PGO_GENERATE
+        __gcov_dump();
+#endif
+        _exit(status);
+}
+
+/*
+ * Closes the descriptors 'low' to 'high', both included.  close_range()
+ * only came with linux 5.9 and glibc 2.34, so without either the
+ * descriptors actually open are looked up in /proc/self/fd instead.
+ */
+static void selftest_close(unsigned int low, unsigned int high)
+{
+        DIR           *dir   = NULL;
+        struct dirent *entry = NULL;
+        long           fd    = 0;
+
+#ifdef SYS_close_range
+        if (0 == syscall(SYS_close_range, low, high, 0U)) {
+                return;
+        }
+#endif
+        if (NULL == (dir = opendir("/proc/self/fd"))) {
+                return;
+        }
+        while (NULL != (entry = readdir(dir))) {
+                fd = std::strtol(entry->d_name, NULL, 10);
+                if (fd != dirfd(dir) && '.' != entry->d_name[0] &&
+                    static_cast<unsigned long>(fd) >= low &&
+                    static_cast<unsigned long>(fd) <= high) {
+                        close(static_cast<int>(fd));
+                }
+        }
+        closedir(dir);
+}
+
+SelfTestOption::SelfTestOption()
+        :
+        channel{SelfTestChannel::PIPE},
+        send_cpu{-1},
+        recv_cpu{-1},
+        impair{false},
+        impairment(),
+        relay_cpu{-1},
+        count{100000U},
+        pads{0U, 64U, 1024U, 16384U, 65536U},
+        rates{0U},
+        timestamp()
+{
+}
+
+bool SelfTestOption::parse(const char *name, SelfTestChannel *channel)
+{
+        static const SelfTestChannel CHANNELS[] = {
+                SelfTestChannel::PIPE,
+                SelfTestChannel::SOCKETPAIR,
+                SelfTestChannel::TCP,
+                SelfTestChannel::UDP,
+                SelfTestChannel::SHM
+        };
+
+        for (auto candidate : CHANNELS) {
+                if (0 == std::strcmp(name, SelfTestOption::name(candidate))) {
+                        *channel = candidate;
+                        return true;
+                }
+        }
+        return false;
+}
+
+const char *SelfTestOption::name(SelfTestChannel channel)
+{
+        switch (channel) {
+        case SelfTestChannel::PIPE:
+                return "pipe";
+        case SelfTestChannel::SOCKETPAIR:
+                return "socketpair";
+        case SelfTestChannel::TCP:
+                return "tcp";
+        case SelfTestChannel::UDP:
+                return "udp";
+        case SelfTestChannel::SHM:
+                return "shm";
+        }
+        return "";
+}
+
+SelfTest::SelfTest(const SelfTestOption &option)
+        :
+        option_(option)
+{
+        using std::runtime_error;
+
+        if (0U == option_.count) {
+                throw runtime_error("SelfTest(): count must not be 0");
+        }
+        option_.timestamp.raw = true;
+}
+
+SelfTestResult SelfTest::run(size_t pad, uint64_t rate) const
+{
+        using std::string;
+        using std::to_string;
+
+        static std::atomic<unsigned> serial{0U};
+        SelfTestResult   result    = {
+                pad, rate, SelfTestResult::Status::OK, 0.0, 0U, 0U, 0, 0, 0
+        };
+        int              fd[2]     = {-1, -1};
+        int              hop[2]    = {-1, -1};
+        int              report[2] = {-1, -1};
+        int              recv_fd   = -1;
+        int              status    = 0;
+        bool             sent      = false;
+        pid_t            receiver  = -1;
+        pid_t            relay     = 0;
+        pid_t            sender    = -1;
+        char             buffer[1 << 12];
+        ssize_t          breach    = 0;
+        string           summary;
+        /* Concurrent runs of a sweep each need a segment of their own. */
+        const string     shm       = "/ts-selftest-" +
+                                     to_string(getpid()) + "-" +
+                                     to_string(serial++);
+        const char      *shm_name  = NULL;
+        struct pollfd    pfd       = { };
+        struct timespec  start     = { };
+        struct timespec  end       = { };
+
+        if ((SelfTestChannel::UDP == option_.channel &&
+             sizeof(FrameHeader) + pad > SELFTEST_UDP_MAX) ||
+            (SelfTestChannel::SHM == option_.channel && option_.impair)) {
+                result.status = SelfTestResult::Status::SKIPPED;
+                return result;
+        }
+        /* The sender writes to 'fd', a relay forwards from it to 'hop'. */
+        if (-1 == channel_(fd) ||
+            (option_.impair && -1 == channel_(hop)) ||
+            -1 == pipe2(report, O_CLOEXEC)) {
+                for (auto end : {fd[0], fd[1], hop[0], hop[1]}) {
+                        if (-1 != end) {
+                                close(end);
+                        }
+                }
+                result.status = SelfTestResult::Status::FAILED;
+                return result;
+        }
+        recv_fd = option_.impair ? hop[0] : fd[0];
+        if (SelfTestChannel::SHM == option_.channel) {
+                shm_name = shm.c_str();
+        }
+
+        /* Otherwise whatever the caller buffered is printed thrice. */
+        fflush(NULL);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (0 == (receiver = fork())) {
+                isolate_({recv_fd, report[1]});
+                selftest_exit(receive_(recv_fd, shm_name, report[1], pad));
+        }
+        if (option_.impair && -1 != receiver && 0 == (relay = fork())) {
+                isolate_({fd[0], hop[1]});
+                selftest_exit(relay_(fd[0], hop[1]));
+        }
+        if (-1 != receiver && -1 != relay && 0 == (sender = fork())) {
+                isolate_({fd[1]});
+                selftest_exit(send_(fd[1], shm_name, pad, rate));
+        }
+        for (auto end : {fd[0], fd[1], hop[0], hop[1], report[1]}) {
+                if (-1 != end) {
+                        close(end);
+                }
+        }
+
+        if (-1 != sender) {
+                waitpid(sender, &status, 0);
+                sent = WIFEXITED(status) &&
+                       EXIT_SUCCESS == WEXITSTATUS(status);
+        }
+        /* Frames held by the relay may take a while to come out. */
+        if (0 < relay) {
+                waitpid(relay, &status, 0);
+                sent = sent && WIFEXITED(status) &&
+                       EXIT_SUCCESS == WEXITSTATUS(status);
+        }
+
+        /* The receiver only ever writes its summary once it is done. */
+        pfd.fd     = report[0];
+        pfd.events = POLLIN;
+        while (-1 != receiver &&
+               -1 == (breach = poll(&pfd, 1U, SELFTEST_GRACE_MS)) &&
+               EINTR == errno) {
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (-1 != receiver && 1 != breach) {
+                kill(receiver, SIGKILL);
+                result.status = SelfTestResult::Status::INCOMPLETE;
+        }
+        while (0 < (breach = read(report[0], buffer, sizeof buffer)) ||
+               (-1 == breach && EINTR == errno)) {
+                if (0 < breach) {
+                        summary.append(buffer, static_cast<size_t>(breach));
+                }
+        }
+        close(report[0]);
+        if (-1 != receiver) {
+                waitpid(receiver, &status, 0);
+        }
+
+        result.elapsed = static_cast<double>(end.tv_sec - start.tv_sec) +
+                         static_cast<double>(end.tv_nsec - start.tv_nsec) /
+                         1e9;
+        parse_(summary.c_str(), &result);
+        if (-1 == receiver || -1 == relay || -1 == sender || !sent) {
+                result.status = SelfTestResult::Status::FAILED;
+        } else if (option_.count != result.frames + result.lost) {
+                result.status = SelfTestResult::Status::INCOMPLETE;
+        }
+        return result;
+}
+
+int SelfTest::sweep(FILE *stream) const
+{
+        SelfTestResult result = { };
+        int            status = 0;
+
+        fprintf(stream,
+                "# ts self-test over %s, %zu frames per point, "
+                "sender cpu %d, receiver cpu %d\n",
+                SelfTestOption::name(option_.channel),
+                option_.count,
+                option_.send_cpu,
+                option_.recv_cpu);
+        print_header(stream);
+        for (auto pad : option_.pads) {
+                for (auto rate : option_.rates) {
+                        result = run(pad, rate);
+                        print(stream, result);
+                        if (SelfTestResult::Status::OK != result.status &&
+                            SelfTestResult::Status::SKIPPED != result.status) {
+                                status = -1;
+                        }
+                }
+        }
+        return status;
+}
+
+void SelfTest::print_header(FILE *stream)
+{
+        fprintf(stream,
+                "# %7s %10s %12s %10s %9s %11s %11s %11s %s\n",
+                "PAD", "RATE", "FRAMES/S", "MB/S", "LOST",
+                "P50(ns)", "P99(ns)", "MAX(ns)", "STATUS");
+        fflush(stream);
+}
+
+void SelfTest::print(FILE *stream, const SelfTestResult &result)
+{
+        static const char *const STATUS[] = {
+                "ok", "incomplete", "skipped", "failed"
+        };
+        const double elapsed = result.elapsed > 0.0 ? result.elapsed : 1.0;
+        const double bytes   = static_cast<double>(result.frames) *
+                               static_cast<double>(sizeof(FrameHeader) +
+                                                   result.pad);
+
+        fprintf(stream,
+                "%9zu %10" PRIu64 " %12.0f %10.1f %9" PRIu64
+                " %11" PRId64 " %11" PRId64 " %11" PRId64 " %s\n",
+                result.pad,
+                result.rate,
+                static_cast<double>(result.frames) / elapsed,
+                bytes / elapsed / 1e6,
+                result.lost,
+                result.p50,
+                result.p99,
+                result.max,
+                STATUS[static_cast<int>(result.status)]);
+        fflush(stream);
+}
+
+/* Opens the channel; 'fd[0]' is the receiving end, 'fd[1]' the sending. */
+int SelfTest::channel_(int fd[2]) const
+{
+        const int          size    = SELFTEST_BUFFER;
+        const int          on      = 1;
+        const int          type    = SelfTestChannel::UDP == option_.channel ?
+                                     SOCK_DGRAM : SOCK_STREAM;
+        int                listener = -1;
+        struct sockaddr_in address[2];
+        socklen_t          length  = sizeof address[0];
+
+        fd[0] = fd[1] = -1;
+        switch (option_.channel) {
+        case SelfTestChannel::SHM:
+                return 0;
+        case SelfTestChannel::PIPE:
+                if (-1 == pipe2(fd, O_CLOEXEC)) {
+                        return -1;
+                }
+                /* Best effort; the default 64 KiB is kept if refused. */
+                fcntl(fd[1], F_SETPIPE_SZ, size);
+                return 0;
+        case SelfTestChannel::SOCKETPAIR:
+                if (-1 == socketpair(AF_UNIX,
+                                     SOCK_STREAM | SOCK_CLOEXEC,
+                                     0,
+                                     fd)) {
+                        return -1;
+                }
+                break;
+        case SelfTestChannel::TCP:
+        case SelfTestChannel::UDP:
+                std::memset(address, 0, sizeof address);
+                for (auto &addr : address) {
+                        addr.sin_family      = AF_INET;
+                        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                }
+                listener = socket(AF_INET, type | SOCK_CLOEXEC, 0);
+                fd[1]    = socket(AF_INET, type | SOCK_CLOEXEC, 0);
+                if (-1 == listener || -1 == fd[1] ||
+                    -1 == bind(listener,
+                               reinterpret_cast<sockaddr *>(&address[0]),
+                               length) ||
+                    -1 == getsockname(listener,
+                                      reinterpret_cast<sockaddr *>(
+                                              &address[0]),
+                                      &length)) {
+                        break;
+                }
+                if (SOCK_STREAM == type) {
+                        if (-1 != listen(listener, 1) &&
+                            -1 != connect(fd[1],
+                                          reinterpret_cast<sockaddr *>(
+                                                  &address[0]),
+                                          length)) {
+                                fd[0] = accept4(listener,
+                                                NULL,
+                                                NULL,
+                                                SOCK_CLOEXEC);
+                        }
+                        setsockopt(fd[1], IPPROTO_TCP, TCP_NODELAY,
+                                   &on, sizeof on);
+                        close(listener);
+                        break;
+                }
+                /* Both datagram sockets are connected to each other. */
+                if (-1 != bind(fd[1],
+                               reinterpret_cast<sockaddr *>(&address[1]),
+                               length) &&
+                    -1 != getsockname(fd[1],
+                                      reinterpret_cast<sockaddr *>(
+                                              &address[1]),
+                                      &length) &&
+                    -1 != connect(fd[1],
+                                  reinterpret_cast<sockaddr *>(&address[0]),
+                                  length) &&
+                    -1 != connect(listener,
+                                  reinterpret_cast<sockaddr *>(&address[1]),
+                                  length)) {
+                        fd[0]    = listener;
+                        listener = -1;
+                }
+                if (-1 != listener) {
+                        close(listener);
+                }
+                break;
+        }
+
+        if (-1 == fd[0] || -1 == fd[1]) {
+                for (int i = 0; i < 2; ++i) {
+                        if (-1 != fd[i]) {
+                                close(fd[i]);
+                        }
+                }
+                return -1;
+        }
+        /* The forced variant goes past rmem_max but needs CAP_NET_ADMIN. */
+        if (-1 == setsockopt(fd[0], SOL_SOCKET, SO_RCVBUFFORCE,
+                             &size, sizeof size)) {
+                setsockopt(fd[0], SOL_SOCKET, SO_RCVBUF, &size, sizeof size);
+        }
+        if (-1 == setsockopt(fd[1], SOL_SOCKET, SO_SNDBUFFORCE,
+                             &size, sizeof size)) {
+                setsockopt(fd[1], SOL_SOCKET, SO_SNDBUF, &size, sizeof size);
+        }
+        return 0;
+}
+
+/* Body of the receiving child; returns its exit status. */
+int SelfTest::receive_(int         fd,
+                       const char *shm,
+                       int         result_fd,
+                       size_t      pad) const
+{
+        TimeStampOption option = option_.timestamp;
+        FILE           *input  = -1 == fd ? NULL : fdopen(fd, "r");
+        /* Formatting the log is part of the cost being measured. */
+        FILE           *log    = fopen("/dev/null", "w");
+
+        option.shm   = shm;
+        option.stats = fdopen(result_fd, "w");
+        if ((NULL == input && NULL == shm) || NULL == log ||
+            NULL == option.stats ||
+            !pin_(option_.recv_cpu)) {
+                return EXIT_FAILURE;
+        }
+        try {
+                if (option.engine && timestamp_engine_supports(option)) {
+                        timestamp_engine_receive(pad,
+                                                 option_.count,
+                                                 fd,
+                                                 log,
+                                                 option);
+                        return EXIT_SUCCESS;
+                }
+
+                TimeStamp timestamp(pad, input, NULL, log, option);
+
+                timestamp << option_.count;
+        } catch (...) {
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+}
+
+/* Body of the sending child; returns its exit status. */
+int SelfTest::send_(int fd, const char *shm, size_t pad, uint64_t rate) const
+{
+        TimeStampOption option = option_.timestamp;
+        FILE           *output = -1 == fd ? NULL : fdopen(fd, "w");
+
+        option.rate  = rate;
+        option.shm   = shm;
+        option.stats = NULL;
+        if ((NULL == output && NULL == shm) || !pin_(option_.send_cpu)) {
+                return EXIT_FAILURE;
+        }
+        try {
+                /* The descriptor is closed on exit, ending the stream. */
+                if (option.engine && timestamp_engine_supports(option)) {
+                        timestamp_engine_send(pad,
+                                              option_.count,
+                                              fd,
+                                              option);
+                        return EXIT_SUCCESS;
+                }
+
+                /* Closing 'output' on destruction signals end of file. */
+                TimeStamp timestamp(pad, NULL, output, NULL, option);
+
+                timestamp >> option_.count;
+        } catch (...) {
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+}
+
+/* Body of the relaying child; returns its exit status. */
+int SelfTest::relay_(int in_fd, int out_fd) const
+{
+        if (!pin_(option_.relay_cpu)) {
+                return EXIT_FAILURE;
+        }
+        try {
+                Impairment impairment(option_.impairment);
+
+                if (-1 == impairment.run(in_fd, out_fd)) {
+                        return EXIT_FAILURE;
+                }
+        } catch (...) {
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+}
+
+bool SelfTest::pin_(int cpu)
+{
+        cpu_set_t set;
+
+        if (0 > cpu) {
+                return true;
+        }
+        if (CPU_SETSIZE <= cpu) {
+                return false;
+        }
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return 0 == sched_setaffinity(0, sizeof set, &set);
+}
+
+/*
+ * Closes every descriptor above stderr but those in 'keep': a channel end
+ * inherited by the wrong child would otherwise keep its reader from ever
+ * seeing end of file.
+ */
+void SelfTest::isolate_(std::initializer_list<int> keep)
+{
+        std::vector<int> sorted(keep);
+        unsigned int     low = 3U;
+
+        std::sort(sorted.begin(), sorted.end());
+        for (auto fd : sorted) {
+                const unsigned int high = static_cast<unsigned int>(fd);
+
+                if (0 > fd) {
+                        continue;
+                }
+                if (high > low) {
+                        selftest_close(low, high - 1U);
+                }
+                low = high + 1U;
+        }
+        selftest_close(low, ~0U);
+}
+
+/* Picks the fields of interest out of a receiver summary. */
+void SelfTest::parse_(const char *summary, SelfTestResult *result)
+{
+        char    key[64] = { };
+        int64_t value   = 0;
+
+        while ('\0' != *summary) {
+                if (2 == sscanf(summary, "%63s %" SCNd64, key, &value)) {
+                        if (0 == std::strcmp("frames", key)) {
+                                result->frames = static_cast<uint64_t>(value);
+                        } else if (0 == std::strcmp("frames.lost", key)) {
+                                result->lost = static_cast<uint64_t>(value);
+                        } else if (0 == std::strcmp("latency.p50", key)) {
+                                result->p50 = value;
+                        } else if (0 == std::strcmp("latency.p99", key)) {
+                                result->p99 = value;
+                        } else if (0 == std::strcmp("latency.max", key)) {
+                                result->max = value;
+                        }
+                }
+                while ('\0' != *summary && '\n' != *summary++) {
+                }
+        }
+}
@@ -0,0 +1,387 @@
+/**
+ * @file shmring.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation source file of the ShmRing class.
+ * A side that finds nothing to do spins for a while and then, unless told
+ * to spin forever, announces itself in the waiter word of the index it is
+ * waiting on and sleeps on that index as a futex; the other side only pays
+ * for a wake-up system call when somebody actually sleeps.  Announcing and
+ * publishing are both sequentially consistent so that neither side can
+ * miss the other (the store-load pattern of Dekker's algorithm).
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "shmring.h"
+
+#include <cerrno>    /* errno */
+#include <stdexcept> /* runtime_error */
+#include <string>
+#include <thread>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <fcntl.h>        /* O_CREAT O_EXCL O_RDWR */
+#include <linux/futex.h>  /* FUTEX_WAIT FUTEX_WAKE */
+#include <signal.h>       /* kill() */
+#include <sys/mman.h>     /* mmap() shm_open() shm_unlink() */
+#include <sys/stat.h>     /* fstat() */
+#include <sys/syscall.h>  /* SYS_futex */
+#include <time.h>         /* nanosleep() */
+#include <unistd.h>       /* ftruncate() getpid() syscall() */
+
+#ifdef __cplusplus
+}
+#endif
+
+/* Marks a segment whose control block is completely initialized. */
+#define SHMRING_MAGIC    0x54534852U
+/* Polls an idle side makes before it goes to sleep on the futex. */
+#define SHMRING_SPIN     2048U
+/* Sleeps are cut short this often to see whether the peer still lives. */
+#define SHMRING_CHECK_NS 100000000L
+/* How long a producer waits for the consumer to create the segment. */
+#define SHMRING_OPEN_MS  10000U
+/* The segment aims at about this many bytes worth of slots. */
+#define SHMRING_BYTES    (1U << 22)
+
+static inline void shmring_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#else
+        std::this_thread::yield();
+#endif
+}
+
+static bool shmring_alive(int32_t pid)
+{
+        return 0 == pid || 0 == kill(pid, 0) || ESRCH != errno;
+}
+
+static void shmring_futex(std::atomic<uint32_t> *word, int op, uint32_t value)
+{
+        struct timespec timeout = {0, SHMRING_CHECK_NS};
+
+        syscall(SYS_futex,
+                reinterpret_cast<uint32_t *>(word),
+                op,
+                value,
+                FUTEX_WAIT == op ? &timeout : NULL,
+                NULL,
+                0);
+}
+
+ShmRing::ShmRing(const char *name, size_t frame, ShmRingRole role, bool spin)
+        :
+        name_{name},
+        role_{role},
+        spin_{spin},
+        control_{NULL},
+        slot_{NULL},
+        length_{0U},
+        mask_{0U},
+        slot_size_{0U},
+        head_{0U},
+        tail_{0U},
+        sleeps_{0U},
+        idle_ms_{0U},
+        limited_{false},
+        timed_out_{false},
+        deadline_{}
+{
+        using std::runtime_error;
+        using std::string;
+
+        const size_t     page     = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const string     prefix   = string("ShmRing(): ") + name + ": ";
+        size_t           count    = 16U;
+        int              fd       = -1;
+        int32_t          vacant   = 0;
+        void            *memory   = MAP_FAILED;
+        struct stat      info     = { };
+        struct timespec  pause    = {0, 1000000L};
+
+        if (frame > UINT32_MAX / 2U) {
+                throw runtime_error(prefix + "frame too large");
+        }
+        if (ShmRingRole::CONSUMER == role_) {
+                slot_size_ = static_cast<uint32_t>(
+                                (frame + CMNUTIL_CACHE_LINE - 1U) /
+                                CMNUTIL_CACHE_LINE * CMNUTIL_CACHE_LINE);
+                while (count < (1U << 16) &&
+                       count * slot_size_ < SHMRING_BYTES) {
+                        count <<= 1;
+                }
+                length_ = page + count * slot_size_;
+
+                /* A segment left behind by a crashed run is replaced. */
+                shm_unlink(name_);
+                fd = shm_open(name_, O_CREAT | O_EXCL | O_RDWR, 0600);
+                if (-1 == fd) {
+                        throw runtime_error(prefix + "shm_open() failed");
+                }
+                if (-1 == ftruncate(fd, static_cast<off_t>(length_)) ||
+                    MAP_FAILED == (memory = mmap(NULL,
+                                                 length_,
+                                                 PROT_READ | PROT_WRITE,
+                                                 MAP_SHARED,
+                                                 fd,
+                                                 0))) {
+                        close(fd);
+                        shm_unlink(name_);
+                        throw runtime_error(prefix + "mapping failed");
+                }
+                close(fd);
+
+                /* A fresh segment is all zeros, all that is left is: */
+                control_             = reinterpret_cast<Control_ *>(memory);
+                control_->slot_size  = slot_size_;
+                control_->slot_count = static_cast<uint32_t>(count);
+                control_->consumer   = static_cast<int32_t>(getpid());
+                control_->ready.store(SHMRING_MAGIC,
+                                      std::memory_order_release);
+        } else {
+                for (unsigned ms = 0U; ; ++ms) {
+                        if (SHMRING_OPEN_MS == ms) {
+                                throw runtime_error(prefix +
+                                                    "no receiver showed up");
+                        }
+                        if (MAP_FAILED != memory) {
+                                munmap(memory, length_);
+                                memory = MAP_FAILED;
+                                nanosleep(&pause, NULL);
+                        }
+                        if (-1 == (fd = shm_open(name_, O_RDWR, 0))) {
+                                nanosleep(&pause, NULL);
+                                continue;
+                        }
+                        if (-1 == fstat(fd, &info) ||
+                            static_cast<size_t>(info.st_size) <= page) {
+                                close(fd);
+                                nanosleep(&pause, NULL);
+                                continue;
+                        }
+                        length_ = static_cast<size_t>(info.st_size);
+                        memory  = mmap(NULL,
+                                       length_,
+                                       PROT_READ | PROT_WRITE,
+                                       MAP_SHARED,
+                                       fd,
+                                       0);
+                        close(fd);
+                        if (MAP_FAILED == memory) {
+                                continue;
+                        }
+                        control_ = reinterpret_cast<Control_ *>(memory);
+                        /* Skips segments being set up or left behind. */
+                        if (SHMRING_MAGIC == control_->ready.load(
+                                        std::memory_order_acquire) &&
+                            0U == control_->closed.load() &&
+                            shmring_alive(control_->consumer)) {
+                                break;
+                        }
+                }
+                slot_size_ = control_->slot_size;
+                count      = control_->slot_count;
+                if (frame > slot_size_ ||
+                    !control_->producer.compare_exchange_strong(
+                            vacant, static_cast<int32_t>(getpid()))) {
+                        munmap(memory, length_);
+                        throw runtime_error(prefix +
+                                            "frame size mismatch or "
+                                            "segment in use");
+                }
+        }
+        slot_ = reinterpret_cast<char *>(memory) + page;
+        mask_ = static_cast<uint32_t>(count - 1U);
+}
+
+ShmRing::~ShmRing()
+{
+        if (ShmRingRole::PRODUCER == role_) {
+                control_->closed.store(1U);
+                shmring_futex(&control_->head, FUTEX_WAKE, 1U);
+        } else {
+                shm_unlink(name_);
+        }
+        munmap(control_, length_);
+}
+
+void *ShmRing::reserve()
+{
+        if (head_ - tail_ <= mask_) {
+                return slot_ + static_cast<size_t>(head_ & mask_) * slot_size_;
+        }
+        tail_ = control_->tail.load(std::memory_order_acquire);
+        while (head_ - tail_ > mask_) {
+                if (!wait_(&control_->tail,
+                           &control_->tail_waiter,
+                           tail_,
+                           control_->consumer)) {
+                        return NULL;
+                }
+                tail_ = control_->tail.load(std::memory_order_acquire);
+        }
+        return slot_ + static_cast<size_t>(head_ & mask_) * slot_size_;
+}
+
+/*
+ * Even a spinning side wakes its peer, which may not spin: the flag only
+ * tells how this end waits, not how the other one does.
+ */
+void ShmRing::commit()
+{
+        control_->head.store(++head_);
+        if (0U != control_->head_waiter.load()) {
+                shmring_futex(&control_->head, FUTEX_WAKE, 1U);
+        }
+}
+
+const void *ShmRing::acquire()
+{
+        if (head_ == tail_) {
+                head_ = control_->head.load(std::memory_order_acquire);
+        }
+        while (head_ == tail_) {
+                if (!wait_(&control_->head,
+                           &control_->head_waiter,
+                           head_,
+                           control_->producer.load())) {
+                        return NULL;
+                }
+                head_ = control_->head.load(std::memory_order_acquire);
+        }
+        return slot_ + static_cast<size_t>(tail_ & mask_) * slot_size_;
+}
+
+/* See commit(). */
+void ShmRing::release()
+{
+        control_->tail.store(++tail_);
+        if (0U != control_->tail_waiter.load()) {
+                shmring_futex(&control_->tail, FUTEX_WAKE, 1U);
+        }
+}
+
+size_t ShmRing::slots() const
+{
+        return static_cast<size_t>(mask_) + 1U;
+}
+
+size_t ShmRing::slot_size() const
+{
+        return slot_size_;
+}
+
+uint64_t ShmRing::sleeps() const
+{
+        return sleeps_;
+}
+
+void ShmRing::limit(uint64_t idle_ms, const struct timespec *deadline)
+{
+        idle_ms_ = idle_ms;
+        limited_ = NULL != deadline;
+        if (limited_) {
+                deadline_ = *deadline;
+        }
+}
+
+bool ShmRing::timed_out() const
+{
+        return timed_out_;
+}
+
+/*
+ * Waits for 'word' to move past 'stale'; false once it never will, that is
+ * the producer closed the stream or the 'peer' process is gone, once the
+ * run is interrupted (see cmnutil_interrupt()) or once the wait outlasts
+ * the limits set by limit().
+ */
+bool ShmRing::wait_(std::atomic<uint32_t> *word,
+                    std::atomic<uint32_t> *waiter,
+                    uint32_t               stale,
+                    int32_t                peer)
+{
+        const bool      consumer = ShmRingRole::CONSUMER == role_;
+        struct timespec until    = deadline_;
+        struct timespec idle     = { };
+        bool            limited  = limited_;
+
+        /* Only limited rings read the clock, and only once they wait. */
+        if (0U != idle_ms_) {
+                idle = cmnutil_deadline(idle_ms_);
+                if (!limited || idle.tv_sec < until.tv_sec ||
+                    (idle.tv_sec == until.tv_sec &&
+                     idle.tv_nsec < until.tv_nsec)) {
+                        until = idle;
+                }
+                limited = true;
+        }
+
+        for (uint64_t spins = 1U; ; ++spins) {
+                if (stale != word->load(std::memory_order_acquire)) {
+                        return true;
+                }
+                if (consumer && 0U != control_->closed.load()) {
+                        return stale != word->load();
+                }
+                if (spin_ || spins < SHMRING_SPIN) {
+                        shmring_relax();
+                        /* Now and then, even a spinning side looks around. */
+                        if (0U == (spins & 0xfffffU) &&
+                            (!shmring_alive(peer) || cmnutil_interrupted())) {
+                                return false;
+                        }
+                        if (0U == (spins & 0xfffffU) && limited &&
+                            0 == cmnutil_remaining(until)) {
+                                timed_out_ = true;
+                                return false;
+                        }
+                        continue;
+                }
+                waiter->store(1U);
+                if (stale == word->load() &&
+                    !(consumer && 0U != control_->closed.load())) {
+                        shmring_futex(word, FUTEX_WAIT, stale);
+                        ++sleeps_;
+                }
+                waiter->store(0U, std::memory_order_relaxed);
+                if (!shmring_alive(peer) || cmnutil_interrupted()) {
+                        return stale != word->load();
+                }
+                if (limited && stale == word->load() &&
+                    0 == cmnutil_remaining(until)) {
+                        timed_out_ = true;
+                        return false;
+                }
+                if (consumer && 0 == peer) {
+                        peer = control_->producer.load();
+                }
+        }
+}
@@ -0,0 +1,530 @@
+/**
+ * @file sweep.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation source file of the Sweep class.
+ * Every experiment is a SelfTest run of its own; worker processes, one per
+ * CPU set, take experiments off a shared counter until none is left.  They
+ * are processes rather than threads since the children of a run go on
+ * without exec(), which is only sound after forking a single thread.
+ * Repetitions are interleaved with the other points rather than run back
+ * to back, so a slow drift of the machine spreads over all points instead
+ * of biasing the few that happened to run during it.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "payload.h"
+#include "sweep.h"
+
+#include <cerrno>    /* errno */
+#include <cinttypes> /* PRIu64 strtoumax() */
+#include <cmath>     /* sqrt() */
+#include <cstdlib>   /* EXIT_FAILURE EXIT_SUCCESS free() strtod() */
+#include <cstring>   /* strcmp() strspn() */
+#include <new>
+#include <stdexcept> /* invalid_argument runtime_error */
+#include <string>
+#include <type_traits>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sched.h>    /* sched_getaffinity() */
+#include <sys/mman.h> /* mmap() munmap() */
+#include <sys/wait.h> /* waitpid() */
+#include <time.h>     /* clock_gettime() */
+#include <unistd.h>   /* fork() _exit() */
+
+#ifdef __cplusplus
+}
+#endif
+
+/* Splits a comma separated 'value' into numbers; false if malformed. */
+static bool sweep_numbers(const char *value, std::vector<uint64_t> *list)
+{
+        char      *endptr = NULL;
+        uintmax_t  number = 0U;
+
+        list->clear();
+        for (;;) {
+                errno  = 0;
+                number = strtoumax(value, &endptr, 10);
+                if (ERANGE == errno || endptr == value || '-' == *value) {
+                        return false;
+                }
+                list->push_back(static_cast<uint64_t>(number));
+                if ('\0' == *endptr) {
+                        return true;
+                }
+                if (',' != *endptr) {
+                        return false;
+                }
+                value = endptr + 1;
+        }
+}
+
+static bool sweep_percents(const char *value, std::vector<double> *list)
+{
+        char   *endptr = NULL;
+        double  number = 0.0;
+
+        list->clear();
+        for (;;) {
+                errno  = 0;
+                number = std::strtod(value, &endptr);
+                if (ERANGE == errno || endptr == value ||
+                    !(number >= 0.0 && number <= 100.0)) {
+                        return false;
+                }
+                list->push_back(number);
+                if ('\0' == *endptr) {
+                        return true;
+                }
+                if (',' != *endptr) {
+                        return false;
+                }
+                value = endptr + 1;
+        }
+}
+
+static bool sweep_switch(const char *value, bool *result)
+{
+        if (0 == std::strcmp("yes", value) || 0 == std::strcmp("1", value)) {
+                *result = true;
+        } else if (0 == std::strcmp("no", value) ||
+                   0 == std::strcmp("0", value)) {
+                *result = false;
+        } else {
+                return false;
+        }
+        return true;
+}
+
+SweepSpec::SweepSpec()
+        :
+        channel{SelfTestChannel::PIPE},
+        /* What tsTest.py sends for each of its points. */
+        count{1024U},
+        repeat{5U},
+        jobs{0U},
+        cpus(),
+        pads{0U},
+        rates{0U},
+        delays{0U},
+        jitters{0U},
+        losses{0.0},
+        reorders{0.0},
+        datagram{false},
+        rto{ImpairOption().rto_ns / 1000U},
+        timestamp()
+{
+}
+
+void SweepSpec::load(FILE *stream)
+{
+        using std::invalid_argument;
+        using std::to_string;
+        using std::vector;
+
+        char             *line     = NULL;
+        size_t            capacity = 0U;
+        size_t            number   = 0U;
+        bool              valid    = false;
+        vector<uint64_t>  list;
+
+        while (-1 != getline(&line, &capacity, stream)) {
+                char *key   = line + std::strspn(line, " \t");
+                char *value = NULL;
+                char *end   = key + std::strcspn(key, "#\r\n");
+
+                ++number;
+                /* Strips the comment and the trailing blanks. */
+                while (end != key && (' ' == end[-1] || '\t' == end[-1])) {
+                        --end;
+                }
+                *end = '\0';
+                if ('\0' == *key) {
+                        continue;
+                }
+                value  = key + std::strcspn(key, " \t");
+                if ('\0' != *value) {
+                        *value++ = '\0';
+                        value   += std::strspn(value, " \t");
+                }
+
+                if (0 == std::strcmp("channel", key)) {
+                        valid = SelfTestOption::parse(value, &channel);
+                } else if (0 == std::strcmp("payload", key)) {
+                        valid = PayloadGenerator::parse(value,
+                                                        &timestamp.payload);
+                } else if (0 == std::strcmp("datagram", key)) {
+                        valid = sweep_switch(value, &datagram);
+                } else if (0 == std::strcmp("pipeline", key)) {
+                        valid = sweep_switch(value, &timestamp.pipeline);
+                } else if (0 == std::strcmp("pad", key)) {
+                        valid = sweep_numbers(value, &pads);
+                } else if (0 == std::strcmp("rate", key)) {
+                        valid = sweep_numbers(value, &rates);
+                } else if (0 == std::strcmp("delay", key)) {
+                        valid = sweep_numbers(value, &delays);
+                } else if (0 == std::strcmp("jitter", key)) {
+                        valid = sweep_numbers(value, &jitters);
+                } else if (0 == std::strcmp("loss", key)) {
+                        valid = sweep_percents(value, &losses);
+                } else if (0 == std::strcmp("reorder", key)) {
+                        valid = sweep_percents(value, &reorders);
+                } else if (0 == std::strcmp("cpus", key)) {
+                        valid = sweep_numbers(value, &list);
+                        cpus.clear();
+                        for (auto cpu : list) {
+                                valid = valid && cpu < CPU_SETSIZE;
+                                cpus.push_back(static_cast<int>(cpu));
+                        }
+                } else if (!sweep_numbers(value, &list) ||
+                           1U != list.size()) {
+                        /* The rest all take a single number. */
+                        valid = false;
+                } else if (0 == std::strcmp("count", key)) {
+                        count = list.front();
+                        valid = 0U != count;
+                } else if (0 == std::strcmp("repeat", key)) {
+                        repeat = list.front();
+                        valid  = 0U != repeat;
+                } else if (0 == std::strcmp("jobs", key)) {
+                        jobs  = list.front();
+                        valid = true;
+                } else if (0 == std::strcmp("rto", key)) {
+                        rto   = list.front();
+                        valid = true;
+                } else if (0 == std::strcmp("batch", key)) {
+                        timestamp.batch = list.front();
+                        valid           = 0U != timestamp.batch;
+                } else {
+                        valid = false;
+                }
+
+                if (!valid) {
+                        std::free(line);
+                        throw invalid_argument("line " +
+                                               to_string(number) +
+                                               ": invalid setting");
+                }
+        }
+        std::free(line);
+}
+
+Sweep::Sweep(const SweepSpec &spec)
+        :
+        spec_(spec),
+        point_(),
+        impair_{false},
+        width_{2U},
+        sets_{0U},
+        jobs_{1U},
+        result_()
+{
+        cpu_set_t    allowed;
+
+        /* Walks the matrix like an odometer, the last dimension fastest. */
+        const size_t size[6] = {
+                spec_.pads.size(),    spec_.rates.size(),
+                spec_.delays.size(),  spec_.jitters.size(),
+                spec_.losses.size(),  spec_.reorders.size()
+        };
+        size_t       digit[6] = { };
+        size_t       total    = 1U;
+
+        for (auto length : size) {
+                total *= length;
+        }
+        for (size_t k = 0U; k < total; ++k) {
+                size_t rest = k;
+
+                for (size_t i = 6U; 0U != i; --i) {
+                        digit[i - 1U] = rest % size[i - 1U];
+                        rest         /= size[i - 1U];
+                }
+                point_.push_back({
+                        spec_.pads[digit[0]],    spec_.rates[digit[1]],
+                        spec_.delays[digit[2]],  spec_.jitters[digit[3]],
+                        spec_.losses[digit[4]],  spec_.reorders[digit[5]]
+                });
+                impair_ = impair_ || 0U != point_.back().delay ||
+                          0U != point_.back().jitter ||
+                          0.0 != point_.back().loss ||
+                          0.0 != point_.back().reorder;
+        }
+        /*
+         * Either every point goes through a relay or none does, so that the
+         * cost of the relay itself never tells two points apart.
+         */
+        impair_ = impair_ || spec_.datagram;
+        width_  = impair_ ? 3U : 2U;
+
+        if (spec_.cpus.empty()) {
+                CPU_ZERO(&allowed);
+                if (0 == sched_getaffinity(0, sizeof allowed, &allowed)) {
+                        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                                if (CPU_ISSET(cpu, &allowed)) {
+                                        spec_.cpus.push_back(cpu);
+                                }
+                        }
+                }
+        }
+        sets_ = spec_.cpus.size() / width_;
+        jobs_ = 0U != spec_.jobs ? spec_.jobs : sets_;
+        if (0U == jobs_) {
+                jobs_ = 1U;
+        }
+        for (const auto &point : point_) {
+                for (size_t run = 0U; run < spec_.repeat; ++run) {
+                        result_.push_back({
+                                point.pad, point.rate,
+                                SelfTestResult::Status::FAILED,
+                                0.0, 0U, 0U, 0, 0, 0
+                        });
+                }
+        }
+}
+
+int Sweep::run(FILE *stream)
+{
+        using std::atomic;
+        using std::runtime_error;
+        using std::vector;
+
+        static_assert(std::is_trivially_copyable<SelfTestResult>::value,
+                      "results are copied in and out of shared memory");
+
+        /* The counter, then the results on a cache line of their own. */
+        const size_t         offset = 64U;
+        const size_t         size   = offset + result_.size() *
+                                      sizeof(SelfTestResult);
+        vector<pid_t>        worker;
+        atomic<size_t>      *next   = NULL;
+        SelfTestResult      *shared = NULL;
+        void                *board  = NULL;
+        pid_t                pid    = -1;
+        struct timespec      start  = { };
+        struct timespec      end    = { };
+        int                  status = 0;
+
+        fprintf(stream,
+                "# ts-sweep over %s%s, %zu points, %zu frames, "
+                "%zu runs each, %zu at a time\n",
+                SelfTestOption::name(spec_.channel),
+                impair_ ? " through ts-impair" : "",
+                point_.size(),
+                spec_.count,
+                spec_.repeat,
+                jobs_);
+        fprintf(stream,
+                "# %7s %10s %10s %10s %7s %8s %9s %12s %10s %11s %10s "
+                "%11s %10s %11s\n",
+                "PAD", "RATE", "DELAY(us)", "JITTER(us)", "LOSS(%)",
+                "REORD(%)", "OK/RUNS", "FRAMES/S", "+-95%",
+                "P50(ns)", "+-95%", "P99(ns)", "+-95%", "MAX(ns)");
+        fflush(stream);
+
+        board = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == board) {
+                throw runtime_error("Sweep::run() : mmap() failed");
+        }
+        next   = new (board) atomic<size_t>(0U);
+        shared = reinterpret_cast<SelfTestResult *>(
+                        static_cast<char *>(board) + offset);
+        /* A worker dying mid-run leaves its experiment as failed. */
+        std::memcpy(shared, result_.data(),
+                    result_.size() * sizeof(SelfTestResult));
+
+        /* Otherwise whatever is buffered is printed by every worker. */
+        fflush(NULL);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t slot = 0U; slot < jobs_; ++slot) {
+                if (0 == (pid = fork())) {
+                        try {
+                                work_(slot, next, shared);
+                        } catch (...) {
+                                _exit(EXIT_FAILURE);
+                        }
+                        _exit(EXIT_SUCCESS);
+                }
+                /* The workers already running take over its share. */
+                if (-1 == pid) {
+                        break;
+                }
+                worker.push_back(pid);
+        }
+        if (worker.empty()) {
+                work_(0U, next, shared);
+        }
+        for (auto job : worker) {
+                while (-1 == waitpid(job, NULL, 0) && EINTR == errno) {
+                }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        std::memcpy(result_.data(), shared,
+                    result_.size() * sizeof(SelfTestResult));
+        munmap(board, size);
+
+        for (size_t i = 0U; i < point_.size(); ++i) {
+                print_(stream, i);
+        }
+        for (auto &result : result_) {
+                if (SelfTestResult::Status::OK != result.status &&
+                    SelfTestResult::Status::SKIPPED != result.status) {
+                        status = -1;
+                }
+        }
+        fprintf(stream, "# finished in %.1f seconds\n",
+                static_cast<double>(end.tv_sec - start.tv_sec) +
+                static_cast<double>(end.tv_nsec - start.tv_nsec) / 1e9);
+        fflush(stream);
+        return status;
+}
+
+/*
+ * Body of one worker; 'slot' picks its CPU set, if there is one for it, and
+ * the results go to the shared 'result' rather than 'result_'.
+ */
+void Sweep::work_(size_t               slot,
+                  std::atomic<size_t> *next,
+                  SelfTestResult      *result) const
+{
+        const size_t   total  = result_.size();
+        SelfTestOption option;
+        size_t         task   = 0U;
+
+        option.channel   = spec_.channel;
+        option.count     = spec_.count;
+        option.impair    = impair_;
+        option.timestamp = spec_.timestamp;
+        if (slot < sets_) {
+                option.send_cpu  = spec_.cpus[slot * width_];
+                option.recv_cpu  = spec_.cpus[slot * width_ + 1U];
+                option.relay_cpu = impair_ ?
+                                   spec_.cpus[slot * width_ + 2U] : -1;
+        }
+        option.impairment.datagram = spec_.datagram;
+        option.impairment.rto_ns   = spec_.rto * 1000U;
+
+        while ((task = (*next)++) < total) {
+                const size_t  index = task % point_.size();
+                const size_t  run   = task / point_.size();
+                const Point_ &point = point_[index];
+
+                option.impairment.delay_ns  = point.delay * 1000U;
+                option.impairment.jitter_ns = point.jitter * 1000U;
+                option.impairment.loss      = point.loss / 100.0;
+                option.impairment.reorder   = point.reorder / 100.0;
+                /* Every run draws different losses. */
+                option.impairment.seed      = ImpairOption().seed ^
+                                              (task + 1U) *
+                                              0x9e3779b97f4a7c15ULL;
+
+                SelfTest self_test(option);
+
+                result[index * spec_.repeat + run] =
+                        self_test.run(point.pad, point.rate);
+        }
+}
+
+/* Mean and 95% confidence interval of the completed runs of one point. */
+void Sweep::print_(FILE *stream, size_t index) const
+{
+        const Point_ &point    = point_[index];
+        size_t        complete = 0U;
+        size_t        skipped  = 0U;
+        double        sum[4]   = { };
+        double        square[4] = { };
+        double        mean[4]  = { };
+        double        ci[4]    = { };
+
+        for (size_t run = 0U; run < spec_.repeat; ++run) {
+                const SelfTestResult &result =
+                        result_[index * spec_.repeat + run];
+                const double value[4] = {
+                        static_cast<double>(result.frames) /
+                        (result.elapsed > 0.0 ? result.elapsed : 1.0),
+                        static_cast<double>(result.p50),
+                        static_cast<double>(result.p99),
+                        static_cast<double>(result.max)
+                };
+
+                if (SelfTestResult::Status::SKIPPED == result.status) {
+                        ++skipped;
+                }
+                if (SelfTestResult::Status::OK != result.status) {
+                        continue;
+                }
+                ++complete;
+                for (size_t i = 0U; i < 4U; ++i) {
+                        sum[i]    += value[i];
+                        square[i] += value[i] * value[i];
+                }
+        }
+        for (size_t i = 0U; 0U != complete && i < 4U; ++i) {
+                const double n = static_cast<double>(complete);
+
+                mean[i] = sum[i] / n;
+                if (1U < complete) {
+                        /* Sample variance, clamped against rounding. */
+                        const double variance = (square[i] - n * mean[i] *
+                                                 mean[i]) / (n - 1.0);
+
+                        ci[i] = t95_(complete - 1U) *
+                                std::sqrt(variance > 0.0 ? variance : 0.0) /
+                                std::sqrt(n);
+                }
+        }
+
+        fprintf(stream,
+                "%9" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+                " %7.2f %8.2f %4zu/%-4zu %12.0f %10.0f %11.0f %10.0f "
+                "%11.0f %10.0f %11.0f%s\n",
+                point.pad, point.rate, point.delay, point.jitter,
+                point.loss, point.reorder, complete, spec_.repeat,
+                mean[0], ci[0], mean[1], ci[1], mean[2], ci[2], mean[3],
+                spec_.repeat == skipped ? " skipped" : "");
+}
+
+/* Two-sided 95% quantile of Student's t distribution. */
+double Sweep::t95_(size_t samples)
+{
+        static const double T95[] = {
+                12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+                2.262,  2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120,
+                2.110,  2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064,
+                2.060,  2.056, 2.052, 2.048, 2.045, 2.042
+        };
+
+        if (0U == samples) {
+                return 0.0;
+        }
+        return samples <= sizeof T95 / sizeof T95[0] ?
+               T95[samples - 1U] : 1.960;
+}
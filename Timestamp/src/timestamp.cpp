@@ -29,23 +29,69 @@
 
 #include "biowrapper.h"
 #include "cmnutil.h"
+#include "fdreader.h"
+#include "payload.h"
+#include "shmring.h"
+#include "spscring_tmp.h"
 #include "timestamp.h"
+#include "timestamp_tmp.h"
 
+#include <atomic>
 #include <cinttypes> /* strtoumax() */
 #include <climits>   /* SIZE_MAX */
 #include <cstdio>    /* fileno() */
-#include <cstring>   /* memset() */
+#include <cstring>   /* memcpy() memset() */
 #include <stdexcept> /* overflow_error runtime_error */
+#include <thread>
+#include <vector>
 
-TimeStamp::TimeStamp(size_t pad_size, FILE *input, FILE *output, FILE *log)
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <fcntl.h>    /* F_SETPIPE_SZ fcntl() pipe2() */
+#include <sys/socket.h> /* SOCK_DGRAM SO_TYPE getsockopt() */
+#include <sys/stat.h> /* fstat() */
+#include <unistd.h>   /* sysconf() */
+
+#ifdef __cplusplus
+}
+#endif
+
+TimeStamp::TimeStamp(size_t                 pad_size,
+                     FILE                  *input,
+                     FILE                  *output,
+                     FILE                  *log,
+                     const TimeStampOption &option)
         :
         pad_size_{pad_size},
         tot_size_{sizeof(Stamp_) + pad_size_},
+        pad_capacity_{pad_size_},
+        length_max_{pad_size_ > FRAME_LENGTH_MAX ? pad_size_ :
+                                                   FRAME_LENGTH_MAX},
         input_{input},
         output_{output},
         log_{log},
         stamp_{NULL},
-        bio_base64_{NULL}
+        bio_base64_{NULL},
+        fd_input_{NULL},
+        shm_input_{NULL},
+        base64_input_{NULL},
+        base64_codec_{NULL},
+        option_(option),
+        initial_{},
+        consumed_{0U},
+        lost_{0U},
+        delta_{},
+        jitter_{},
+        pipeline_{},
+        shm_{},
+        batch_{},
+        pace_start_{},
+        deadline_{},
+        timed_out_{false},
+        overrun_{false},
+        missing_{0U}
 {
         using std::overflow_error;
         using std::runtime_error;
@@ -70,12 +116,12 @@ TimeStamp::TimeStamp(size_t pad_size, FILE *input, FILE *output, FILE *log)
                 throw runtime_error("TimeStamp(): malloc() call failed");
         }
         /*
-         * Note the trailing padding field is intentially left un-initialized
-         * to prevent potential compression algorithms used by ssh from
-         * indirectly shortening the actual length of the message:
-         * that's also the reason malloc() is used instead of calloc().
+         * The trailing padding field only serves as the receive buffer of
+         * the base64 path; what the sender pads frames with is up to the
+         * PayloadGenerator selected by 'option_.payload'.
          */
         std::memset(stamp_, 0, sizeof(Stamp_));
+        stamp_->header.length = narrow_cast<uint32_t, size_t>(pad_size_);
 }
 
 TimeStamp::~TimeStamp()
@@ -86,54 +132,93 @@ TimeStamp::~TimeStamp()
 
 /*
  * Reveives timestamps 'count' times from 'input_' and record result to 'log_'.
+ * A run that times out (see 'option_.timeout') or meets a frame longer than
+ * it trusts counts the frames still missing as lost and ends with what it
+ * has.
  */
 TimeStamp &TimeStamp::operator << (const size_t count)
 {
         using std::runtime_error;
 
-        enum            {DELTA, NORMALIZED, TS_ARRAY_SIZE};
-        auto            casted_tot_size = narrow_cast<int, size_t>(tot_size_);
-        size_t           i          = 0U;
+        size_t           received   = 0U;
         FILE            *input_file = (NULL == input_) ? stdin : input_;
-        FILE            *log_file   = (NULL == log_) ? stdout : log_;
-        /* Used to store the initial timestamp received in this run. */
-        struct timespec  initial    = { };
-        struct timespec  current    = { };
-        BIOWrapper       bio_input(input_file, BIO_NOCLOSE);
-        struct timespec  ts_array[TS_ARRAY_SIZE] = { };
+        const bool       limited    = 0U != option_.timeout ||
+                                      0U != option_.idle_timeout;
+        const timespec  *deadline   = 0U == option_.timeout ?
+                                      NULL : &deadline_;
 
-        /* Build the chain of the form bio_base64_--bio_input. */
-        bio_base64_->push(bio_input);
+        deadline_  = cmnutil_deadline(option_.timeout);
+        timed_out_ = false;
+        overrun_   = false;
+        missing_   = 0U;
+        if (NULL != option_.shm) {
+                ShmRing ring(option_.shm,
+                             tot_size_,
+                             ShmRingRole::CONSUMER,
+                             option_.shm_spin);
 
-        for (i = 0U; i < count; ++i) {
-                if (casted_tot_size !=
-                    bio_base64_->read(stamp_, casted_tot_size)) {
-                        break;
+                if (limited) {
+                        ring.limit(option_.idle_timeout, deadline);
                 }
-                if (0U == i) {
-                        fprintf(log_file, "DELTA,NORMALIZED\n");
-                        initial = stamp_->timespec;
+                shm_input_  = &ring;
+                received    = option_.pipeline ? receive_pipeline_(count) :
+                                                 receive_serial_(count);
+                shm_input_  = NULL;
+                shm_.slots  = ring.slots();
+                shm_.sleeps = ring.sleeps();
+                timed_out_  = ring.timed_out();
+        } else if (option_.raw) {
+                /* Room for plenty of frames, but at least a whole one. */
+                FdReader reader(fileno(input_file),
+                                tot_size_ > (1U << 20) ? tot_size_ : 1U << 20);
+
+                if (limited) {
+                        reader.limit(option_.idle_timeout, deadline);
                 }
+                fd_input_  = &reader;
+                received   = option_.pipeline ? receive_pipeline_(count) :
+                                                receive_serial_(count);
+                fd_input_  = NULL;
+                timed_out_ = reader.timed_out();
+        } else if (limited) {
                 /*
-                 * clock_gettime() needs to be called after the read from
-                 * stdin due to the possibility of being blocked.
+                 * The base64 BIO loses its place once its source asks for a
+                 * retry, so a wait that can be cut short decodes the same
+                 * stream with the Base64Codec of the engine instead.
                  */
-                if (-1 == clock_gettime(CLOCK_REALTIME, &current)) {
-                        break;
-                }
+                FdTransport transport(fileno(input_file),
+                                      tot_size_ > (1U << 20) ?
+                                      tot_size_ : 1U << 20);
+                Base64Codec codec(tot_size_);
 
-                ts_array[DELTA] = timespec_diff_(&current, &stamp_->timespec);
-                ts_array[NORMALIZED] = timespec_diff_(&current, &initial);
+                transport.limit(option_.idle_timeout, deadline);
+                base64_input_ = &transport;
+                base64_codec_ = &codec;
+                received      = option_.pipeline ?
+                                receive_pipeline_(count) :
+                                receive_serial_(count);
+                base64_input_ = NULL;
+                base64_codec_ = NULL;
+                timed_out_    = transport.timed_out();
+                overrun_      = codec.overrun();
+        } else {
+                BIOWrapper bio_input(input_file, BIO_NOCLOSE);
 
-                if (-1 == log_dump_(ts_array, TS_ARRAY_SIZE)) {
-                        break;
-                }
+                /* Build the chain of the form bio_base64_--bio_input. */
+                bio_base64_->push(bio_input);
+                received = option_.pipeline ? receive_pipeline_(count) :
+                                              receive_serial_(count);
+                /* Removes the 'bio_input' from the chain. */
+                bio_input.pop();
         }
+        if (timed_out_ || overrun_) {
+                missing_  = count - received;
+                lost_    += missing_;
+                received  = count;
+        }
+        report_();
 
-        /* Removes the 'bio_input' from the chain. */
-        bio_input.pop();
-
-        if (count != i) {
+        if (count != received) {
                 throw runtime_error("TimeStamp::operator <<() : "
                                     "failed to receive required amount");
         }
@@ -145,32 +230,580 @@ TimeStamp &TimeStamp::operator >> (const size_t count)
 {
         using std::runtime_error;
 
-        auto       casted_tot_size  = narrow_cast<int, size_t>(tot_size_);
-        size_t     i                = 0U;
+        size_t     sent             = 0U;
         FILE      *output_file      = (NULL == output_) ? stdout : output_;
-        BIOWrapper bio_output(output_file, BIO_NOCLOSE);
+        /* Every frame of a pending batch needs a padding of its own. */
+        PayloadGenerator payload(option_.payload,
+                                 pad_size_,
+                                 option_.raw ? option_.batch : 1U);
 
-        bio_base64_->push(bio_output);
+        clock_gettime(CLOCK_MONOTONIC, &pace_start_);
+        if (NULL != option_.shm) {
+                sent = send_shm_(count, payload);
+        } else if (option_.raw && option_.splice) {
+                sent = send_splice_(fileno(output_file), count, payload);
+        } else if (option_.raw) {
+                sent = send_raw_(fileno(output_file), count, payload);
+        } else {
+                BIOWrapper bio_output(output_file, BIO_NOCLOSE);
+
+                bio_base64_->push(bio_output);
+                sent = send_base64_(count, payload);
+                bio_base64_->flush();
+                /* Removes the 'bio_output' from the chain. */
+                bio_output.pop();
+        }
+        report_send_();
+
+        if (count != sent) {
+                throw runtime_error("TimeStamp::operator >>() : "
+                                    "failed to send required amount");
+        }
+        return *this;
+}
+
+/*
+ * The stamp and its padding are written separately, which the base64 BIO
+ * encodes as one continuous stream.
+ */
+size_t TimeStamp::send_base64_(const size_t count, PayloadGenerator &payload)
+{
+        auto   casted_stamp_size = narrow_cast<int, size_t>(sizeof(Stamp_));
+        auto   casted_pad_size   = narrow_cast<int, size_t>(pad_size_);
+        size_t i                 = 0U;
 
         for (i = 0; i < count; ++i) {
-                if (-1 == clock_gettime(CLOCK_REALTIME, &(stamp_->timespec))) {
+                pace_(i);
+                stamp_->header.seq = i;
+                if (-1 == clock_gettime(option_.clock,
+                                        &stamp_->header.timespec)) {
                         break;
                 }
-                if (casted_tot_size !=
-                    bio_base64_->write(stamp_, casted_tot_size)) {
+                if (casted_stamp_size !=
+                    bio_base64_->write(stamp_, casted_stamp_size)) {
+                        break;
+                }
+                /* BIO_write() returns 0 rather than the length for 0. */
+                if (0 != casted_pad_size &&
+                    casted_pad_size !=
+                    bio_base64_->write(payload.next(), casted_pad_size)) {
                         break;
                 }
         }
+        return i;
+}
 
-        bio_base64_->flush();
-        /* Removes the 'bio_output' from the chain. */
-        bio_output.pop();
+/*
+ * Frames go straight to the descriptor without any user space buffering,
+ * 'option_.batch' of them per writev() at most: each one gets its own stamp
+ * as well as its own padding.
+ */
+size_t TimeStamp::send_raw_(int               fd,
+                            const size_t      count,
+                            PayloadGenerator &payload)
+{
+        using std::vector;
 
-        if (count != i) {
-                throw runtime_error("TimeStamp::operator >>() : "
-                                    "failed to send required amount");
+        auto             casted_tot_size = narrow_cast<ssize_t, size_t>(
+                                                tot_size_);
+        const size_t     batch           = 0U == option_.batch ?
+                                           1U : option_.batch;
+        const int64_t    batch_ns        = static_cast<int64_t>(
+                                                option_.batch_usec) * 1000;
+        /* Paced frames may otherwise wait a whole gap for a partial batch. */
+        const bool       bounded         = 0 != batch_ns &&
+                                           0U != option_.rate;
+        size_t           i               = 0U;
+        size_t           pending         = 0U;
+        uint64_t         due             = 0U;
+        /* When the oldest pending frame has to go, past 'pace_start_'. */
+        uint64_t         expiry          = 0U;
+        struct timespec  now             = { };
+        struct timespec  waited          = { };
+        struct timespec  oldest          = { };
+        vector<FrameHeader> stamps(batch, stamp_->header);
+        vector<iovec>    iov(2U * batch);
+        /* Writes out the 'pending' frames, all of them having left 'now'. */
+        auto             flush           = [&]() -> bool {
+                ssize_t  size = casted_tot_size *
+                                static_cast<ssize_t>(pending);
+
+                if (size != bseq_writev(fd,
+                                        iov.data(),
+                                        static_cast<int>(2U * pending))) {
+                        return false;
+                }
+                for (size_t j = 0U; j < pending; ++j) {
+                        waited = timestamp_diff(&now,
+                                                &stamps[j].timespec);
+                        batch_.hold.record(
+                                static_cast<int64_t>(waited.tv_sec) *
+                                1000000000 + waited.tv_nsec);
+                }
+                batch_.frames += pending;
+                ++batch_.writes;
+                pending        = 0U;
+                return true;
+        };
+
+        for (i = 0; i < count; ++i) {
+                /* Due as timestamp_pace() has it, see 'option_.rate'. */
+                due = bounded ? static_cast<uint64_t>(
+                                static_cast<double>(i) * 1e9 /
+                                static_cast<double>(option_.rate)) : 0U;
+                if (bounded && 0U != pending && expiry < due) {
+                        timestamp_sleep_until(pace_start_, expiry);
+                        if (-1 == clock_gettime(option_.clock, &now) ||
+                            !flush()) {
+                                return batch_.frames;
+                        }
+                }
+                pace_(i);
+                stamps[pending].seq = i;
+                if (-1 == clock_gettime(option_.clock,
+                                        &stamps[pending].timespec)) {
+                        break;
+                }
+                iov[2U * pending].iov_base      = &stamps[pending];
+                iov[2U * pending].iov_len       = sizeof(Stamp_);
+                iov[2U * pending + 1U].iov_base = const_cast<char *>(
+                                                        payload.next());
+                iov[2U * pending + 1U].iov_len  = pad_size_;
+                if (bounded && 0U == pending) {
+                        clock_gettime(CLOCK_MONOTONIC, &oldest);
+                        oldest = timestamp_diff(&oldest, &pace_start_);
+                        expiry = static_cast<uint64_t>(oldest.tv_sec) *
+                                 1000000000U +
+                                 static_cast<uint64_t>(oldest.tv_nsec) +
+                                 static_cast<uint64_t>(batch_ns);
+                }
+                now    = stamps[pending++].timespec;
+                waited = timestamp_diff(&now, &stamps[0].timespec);
+
+                if (pending < batch &&
+                    (0 == batch_ns ||
+                     static_cast<int64_t>(waited.tv_sec) * 1000000000 +
+                     waited.tv_nsec < batch_ns)) {
+                        continue;
+                }
+                if (!flush()) {
+                        return batch_.frames;
+                }
         }
-        return *this;
+
+        /* Whatever is left over when the loop ends goes out in one piece. */
+        if (0U != pending) {
+                clock_gettime(option_.clock, &now);
+                flush();
+        }
+        return batch_.frames;
+}
+
+/*
+ * Only the stamp is copied for each frame: the padding is allocated once by
+ * 'payload', and its pages are handed to the kernel by reference with
+ * vmsplice().  They must thus never change afterwards, which rules out the
+ * modes refreshing the padding.  A pipe takes the pages directly; a socket
+ * gets them through a private pipe and splice(), which would cut each frame
+ * in two datagrams on a datagram socket, so those are refused.  Anything
+ * else falls back to send_raw_().
+ */
+size_t TimeStamp::send_splice_(int               fd,
+                               const size_t      count,
+                               PayloadGenerator &payload)
+{
+        using std::invalid_argument;
+
+        const size_t    page     = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t    pipe_size = (pad_size_ + page) / page * page;
+        auto            casted_stamp_size = narrow_cast<ssize_t, size_t>(
+                                                sizeof(Stamp_));
+        auto            casted_pad_size   = narrow_cast<ssize_t, size_t>(
+                                                pad_size_);
+        size_t          i        = 0U;
+        size_t          chunk    = 0U;
+        size_t          moved    = 0U;
+        int             relay[2] = {-1, -1};
+        const char     *padding  = NULL;
+        int             type     = 0;
+        socklen_t       length   = sizeof(type);
+        struct stat     info     = { };
+
+        if (-1 == fstat(fd, &info)) {
+                return 0U;
+        }
+        if (!S_ISFIFO(info.st_mode) && !S_ISSOCK(info.st_mode)) {
+                return send_raw_(fd, count, payload);
+        }
+        if (PayloadMode::RANDOM == option_.payload ||
+            PayloadMode::SLIDING == option_.payload) {
+                throw invalid_argument("TimeStamp::send_splice_() : "
+                                       "--splice needs a fixed padding");
+        }
+        if (S_ISSOCK(info.st_mode) &&
+            (-1 == getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &length) ||
+             SOCK_STREAM != type)) {
+                throw invalid_argument("TimeStamp::send_splice_() : "
+                                       "--splice needs a stream socket");
+        }
+
+        /*
+         * The relay pipe is drained right after each fill, so one chunk
+         * must never exceed its capacity or vmsplice() would block forever.
+         */
+        if (S_ISSOCK(info.st_mode)) {
+                if (-1 == pipe2(relay, O_CLOEXEC)) {
+                        return 0U;
+                }
+                fcntl(relay[1], F_SETPIPE_SZ, static_cast<int>(pipe_size));
+                chunk = static_cast<size_t>(fcntl(relay[1], F_GETPIPE_SZ));
+        }
+
+        for (i = 0U; i < count; ++i) {
+                pace_(i);
+                stamp_->header.seq = i;
+                if (-1 == clock_gettime(option_.clock,
+                                        &stamp_->header.timespec)) {
+                        break;
+                }
+                if (casted_stamp_size !=
+                    bseq_write(fd, stamp_, sizeof(Stamp_))) {
+                        break;
+                }
+                padding = payload.next();
+                if (-1 == relay[0] &&
+                    casted_pad_size != bseq_vmsplice(fd, padding, pad_size_)) {
+                        break;
+                }
+                for (moved = -1 == relay[0] ? pad_size_ : 0U;
+                     moved < pad_size_;
+                     moved += chunk) {
+                        size_t len = pad_size_ - moved < chunk ?
+                                     pad_size_ - moved : chunk;
+
+                        if (static_cast<ssize_t>(len) !=
+                            bseq_vmsplice(relay[1], padding + moved, len) ||
+                            static_cast<ssize_t>(len) !=
+                            bseq_splice(relay[0], fd, len)) {
+                                break;
+                        }
+                }
+                if (moved < pad_size_) {
+                        break;
+                }
+                /* Every frame leaves as soon as it is stamped. */
+                batch_.hold.record(0);
+                ++batch_.frames;
+                ++batch_.writes;
+        }
+
+        if (-1 != relay[0]) {
+                close(relay[0]);
+                close(relay[1]);
+        }
+        return i;
+}
+
+/*
+ * Each frame is stamped before waiting for a free slot, so a full ring
+ * shows up in the latency just like a full pipe does on the other paths.
+ */
+size_t TimeStamp::send_shm_(const size_t count, PayloadGenerator &payload)
+{
+        ShmRing  ring(option_.shm,
+                      tot_size_,
+                      ShmRingRole::PRODUCER,
+                      option_.shm_spin);
+        char    *slot = NULL;
+        size_t   i    = 0U;
+
+        for (i = 0U; i < count; ++i) {
+                pace_(i);
+                stamp_->header.seq = i;
+                if (-1 == clock_gettime(option_.clock,
+                                        &stamp_->header.timespec)) {
+                        break;
+                }
+                if (NULL == (slot = reinterpret_cast<char *>(
+                                        ring.reserve()))) {
+                        break;
+                }
+                std::memcpy(slot, &stamp_->header, sizeof(Stamp_));
+                std::memcpy(slot + sizeof(Stamp_), payload.next(), pad_size_);
+                ring.commit();
+        }
+        return i;
+}
+
+/* Reads one frame and stamps its arrival; false on error or end of input. */
+bool TimeStamp::read_sample_(Sample_ *sample)
+{
+        FrameHeader  header = { };
+        const void  *data   = NULL;
+
+        if (NULL != shm_input_) {
+                if (NULL == (data = shm_input_->acquire())) {
+                        return false;
+                }
+                /* The padding is never looked at, so it is left in place. */
+                std::memcpy(&header, data, sizeof header);
+                shm_input_->release();
+        } else if (NULL != fd_input_) {
+                if (NULL == (data = fd_input_->next(sizeof header))) {
+                        return false;
+                }
+                /* Frames are packed back to back, so it may be unaligned. */
+                std::memcpy(&header, data, sizeof header);
+                if (header.length > length_max_) {
+                        overrun_ = true;
+                        return false;
+                }
+                if (0U != header.length &&
+                    NULL == fd_input_->next(header.length)) {
+                        return false;
+                }
+        } else if (NULL != base64_codec_) {
+                /* Bounds 'length' by 'length_max_' as well, see overrun(). */
+                if (!base64_codec_->decode(*base64_input_, &header)) {
+                        return false;
+                }
+        } else {
+                if (!bio_read_full_(&stamp_->header, sizeof header)) {
+                        return false;
+                }
+                header = stamp_->header;
+                if (header.length > length_max_) {
+                        overrun_ = true;
+                        return false;
+                }
+                if (header.length > pad_capacity_ &&
+                    -1 == pad_reserve_(header.length)) {
+                        return false;
+                }
+                if (!bio_read_full_(stamp_->padding, header.length)) {
+                        return false;
+                }
+        }
+        /*
+         * clock_gettime() needs to be called after the read from
+         * stdin due to the possibility of being blocked.
+         */
+        if (-1 == clock_gettime(option_.clock, &sample->received)) {
+                return false;
+        }
+        sample->seq   = header.seq;
+        sample->sent  = header.timespec;
+        sample->flags = header.flags;
+        return true;
+}
+
+/* BIO_read() may return short, so loop until all of 'len' is there. */
+bool TimeStamp::bio_read_full_(void *data, size_t len)
+{
+        char   *buffer = reinterpret_cast<char *>(data);
+        int     breach = 0;
+
+        while (0U != len) {
+                breach = bio_base64_->read(buffer,
+                                           narrow_cast<int, size_t>(len));
+                if (0 >= breach) {
+                        return false;
+                }
+                buffer += breach;
+                len    -= static_cast<size_t>(breach);
+        }
+        return true;
+}
+
+/* Grows the receive buffer of the base64 path for frames of 'len' padding. */
+int TimeStamp::pad_reserve_(size_t len)
+{
+        void *memory = NULL;
+
+        if (len > length_max_) {
+                return -1;
+        }
+        if (NULL == (memory = std::realloc(stamp_, sizeof(Stamp_) + len))) {
+                return -1;
+        }
+        stamp_        = reinterpret_cast<Stamp_ *>(memory);
+        pad_capacity_ = len;
+        return 0;
+}
+
+/* Everything done to a sample after it is read: statistics and the log. */
+int TimeStamp::consume_(const Sample_ &sample)
+{
+        enum            {DELTA, NORMALIZED, TS_ARRAY_SIZE};
+        FILE            *log_file   = (NULL == log_) ? stdout : log_;
+        struct timespec  ts_array[TS_ARRAY_SIZE] = { };
+        int64_t          transit    = 0;
+
+        if (0U == consumed_++ && option_.log) {
+                fprintf(log_file, "DELTA,NORMALIZED\n");
+        }
+        /* A frame dropped by a relay only counts, there is nothing to log. */
+        if (0U != (sample.flags & FRAME_FLAG_LOST)) {
+                ++lost_;
+                return 0;
+        }
+        if (0U == delta_.count()) {
+                initial_ = sample.sent;
+        }
+
+        ts_array[DELTA] = timestamp_diff(&sample.received, &sample.sent);
+        ts_array[NORMALIZED] = timestamp_diff(&sample.received, &initial_);
+        transit = static_cast<int64_t>(ts_array[DELTA].tv_sec) *
+                  1000000000 + ts_array[DELTA].tv_nsec;
+        delta_.record(transit);
+        jitter_.record(sample.received, transit);
+
+        return option_.log ?
+               timestamp_log_dump(log_file, ts_array, TS_ARRAY_SIZE) : 0;
+}
+
+size_t TimeStamp::receive_serial_(const size_t count)
+{
+        Sample_ sample = { };
+        size_t  i      = 0U;
+
+        for (i = 0U; i < count; ++i) {
+                if (!read_sample_(&sample) || -1 == consume_(sample)) {
+                        break;
+                }
+        }
+        return i;
+}
+
+/*
+ * The calling thread only reads and stamps; a consumer thread drains the ring
+ * so a stalled log never delays the next read.  If the ring fills up the
+ * reader yields until a slot frees, and the event as well as the time lost
+ * is accounted for in 'pipeline_'.
+ */
+size_t TimeStamp::receive_pipeline_(const size_t count)
+{
+        SPSCRing<Sample_>   ring(option_.ring_size);
+        std::atomic<bool>   done{false};
+        std::atomic<bool>   failed{false};
+        size_t              consumed = 0U;
+        Sample_             sample   = { };
+        struct timespec     begin    = { };
+        struct timespec     end      = { };
+        std::thread         consumer([&]() {
+                Sample_ record = { };
+
+                for (;;) {
+                        if (!ring.pop(record)) {
+                                /* Re-check after 'done' to drain leftovers. */
+                                if (!done.load(std::memory_order_acquire)) {
+                                        std::this_thread::yield();
+                                        continue;
+                                }
+                                if (!ring.pop(record)) {
+                                        break;
+                                }
+                        }
+                        if (-1 == consume_(record)) {
+                                failed.store(true, std::memory_order_release);
+                                break;
+                        }
+                        ++consumed;
+                }
+        });
+
+        for (size_t i = 0U; i < count; ++i) {
+                if (failed.load(std::memory_order_relaxed) ||
+                    !read_sample_(&sample)) {
+                        break;
+                }
+                if (ring.push(sample)) {
+                        continue;
+                }
+
+                ++pipeline_.full;
+                clock_gettime(CLOCK_MONOTONIC, &begin);
+                while (!ring.push(sample)) {
+                        if (failed.load(std::memory_order_relaxed)) {
+                                break;
+                        }
+                        std::this_thread::yield();
+                }
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                end = timestamp_diff(&end, &begin);
+                pipeline_.stall_ns += static_cast<uint64_t>(end.tv_sec) *
+                                      1000000000U + end.tv_nsec;
+        }
+
+        done.store(true, std::memory_order_release);
+        consumer.join();
+        return consumed;
+}
+
+/* See 'option_.rate'. */
+void TimeStamp::pace_(const size_t i) const
+{
+        if (0U != option_.rate) {
+                timestamp_pace(pace_start_, option_.rate, i);
+        }
+}
+
+/* Prints a summary of the run to 'option_.stats' as "key value" lines. */
+void TimeStamp::report_() const
+{
+        FILE *stats = option_.stats;
+
+        if (NULL == stats) {
+                return;
+        }
+        timestamp_report(stats, delta_, lost_, "receiver",
+                         option_.calibration);
+        timestamp_report_jitter(stats, jitter_);
+        if (0U != option_.timeout || 0U != option_.idle_timeout ||
+            overrun_) {
+                fprintf(stats, "%-24s %" PRIu64 "\n", "frames.missing",
+                        missing_);
+        }
+        if (option_.pipeline) {
+                fprintf(stats, "%-24s %zu\n",         "pipeline.ring",
+                        option_.ring_size);
+                fprintf(stats, "%-24s %" PRIu64 "\n", "pipeline.full",
+                        pipeline_.full);
+                fprintf(stats, "%-24s %" PRIu64 "\n", "pipeline.stall",
+                        pipeline_.stall_ns);
+        }
+        if (NULL != option_.shm) {
+                fprintf(stats, "%-24s %zu\n",         "shm.slots",
+                        shm_.slots);
+                fprintf(stats, "%-24s %" PRIu64 "\n", "shm.sleeps",
+                        shm_.sleeps);
+        }
+        fflush(stats);
+}
+
+/* Sender counterpart of report_(); only the raw path coalesces frames. */
+void TimeStamp::report_send_() const
+{
+        FILE *stats = option_.stats;
+
+        if (NULL == stats || !option_.raw) {
+                return;
+        }
+        fprintf(stats, "# ts sender summary, latencies in nanoseconds\n");
+        fprintf(stats, "%-24s %" PRIu64 "\n", "frames", batch_.frames);
+        fprintf(stats, "%-24s %" PRIu64 "\n", "writes", batch_.writes);
+        fprintf(stats, "%-24s %.2f\n",        "frames.per.write",
+                0U == batch_.writes ? 0.0 :
+                static_cast<double>(batch_.frames) /
+                static_cast<double>(batch_.writes));
+        fprintf(stats, "%-24s %.0f\n",        "hold.mean",
+                batch_.hold.mean());
+        fprintf(stats, "%-24s %" PRId64 "\n", "hold.p50",
+                batch_.hold.percentile(0.50));
+        fprintf(stats, "%-24s %" PRId64 "\n", "hold.p99",
+                batch_.hold.percentile(0.99));
+        fprintf(stats, "%-24s %" PRId64 "\n", "hold.max", batch_.hold.max());
+        fflush(stats);
 }
 
 /* Can only be called in constructor or destructor. */
@@ -206,58 +839,3 @@ void TimeStamp::io_control_(LogSwitch_ flip)
                 bio_base64_ = new BIOWrapper(BIOWrapper::f_base64());
         }
 }
-
-int TimeStamp::log_dump_(const timespec timespec_array[], const size_t size)
-{
-        /* Temporary buffer used for localtime_r() call. */
-        struct tm        tmp_tm           = { };
-        char             tmp_sec[1 << 13] = { };
-        char            *endptr           = NULL;
-        intmax_t         sec              = 0;
-        intmax_t         result           = 0;
-        FILE            *log_file         = (NULL == log_) ? stdout : log_;
-
-        for (size_t i = 0; i < size; ++i) {
-                if (NULL == localtime_r(&(timespec_array[i].tv_sec), &tmp_tm)){
-                        return -1;
-                }
-                if (0 == strftime(tmp_sec, sizeof tmp_sec, "%s", &tmp_tm)) {
-                        return -1;
-                }
-
-                endptr = NULL;
-                errno  = 0;
-                sec    = strtoimax(tmp_sec, &endptr, 10);
-                if (INTMAX_MAX == sec && ERANGE == errno) {
-                        return -1;
-                }
-                if (0 == sec && endptr == tmp_sec) {
-                        return -1;
-                }
-                /* Result is in milliseconds. */
-                result = 1000 * sec + timespec_array[i].tv_nsec / 1000000;
-                fprintf(log_file, "%" PRIdMAX "%s",
-                        result,
-                        size == i + 1 ? "\n" : ",");
-        }
-        fflush(log_file);
-        return 0;
-}
-
-/*
- * Modified from the example from:
- * http://www.guyrutenberg.com/2007/09/22/profiling-code-using-clock_gettime/
- */
-timespec TimeStamp::timespec_diff_(const timespec *end, const timespec *start)
-{
-        struct timespec result;
-
-        if (0 > (end->tv_nsec - start->tv_nsec)) {
-                result.tv_sec = end->tv_sec - start->tv_sec - 1;
-                result.tv_nsec = 1000000000 + end->tv_nsec - start->tv_nsec;
-        } else {
-                result.tv_sec = end->tv_sec - start->tv_sec;
-                result.tv_nsec = end->tv_nsec - start->tv_nsec;
-        }
-        return result;
-}
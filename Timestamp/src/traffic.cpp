@@ -0,0 +1,384 @@
+/**
+ * @file traffic.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation source file of the TrafficModel class.
+ * Every distribution is drawn by inverting its distribution function (or
+ * by Box-Muller for the normal one) from a private xorshift128+ stream
+ * rather than through <random>, whose distributions may differ from one
+ * standard library to the next, so a seed names the same departures
+ * wherever ts was built; which is what lets the receiver regenerate them.
+ */
+
+#include "frame.h"
+#include "traffic.h"
+
+#include <cerrno>    /* errno */
+#include <cmath>     /* exp() isfinite() isnan() llround() log() pow() */
+#include <cstdlib>   /* strtod() */
+#include <cstring>   /* strncmp() */
+#include <stdexcept> /* runtime_error */
+
+/* Departures drawn ahead at a time, 16 MiB worth of records. */
+#define TRAFFIC_CHUNK (1U << 20)
+/* Largest frame of a size model; the length field is 32 bits wide. */
+#define TRAFFIC_FRAME_MAX (1U << 30)
+
+/* splitmix64, as in payload.cpp, spreads the seed over the state. */
+static uint64_t traffic_mix(uint64_t *state)
+{
+        uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+}
+
+/*
+ * Reads exactly 'count' comma separated finite, non-negative numbers from
+ * 'text' into 'value'; false if there are more, fewer or malformed ones.
+ */
+static bool traffic_numbers(const char *text, double *value, size_t count)
+{
+        char *endptr = NULL;
+
+        for (size_t i = 0U; i < count; ++i) {
+                errno    = 0;
+                value[i] = std::strtod(text, &endptr);
+                if (ERANGE == errno || endptr == text ||
+                    !std::isfinite(value[i]) || 0.0 > value[i] ||
+                    (i + 1U < count ? ',' : '\0') != *endptr) {
+                        return false;
+                }
+                text = endptr + 1;
+        }
+        return true;
+}
+
+TrafficSpec::TrafficSpec()
+        :
+        arrival{ArrivalModel::CONSTANT},
+        rate{0.0},
+        on_usec{0.0},
+        off_usec{0.0},
+        size{SizeModel::FIXED},
+        shape{0.0},
+        low{0.0},
+        high{0.0},
+        seed{1U}
+{
+}
+
+bool TrafficSpec::active() const
+{
+        return ArrivalModel::CONSTANT != arrival || SizeModel::FIXED != size;
+}
+
+TrafficModel::TrafficModel(const TrafficSpec &spec, size_t pad, size_t count)
+        :
+        spec_(spec),
+        pad_{pad},
+        count_{count},
+        max_pad_{pad},
+        drawn_{0U},
+        buffer_(count < TRAFFIC_CHUNK ? count : TRAFFIC_CHUNK),
+        cursor_{0U},
+        filled_{0U},
+        elapsed_{0.0},
+        planned_{0U},
+        s0_{0U},
+        s1_{0U},
+        on_{true},
+        left_{0.0},
+        spare_{NAN}
+{
+        using std::runtime_error;
+
+        const double header = static_cast<double>(sizeof(FrameHeader));
+
+        if (0U == count_) {
+                throw runtime_error("TrafficModel(): no departures asked for");
+        }
+        if (ArrivalModel::CONSTANT != spec_.arrival && 0.0 >= spec_.rate) {
+                throw runtime_error("TrafficModel(): rate has to be "
+                                    "positive");
+        }
+        if (ArrivalModel::ONOFF == spec_.arrival &&
+            (0.0 >= spec_.on_usec || 0.0 >= spec_.off_usec)) {
+                throw runtime_error("TrafficModel(): on and off periods "
+                                    "have to be positive");
+        }
+        switch (spec_.size) {
+        case SizeModel::PARETO:
+                if (0.0 >= spec_.shape || header > spec_.low ||
+                    spec_.low >= spec_.high) {
+                        throw runtime_error("TrafficModel(): Pareto sizes "
+                                            "need a positive shape and "
+                                            "32 <= MIN < MAX");
+                }
+                break;
+        case SizeModel::LOGNORMAL:
+                if (0.0 >= spec_.shape || header > spec_.low ||
+                    spec_.low > spec_.high) {
+                        throw runtime_error("TrafficModel(): lognormal "
+                                            "sizes need a positive sigma "
+                                            "and 32 <= MEDIAN <= MAX");
+                }
+                break;
+        case SizeModel::FIXED:
+                break;
+        }
+        if (SizeModel::FIXED != spec_.size) {
+                if (spec_.high > TRAFFIC_FRAME_MAX) {
+                        throw runtime_error("TrafficModel(): largest frame "
+                                            "exceeds maximum");
+                }
+                max_pad_ = static_cast<size_t>(spec_.high) -
+                           sizeof(FrameHeader);
+        }
+        seed_();
+        fill_();
+}
+
+bool TrafficModel::next(uint64_t *interval, size_t *pad)
+{
+        if (cursor_ == filled_) {
+                if (drawn_ == count_) {
+                        return false;
+                }
+                fill_();
+        }
+        *interval = buffer_[cursor_].interval;
+        *pad      = buffer_[cursor_].pad;
+        ++cursor_;
+        return true;
+}
+
+void TrafficModel::rewind()
+{
+        seed_();
+        fill_();
+}
+
+size_t TrafficModel::count() const
+{
+        return count_;
+}
+
+size_t TrafficModel::max_pad() const
+{
+        return max_pad_;
+}
+
+double TrafficModel::mean_interval() const
+{
+        switch (spec_.arrival) {
+        case ArrivalModel::POISSON:
+                return 1e9 / spec_.rate;
+        case ArrivalModel::ONOFF:
+                return 1e9 / spec_.rate *
+                       (spec_.on_usec + spec_.off_usec) / spec_.on_usec;
+        case ArrivalModel::CONSTANT:
+        default:
+                return 0.0 < spec_.rate ? 1e9 / spec_.rate : 0.0;
+        }
+}
+
+bool TrafficModel::parse_arrival(const char *text, TrafficSpec *spec)
+{
+        using std::strncmp;
+
+        double value[3] = { };
+
+        if (0 == strncmp("poisson:", text, 8U) &&
+            traffic_numbers(text + 8, value, 1U)) {
+                spec->arrival = ArrivalModel::POISSON;
+                spec->rate    = value[0];
+                return true;
+        }
+        if (0 == strncmp("onoff:", text, 6U) &&
+            traffic_numbers(text + 6, value, 3U)) {
+                spec->arrival  = ArrivalModel::ONOFF;
+                spec->rate     = value[0];
+                spec->on_usec  = value[1];
+                spec->off_usec = value[2];
+                return true;
+        }
+        return false;
+}
+
+bool TrafficModel::parse_size(const char *text, TrafficSpec *spec)
+{
+        using std::strncmp;
+
+        double value[3] = { };
+
+        if (0 == strncmp("pareto:", text, 7U) &&
+            traffic_numbers(text + 7, value, 3U)) {
+                spec->size  = SizeModel::PARETO;
+                spec->shape = value[0];
+                spec->low   = value[1];
+                spec->high  = value[2];
+                return true;
+        }
+        if (0 == strncmp("lognormal:", text, 10U) &&
+            traffic_numbers(text + 10, value, 3U)) {
+                spec->size  = SizeModel::LOGNORMAL;
+                spec->low   = value[0];
+                spec->shape = value[1];
+                spec->high  = value[2];
+                return true;
+        }
+        return false;
+}
+
+/* Draws the next chunk of departures into the buffer. */
+void TrafficModel::fill_()
+{
+        uint64_t due = 0U;
+
+        filled_ = count_ - drawn_ < buffer_.size() ?
+                  count_ - drawn_ : buffer_.size();
+        for (size_t i = 0U; i < filled_; ++i) {
+                elapsed_           += gap_();
+                due                 = static_cast<uint64_t>(
+                                              std::llround(elapsed_));
+                buffer_[i].interval = due - planned_;
+                buffer_[i].pad      = pad_of_();
+                planned_            = due;
+        }
+        drawn_  += filled_;
+        cursor_  = 0U;
+}
+
+void TrafficModel::seed_()
+{
+        uint64_t state = spec_.seed;
+
+        s0_ = traffic_mix(&state);
+        s1_ = traffic_mix(&state);
+        if (0U == (s0_ | s1_)) {
+                s1_ = 1U;
+        }
+        drawn_   = 0U;
+        elapsed_ = 0.0;
+        planned_ = 0U;
+        spare_   = NAN;
+        on_      = true;
+        left_    = ArrivalModel::ONOFF == spec_.arrival ?
+                   exponential_(spec_.on_usec * 1e3) : 0.0;
+}
+
+/* Uniform over (0, 1], so that its logarithm is always finite. */
+double TrafficModel::uniform_()
+{
+        uint64_t       s1 = s0_;
+        const uint64_t s0 = s1_;
+
+        s0_  = s0;
+        s1  ^= s1 << 23;
+        s1_  = s1 ^ s0 ^ (s1 >> 17) ^ (s0 >> 26);
+        return static_cast<double>(((s1_ + s0) >> 11) + 1U) /
+               9007199254740992.0;
+}
+
+double TrafficModel::exponential_(double mean)
+{
+        return -mean * std::log(uniform_());
+}
+
+double TrafficModel::normal_()
+{
+        const double pi     = 3.14159265358979323846;
+        double       radius = 0.0;
+        double       angle  = 0.0;
+        double       value  = spare_;
+
+        if (!std::isnan(value)) {
+                spare_ = NAN;
+                return value;
+        }
+        radius = std::sqrt(-2.0 * std::log(uniform_()));
+        angle  = 2.0 * pi * uniform_();
+        spare_ = radius * std::sin(angle);
+        return radius * std::cos(angle);
+}
+
+/* Nanoseconds from the last departure to the next one. */
+double TrafficModel::gap_()
+{
+        double gap  = 0.0;
+        double draw = 0.0;
+
+        switch (spec_.arrival) {
+        case ArrivalModel::POISSON:
+                return exponential_(1e9 / spec_.rate);
+        case ArrivalModel::ONOFF:
+                /*
+                 * Both the gaps and the periods are memoryless, so a gap
+                 * that outlasts the on period is simply drawn anew once the
+                 * next one begins.
+                 */
+                for (;;) {
+                        draw = exponential_(1e9 / spec_.rate);
+                        if (draw <= left_) {
+                                left_ -= draw;
+                                return gap + draw;
+                        }
+                        gap  += left_ + exponential_(spec_.off_usec * 1e3);
+                        left_ = exponential_(spec_.on_usec * 1e3);
+                }
+        case ArrivalModel::CONSTANT:
+        default:
+                return 0.0 < spec_.rate ? 1e9 / spec_.rate : 0.0;
+        }
+}
+
+/* Padding of the next frame, its size drawn from the size model. */
+size_t TrafficModel::pad_of_()
+{
+        const double header = static_cast<double>(sizeof(FrameHeader));
+        double       frame  = 0.0;
+        size_t       bytes  = 0U;
+
+        switch (spec_.size) {
+        case SizeModel::PARETO:
+                /* The inverse of the Pareto distribution cut at 'high'. */
+                frame = spec_.low *
+                        std::pow(1.0 - uniform_() *
+                                 (1.0 - std::pow(spec_.low / spec_.high,
+                                                 spec_.shape)),
+                                 -1.0 / spec_.shape);
+                break;
+        case SizeModel::LOGNORMAL:
+                frame = spec_.low * std::exp(spec_.shape * normal_());
+                break;
+        case SizeModel::FIXED:
+        default:
+                return pad_;
+        }
+        /* The odd lognormal outlier is clamped rather than drawn again. */
+        frame = frame < header ? header :
+                frame > spec_.high ? spec_.high : frame;
+        bytes = static_cast<size_t>(frame + 0.5) - sizeof(FrameHeader);
+        return bytes > max_pad_ ? max_pad_ : bytes;
+}
@@ -55,13 +55,122 @@ int main(int argc, char *argv[])
          */
 #define RECEIVER    'r'
 #define SENDER      's'
+#define SELF_TEST   OPT_SELF_TEST
+#define CALIBRATE   OPT_CALIBRATE
+#define DUPLEX      OPT_DUPLEX
+#define DAEMON      OPT_DAEMON
 #define UNSPECIFIED  0
-        Argument    argument       = {0U, 0U, NULL};
+        Argument    argument       = {
+                0U, 0U, NULL, NULL, TrafficSpec(), TimeStampOption(),
+                SelfTestOption(), 0U, 0U, 0U, 7U, NULL
+        };
         int         operating_mode = UNSPECIFIED;
         FILE       *user_log       = NULL;
 
         argument = argument_parse(&operating_mode, argc, argv);
 
+        if (SELF_TEST == operating_mode) {
+                SelfTest self_test(argument.self_test);
+
+                return -1 == self_test.sweep(stdout) ?
+                       EXIT_FAILURE : EXIT_SUCCESS;
+        }
+        if (DAEMON == operating_mode) {
+                TimeStampDaemon daemon(argument.socket, argument.option);
+
+                timestamp_signal_install();
+                return -1 == daemon.serve() ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+        if (CALIBRATE == operating_mode) {
+                timestamp_engine_calibrate(argument.block,
+                                           argument.count,
+                                           stdout,
+                                           argument.option);
+                return EXIT_SUCCESS;
+        }
+
+        if (argument.option.engine &&
+            timestamp_engine_supports(argument.option)) {
+                if (argument.option.stream) {
+                        timestamp_signal_install();
+                        alarm(argument.duration);
+                }
+                switch (operating_mode) {
+                case DUPLEX:
+                        /* Stdout carries the frames, so only --no-log. */
+                        if (NULL == argument.env_output_file) {
+                                LogFile log(stderr);
+
+                                timestamp_engine_duplex(argument.block,
+                                                        argument.count,
+                                                        STDIN_FILENO,
+                                                        STDOUT_FILENO,
+                                                        log,
+                                                        argument.option);
+                                break;
+                        }
+                        {
+                                LogFile log(argument.env_output_file,
+                                            argument.rotate_bytes,
+                                            argument.rotate_seconds,
+                                            argument.rotate_keep);
+
+                                timestamp_engine_duplex(argument.block,
+                                                        argument.count,
+                                                        STDIN_FILENO,
+                                                        STDOUT_FILENO,
+                                                        log,
+                                                        argument.option);
+                        }
+                        break;
+                case RECEIVER:
+                        if (NULL == argument.env_output_file) {
+                                timestamp_engine_receive(argument.block,
+                                                         argument.count,
+                                                         STDIN_FILENO,
+                                                         stdout,
+                                                         argument.option,
+                                                         &argument.traffic);
+                                break;
+                        }
+                        {
+                                LogFile log(argument.env_output_file,
+                                            argument.rotate_bytes,
+                                            argument.rotate_seconds,
+                                            argument.rotate_keep);
+
+                                timestamp_engine_receive(argument.block,
+                                                         argument.count,
+                                                         STDIN_FILENO,
+                                                         log,
+                                                         argument.option,
+                                                         &argument.traffic);
+                        }
+                        break;
+                case SENDER:
+                        if (NULL != argument.schedule) {
+                                timestamp_engine_replay(argument.schedule,
+                                                        argument.count,
+                                                        STDOUT_FILENO,
+                                                        argument.option);
+                                break;
+                        }
+                        if (argument.traffic.active()) {
+                                timestamp_engine_model(argument.traffic,
+                                                       argument.block,
+                                                       argument.count,
+                                                       STDOUT_FILENO,
+                                                       argument.option);
+                                break;
+                        }
+                        timestamp_engine_send(argument.block,
+                                              argument.count,
+                                              STDOUT_FILENO,
+                                              argument.option);
+                }
+                return EXIT_SUCCESS;
+        }
+
         if (NULL != argument.env_output_file) {
                 /*
                  * Note the return value of fopen() is not checked:
@@ -75,7 +184,11 @@ int main(int argc, char *argv[])
                 user_log = fopen(argument.env_output_file, "w");
         }
 
-        TimeStamp   timestamp(argument.block, NULL, NULL, user_log);
+        TimeStamp   timestamp(argument.block,
+                              NULL,
+                              NULL,
+                              user_log,
+                              argument.option);
 
         switch (operating_mode) {
         case RECEIVER:
@@ -96,14 +209,22 @@ Argument argument_parse(int *operating_mode, int argc, char *argv[])
 {
         using std::string;
 
+        using std::vector;
+
         int                         opt              = 0;
-        Argument                    argument         = {0U, 0U, NULL};
+        Argument                    argument         = {
+                0U, 0U, NULL, NULL, TrafficSpec(), TimeStampOption(),
+                SelfTestOption(), 0U, 0U, 0U, 7U, NULL
+        };
+        vector<uint64_t>            list;
+        FILE                       *stream           = NULL;
+        const char                 *mismatch         = NULL;
         /*
          * Prohibit getopt_long() from printing error message of its own by
          * prefixing the optstring formal parameter (TSSEND_FLAGS actual
          * argument in this case) by a colon.
          */
-        static const char *const    TSSEND_FLAGS     = ":b:c:rs";
+        static const char *const    TSSEND_FLAGS     = ":b:c:prsS";
         /*
          * From the manual page (section 3) of getopt(),
          * "by default, getopt() permutes the contents of argv as it scans",
@@ -125,11 +246,47 @@ Argument argument_parse(int *operating_mode, int argc, char *argv[])
          * sacrificed.
          */
         static const struct option  LONG_OPTIONS[] = {
-                {"block",    required_argument, NULL, 'b'},
-                {"count",    required_argument, NULL, 'c'},
-                {"help",     no_argument,       NULL, 'h'},
-                {"receiver", no_argument,       NULL, 'r'},
-                {"sender",   no_argument,       NULL, 's'},
+                {"batch",       required_argument, NULL, OPT_BATCH},
+                {"batch-usec",  required_argument, NULL, OPT_BATCH_US},
+                {"block",       required_argument, NULL, 'b'},
+                {"calibrate",   no_argument,       NULL, OPT_CALIBRATE},
+                {"calibration", required_argument, NULL, OPT_CALIB_IN},
+                {"channel",     required_argument, NULL, OPT_CHANNEL},
+                {"clock",       required_argument, NULL, OPT_CLOCK},
+                {"count",       required_argument, NULL, 'c'},
+                {"daemon",      required_argument, NULL, OPT_DAEMON},
+                {"crc",         no_argument,       NULL, OPT_CRC},
+                {"cpu",         required_argument, NULL, OPT_CPU},
+                {"duplex",      no_argument,       NULL, OPT_DUPLEX},
+                {"duration",    required_argument, NULL, OPT_DURATION},
+                {"help",        no_argument,       NULL, 'h'},
+                {"idle-timeout", required_argument, NULL, OPT_IDLE},
+                {"interval",    required_argument, NULL, OPT_INTERVAL},
+                {"legacy",      no_argument,       NULL, OPT_LEGACY},
+                {"no-log",      no_argument,       NULL, OPT_NO_LOG},
+                {"pads",        required_argument, NULL, OPT_PADS},
+                {"payload",     required_argument, NULL, OPT_PAYLOAD},
+                {"pipeline",    no_argument,       NULL, 'p'},
+                {"rate",        required_argument, NULL, OPT_RATE},
+                {"rates",       required_argument, NULL, OPT_RATES},
+                {"schedule",    required_argument, NULL, OPT_SCHEDULE},
+                {"seed",        required_argument, NULL, OPT_SEED},
+                {"sizes",       required_argument, NULL, OPT_SIZES},
+                {"traffic",     required_argument, NULL, OPT_TRAFFIC},
+                {"raw",         no_argument,       NULL, OPT_RAW},
+                {"receiver",    no_argument,       NULL, 'r'},
+                {"reorder",     required_argument, NULL, OPT_REORDER},
+                {"ring",        required_argument, NULL, OPT_RING_SIZE},
+                {"rotate-keep", required_argument, NULL, OPT_ROT_KEEP},
+                {"rotate-size", required_argument, NULL, OPT_ROT_SIZE},
+                {"rotate-time", required_argument, NULL, OPT_ROT_TIME},
+                {"self-test",   no_argument,       NULL, OPT_SELF_TEST},
+                {"sender",      no_argument,       NULL, 's'},
+                {"shm",         required_argument, NULL, OPT_SHM},
+                {"shm-spin",    no_argument,       NULL, OPT_SHM_SPIN},
+                {"splice",      no_argument,       NULL, OPT_SPLICE},
+                {"timeout",     required_argument, NULL, OPT_TIMEOUT},
+                {"stats",       no_argument,       NULL, 'S'},
                 {
                         .name    = NULL,
                         .has_arg = 0,
@@ -156,10 +313,248 @@ Argument argument_parse(int *operating_mode, int argc, char *argv[])
                         break;
                 case 'c':
                         argument.count = number_validate(optarg);
+                        /* Tells an explicit 0, no limit, from a typo. */
+                        if (0U == argument.count) {
+                                if (!list_validate(optarg, &list) ||
+                                    1U != list.size()) {
+                                        usage(PROGRAM_NAME.c_str(),
+                                              EXIT_FAILURE,
+                                              "Invalid argument!");
+                                }
+                                argument.option.stream = true;
+                        }
+                        break;
+                case 'p':
+                        argument.option.pipeline = true;
                         break;
                 case 'r':
                 case 's':
+                case OPT_SELF_TEST:
+                case OPT_CALIBRATE:
+                case OPT_DUPLEX:
+                        *operating_mode = opt;
+                        break;
+                case OPT_DAEMON:
                         *operating_mode = opt;
+                        argument.socket = optarg;
+                        break;
+                case 'S':
+                        argument.option.stats = stderr;
+                        break;
+                case OPT_BATCH:
+                        argument.option.batch = number_validate(optarg);
+                        if (0U == argument.option.batch) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        break;
+                case OPT_BATCH_US:
+                        argument.option.batch_usec = number_validate(optarg);
+                        break;
+                case OPT_PAYLOAD:
+                        if (!PayloadGenerator::parse(
+                                        optarg, &argument.option.payload)) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        break;
+                case OPT_CHANNEL:
+                        if (!SelfTestOption::parse(
+                                        optarg,
+                                        &argument.self_test.channel)) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        break;
+                case OPT_CLOCK:
+                        if (0 == std::strcmp("realtime", optarg)) {
+                                argument.option.clock = CLOCK_REALTIME;
+                        } else if (0 == std::strcmp("coarse", optarg)) {
+                                argument.option.clock =
+                                        CLOCK_REALTIME_COARSE;
+                        } else {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        break;
+                case OPT_CPU:
+                        /* Either one CPU for both ends, or "SEND,RECV". */
+                        if (!list_validate(optarg, &list) ||
+                            2U < list.size() ||
+                            CPU_SETSIZE <= list.front() ||
+                            CPU_SETSIZE <= list.back()) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        argument.self_test.send_cpu = static_cast<int>(
+                                                        list.front());
+                        argument.self_test.recv_cpu = static_cast<int>(
+                                                        list.back());
+                        break;
+                case OPT_PADS:
+                        if (!list_validate(optarg, &list)) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        argument.self_test.pads.clear();
+                        for (auto pad : list) {
+                                argument.self_test.pads.push_back(
+                                        narrow_cast<size_t, uint64_t>(pad));
+                        }
+                        break;
+                case OPT_RATE:
+                        if (!list_validate(optarg, &list) ||
+                            1U != list.size()) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        argument.option.rate = list.front();
+                        break;
+                case OPT_RATES:
+                        if (!list_validate(optarg,
+                                           &argument.self_test.rates)) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        break;
+                case OPT_LEGACY:
+                        argument.option.engine = false;
+                        break;
+                case OPT_SCHEDULE:
+                        argument.schedule = optarg;
+                        break;
+                case OPT_TRAFFIC:
+                        if (!TrafficModel::parse_arrival(optarg,
+                                                         &argument.traffic)) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        break;
+                case OPT_SIZES:
+                        if (!TrafficModel::parse_size(optarg,
+                                                      &argument.traffic)) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        break;
+                case OPT_SEED:
+                        if (!list_validate(optarg, &list) ||
+                            1U != list.size()) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        argument.traffic.seed = list.front();
+                        break;
+                case OPT_DURATION:
+                case OPT_INTERVAL:
+                case OPT_ROT_SIZE:
+                case OPT_ROT_TIME:
+                case OPT_ROT_KEEP:
+                        if (!list_validate(optarg, &list) ||
+                            1U != list.size() || 0U == list.front()) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        if (OPT_DURATION == opt) {
+                                argument.duration = narrow_cast<unsigned,
+                                        uint64_t>(list.front());
+                        } else if (OPT_INTERVAL == opt) {
+                                argument.option.interval = list.front();
+                        } else if (OPT_ROT_SIZE == opt) {
+                                argument.rotate_bytes = list.front();
+                        } else if (OPT_ROT_TIME == opt) {
+                                argument.rotate_seconds = list.front();
+                        } else {
+                                argument.rotate_keep = narrow_cast<unsigned,
+                                        uint64_t>(list.front());
+                        }
+                        if (OPT_ROT_KEEP != opt) {
+                                argument.option.stream = true;
+                        }
+                        break;
+                case OPT_TIMEOUT:
+                case OPT_IDLE:
+                        if (!list_validate(optarg, &list) ||
+                            1U != list.size() || 0U == list.front()) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        if (OPT_TIMEOUT == opt) {
+                                argument.option.timeout = list.front();
+                        } else {
+                                argument.option.idle_timeout = list.front();
+                        }
+                        break;
+                case OPT_CRC:
+                        argument.option.crc = true;
+                        break;
+                case OPT_CALIB_IN:
+                        stream = std::fopen(optarg, "r");
+                        if (NULL == stream) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Cannot open the calibration file!");
+                        }
+                        try {
+                                argument.option.calibration.load(stream);
+                        } catch (const std::invalid_argument &error) {
+                                std::fclose(stream);
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      error.what());
+                        }
+                        std::fclose(stream);
+                        break;
+                case OPT_NO_LOG:
+                        argument.option.log = false;
+                        break;
+                case OPT_RAW:
+                        argument.option.raw = true;
+                        break;
+                case OPT_SHM:
+                        argument.option.shm = optarg;
+                        break;
+                case OPT_SHM_SPIN:
+                        argument.option.shm_spin = true;
+                        break;
+                case OPT_SPLICE:
+                        argument.option.splice = true;
+                        break;
+                case OPT_REORDER:
+                        argument.option.reorder = number_validate(optarg);
+                        /* Slots are found by masking the sequence number. */
+                        if (0U == argument.option.reorder ||
+                            (1U << 20) < argument.option.reorder ||
+                            0U != (argument.option.reorder &
+                                   (argument.option.reorder - 1U))) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        break;
+                case OPT_RING_SIZE:
+                        argument.option.ring_size = number_validate(optarg);
+                        /* A power of two is required by the ring. */
+                        if (0U == argument.option.ring_size ||
+                            0U != (argument.option.ring_size &
+                                   (argument.option.ring_size - 1U))) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
                         break;
                 case '?':
                         usage(PROGRAM_NAME.c_str(),
@@ -183,19 +578,220 @@ Argument argument_parse(int *operating_mode, int argc, char *argv[])
          * If the above branch is taken, all the code following would NEVER
          * be executed since usage does not return to its caller.
          */
-        if (0U == argument.count) {
+        if (argument.option.crc &&
+            (!argument.option.engine ||
+             !timestamp_engine_supports(argument.option))) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      "--crc excludes --legacy, --pipeline, --batch, "
+                      "--batch-usec and --splice!");
+        }
+        if (argument.option.calibration.active() &&
+            RECEIVER != *operating_mode && DUPLEX != *operating_mode &&
+            DAEMON != *operating_mode) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      "--calibration is for the receiver!");
+        }
+        /* The daemon checks each request, see TimeStampDaemon::run_(). */
+        if (argument.option.calibration.active() &&
+            DAEMON != *operating_mode) {
+                mismatch = argument.option.calibration.mismatch(
+                                argument.option.clock,
+                                argument.option.raw,
+                                argument.option.crc,
+                                argument.block);
+        }
+        if (NULL != mismatch) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      (string("--calibration was measured with another ") +
+                       mismatch + "!").c_str());
+        }
+        /* Requests only pick the frames, the rest is the daemon's. */
+        if (DAEMON == *operating_mode) {
+                if (!argument.option.engine ||
+                    !timestamp_engine_supports(argument.option) ||
+                    NULL != argument.option.shm ||
+                    NULL != argument.schedule ||
+                    argument.traffic.active() || argument.option.stream) {
+                        usage(PROGRAM_NAME.c_str(),
+                              EXIT_FAILURE,
+                              "--daemon excludes --legacy, -p, --batch, "
+                              "--batch-usec, --splice, --shm,\n--schedule, "
+                              "--traffic, --sizes, -c 0, --duration, "
+                              "--interval and --rotate-*!");
+                }
+                return argument;
+        }
+        /* The floor is that of the engine over a pipe, as ts runs it. */
+        if (CALIBRATE == *operating_mode) {
+                if (!argument.option.engine ||
+                    !timestamp_engine_supports(argument.option) ||
+                    NULL != argument.option.shm) {
+                        usage(PROGRAM_NAME.c_str(),
+                              EXIT_FAILURE,
+                              "--calibrate excludes --legacy, --pipeline, "
+                              "--batch, --batch-usec,\n--splice and "
+                              "--shm!");
+                }
+                if (0U == argument.count) {
+                        argument.count = 100000U;
+                }
+                return argument;
+        }
+        if (SELF_TEST == *operating_mode) {
+                /* Both ends of every point share the remaining options. */
+                if (0U != argument.count) {
+                        argument.self_test.count = argument.count;
+                }
+                argument.option.stream       = false;
+                argument.self_test.timestamp = argument.option;
+                if (argument.option.splice &&
+                    1U != argument.option.batch) {
+                        usage(PROGRAM_NAME.c_str(),
+                              EXIT_FAILURE,
+                              "--splice excludes --batch!");
+                }
+                return argument;
+        }
+        /* Each direction is an engine run of its own, of -c frames. */
+        if (DUPLEX == *operating_mode &&
+            (!argument.option.engine ||
+             !timestamp_engine_supports(argument.option) ||
+             NULL != argument.option.shm || NULL != argument.schedule ||
+             argument.traffic.active() || argument.option.stream)) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      "--duplex excludes --legacy, -p, --batch, --batch-usec, "
+                      "--splice, --shm,\n--schedule, --traffic, --sizes, "
+                      "-c 0, --duration, --interval and --rotate-*!");
+        }
+        /* A schedule says how many frames there are on its own. */
+        if (NULL != argument.schedule &&
+            (SENDER != *operating_mode || !argument.option.engine ||
+             !timestamp_engine_supports(argument.option) ||
+             0U != argument.option.rate)) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      "--schedule is for the sender and excludes --legacy, "
+                      "--rate,\n--batch, --batch-usec and --splice!");
+        }
+        /* Either end may have a model, the receiver to compare against. */
+        if (argument.traffic.active() &&
+            (!argument.option.engine ||
+             !timestamp_engine_supports(argument.option) ||
+             NULL != argument.schedule ||
+             (ArrivalModel::CONSTANT != argument.traffic.arrival &&
+              0U != argument.option.rate))) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      "--traffic and --sizes exclude --legacy, --schedule, "
+                      "--batch,\n--batch-usec and --splice, and --traffic "
+                      "excludes --rate!");
+        }
+        if (ArrivalModel::CONSTANT == argument.traffic.arrival) {
+                argument.traffic.rate =
+                        static_cast<double>(argument.option.rate);
+        }
+        /* Streaming needs the engine and goes on until told to stop. */
+        if (argument.option.stream &&
+            (!argument.option.engine ||
+             !timestamp_engine_supports(argument.option) ||
+             NULL != argument.schedule || argument.traffic.active())) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      "-c 0, --duration, --interval and --rotate-* exclude "
+                      "--legacy,\n--schedule, --traffic, --sizes, --batch, "
+                      "--batch-usec and --splice!");
+        }
+        if ((0U != argument.option.interval || 0U != argument.rotate_bytes ||
+             0U != argument.rotate_seconds) && RECEIVER != *operating_mode) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      "--interval and --rotate-* are for the receiver!");
+        }
+        if (0U != argument.option.reorder &&
+            ((RECEIVER != *operating_mode && DUPLEX != *operating_mode) ||
+             !argument.option.engine ||
+             !timestamp_engine_supports(argument.option) ||
+             argument.option.stream || argument.traffic.active())) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      "--reorder is for the receiver and excludes --legacy, "
+                      "-p, -c 0,\n--duration, --interval, --rotate-*, "
+                      "--traffic and --sizes!");
+        }
+        if ((0U != argument.option.timeout ||
+             0U != argument.option.idle_timeout) &&
+            RECEIVER != *operating_mode && DUPLEX != *operating_mode) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      "--timeout and --idle-timeout are for the receiver!");
+        }
+        if (0U != argument.option.interval && NULL == argument.option.stats) {
+                argument.option.stats = stderr;
+        }
+        if (0U == argument.count && NULL == argument.schedule &&
+            !argument.option.stream) {
                 usage(PROGRAM_NAME.c_str(), EXIT_FAILURE, "Invalid argument!");
         }
+        /* Only raw frames can be coalesced without breaking the encoding. */
+        if (!argument.option.raw && (1U != argument.option.batch ||
+                                     0U != argument.option.batch_usec)) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      "--batch and --batch-usec require --raw!");
+        }
+        if (argument.option.splice && (!argument.option.raw ||
+                                       1U != argument.option.batch)) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      "--splice requires --raw and excludes --batch!");
+        }
+        /* vmsplice() hands out the very pages the generator rewrites. */
+        if (argument.option.splice &&
+            (PayloadMode::RANDOM == argument.option.payload ||
+             PayloadMode::SLIDING == argument.option.payload)) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      "--splice excludes --payload random and sliding!");
+        }
+        /* The ring has a slot per frame, there is nothing to coalesce. */
+        if (NULL != argument.option.shm && (argument.option.splice ||
+                                            1U != argument.option.batch)) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      "--shm excludes --splice and --batch!");
+        }
 
         /*
          * If the environment variable is not set,
          * let TimeStamp fall back to print to stdout instead.
          */
         argument.env_output_file = secure_getenv(ENV_TIMESTAMP_OUTPUT);
+        if ((0U != argument.rotate_bytes || 0U != argument.rotate_seconds) &&
+            (NULL == argument.env_output_file || !argument.option.log)) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      "--rotate-* need a log file, see "
+                      ENV_TIMESTAMP_OUTPUT "!");
+        }
+        if (DUPLEX == *operating_mode && argument.option.log &&
+            NULL == argument.env_output_file) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      "--duplex sends on stdout, so it needs --no-log or a "
+                      "log file,\nsee " ENV_TIMESTAMP_OUTPUT "!");
+        }
 
         return argument;
 #undef RECEIVER
 #undef SENDER
+#undef SELF_TEST
+#undef CALIBRATE
+#undef DUPLEX
+#undef DAEMON
 #undef UNSPECIFIED
 }
 
@@ -222,6 +818,33 @@ static size_t number_validate(const char *const candidate)
         return narrow_cast<size_t, uintmax_t>(result);
 }
 
+/* Parses a comma separated list of numbers, "0,64,1024" for instance. */
+static bool list_validate(const char *const     candidate,
+                          std::vector<uint64_t> *result)
+{
+        const char *cursor = candidate;
+        char       *endptr = NULL;
+        uintmax_t   number = 0U;
+
+        result->clear();
+        for (;;) {
+                errno  = 0;
+                number = strtoumax(cursor, &endptr, 10);
+                if (ERANGE == errno || endptr == cursor ||
+                    '-' == *cursor || UINT64_MAX < number) {
+                        return false;
+                }
+                result->push_back(static_cast<uint64_t>(number));
+                if ('\0' == *endptr) {
+                        return true;
+                }
+                if (',' != *endptr) {
+                        return false;
+                }
+                cursor = endptr + 1;
+        }
+}
+
 static void usage(const char *name, int status, const char *msg)
 {
         using std::fprintf;
@@ -234,8 +857,26 @@ static void usage(const char *name, int status, const char *msg)
         }
         fprintf(stderr,
                 "[" ANSI_COLOR_BLUE "Usage" ANSI_COLOR_RESET "]\n"
-                "%s [-h] [-r | -s] "
-                "[-b BLOCK_PADDING_COUNT] [-c MESSAGE_COUNT]\n\n"
+                "%s [-h] [-r | -s | --duplex | --self-test | --calibrate |\n"
+                "--daemon SOCKET] [-b BLOCK_PADDING_COUNT] "
+                "[-c MESSAGE_COUNT]\n"
+                "[-p] [--ring RING_SIZE] [-S] [--raw]\n"
+                "[--batch FRAMES] [--batch-usec MICROSECONDS] [--splice]\n"
+                "[--payload none|zero|pattern|random|sliding] "
+                "[--rate FRAMES_PER_SECOND]\n"
+                "[--channel pipe|socketpair|tcp|udp|shm] [--cpu SEND[,RECV]]\n"
+                "[--pads PAD[,PAD...]] [--rates RATE[,RATE...]]\n"
+                "[--shm NAME] [--shm-spin] [--clock realtime|coarse] "
+                "[--no-log] [--legacy] [--schedule FILE]\n"
+                "[--traffic poisson:RATE|onoff:RATE,ON_USEC,OFF_USEC]\n"
+                "[--sizes pareto:SHAPE,MIN,MAX|lognormal:MEDIAN,SIGMA,MAX] "
+                "[--seed SEED]\n"
+                "[--duration SECONDS] [--interval SECONDS] "
+                "[--rotate-size BYTES]\n"
+                "[--rotate-time SECONDS] [--rotate-keep FILES]\n"
+                "[--timeout MILLISECONDS] [--idle-timeout MILLISECONDS] "
+                "[--crc]\n"
+                "[--calibration FILE] [--reorder FRAMES]\n\n"
 
                 "<" ANSI_COLOR_CYAN "Receiver Mode" ANSI_COLOR_RESET ">\n"
                 "Receives messages containing timestamps padded with "
@@ -252,6 +893,34 @@ static void usage(const char *name, int status, const char *msg)
                 "to stdout "
                 ANSI_COLOR_MAGENTA "MESSAGE_COUNT" ANSI_COLOR_RESET
                 " times.\n\n"
+
+                "<" ANSI_COLOR_CYAN "Duplex   Mode" ANSI_COLOR_RESET ">\n"
+                "Both at once, for a peer doing the same: sends to stdout "
+                "while receiving\n"
+                "from stdin, and summarizes both directions together.\n\n"
+
+                "<" ANSI_COLOR_CYAN "Daemon   Mode" ANSI_COLOR_RESET ">\n"
+                "Stays resident and runs the sender or the receiver over "
+                "every connection to\n"
+                "the Unix socket "
+                ANSI_COLOR_MAGENTA "SOCKET" ANSI_COLOR_RESET
+                " ('@' first for the abstract namespace), with the options\n"
+                "of the line the client starts with, e.g. "
+                "'-r -c 1024 --raw -S'.\n\n"
+
+                "<" ANSI_COLOR_CYAN "Self-Test Mode" ANSI_COLOR_RESET ">\n"
+                "Forks a raw sender and a raw receiver over a local channel "
+                "for every\n"
+                "combination of --pads and --rates and prints a table of "
+                "what ts sustains.\n\n"
+
+                "<" ANSI_COLOR_CYAN "Calibrate Mode" ANSI_COLOR_RESET ">\n"
+                "Sends "
+                ANSI_COLOR_MAGENTA "MESSAGE_COUNT" ANSI_COLOR_RESET
+                " messages (default 100000) through a pipe to itself\n"
+                "and prints what each step of ts costs, and the floor it "
+                "puts under every\n"
+                "latency, as a file for --calibration.\n\n"
 #if 0
                 "simultaneously receives message from stdin and write the "
                 "result to a file\n"
@@ -262,16 +931,106 @@ static void usage(const char *name, int status, const char *msg)
                 "-h, --help\tshow this help message and exit\n"
                 "-r, --receiver\toperates in receiver mode\n"
                 "-s, --sender\toperates in sender mode\n"
+                "--duplex\toperates in duplex mode, needs --no-log or "
+                ENV_TIMESTAMP_OUTPUT "\n"
+                "--daemon\toperates in daemon mode at SOCKET\n"
                 "-b, --block\tnumber of padding blocks in addition to "
                 "timestamps\n"
-                "-c, --count\tnumber of messages to be sent\n"
+                "-c, --count\tnumber of messages to be sent, 0 for no "
+                "limit\n"
+                "-p, --pipeline\treceive on one thread, log on another\n"
+                "--ring\t\tsamples buffered between the two threads of "
+                "--pipeline,\n\t\ta power of two (default 65536)\n"
+                "-S, --stats\tprint a summary of the run to stderr\n"
+                "--raw\t\tsend binary frames straight through the file "
+                "descriptors\n\t\tinstead of base64 over stdio; both ends "
+                "need it\n"
+                "--batch\t\tsender: coalesce up to this many frames per "
+                "write (--raw)\n"
+                "--batch-usec\tsender: write a partial batch once its "
+                "oldest frame waited\n\t\tthis many microseconds "
+                "(--raw)\n"
+                "--splice\tsender: hand the padding to a pipe or socket "
+                "without copying\n\t\tit (--raw, not with --payload "
+                "random or sliding)\n"
+                "--payload\tsender: padding content, 'none' (default) "
+                "leaves it as\n\t\tallocated, 'random' regenerates all "
+                "of it per message,\n\t\t'sliding' only a sixteenth of "
+                "it\n"
+                "--rate\t\tsender: messages per second (default 0, as "
+                "fast as possible)\n"
+                "--self-test\tmeasure ts itself, see below\n"
+                "--calibrate\tmeasure the floor of ts on this host, see "
+                "above\n"
+                "--shm\t\texchange messages through the shared memory "
+                "ring NAME\n\t\tinstead of stdin/stdout; both ends "
+                "need it\n"
+                "--shm-spin\tbusy wait on the ring instead of sleeping "
+                "when idle\n"
+                "--clock\t\tclock to stamp with, 'coarse' is cheaper but "
+                "only as fine as\n\t\tthe scheduler tick (default "
+                "realtime)\n"
+                "--no-log\treceiver: keep the statistics but skip the "
+                "per message log\n"
+                "--legacy\trun on the general code path even where the "
+                "specialized one\n\t\tcovers the options\n"
+                "--schedule\tsender: replay the departures of FILE, one "
+                "'INTERVAL_NS\n\t\tFRAME_BYTES' line per message, "
+                "instead of -b and --rate;\n\t\t-c replays only the "
+                "first messages\n"
+                "--traffic\tsend at Poisson arrivals of RATE per second, "
+                "or at RATE only\n\t\tduring exponentially distributed "
+                "on periods of mean ON_USEC\n\t\tmicroseconds between off "
+                "periods of mean OFF_USEC; on the\n\t\treceiver, the "
+                "model the sender used, to compare against\n"
+                "--sizes\t\tdraw the size of each message, header "
+                "included, from a\n\t\tPareto or lognormal distribution "
+                "cut off at MAX bytes, instead\n\t\tof -b; same as "
+                "--traffic on the receiver\n"
+                "--seed\t\tseed of --traffic and --sizes, both ends need "
+                "the same (default 1)\n"
+                "--duration\tstop after this many seconds, without "
+                "limit on -c unless given\n"
+                "--interval\treceiver: summarize the last SECONDS every "
+                "SECONDS to stderr\n"
+                "--rotate-size\treceiver: move the log file aside to "
+                "FILE.1 once this large\n"
+                "--rotate-time\treceiver: move the log file aside to "
+                "FILE.1 once this old\n"
+                "--rotate-keep\treceiver: rotated log files kept "
+                "(default 7)\n"
+                "--timeout\treceiver: give up on the frames still missing "
+                "after\n\t\tMILLISECONDS and count them as lost\n"
+                "--idle-timeout\treceiver: the same, once nothing arrived "
+                "for MILLISECONDS\n"
+                "--crc\t\tprotect every frame with a CRC32C, both ends "
+                "need it;\n\t\tthe receiver drops the frames failing it "
+                "as lost\n"
+                "--calibration\treceiver: take the floor in FILE, as "
+                "printed by --calibrate\n\t\twith the same options, off "
+                "the latencies of the summary\n"
+                "--reorder\treceiver: put frames back into the order "
+                "they were sent in,\n\t\twaiting for up to FRAMES later "
+                "ones, a power of two\n"
+                "--channel\tself-test: channel between the two ends "
+                "(default pipe),\n\t\tor shm\n"
+                "--cpu\t\tself-test: CPUs to pin the sender and the "
+                "receiver to\n"
+                "--pads\t\tself-test: padding sizes to sweep "
+                "(default 0,64,1024,16384,65536)\n"
+                "--rates\t\tself-test: sender rates to sweep "
+                "(default 0)\n"
                 "\n[" ANSI_COLOR_BLUE "NOTE" ANSI_COLOR_RESET "]\n"
                 "1. Environment variable "
                 ANSI_COLOR_MAGENTA ENV_TIMESTAMP_OUTPUT ANSI_COLOR_RESET
                 " needs to be set for the receiver to\n"
                 "print to log file.\n\n"
                 "2. It will print gibberish if shell redirection isn't used"
-                " on the sender side.\n\n",
+                " on the sender side.\n\n"
+                "3. With -c 0, --duration, --interval or --rotate-*, "
+                "SIGTERM and SIGINT end\n"
+                "the run with its summary and SIGHUP reopens the log "
+                "file.\n\n",
                 NULL == name ? "" : name);
         std::exit(status);
 }
@@ -0,0 +1,210 @@
+/**
+ * @file tsbench.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Main driver of the ts-bench program; microbenchmarks of every stage of
+ * the hot path of ts.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+/* All the depedendent headers are put into a separate private header. */
+#define TSBENCHONLY
+#include "benchutil.h"
+#undef  TSBENCHONLY
+
+int main(int argc, char *argv[])
+{
+        BenchOption option = argument_parse(argc, argv);
+        Bench       bench(option);
+
+        return -1 == bench.run(stdout) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+BenchOption argument_parse(int argc, char *argv[])
+{
+        using std::string;
+
+        int                         opt              = 0;
+        uintmax_t                   number           = 0U;
+        const char                 *cursor           = NULL;
+        char                       *endptr           = NULL;
+        BenchOption                 option;
+        static const char *const    TSBENCH_FLAGS    = ":c:f:hr:t:";
+        const string                PROGRAM_NAME     = string(argv[0]);
+        static const struct option  LONG_OPTIONS[] = {
+                {"baseline",    required_argument, NULL, OPT_BASELINE},
+                {"compare",     required_argument, NULL, OPT_COMPARE},
+                {"count",       required_argument, NULL, 'c'},
+                {"filter",      required_argument, NULL, 'f'},
+                {"help",        no_argument,       NULL, 'h'},
+                {"pads",        required_argument, NULL, OPT_PADS},
+                {"ratios",      required_argument, NULL, OPT_RATIOS},
+                {"repeat",      required_argument, NULL, 'r'},
+                {"save",        required_argument, NULL, OPT_SAVE},
+                {"time",        required_argument, NULL, 't'},
+                {
+                        .name    = NULL,
+                        .has_arg = 0,
+                        .flag    = NULL,
+                        .val     = 0
+                }
+        };
+
+        while (-1 != (opt = getopt_long(argc,
+                                        argv,
+                                        TSBENCH_FLAGS,
+                                        LONG_OPTIONS,
+                                        NULL))) {
+                switch (opt) {
+                case 'c':
+                case 'r':
+                case 't':
+                        if (!number_validate(optarg, &number) ||
+                            0U == number) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        if ('c' == opt) {
+                                option.count  = static_cast<size_t>(number);
+                        } else if ('r' == opt) {
+                                option.repeat = static_cast<size_t>(number);
+                        } else {
+                                option.min_ms = static_cast<uint64_t>(number);
+                        }
+                        break;
+                case 'f':
+                        option.filter = optarg;
+                        break;
+                case OPT_BASELINE:
+                case OPT_COMPARE:
+                        option.baseline = optarg;
+                        option.strict   = OPT_BASELINE == opt;
+                        break;
+                case OPT_RATIOS:
+                        option.ratios = optarg;
+                        break;
+                case OPT_SAVE:
+                        option.save = optarg;
+                        break;
+                case OPT_PADS:
+                        option.pads.clear();
+                        for (cursor = optarg; ; cursor = endptr + 1) {
+                                errno  = 0;
+                                number = strtoumax(cursor, &endptr, 10);
+                                if (ERANGE == errno || endptr == cursor ||
+                                    '-' == *cursor ||
+                                    (',' != *endptr && '\0' != *endptr)) {
+                                        usage(PROGRAM_NAME.c_str(),
+                                              EXIT_FAILURE,
+                                              "Invalid argument!");
+                                }
+                                option.pads.push_back(
+                                        narrow_cast<size_t, uintmax_t>(
+                                                number));
+                                if ('\0' == *endptr) {
+                                        break;
+                                }
+                        }
+                        break;
+                case '?':
+                        usage(PROGRAM_NAME.c_str(),
+                              EXIT_FAILURE,
+                              "There is no such option!");
+                case ':':
+                        usage(PROGRAM_NAME.c_str(),
+                              EXIT_FAILURE,
+                              "Missing argument!");
+                case 'h':
+                default:
+                        usage(PROGRAM_NAME.c_str(), EXIT_FAILURE, NULL);
+                }
+        }
+        if (optind != argc) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      "Too many arguments!");
+        }
+        return option;
+}
+
+static bool number_validate(const char *const candidate, uintmax_t *result)
+{
+        char *endptr = NULL;
+
+        errno   = 0;
+        *result = strtoumax(candidate, &endptr, 10);
+        return !(ERANGE == errno || endptr == candidate || '\0' != *endptr);
+}
+
+static void usage(const char *name, int status, const char *msg)
+{
+        using std::fprintf;
+
+        if (NULL != msg) {
+                fprintf(stderr,
+                        "[" ANSI_COLOR_BLUE "Error" ANSI_COLOR_RESET "]\n"
+                        "%s\n\n",
+                        msg);
+        }
+        fprintf(stderr,
+                "[" ANSI_COLOR_BLUE "Usage" ANSI_COLOR_RESET "]\n"
+                "%s [-h] [-r REPEAT] [-t MILLISECONDS] [-c COUNT] "
+                "[--pads PAD[,PAD...]]\n"
+                "[-f FILTER] [--baseline FILE | --compare FILE] "
+                "[--ratios FILE]\n[--save FILE]\n\n"
+
+                "Times every stage of the hot path of ts on its own and "
+                "prints one line\n"
+                "per benchmark: its name, the median and the minimum "
+                "nanoseconds per\n"
+                "operation over REPEAT runs, and the throughput in MB/s "
+                "where it has one.\n"
+                "Against a baseline, fails if any result is more than its "
+                "tolerance above\n"
+                "the baseline; --save writes such a baseline.  Against "
+                "ratios, fails if any\n"
+                "result is more than its ratio times that of its "
+                "reference in the same run.\n\n"
+
+                "[" ANSI_COLOR_BLUE "Optional Arguments" ANSI_COLOR_RESET "]\n"
+                "-h, --help\tshow this help message and exit\n"
+                "-r, --repeat\truns per benchmark (default 5)\n"
+                "-t, --time\tminimum duration of a run in milliseconds "
+                "(default 50)\n"
+                "-c, --count\tframes per loopback run (default 100000)\n"
+                "--pads\t\tpadding sizes to benchmark "
+                "(default 0,64,1024,16384)\n"
+                "-f, --filter\tonly run benchmarks whose name contains "
+                "FILTER\n"
+                "--baseline\tonly run the benchmarks of the baseline FILE "
+                "and judge them\n"
+                "--compare\tthe same, but only to print the changes\n"
+                "--ratios\tonly run the benchmarks the ratios FILE names "
+                "and judge them\n"
+                "--save\t\twrite the results to FILE as a baseline\n",
+                NULL == name ? "" : name);
+        std::exit(status);
+}
@@ -0,0 +1,238 @@
+/**
+ * @file tscommon.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation file of the parts of timestamp.h that the TimeStamp class
+ * shares with the TimeStampEngine; unlike the class they need no OpenSSL,
+ * so the timestamp library is built from this file rather than that one.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "cmnutil.h"
+#include "timestamp.h"
+
+#include <cerrno>    /* EINTR ERANGE */
+#include <cinttypes> /* PRId64 PRIu64 strtoimax() */
+#include <csignal>   /* sig_atomic_t sigaction() */
+#include <ctime>     /* localtime_r() strftime() */
+
+TimeStampOption::TimeStampOption()
+        :
+        pipeline{false},
+        raw{false},
+        ring_size{1U << 16},
+        splice{false},
+        payload{PayloadMode::NONE},
+        batch{1U},
+        batch_usec{0U},
+        rate{0U},
+        shm{NULL},
+        shm_spin{false},
+        clock{CLOCK_REALTIME},
+        log{true},
+        engine{true},
+        stats{NULL},
+        stream{false},
+        interval{0U},
+        timeout{0U},
+        idle_timeout{0U},
+        crc{false},
+        reorder{0U},
+        calibration{}
+{
+}
+
+void timestamp_pace(const struct timespec &start, uint64_t rate, size_t i)
+{
+        timestamp_sleep_until(start,
+                              static_cast<uint64_t>(
+                                      static_cast<double>(i) * 1e9 /
+                                      static_cast<double>(rate)));
+}
+
+void timestamp_sleep_until(const struct timespec &start, uint64_t offset)
+{
+        struct timespec due     = start;
+
+        offset      += static_cast<uint64_t>(due.tv_nsec);
+        due.tv_sec  += static_cast<time_t>(offset / 1000000000U);
+        due.tv_nsec  = static_cast<long>(offset % 1000000000U);
+        while (EINTR == clock_nanosleep(CLOCK_MONOTONIC,
+                                        TIMER_ABSTIME,
+                                        &due,
+                                        NULL) &&
+               !cmnutil_interrupted()) {
+        }
+}
+
+/* Set by SIGHUP, cleared by timestamp_hangup(). */
+static volatile sig_atomic_t timestamp_hup = 0;
+
+static void timestamp_signal(int signo)
+{
+        if (SIGHUP == signo) {
+                timestamp_hup = 1;
+        } else {
+                cmnutil_interrupt();
+        }
+}
+
+void timestamp_signal_install()
+{
+        struct sigaction action = { };
+
+        /* No SA_RESTART, so that blocking calls return with EINTR. */
+        action.sa_handler = timestamp_signal;
+        sigemptyset(&action.sa_mask);
+        CMNUTIL_ERRNOABRT(-1, sigaction(SIGTERM, &action, NULL));
+        CMNUTIL_ERRNOABRT(-1, sigaction(SIGINT, &action, NULL));
+        CMNUTIL_ERRNOABRT(-1, sigaction(SIGALRM, &action, NULL));
+        CMNUTIL_ERRNOABRT(-1, sigaction(SIGHUP, &action, NULL));
+}
+
+bool timestamp_hangup()
+{
+        if (0 == timestamp_hup) {
+                return false;
+        }
+        timestamp_hup = 0;
+        return true;
+}
+
+void timestamp_report(FILE              *stats,
+                      const Histogram   &delta,
+                      uint64_t           lost,
+                      const char        *what,
+                      const Calibration &calibration)
+{
+        /* An empty histogram reports 0 and has no floor to take off. */
+        const int64_t floor = 0U == delta.count() ? 0 : calibration.floor;
+
+        fprintf(stats, "# ts %s summary, latencies in nanoseconds\n", what);
+        fprintf(stats, "%-24s %" PRIu64 "\n", "frames", delta.count());
+        fprintf(stats, "%-24s %" PRIu64 "\n", "frames.lost", lost);
+        if (calibration.active()) {
+                fprintf(stats, "%-24s %" PRId64 "\n", "latency.floor",
+                        calibration.floor);
+        }
+        fprintf(stats, "%-24s %" PRId64 "\n", "latency.min",
+                delta.min() - floor);
+        fprintf(stats, "%-24s %.0f\n",        "latency.mean",
+                delta.mean() - static_cast<double>(floor));
+        fprintf(stats, "%-24s %" PRId64 "\n", "latency.p50",
+                delta.percentile(0.50) - floor);
+        fprintf(stats, "%-24s %" PRId64 "\n", "latency.p90",
+                delta.percentile(0.90) - floor);
+        fprintf(stats, "%-24s %" PRId64 "\n", "latency.p99",
+                delta.percentile(0.99) - floor);
+        fprintf(stats, "%-24s %" PRId64 "\n", "latency.p999",
+                delta.percentile(0.999) - floor);
+        fprintf(stats, "%-24s %" PRId64 "\n", "latency.max",
+                delta.max() - floor);
+        fprintf(stats, "%-24s %" PRIu64 "\n", "latency.negative",
+                delta.negative());
+        if (calibration.active()) {
+                fprintf(stats, "%-24s %" PRIu64 "\n", "latency.unresolved",
+                        delta.count_below(calibration.floor +
+                                          calibration.resolution));
+        }
+}
+
+void timestamp_report_jitter(FILE *stats, const Jitter &jitter)
+{
+        const Histogram &ipdv = jitter.ipdv();
+
+        fprintf(stats, "%-24s %.0f\n",        "jitter", jitter.jitter());
+        fprintf(stats, "%-24s %" PRId64 "\n", "interarrival.min",
+                jitter.interarrival_min());
+        fprintf(stats, "%-24s %.0f\n",        "interarrival.mean",
+                jitter.interarrival_mean());
+        fprintf(stats, "%-24s %" PRId64 "\n", "interarrival.max",
+                jitter.interarrival_max());
+        fprintf(stats, "%-24s %" PRId64 "\n", "ipdv.min", jitter.ipdv_min());
+        fprintf(stats, "%-24s %" PRId64 "\n", "ipdv.abs.p50",
+                ipdv.percentile(0.50));
+        fprintf(stats, "%-24s %" PRId64 "\n", "ipdv.abs.p99",
+                ipdv.percentile(0.99));
+        fprintf(stats, "%-24s %" PRId64 "\n", "ipdv.abs.p999",
+                ipdv.percentile(0.999));
+        fprintf(stats, "%-24s %" PRId64 "\n", "ipdv.max", jitter.ipdv_max());
+}
+
+int timestamp_log_dump(FILE           *log,
+                       const timespec  timespec_array[],
+                       const size_t    size)
+{
+        /* Temporary buffer used for localtime_r() call. */
+        struct tm        tmp_tm           = { };
+        char             tmp_sec[1 << 13] = { };
+        char            *endptr           = NULL;
+        intmax_t         sec              = 0;
+        intmax_t         result           = 0;
+
+        for (size_t i = 0; i < size; ++i) {
+                if (NULL == localtime_r(&(timespec_array[i].tv_sec), &tmp_tm)){
+                        return -1;
+                }
+                if (0 == strftime(tmp_sec, sizeof tmp_sec, "%s", &tmp_tm)) {
+                        return -1;
+                }
+
+                endptr = NULL;
+                errno  = 0;
+                sec    = strtoimax(tmp_sec, &endptr, 10);
+                if (INTMAX_MAX == sec && ERANGE == errno) {
+                        return -1;
+                }
+                if (0 == sec && endptr == tmp_sec) {
+                        return -1;
+                }
+                /* Result is in milliseconds. */
+                result = 1000 * sec + timespec_array[i].tv_nsec / 1000000;
+                fprintf(log, "%" PRIdMAX "%s",
+                        result,
+                        size == i + 1 ? "\n" : ",");
+        }
+        fflush(log);
+        return 0;
+}
+
+/*
+ * Modified from the example from:
+ * http://www.guyrutenberg.com/2007/09/22/profiling-code-using-clock_gettime/
+ */
+timespec timestamp_diff(const timespec *end, const timespec *start)
+{
+        struct timespec result;
+
+        if (0 > (end->tv_nsec - start->tv_nsec)) {
+                result.tv_sec = end->tv_sec - start->tv_sec - 1;
+                result.tv_nsec = 1000000000 + end->tv_nsec - start->tv_nsec;
+        } else {
+                result.tv_sec = end->tv_sec - start->tv_sec;
+                result.tv_nsec = end->tv_nsec - start->tv_nsec;
+        }
+        return result;
+}
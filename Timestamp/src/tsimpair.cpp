@@ -0,0 +1,292 @@
+/**
+ * @file tsimpair.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Main driver of the ts-impair program; it sits between 'ts -s --raw' and
+ * 'ts -r --raw' and does to their frames what tc/netem would do to a link.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+/* All the depedendent headers are put into a separate private header. */
+#define TSIMPAIRONLY
+#include "impairutil.h"
+#undef  TSIMPAIRONLY
+
+int main(int argc, char *argv[])
+{
+        using std::runtime_error;
+
+        ImpairArgument argument = argument_parse(argc, argv);
+        Impairment     impairment(argument.option);
+
+        if (-1 == impairment.run(STDIN_FILENO, STDOUT_FILENO)) {
+                throw runtime_error("main() : relaying frames failed");
+        }
+        if (argument.stats) {
+                impairment.report(stderr);
+        }
+        return EXIT_SUCCESS;
+}
+
+ImpairArgument argument_parse(int argc, char *argv[])
+{
+        using std::string;
+
+        int                         opt              = 0;
+        uintmax_t                   number           = 0U;
+        ImpairArgument              argument         = {
+                false, ImpairOption()
+        };
+        static const char *const    TSIMPAIR_FLAGS   = ":d:hj:l:o:q:R:S";
+        const string                PROGRAM_NAME     = string(argv[0]);
+        static const struct option  LONG_OPTIONS[] = {
+                {"burst",       required_argument, NULL, OPT_BURST},
+                {"datagram",    no_argument,       NULL, OPT_DATAGRAM},
+                {"delay",       required_argument, NULL, 'd'},
+                {"help",        no_argument,       NULL, 'h'},
+                {"jitter",      required_argument, NULL, 'j'},
+                {"loss",        required_argument, NULL, 'l'},
+                {"queue",       required_argument, NULL, 'q'},
+                {"rate",        required_argument, NULL, 'R'},
+                {"reorder",     required_argument, NULL, 'o'},
+                {"rto",         required_argument, NULL, OPT_RTO},
+                {"seed",        required_argument, NULL, OPT_SEED},
+                {"stats",       no_argument,       NULL, 'S'},
+                {
+                        .name    = NULL,
+                        .has_arg = 0,
+                        .flag    = NULL,
+                        .val     = 0
+                }
+        };
+
+        while (-1 != (opt = getopt_long(argc,
+                                        argv,
+                                        TSIMPAIR_FLAGS,
+                                        LONG_OPTIONS,
+                                        NULL))) {
+                switch (opt) {
+                case 'd':
+                case 'j':
+                case 'q':
+                case OPT_BURST:
+                case OPT_RTO:
+                case OPT_SEED:
+                        if (!number_validate(optarg, &number)) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        break;
+                case 'l':
+                        if (!percent_validate(optarg,
+                                              &argument.option.loss)) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        break;
+                case 'o':
+                        if (!percent_validate(optarg,
+                                              &argument.option.reorder)) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        break;
+                case 'R':
+                        if (!rate_validate(optarg,
+                                           &argument.option.rate_bps)) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        break;
+                case 'S':
+                        argument.stats = true;
+                        break;
+                case OPT_DATAGRAM:
+                        argument.option.datagram = true;
+                        break;
+                case '?':
+                        usage(PROGRAM_NAME.c_str(),
+                              EXIT_FAILURE,
+                              "There is no such option!");
+                case ':':
+                        usage(PROGRAM_NAME.c_str(),
+                              EXIT_FAILURE,
+                              "Missing argument!");
+                case 'h':
+                default:
+                        usage(PROGRAM_NAME.c_str(), EXIT_FAILURE, NULL);
+                }
+
+                switch (opt) {
+                case 'd':
+                        argument.option.delay_ns = number * 1000U;
+                        break;
+                case 'j':
+                        argument.option.jitter_ns = number * 1000U;
+                        break;
+                case 'q':
+                        if (0U == number || UINT32_MAX <= number) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        argument.option.queue = narrow_cast<size_t,
+                                                            uintmax_t>(number);
+                        break;
+                case OPT_BURST:
+                        argument.option.burst = number;
+                        break;
+                case OPT_RTO:
+                        argument.option.rto_ns = number * 1000U;
+                        break;
+                case OPT_SEED:
+                        argument.option.seed = number;
+                }
+        }
+
+        /* Reordering is what jitter does to datagrams, never to a stream. */
+        if (0.0 != argument.option.reorder && !argument.option.datagram) {
+                usage(PROGRAM_NAME.c_str(),
+                      EXIT_FAILURE,
+                      "--reorder requires --datagram!");
+        }
+        return argument;
+}
+
+static bool number_validate(const char *const candidate, uintmax_t *result)
+{
+        char *endptr = NULL;
+
+        errno   = 0;
+        *result = strtoumax(candidate, &endptr, 10);
+        return !(ERANGE == errno || endptr == candidate || '\0' != *endptr);
+}
+
+static bool percent_validate(const char *const candidate, double *result)
+{
+        char *endptr = NULL;
+
+        errno   = 0;
+        *result = std::strtod(candidate, &endptr) / 100.0;
+        if (endptr != candidate && '%' == *endptr) {
+                ++endptr;
+        }
+        return !(ERANGE == errno || endptr == candidate || '\0' != *endptr ||
+                 !(*result >= 0.0 && *result <= 1.0));
+}
+
+/* Accepts the 'k', 'M' and 'G' suffixes of tc, as powers of ten. */
+static bool rate_validate(const char *const candidate, uint64_t *result)
+{
+        char      *endptr = NULL;
+        uintmax_t  rate   = 0U;
+        uintmax_t  scale  = 1U;
+
+        errno = 0;
+        rate  = strtoumax(candidate, &endptr, 10);
+        if (ERANGE == errno || endptr == candidate) {
+                return false;
+        }
+        switch (*endptr) {
+        case 'k':
+        case 'K':
+                scale = 1000U;
+                break;
+        case 'm':
+        case 'M':
+                scale = 1000000U;
+                break;
+        case 'g':
+        case 'G':
+                scale = 1000000000U;
+                break;
+        case '\0':
+                break;
+        default:
+                return false;
+        }
+        if ('\0' != *endptr && '\0' != endptr[1] &&
+            0 != std::strcmp(endptr + 1, "bit")) {
+                return false;
+        }
+        if (0U != rate && UINT64_MAX / rate < scale) {
+                return false;
+        }
+        *result = rate * scale;
+        return true;
+}
+
+static void usage(const char *name, int status, const char *msg)
+{
+        using std::fprintf;
+
+        if (NULL != msg) {
+                fprintf(stderr,
+                        "[" ANSI_COLOR_BLUE "Error" ANSI_COLOR_RESET "]\n"
+                        "%s\n\n",
+                        msg);
+        }
+        fprintf(stderr,
+                "[" ANSI_COLOR_BLUE "Usage" ANSI_COLOR_RESET "]\n"
+                "%s [-h] [-d USEC] [-j USEC] [-l PERCENT] [--rto USEC]\n"
+                "[--datagram] [-o PERCENT] [-R RATE] [--burst BYTES]\n"
+                "[-q FRAMES] [--seed SEED] [-S]\n\n"
+
+                "Relays the frames of 'ts -s --raw' on stdin to "
+                "'ts -r --raw' on stdout,\n"
+                "impairing them on the way like tc/netem would.\n\n"
+
+                "[" ANSI_COLOR_BLUE "Optional Arguments" ANSI_COLOR_RESET "]\n"
+                "-h, --help\tshow this help message and exit\n"
+                "-d, --delay\tone-way delay in microseconds\n"
+                "-j, --jitter\tuniform jitter of up to this many "
+                "microseconds either way\n"
+                "-l, --loss\tpercentage of frames lost\n"
+                "--rto\t\tstream: microseconds before a lost frame is "
+                "retransmitted\n\t\t(default 200000)\n"
+                "--datagram\tdrop lost frames instead of retransmitting "
+                "them, and let\n\t\tframes overtake each other\n"
+                "-o, --reorder\tdatagram: percentage of frames sent "
+                "without delay\n"
+                "-R, --rate\tlink rate in bits per second, with an "
+                "optional k, M or G\n\t\tsuffix\n"
+                "--burst\t\tbytes the link may send at once "
+                "(default 65536)\n"
+                "-q, --queue\tframes held at most (default 65536)\n"
+                "--seed\t\tseed of the loss, jitter and reorder "
+                "decisions\n"
+                "-S, --stats\tprint a summary of the run to stderr\n"
+                "\n[" ANSI_COLOR_BLUE "NOTE" ANSI_COLOR_RESET "]\n"
+                "In datagram mode a lost frame still reaches the receiver "
+                "as a placeholder,\n"
+                "so 'ts -r -c MESSAGE_COUNT' counts it as lost instead "
+                "of waiting for it.\n\n",
+                NULL == name ? "" : name);
+        std::exit(status);
+}
@@ -0,0 +1,259 @@
+/**
+ * @file tsstats.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Main driver of the ts-stats program; summarizes whole receiver logs at
+ * once, where tsTest.py only samples them.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+/* All the depedendent headers are put into a separate private header. */
+#define TSSTATSONLY
+#include "statsutil.h"
+#undef  TSSTATSONLY
+
+int main(int argc, char *argv[])
+{
+        using std::fprintf;
+        using std::invalid_argument;
+
+        StatsArgument    argument   = argument_parse(argc, argv);
+        SampleArray      samples;
+        SampleSummary    delta;
+        SampleSummary    normalized;
+        FILE            *stream     = NULL;
+        struct timespec  start      = { };
+        double           loading    = 0.0;
+        double           summing    = 0.0;
+        const unsigned   threads    = 0U != argument.threads ?
+                                      argument.threads : sample_threads();
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (const char *log : argument.logs) {
+                stream = 0 == std::strcmp("-", log) ?
+                         stdin : std::fopen(log, "r");
+                if (NULL == stream) {
+                        usage(argv[0], EXIT_FAILURE, "Cannot open the log!");
+                }
+                try {
+                        samples.load(stream);
+                } catch (const invalid_argument &error) {
+                        fprintf(stderr, "%s: %s\n", log, error.what());
+                        return EXIT_FAILURE;
+                }
+                if (stdin != stream) {
+                        std::fclose(stream);
+                }
+        }
+        loading = elapsed(start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        delta      = sample_summarize(samples.delta().data(),
+                                      samples.size(),
+                                      argument.quantiles,
+                                      threads);
+        normalized = sample_summarize(samples.normalized().data(),
+                                      samples.size(),
+                                      std::vector<double>(),
+                                      threads);
+        summing    = elapsed(start);
+
+        fprintf(stdout, "# ts-stats summary, samples in milliseconds\n");
+        fprintf(stdout, "%-24s %zu\n",        "samples", samples.size());
+        fprintf(stdout, "%-24s %" PRId64 "\n", "delta.min", delta.min);
+        fprintf(stdout, "%-24s %.3f\n",       "delta.mean", delta.mean);
+        fprintf(stdout, "%-24s %.3f\n",       "delta.stddev", delta.stddev);
+        for (size_t i = 0U; i < argument.percentiles.size(); ++i) {
+                fprintf(stdout, "%-24s %" PRId64 "\n",
+                        ("delta.p" + argument.percentiles[i]).c_str(),
+                        delta.percentile[i]);
+        }
+        fprintf(stdout, "%-24s %" PRId64 "\n", "delta.max", delta.max);
+        fprintf(stdout, "%-24s %" PRId64 "\n", "normalized.min",
+                normalized.min);
+        fprintf(stdout, "%-24s %" PRId64 "\n", "normalized.max",
+                normalized.max);
+        fprintf(stdout, "%-24s %u\n",         "threads", threads);
+        fprintf(stdout, "%-24s %s\n",         "vector",
+                sample_accelerated() ? "avx2" : "none");
+        fprintf(stdout, "%-24s %.3f\n",       "seconds.load", loading);
+        fprintf(stdout, "%-24s %.3f\n",       "seconds.summary", summing);
+        return EXIT_SUCCESS;
+}
+
+StatsArgument argument_parse(int argc, char *argv[])
+{
+        using std::string;
+
+        int                         opt              = 0;
+        uintmax_t                   number           = 0U;
+        StatsArgument               argument         = { 0U, { }, { }, { } };
+        static const char *const    TSSTATS_FLAGS    = ":hj:p:";
+        const string                PROGRAM_NAME     = string(argv[0]);
+        static const struct option  LONG_OPTIONS[] = {
+                {"help",        no_argument,       NULL, 'h'},
+                {"jobs",        required_argument, NULL, 'j'},
+                {"percentiles", required_argument, NULL, 'p'},
+                {
+                        .name    = NULL,
+                        .has_arg = 0,
+                        .flag    = NULL,
+                        .val     = 0
+                }
+        };
+
+        while (-1 != (opt = getopt_long(argc,
+                                        argv,
+                                        TSSTATS_FLAGS,
+                                        LONG_OPTIONS,
+                                        NULL))) {
+                switch (opt) {
+                case 'j':
+                        if (!number_validate(optarg, &number) ||
+                            0U == number || 1024U < number) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        argument.threads = static_cast<unsigned>(number);
+                        break;
+                case 'p':
+                        if (!percentiles_validate(optarg, &argument)) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        break;
+                case '?':
+                        usage(PROGRAM_NAME.c_str(),
+                              EXIT_FAILURE,
+                              "There is no such option!");
+                case ':':
+                        usage(PROGRAM_NAME.c_str(),
+                              EXIT_FAILURE,
+                              "Missing argument!");
+                case 'h':
+                default:
+                        usage(PROGRAM_NAME.c_str(), EXIT_FAILURE, NULL);
+                }
+        }
+
+        if (argument.percentiles.empty()) {
+                percentiles_validate("50,90,99,99.9", &argument);
+        }
+        for (int i = optind; i < argc; ++i) {
+                argument.logs.push_back(argv[i]);
+        }
+        if (argument.logs.empty()) {
+                argument.logs.push_back("-");
+        }
+        return argument;
+}
+
+/* Seconds since 'start' on CLOCK_MONOTONIC. */
+static double elapsed(const struct timespec &start)
+{
+        struct timespec now = { };
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return static_cast<double>(now.tv_sec - start.tv_sec) +
+               static_cast<double>(now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static bool number_validate(const char *const candidate, uintmax_t *result)
+{
+        char *endptr = NULL;
+
+        errno   = 0;
+        *result = strtoumax(candidate, &endptr, 10);
+        return !(ERANGE == errno || endptr == candidate || '\0' != *endptr);
+}
+
+/*
+ * Replaces the percentiles with the comma separated list in 'candidate';
+ * "99.9" is reported as "p999", like the summary of 'ts -S'.
+ */
+static bool percentiles_validate(const char *const  candidate,
+                                 StatsArgument     *argument)
+{
+        const char *begin   = candidate;
+        char       *endptr  = NULL;
+        double      percent = 0.0;
+        std::string name;
+
+        argument->percentiles.clear();
+        argument->quantiles.clear();
+        for (;;) {
+                errno   = 0;
+                percent = std::strtod(begin, &endptr);
+                if (ERANGE == errno || endptr == begin || percent < 0.0 ||
+                    percent > 100.0 || (',' != *endptr && '\0' != *endptr)) {
+                        return false;
+                }
+                name.clear();
+                for (const char *digit = begin; digit != endptr; ++digit) {
+                        if ('.' != *digit) {
+                                name += *digit;
+                        }
+                }
+                argument->percentiles.push_back(name);
+                argument->quantiles.push_back(percent / 100.0);
+                if ('\0' == *endptr) {
+                        return true;
+                }
+                begin = endptr + 1;
+        }
+}
+
+static void usage(const char *name, int status, const char *msg)
+{
+        using std::fprintf;
+
+        if (NULL != msg) {
+                fprintf(stderr,
+                        "[" ANSI_COLOR_BLUE "Error" ANSI_COLOR_RESET "]\n"
+                        "%s\n\n",
+                        msg);
+        }
+        fprintf(stderr,
+                "[" ANSI_COLOR_BLUE "Usage" ANSI_COLOR_RESET "]\n"
+                "%s [-h] [-j JOBS] [-p PERCENTILE[,PERCENTILE...]] "
+                "[LOG | -]...\n\n"
+
+                "Summarizes the samples of every "
+                ANSI_COLOR_MAGENTA "LOG" ANSI_COLOR_RESET
+                " written by 'ts -r' (the parts of a\n"
+                "rotated log in order), or of the standard input; the "
+                "summary is exact,\nnot an estimate.\n\n"
+
+                "[" ANSI_COLOR_BLUE "Optional Arguments" ANSI_COLOR_RESET "]\n"
+                "-h, --help\t\tshow this help message and exit\n"
+                "-j, --jobs\t\tthreads to summarize on (default: one per "
+                "allowed CPU)\n"
+                "-p, --percentiles\tpercentiles of DELTA to report "
+                "(default 50,90,99,99.9)\n\n",
+                NULL == name ? "" : name);
+        std::exit(status);
+}
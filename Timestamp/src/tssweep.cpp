@@ -0,0 +1,207 @@
+/**
+ * @file tssweep.cpp
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Main driver of the ts-sweep program; the local, parallel counterpart of
+ * tsTest.py.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+/* All the depedendent headers are put into a separate private header. */
+#define TSSWEEPONLY
+#include "sweeputil.h"
+#undef  TSSWEEPONLY
+
+int main(int argc, char *argv[])
+{
+        SweepSpec spec  = argument_parse(argc, argv);
+        Sweep     sweep(spec);
+
+        return -1 == sweep.run(stdout) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+SweepSpec argument_parse(int argc, char *argv[])
+{
+        using std::invalid_argument;
+        using std::string;
+
+        int                         opt              = 0;
+        uintmax_t                   number           = 0U;
+        SweepSpec                   spec;
+        FILE                       *stream           = NULL;
+        /*
+         * Command line settings are collected as spec lines, applied after
+         * the spec file so that they take precedence over it.
+         */
+        string                      override;
+        static const char *const    TSSWEEP_FLAGS    = ":c:e:hj:r:";
+        const string                PROGRAM_NAME     = string(argv[0]);
+        static const struct option  LONG_OPTIONS[] = {
+                {"count",       required_argument, NULL, 'c'},
+                {"cpus",        required_argument, NULL, OPT_CPUS},
+                {"help",        no_argument,       NULL, 'h'},
+                {"jobs",        required_argument, NULL, 'j'},
+                {"repeat",      required_argument, NULL, 'r'},
+                {"set",         required_argument, NULL, 'e'},
+                {
+                        .name    = NULL,
+                        .has_arg = 0,
+                        .flag    = NULL,
+                        .val     = 0
+                }
+        };
+
+        while (-1 != (opt = getopt_long(argc,
+                                        argv,
+                                        TSSWEEP_FLAGS,
+                                        LONG_OPTIONS,
+                                        NULL))) {
+                switch (opt) {
+                case 'c':
+                case 'j':
+                case 'r':
+                        if (!number_validate(optarg, &number)) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Invalid argument!");
+                        }
+                        override += 'c' == opt ? "count " :
+                                    'j' == opt ? "jobs " : "repeat ";
+                        override += optarg;
+                        override += '\n';
+                        break;
+                case 'e':
+                        override += optarg;
+                        override += '\n';
+                        break;
+                case OPT_CPUS:
+                        override += "cpus ";
+                        override += optarg;
+                        override += '\n';
+                        break;
+                case '?':
+                        usage(PROGRAM_NAME.c_str(),
+                              EXIT_FAILURE,
+                              "There is no such option!");
+                case ':':
+                        usage(PROGRAM_NAME.c_str(),
+                              EXIT_FAILURE,
+                              "Missing argument!");
+                case 'h':
+                default:
+                        usage(PROGRAM_NAME.c_str(), EXIT_FAILURE, NULL);
+                }
+        }
+        if (argc - optind > 1) {
+                usage(PROGRAM_NAME.c_str(), EXIT_FAILURE, "Too many files!");
+        }
+
+        try {
+                if (optind < argc) {
+                        stream = 0 == std::strcmp("-", argv[optind]) ?
+                                 stdin : std::fopen(argv[optind], "r");
+                        if (NULL == stream) {
+                                usage(PROGRAM_NAME.c_str(),
+                                      EXIT_FAILURE,
+                                      "Cannot open the spec file!");
+                        }
+                        spec.load(stream);
+                        if (stdin != stream) {
+                                std::fclose(stream);
+                        }
+                }
+                if (!override.empty()) {
+                        stream = fmemopen(&override[0], override.size(), "r");
+                        if (NULL == stream) {
+                                throw std::runtime_error("argument_parse(): "
+                                                         "fmemopen() failed");
+                        }
+                        spec.load(stream);
+                        std::fclose(stream);
+                }
+        } catch (const invalid_argument &error) {
+                usage(PROGRAM_NAME.c_str(), EXIT_FAILURE, error.what());
+        }
+        return spec;
+}
+
+static bool number_validate(const char *const candidate, uintmax_t *result)
+{
+        char *endptr = NULL;
+
+        errno   = 0;
+        *result = strtoumax(candidate, &endptr, 10);
+        return !(ERANGE == errno || endptr == candidate || '\0' != *endptr);
+}
+
+static void usage(const char *name, int status, const char *msg)
+{
+        using std::fprintf;
+
+        if (NULL != msg) {
+                fprintf(stderr,
+                        "[" ANSI_COLOR_BLUE "Error" ANSI_COLOR_RESET "]\n"
+                        "%s\n\n",
+                        msg);
+        }
+        fprintf(stderr,
+                "[" ANSI_COLOR_BLUE "Usage" ANSI_COLOR_RESET "]\n"
+                "%s [-h] [-c COUNT] [-r REPEAT] [-j JOBS] [--cpus CPU,...]\n"
+                "[-e 'KEY VALUE[,VALUE...]']... [SPEC_FILE | -]\n\n"
+
+                "Runs 'ts' over a local channel for every point of the "
+                "matrix in\n"
+                ANSI_COLOR_MAGENTA "SPEC_FILE" ANSI_COLOR_RESET
+                ", REPEAT times each and JOBS points at a time, and "
+                "prints\n"
+                "the mean and 95%% confidence interval of every point.\n\n"
+
+                "[" ANSI_COLOR_BLUE "Optional Arguments" ANSI_COLOR_RESET "]\n"
+                "-h, --help\tshow this help message and exit\n"
+                "-c, --count\tmessages per run (default 1024)\n"
+                "-r, --repeat\truns per point (default 5)\n"
+                "-j, --jobs\truns at a time (default: one per set of "
+                "CPUs)\n"
+                "--cpus\t\tCPUs to run on, 2 per run or 3 with "
+                "impairments\n\t\t(default: all allowed)\n"
+                "-e, --set\tany setting of the spec file, e.g. "
+                "-e 'loss 0,1,5'\n"
+                "\n[" ANSI_COLOR_BLUE "SPEC FILE" ANSI_COLOR_RESET "]\n"
+                "One 'KEY VALUE' per line, '#' starts a comment; lists "
+                "are comma separated:\n"
+                "channel  pipe|socketpair|tcp|udp\n"
+                "pad      padding sizes in bytes\n"
+                "rate     messages per second, 0 for unlimited\n"
+                "delay    one-way delays in microseconds\n"
+                "jitter   jitters in microseconds\n"
+                "loss     loss percentages\n"
+                "reorder  reorder percentages (with datagram yes)\n"
+                "datagram yes|no, drop lost frames instead of "
+                "retransmitting\n"
+                "rto      retransmission timeout in microseconds\n"
+                "count, repeat, jobs, cpus, batch, payload, pipeline\n\n",
+                NULL == name ? "" : name);
+        std::exit(status);
+}
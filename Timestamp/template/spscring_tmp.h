@@ -0,0 +1,146 @@
+/**
+ * @file spscring_tmp.h
+ * @author Jiahui Xie
+ *
+ * @section LICENSE
+ *
+ * Copyright © 2016 Jiahui Xie
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Template header of a bounded lock-free single-producer/single-consumer
+ * ring; the producer and the consumer indices live on their own cache lines
+ * so the two threads never write to the same line, and each side keeps a
+ * private copy of the other side's index to avoid touching the shared line
+ * on every operation.
+ */
+
+#ifndef SPSCRING_TMP_H
+#define SPSCRING_TMP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>   /* posix_memalign() free() */
+#include <stdexcept> /* invalid_argument runtime_error */
+#include <type_traits>
+
+#include "cmnutil.h"
+
+template<typename Type>
+class SPSCRing final {
+        static_assert(std::is_trivially_copyable<Type>::value,
+                      "SPSCRing<> only carries trivially copyable records");
+public:
+        /* 'capacity' has to be a power of two. */
+        explicit SPSCRing(size_t capacity)
+                :
+                mask_{capacity - 1U},
+                slot_{NULL}
+        {
+                using std::invalid_argument;
+                using std::runtime_error;
+
+                void *memory = NULL;
+
+                if (0U == capacity || 0U != (capacity & mask_)) {
+                        throw invalid_argument("SPSCRing(): capacity must be "
+                                               "a power of two");
+                }
+                if (0 != posix_memalign(&memory,
+                                        CMNUTIL_CACHE_LINE,
+                                        capacity * sizeof(Type))) {
+                        throw runtime_error("SPSCRing(): "
+                                            "posix_memalign() call failed");
+                }
+                slot_ = reinterpret_cast<Type *>(memory);
+                producer_.index.store(0U, std::memory_order_relaxed);
+                producer_.cache = 0U;
+                consumer_.index.store(0U, std::memory_order_relaxed);
+                consumer_.cache = 0U;
+        }
+        SPSCRing(const SPSCRing &)               = delete;
+        SPSCRing(const SPSCRing &&)              = delete;
+        SPSCRing &operator = (const SPSCRing &)  = delete;
+        SPSCRing &operator = (const SPSCRing &&) = delete;
+        ~SPSCRing()
+        {
+                std::free(slot_);
+        }
+
+        size_t capacity() const
+        {
+                return mask_ + 1U;
+        }
+
+        /* Producer side only; returns false if the ring is full. */
+        bool push(const Type &record)
+        {
+                size_t head = producer_.index.load(std::memory_order_relaxed);
+
+                if (head - producer_.cache > mask_) {
+                        producer_.cache = consumer_.index.load(
+                                                std::memory_order_acquire);
+                        if (head - producer_.cache > mask_) {
+                                return false;
+                        }
+                }
+                slot_[head & mask_] = record;
+                producer_.index.store(head + 1U, std::memory_order_release);
+                return true;
+        }
+
+        /* Consumer side only; returns false if the ring is empty. */
+        bool pop(Type &record)
+        {
+                size_t tail = consumer_.index.load(std::memory_order_relaxed);
+
+                if (tail == consumer_.cache) {
+                        consumer_.cache = producer_.index.load(
+                                                std::memory_order_acquire);
+                        if (tail == consumer_.cache) {
+                                return false;
+                        }
+                }
+                record = slot_[tail & mask_];
+                consumer_.index.store(tail + 1U, std::memory_order_release);
+                return true;
+        }
+
+        /* Approximate when called concurrently; exact once both sides idle. */
+        size_t size() const
+        {
+                return producer_.index.load(std::memory_order_acquire) -
+                       consumer_.index.load(std::memory_order_acquire);
+        }
+
+private:
+        /*
+         * 'index' is written by its owner only; 'cache' is the owner's last
+         * observation of the opposite index.
+         */
+        struct alignas(CMNUTIL_CACHE_LINE) Side_ {
+                std::atomic<size_t> index;
+                size_t              cache;
+        };
+
+        /* data */
+        const size_t mask_;
+        Type        *slot_;
+        Side_        producer_;
+        Side_        consumer_;
+};
+
+#endif /* SPSCRING_TMP_H */
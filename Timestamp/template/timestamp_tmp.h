@@ -22,8 +22,11 @@
  * @section DESCRIPTION
  *
  * Template header for the main sending and receiving functionality of
- * the timestamp program; along with a utility template function for doing
- * conversion between two scalar numeric types.
+ * the timestamp program, specialized at compile time: the transport, the
+ * codec, the clock and the sink of the samples are policies fixed by the
+ * instantiation, and so may be the padding size, so the per frame loop
+ * carries no branch on any of them.  The TimeStamp class remains the
+ * general path; engine.cpp decides which configurations come here.
  */
 
 #ifndef TIMESTAMP_TMP_H
@@ -33,81 +36,1624 @@
 #define _GNU_SOURCE
 #endif
 
-#include "timestamp.h"
-
-
-#include <ctime>
-#include <cstdio>
-#include <cstdlib>
-#include <cstring>
-#include <stdexcept>
+#include <climits>   /* SIZE_MAX */
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>    /* fwrite() */
+#include <cstring>   /* memcpy() memset() */
+#include <limits>    /* numeric_limits */
+#include <utility>   /* forward() */
+#include <vector>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#include <unistd.h>     /* clock_gettime() read() write() */
+#include <sys/uio.h> /* iovec */
+#include <time.h>    /* clock_gettime() */
 
 #ifdef __cplusplus
 }
 #endif
+
+#include "cmnutil.h"
+#include "crc32c.h"
+#include "fdreader.h"
+#include "frame.h"
+#include "histogram.h"
+#include "jitter.h"
+#include "logfile.h"
+#include "payload.h"
+#include "schedule.h"
+#include "shmring.h"
+#include "timestamp.h"
+#include "traffic.h"
+
+/* Padding size argument of TimeStampEngine::send() known only at run time. */
+#define TIMESTAMP_DYNAMIC_PAD SIZE_MAX
+
+/*
+ * Clock policies: where the stamps come from.  The coarse clock is read
+ * without a system call at the resolution of the scheduler tick.
+ */
+struct RealtimeClock {
+        static int now(struct timespec *stamp)
+        {
+                return clock_gettime(CLOCK_REALTIME, stamp);
+        }
+};
+
+struct CoarseClock {
+        static int now(struct timespec *stamp)
+        {
+                return clock_gettime(CLOCK_REALTIME_COARSE, stamp);
+        }
+};
+
 /*
- * Note the while loop calling write() is based on the
- * "BSD Sockets: A Quick And Dirty Primer" by Jim Frost.
+ * Transport policies: how whole frames, or for a codec of its own a byte
+ * stream, get from one end to the other.
  */
-template<typename IntType>
-IntType timestamp(size_t pad_size, IntType rs_count, TimeStampMode mode)
-{
-        using std::fclose;
-        using std::free;
-        using std::fprintf;
-        using std::malloc;
-
-        IntType        i                     = 0;
-        bool           force_break           = false;
-        struct tm      tmp_tm                = { };
-        char           tmp_strftime[1 << 13] = { };
-        TimeStamp     *current               = NULL;
-        FILE          *log_file              = timestamp_log_setup(mode);
-
-        if (NULL == log_file) {
-                force_break = true;
-        }
-
-        memset(current, 0, (sizeof current) + pad_size);
-        memset(&tmp_tm, 0, sizeof tmp_tm);
-        memset(tmp_strftime, 0, sizeof tmp_strftime);
-
-        for (i = 0; false == force_break && i < rs_count; ++i) {
-                if (NULL == timestamp_manipulate(current, mode)) {
-                        force_break = true;
+class FdTransport final {
+public:
+        /* Bytes may be read and written in any pieces. */
+        static constexpr bool STREAM = true;
+
+        FdTransport()                                   = delete;
+        FdTransport(const FdTransport &)                = delete;
+        FdTransport(const FdTransport &&)               = delete;
+        /*
+         * A sender passes 0 for 'capacity' and never allocates a buffer;
+         * a receiver takes frames of up to 'capacity' or FRAME_LENGTH_MAX
+         * bytes of padding, whichever is more, see overrun().
+         * Note the class does NOT take ownership of 'fd'.
+         */
+        FdTransport(int fd, size_t capacity)
+                :
+                fd_{fd},
+                reader_(fd, capacity),
+                length_max_{capacity > FRAME_LENGTH_MAX ?
+                            capacity : FRAME_LENGTH_MAX},
+                overrun_{false}
+        {
+        }
+
+        bool send_frame(const FrameHeader &header,
+                        const char        *padding,
+                        size_t             len)
+        {
+                struct iovec iov[2] = {
+                        {const_cast<FrameHeader *>(&header), sizeof header},
+                        {const_cast<char *>(padding),        len}
+                };
+
+                return static_cast<ssize_t>(sizeof header + len) ==
+                       bseq_writev(fd_, iov, 0U == len ? 1 : 2);
+        }
+
+        /* Appends the 'tail_len' bytes of 'tail' to the padding. */
+        bool send_frame(const FrameHeader &header,
+                        const char        *padding,
+                        size_t             len,
+                        const char        *tail,
+                        size_t             tail_len)
+        {
+                struct iovec iov[3] = {
+                        {const_cast<FrameHeader *>(&header), sizeof header},
+                        {const_cast<char *>(padding),        len},
+                        {const_cast<char *>(tail),           tail_len}
+                };
+
+                return static_cast<ssize_t>(sizeof header + len +
+                                            tail_len) ==
+                       bseq_writev(fd_, iov, 3);
+        }
+
+        bool receive_frame(FrameHeader *header)
+        {
+                const char *padding = NULL;
+
+                return receive_frame(header, &padding);
+        }
+
+        /* Also hands out the padding, valid until the next call. */
+        bool receive_frame(FrameHeader *header, const char **padding)
+        {
+                const void *data = reader_.next(sizeof *header);
+
+                if (NULL == data) {
+                        return false;
+                }
+                /* Frames are packed back to back, so it may be unaligned. */
+                std::memcpy(header, data, sizeof *header);
+                if (0U == header->length) {
+                        *padding = NULL;
+                        return true;
+                }
+                if (header->length > length_max_) {
+                        overrun_ = true;
+                        return false;
+                }
+                *padding = static_cast<const char *>(
+                                reader_.next(header->length));
+                return NULL != *padding;
+        }
+
+        bool write(const char *data, size_t len)
+        {
+                return static_cast<ssize_t>(len) ==
+                       bseq_write(fd_, data, len);
+        }
+
+        const char *read_some(size_t *len)
+        {
+                return static_cast<const char *>(reader_.some(len));
+        }
+
+        void consume(size_t len)
+        {
+                reader_.skip(len);
+        }
+
+        /* See FdReader::limit(). */
+        void limit(uint64_t idle_ms, const struct timespec *deadline)
+        {
+                reader_.limit(idle_ms, deadline);
+        }
+
+        bool timed_out() const
+        {
+                return reader_.timed_out();
+        }
+
+        /*
+         * Whether receiving stopped at a frame claiming more padding than
+         * it may have; nothing after it can be told apart any more.
+         */
+        bool overrun() const
+        {
+                return overrun_;
+        }
+
+        FdTransport &operator =(const FdTransport &)    = delete;
+        FdTransport &operator =(const FdTransport &&)   = delete;
+
+private:
+        /* data */
+        int      fd_;
+        FdReader reader_;
+        size_t   length_max_;
+        bool     overrun_;
+};
+
+class ShmTransport final {
+public:
+        /* Only ever carries whole frames, one per slot. */
+        static constexpr bool STREAM = false;
+
+        ShmTransport()                                  = delete;
+        ShmTransport(const ShmTransport &)              = delete;
+        ShmTransport(const ShmTransport &&)             = delete;
+        /* Same arguments as the ShmRing it wraps. */
+        ShmTransport(const char *name,
+                     size_t      frame,
+                     ShmRingRole role,
+                     bool        spin)
+                :
+                ring_(name, frame, role, spin),
+                held_{false}
+        {
+        }
+
+        bool send_frame(const FrameHeader &header,
+                        const char        *padding,
+                        size_t             len)
+        {
+                char *slot = static_cast<char *>(ring_.reserve());
+
+                if (NULL == slot) {
+                        return false;
+                }
+                std::memcpy(slot, &header, sizeof header);
+                std::memcpy(slot + sizeof header, padding, len);
+                ring_.commit();
+                return true;
+        }
+
+        /* Appends the 'tail_len' bytes of 'tail' to the padding. */
+        bool send_frame(const FrameHeader &header,
+                        const char        *padding,
+                        size_t             len,
+                        const char        *tail,
+                        size_t             tail_len)
+        {
+                char *slot = static_cast<char *>(ring_.reserve());
+
+                if (NULL == slot) {
+                        return false;
+                }
+                std::memcpy(slot, &header, sizeof header);
+                std::memcpy(slot + sizeof header, padding, len);
+                std::memcpy(slot + sizeof header + len, tail, tail_len);
+                ring_.commit();
+                return true;
+        }
+
+        bool receive_frame(FrameHeader *header)
+        {
+                const char *padding = NULL;
+
+                if (!receive_frame(header, &padding)) {
+                        return false;
+                }
+                /* The padding is never looked at, so it is left in place. */
+                ring_.release();
+                held_ = false;
+                return true;
+        }
+
+        /*
+         * Also hands out the padding, NULL if 'length' overruns the slot;
+         * the slot is only handed back to the producer by the next call.
+         */
+        bool receive_frame(FrameHeader *header, const char **padding)
+        {
+                const char *slot = NULL;
+
+                if (held_) {
+                        ring_.release();
+                        held_ = false;
+                }
+                if (NULL == (slot = static_cast<const char *>(
+                                     ring_.acquire()))) {
+                        return false;
+                }
+                std::memcpy(header, slot, sizeof *header);
+                *padding = header->length >
+                           ring_.slot_size() - sizeof *header ?
+                           NULL : slot + sizeof *header;
+                held_    = true;
+                return true;
+        }
+
+        const ShmRing &ring() const
+        {
+                return ring_;
+        }
+
+        /* See ShmRing::limit(). */
+        void limit(uint64_t idle_ms, const struct timespec *deadline)
+        {
+                ring_.limit(idle_ms, deadline);
+        }
+
+        bool timed_out() const
+        {
+                return ring_.timed_out();
+        }
+
+        /* A slot bounds every frame, see receive_frame(). */
+        bool overrun() const
+        {
+                return false;
+        }
+
+        ShmTransport &operator =(const ShmTransport &)  = delete;
+        ShmTransport &operator =(const ShmTransport &&) = delete;
+
+private:
+        /* data */
+        ShmRing ring_;
+        /* Whether the last slot acquired is still to be released. */
+        bool    held_;
+};
+
+/* Codec policies: what frames look like on the transport. */
+struct RawCodec {
+        template<typename Transport>
+        bool encode(Transport         &transport,
+                    const FrameHeader &header,
+                    const char        *padding,
+                    size_t             len)
+        {
+                return transport.send_frame(header, padding, len);
+        }
+
+        /* Appends the 'tail_len' bytes of 'tail' to the padding. */
+        template<typename Transport>
+        bool encode(Transport         &transport,
+                    const FrameHeader &header,
+                    const char        *padding,
+                    size_t             len,
+                    const char        *tail,
+                    size_t             tail_len)
+        {
+                return transport.send_frame(header,
+                                            padding,
+                                            len,
+                                            tail,
+                                            tail_len);
+        }
+
+        template<typename Transport>
+        bool flush(Transport &)
+        {
+                return true;
+        }
+
+        template<typename Transport>
+        bool decode(Transport &transport, FrameHeader *header)
+        {
+                return transport.receive_frame(header);
+        }
+
+        /* Also hands out the padding, valid until the next call. */
+        template<typename Transport>
+        bool decode(Transport   &transport,
+                    FrameHeader *header,
+                    const char **padding)
+        {
+                return transport.receive_frame(header, padding);
+        }
+
+        /* The transport tells, see FdTransport::overrun(). */
+        bool overrun() const
+        {
+                return false;
+        }
+};
+
+/*
+ * Produces exactly what the base64 BIO of OpenSSL does, a line of 64
+ * characters per 48 bytes and the remainder padded on flush, so either end
+ * may be the TimeStamp class; every frame is encoded into one write.
+ * The decoder skips anything outside of the alphabet, but a '=' drops the
+ * fill bits of the quantum it ends, so flushed pieces may follow each other.
+ */
+class Base64Codec final {
+public:
+        Base64Codec()                                   = delete;
+        Base64Codec(const Base64Codec &)                = delete;
+        Base64Codec(const Base64Codec &&)               = delete;
+        /*
+         * 'frame' is the frame size, header included, to size buffers by;
+         * the decoder takes frames of up to 'frame' or FRAME_LENGTH_MAX
+         * bytes of padding, whichever is more, see overrun().
+         */
+        explicit Base64Codec(size_t frame)
+                :
+                carry_len_{0U},
+                out_len_{0U},
+                out_((frame / BLOCK + 2U) * (LINE + 1U)),
+                plain_(1U << 16),
+                plain_begin_{0U},
+                plain_end_{0U},
+                bits_{0U},
+                accumulator_{0U},
+                value_{table_().value},
+                padding_(frame),
+                length_max_{frame > FRAME_LENGTH_MAX ?
+                            frame : FRAME_LENGTH_MAX},
+                overrun_{false}
+        {
+        }
+
+        template<typename Transport>
+        bool encode(Transport         &transport,
+                    const FrameHeader &header,
+                    const char        *padding,
+                    size_t             len)
+        {
+                return encode(transport, header, padding, len, NULL, 0U);
+        }
+
+        /* Appends the 'tail_len' bytes of 'tail' to the padding. */
+        template<typename Transport>
+        bool encode(Transport         &transport,
+                    const FrameHeader &header,
+                    const char        *padding,
+                    size_t             len,
+                    const char        *tail,
+                    size_t             tail_len)
+        {
+                static_assert(Transport::STREAM,
+                              "base64 needs a byte stream transport");
+                const size_t need = ((carry_len_ + sizeof header + len +
+                                      tail_len) / BLOCK + 2U) * (LINE + 1U);
+
+                if (need > out_.size()) {
+                        out_.resize(need);
+                }
+                append_(reinterpret_cast<const unsigned char *>(&header),
+                        sizeof header);
+                append_(reinterpret_cast<const unsigned char *>(padding),
+                        len);
+                append_(reinterpret_cast<const unsigned char *>(tail),
+                        tail_len);
+                return drain_(transport);
+        }
+
+        template<typename Transport>
+        bool flush(Transport &transport)
+        {
+                static_assert(Transport::STREAM,
+                              "base64 needs a byte stream transport");
+                char *out = &out_[out_len_];
+
+                if (0U == carry_len_) {
+                        return drain_(transport);
+                }
+                std::memset(carry_ + carry_len_, 0, 3U);
+                for (size_t i = 0U; i < carry_len_; i += 3U) {
+                        out = quantum_(out, carry_ + i);
+                }
+                /* 1 or 2 bytes left over take 2 or 3 significant digits. */
+                switch (carry_len_ % 3U) {
+                case 1U:
+                        out[-2] = '=';
+                        out[-1] = '=';
+                        break;
+                case 2U:
+                        out[-1] = '=';
                         break;
                 }
-                if (TimeStampMode::RECEIVE == mode) {
-                        if (NULL == localtime_r(&current->timespec.tv_sec,
-                                                &tmp_tm)) {
-                                force_break = true;
+                *out++     = '\n';
+                out_len_   = static_cast<size_t>(out - out_.data());
+                carry_len_ = 0U;
+                return drain_(transport);
+        }
+
+        template<typename Transport>
+        bool decode(Transport &transport, FrameHeader *header)
+        {
+                static_assert(Transport::STREAM,
+                              "base64 needs a byte stream transport");
+                return fetch_(transport,
+                              reinterpret_cast<unsigned char *>(header),
+                              sizeof *header) &&
+                       bound_(*header) &&
+                       fetch_(transport, NULL, header->length);
+        }
+
+        /* Also hands out the padding, valid until the next call. */
+        template<typename Transport>
+        bool decode(Transport   &transport,
+                    FrameHeader *header,
+                    const char **padding)
+        {
+                static_assert(Transport::STREAM,
+                              "base64 needs a byte stream transport");
+                if (!fetch_(transport,
+                            reinterpret_cast<unsigned char *>(header),
+                            sizeof *header) || !bound_(*header)) {
+                        return false;
+                }
+                if (header->length > padding_.size()) {
+                        padding_.resize(header->length);
+                }
+                *padding = reinterpret_cast<const char *>(padding_.data());
+                return fetch_(transport, padding_.data(), header->length);
+        }
+
+        /* Same as FdTransport::overrun(). */
+        bool overrun() const
+        {
+                return overrun_;
+        }
+
+        Base64Codec &operator =(const Base64Codec &)    = delete;
+        Base64Codec &operator =(const Base64Codec &&)   = delete;
+
+private:
+        /* Input bytes per line of output and characters per line. */
+        static const size_t BLOCK = 48U;
+        static const size_t LINE  = 64U;
+
+        struct Table_ {
+                Table_()
+                {
+                        std::memset(value, 0xff, sizeof value);
+                        for (unsigned i = 0U; i < 64U; ++i) {
+                                value[static_cast<unsigned char>(
+                                        ALPHABET[i])] =
+                                        static_cast<unsigned char>(i);
+                        }
+                }
+
+                unsigned char value[256];
+        };
+
+        static constexpr const char *ALPHABET =
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+                "0123456789+/";
+
+        /* data */
+        unsigned char        carry_[BLOCK + 3U];
+        size_t               carry_len_;
+        size_t               out_len_;
+        std::vector<char>    out_;
+        std::vector<unsigned char> plain_;
+        size_t               plain_begin_;
+        size_t               plain_end_;
+        unsigned             bits_;
+        uint32_t             accumulator_;
+        const unsigned char *value_;
+        /* Where decode() puts the padding, if asked for it. */
+        std::vector<unsigned char> padding_;
+        size_t               length_max_;
+        bool                 overrun_;
+
+        static const Table_ &table_()
+        {
+                static const Table_ table;
+
+                return table;
+        }
+
+        /* Whether the padding 'header' claims can be taken on trust. */
+        bool bound_(const FrameHeader &header)
+        {
+                if (header.length > length_max_) {
+                        overrun_ = true;
+                }
+                return !overrun_;
+        }
+
+        static char *quantum_(char *out, const unsigned char *in)
+        {
+                const uint32_t group = static_cast<uint32_t>(in[0]) << 16 |
+                                       static_cast<uint32_t>(in[1]) << 8 |
+                                       static_cast<uint32_t>(in[2]);
+
+                out[0] = ALPHABET[group >> 18];
+                out[1] = ALPHABET[group >> 12 & 0x3fU];
+                out[2] = ALPHABET[group >> 6 & 0x3fU];
+                out[3] = ALPHABET[group & 0x3fU];
+                return out + 4;
+        }
+
+        /* Encodes whole lines straight from 'in', carrying the rest over. */
+        void append_(const unsigned char *in, size_t len)
+        {
+                size_t take = 0U;
+
+                while (0U != len) {
+                        if (0U == carry_len_ && len >= BLOCK) {
+                                line_(in);
+                                in  += BLOCK;
+                                len -= BLOCK;
+                                continue;
+                        }
+                        take = BLOCK - carry_len_ < len ?
+                               BLOCK - carry_len_ : len;
+                        std::memcpy(carry_ + carry_len_, in, take);
+                        carry_len_ += take;
+                        in         += take;
+                        len        -= take;
+                        if (BLOCK == carry_len_) {
+                                line_(carry_);
+                                carry_len_ = 0U;
+                        }
+                }
+        }
+
+        void line_(const unsigned char *in)
+        {
+                char *out = &out_[out_len_];
+
+                for (size_t i = 0U; i < BLOCK; i += 3U) {
+                        out = quantum_(out, in + i);
+                }
+                *out      = '\n';
+                out_len_ += LINE + 1U;
+        }
+
+        template<typename Transport>
+        bool drain_(Transport &transport)
+        {
+                const size_t len = out_len_;
+
+                out_len_ = 0U;
+                return 0U == len || transport.write(out_.data(), len);
+        }
+
+        /* Decodes 'len' bytes into 'out', or discards them if it is NULL. */
+        template<typename Transport>
+        bool fetch_(Transport &transport, unsigned char *out, size_t len)
+        {
+                size_t take = 0U;
+
+                while (0U != len) {
+                        if (plain_begin_ == plain_end_) {
+                                if (!refill_(transport)) {
+                                        return false;
+                                }
+                                continue;
+                        }
+                        take = plain_end_ - plain_begin_ < len ?
+                               plain_end_ - plain_begin_ : len;
+                        if (NULL != out) {
+                                std::memcpy(out, &plain_[plain_begin_], take);
+                                out += take;
+                        }
+                        plain_begin_ += take;
+                        len          -= take;
+                }
+                return true;
+        }
+
+        /* Decodes whatever the transport has buffered, as much as fits. */
+        template<typename Transport>
+        bool refill_(Transport &transport)
+        {
+                size_t          len   = 0U;
+                size_t          i     = 0U;
+                unsigned char   digit = 0U;
+                const char     *data  = transport.read_some(&len);
+
+                if (NULL == data) {
+                        return false;
+                }
+                plain_begin_ = 0U;
+                plain_end_   = 0U;
+                for (i = 0U; i < len && plain_end_ < plain_.size(); ++i) {
+                        digit = value_[static_cast<unsigned char>(data[i])];
+                        if (64U <= digit) {
+                                if ('=' == data[i]) {
+                                        bits_ = 0U;
+                                }
+                                continue;
+                        }
+                        accumulator_ = accumulator_ << 6 | digit;
+                        bits_       += 6U;
+                        if (8U <= bits_) {
+                                bits_ -= 8U;
+                                plain_[plain_end_++] = static_cast<
+                                        unsigned char>(accumulator_ >> bits_);
+                        }
+                }
+                transport.consume(i);
+                return true;
+        }
+};
+
+/*
+ * Wraps the codec 'Inner', which it constructs from 'args', and protects
+ * every frame with a CRC32C of its header and padding: the encoder appends
+ * it as a trailer counted in 'length' and sets FRAME_FLAG_CRC, the decoder
+ * checks and strips both again.  A frame failing the check is handed on as
+ * a FRAME_FLAG_LOST placeholder, so that it still counts towards the run,
+ * and counted in corrupt().
+ */
+template<typename Inner>
+class CrcCodec final {
+public:
+        CrcCodec(const CrcCodec &)                      = delete;
+        CrcCodec(const CrcCodec &&)                     = delete;
+        template<typename... Args>
+        explicit CrcCodec(Args &&... args)
+                :
+                inner_(std::forward<Args>(args)...),
+                corrupt_{0U}
+        {
+        }
+
+        template<typename Transport>
+        bool encode(Transport         &transport,
+                    const FrameHeader &header,
+                    const char        *padding,
+                    size_t             len)
+        {
+                FrameHeader framed = header;
+                uint32_t    crc    = 0U;
+
+                framed.length  = static_cast<uint32_t>(len + CRC32C_SIZE);
+                framed.flags  |= FRAME_FLAG_CRC;
+                crc = crc32c(crc32c(0U, &framed, sizeof framed),
+                             padding,
+                             len);
+                return inner_.encode(transport,
+                                     framed,
+                                     padding,
+                                     len,
+                                     reinterpret_cast<const char *>(&crc),
+                                     CRC32C_SIZE);
+        }
+
+        template<typename Transport>
+        bool flush(Transport &transport)
+        {
+                return inner_.flush(transport);
+        }
+
+        template<typename Transport>
+        bool decode(Transport &transport, FrameHeader *header)
+        {
+                const char *padding = NULL;
+                uint32_t    crc     = 0U;
+
+                if (!inner_.decode(transport, header, &padding)) {
+                        return false;
+                }
+                /* Placeholders of a relay have nothing to check. */
+                if (0U != (header->flags & FRAME_FLAG_LOST)) {
+                        return true;
+                }
+                if (0U != (header->flags & FRAME_FLAG_CRC) &&
+                    CRC32C_SIZE <= header->length && NULL != padding) {
+                        std::memcpy(&crc,
+                                    padding + header->length - CRC32C_SIZE,
+                                    CRC32C_SIZE);
+                        if (crc == crc32c(crc32c(0U, header, sizeof *header),
+                                          padding,
+                                          header->length - CRC32C_SIZE)) {
+                                header->length -= CRC32C_SIZE;
+                                header->flags  &= ~FRAME_FLAG_CRC;
+                                return true;
+                        }
+                }
+                ++corrupt_;
+                header->flags  = FRAME_FLAG_LOST;
+                header->length = 0U;
+                return true;
+        }
+
+        /* Frames dropped for failing the check. */
+        uint64_t corrupt() const
+        {
+                return corrupt_;
+        }
+
+        /* See FdTransport::overrun(). */
+        bool overrun() const
+        {
+                return inner_.overrun();
+        }
+
+        CrcCodec &operator =(const CrcCodec &)          = delete;
+        CrcCodec &operator =(const CrcCodec &&)         = delete;
+
+private:
+        /* data */
+        Inner             inner_;
+        uint64_t          corrupt_;
+};
+
+/*
+ * Sink policies: what becomes of each received frame.  Both keep the
+ * statistics; only SampleSink<true> also writes the "DELTA,NORMALIZED"
+ * log, in the same format as the TimeStamp class but buffered until
+ * flush() rather than flushed line by line.
+ */
+template<bool LOG>
+class SampleSink final {
+public:
+        SampleSink()                                    = delete;
+        SampleSink(const SampleSink &)                  = delete;
+        SampleSink(const SampleSink &&)                 = delete;
+        /* Note the class does NOT take ownership of 'log'. */
+        explicit SampleSink(FILE *log)
+                :
+                log_{log},
+                consumed_{0U},
+                lost_{0U},
+                initial_{},
+                delta_{},
+                jitter_{},
+                buffer_(LOG ? 1U << 16 : 0U),
+                buffer_len_{0U},
+                written_{0U},
+                fresh_{true}
+        {
+        }
+
+        int record(const FrameHeader &header, const struct timespec &received)
+        {
+                struct timespec delta      = { };
+                struct timespec normalized = { };
+                int64_t         transit    = 0;
+
+                if (LOG && fresh_) {
+                        fresh_ = false;
+                        append_("DELTA,NORMALIZED\n", 17U);
+                }
+                ++consumed_;
+                /* A frame dropped by a relay only counts. */
+                if (0U != (header.flags & FRAME_FLAG_LOST)) {
+                        ++lost_;
+                        return 0;
+                }
+                if (0U == delta_.count()) {
+                        initial_ = header.timespec;
+                }
+                delta   = diff_(received, header.timespec);
+                transit = static_cast<int64_t>(delta.tv_sec) * 1000000000 +
+                          delta.tv_nsec;
+                delta_.record(transit);
+                jitter_.record(received, transit);
+                if (LOG) {
+                        normalized = diff_(received, initial_);
+                        return line_(delta, normalized);
+                }
+                return 0;
+        }
+
+        /*
+         * Writes out and flushes what is buffered of the log, which stays
+         * open; -1 if any of it failed.
+         */
+        int flush()
+        {
+                if (!LOG) {
+                        return 0;
+                }
+                if (0U != buffer_len_ &&
+                    buffer_len_ != std::fwrite(buffer_.data(),
+                                               1U,
+                                               buffer_len_,
+                                               log_)) {
+                        return -1;
+                }
+                buffer_len_ = 0U;
+                return std::fflush(log_);
+        }
+
+        /*
+         * Goes on logging to 'log', with the column heading first if
+         * 'heading' is set; flush() has to come first.
+         */
+        void redirect(FILE *log, bool heading)
+        {
+                log_     = log;
+                written_ = 0U;
+                fresh_   = heading;
+        }
+
+        const Histogram &delta() const
+        {
+                return delta_;
+        }
+
+        const Jitter &jitter() const
+        {
+                return jitter_;
+        }
+
+        uint64_t lost() const
+        {
+                return lost_;
+        }
+
+        /* Bytes of log since the start or the last redirect(). */
+        uint64_t written() const
+        {
+                return written_;
+        }
+
+        SampleSink &operator =(const SampleSink &)      = delete;
+        SampleSink &operator =(const SampleSink &&)     = delete;
+
+private:
+        /* data */
+        FILE              *log_;
+        uint64_t           consumed_;
+        uint64_t           lost_;
+        struct timespec    initial_;
+        Histogram          delta_;
+        Jitter             jitter_;
+        std::vector<char>  buffer_;
+        size_t             buffer_len_;
+        uint64_t           written_;
+        bool               fresh_;
+
+        static struct timespec diff_(const struct timespec &end,
+                                     const struct timespec &start)
+        {
+                struct timespec result = {
+                        end.tv_sec - start.tv_sec,
+                        end.tv_nsec - start.tv_nsec
+                };
+
+                if (0 > result.tv_nsec) {
+                        --result.tv_sec;
+                        result.tv_nsec += 1000000000;
+                }
+                return result;
+        }
+
+        /* Writes 'value' in decimal so that it ends right before 'end'. */
+        static char *decimal_(char *end, int64_t value)
+        {
+                uint64_t magnitude = 0 > value ?
+                                     0U - static_cast<uint64_t>(value) :
+                                     static_cast<uint64_t>(value);
+
+                do {
+                        *--end     = static_cast<char>('0' + magnitude % 10U);
+                        magnitude /= 10U;
+                } while (0U != magnitude);
+                if (0 > value) {
+                        *--end = '-';
+                }
+                return end;
+        }
+
+        /* Milliseconds, the way the TimeStamp class logs them. */
+        int line_(const struct timespec &delta,
+                  const struct timespec &normalized)
+        {
+                char  line[64];
+                char *end   = line + sizeof line;
+                char *begin = end;
+
+                *--begin = '\n';
+                begin    = decimal_(begin,
+                                    1000 * static_cast<int64_t>(
+                                            normalized.tv_sec) +
+                                    normalized.tv_nsec / 1000000);
+                *--begin = ',';
+                begin    = decimal_(begin,
+                                    1000 * static_cast<int64_t>(
+                                            delta.tv_sec) +
+                                    delta.tv_nsec / 1000000);
+                return append_(begin, static_cast<size_t>(end - begin));
+        }
+
+        int append_(const char *data, size_t len)
+        {
+                if (buffer_len_ + len > buffer_.size()) {
+                        if (buffer_len_ != std::fwrite(buffer_.data(),
+                                                       1U,
+                                                       buffer_len_,
+                                                       log_)) {
+                                return -1;
+                        }
+                        buffer_len_ = 0U;
+                }
+                std::memcpy(&buffer_[buffer_len_], data, len);
+                buffer_len_ += len;
+                written_    += len;
+                return 0;
+        }
+};
+
+typedef SampleSink<true>  LogSink;
+typedef SampleSink<false> StatsSink;
+
+/*
+ * Passes every frame on to a 'Sink' for a run of any length, in constant
+ * memory: every 'interval' seconds (0 for never) by the receive stamps, a
+ * summary of the frames since the last one goes to 'stats'; the log is
+ * flushed every second, rotated as the limits of 'log' say and reopened
+ * after a SIGHUP; and the run ends at the first frame after
+ * cmnutil_interrupted().
+ */
+template<typename Sink>
+class StreamSink final {
+public:
+        StreamSink()                                    = delete;
+        StreamSink(const StreamSink &)                  = delete;
+        StreamSink(const StreamSink &&)                 = delete;
+        /*
+         * The summaries go without the floor of 'calibration', see
+         * timestamp_report().
+         * Note the class does NOT take ownership of any of its arguments.
+         */
+        StreamSink(Sink              &sink,
+                   LogFile           &log,
+                   uint64_t           interval,
+                   FILE              *stats,
+                   const Calibration &calibration)
+                :
+                sink_(sink),
+                log_(log),
+                interval_{static_cast<time_t>(interval)},
+                stats_{stats},
+                calibration_(calibration),
+                due_{0},
+                summary_due_{0},
+                rotate_due_{0},
+                lost_{0U},
+                delta_{},
+                jitter_{}
+        {
+        }
+
+        int record(const FrameHeader &header, const struct timespec &received)
+        {
+                int64_t transit = 0;
+
+                if (cmnutil_interrupted() ||
+                    (received.tv_sec >= due_ && -1 == roll_(received))) {
+                        return -1;
+                }
+                if (0U != (header.flags & FRAME_FLAG_LOST)) {
+                        ++lost_;
+                } else {
+                        transit = static_cast<int64_t>(
+                                          received.tv_sec -
+                                          header.timespec.tv_sec) *
+                                  1000000000 +
+                                  (received.tv_nsec -
+                                   header.timespec.tv_nsec);
+                        delta_.record(transit);
+                        jitter_.record(received, transit);
+                }
+                if (-1 == sink_.record(header, received)) {
+                        return -1;
+                }
+                if (0U != log_.bytes() && sink_.written() >= log_.bytes()) {
+                        return rotate_();
+                }
+                return timestamp_hangup() ? reopen_() : 0;
+        }
+
+        /* Summarizes the frames since the last summary, if there are any. */
+        void finish(const struct timespec &now)
+        {
+                if (0 != interval_ && 0U != delta_.count() + lost_) {
+                        summarize_(now);
+                }
+        }
+
+        StreamSink &operator =(const StreamSink &)      = delete;
+        StreamSink &operator =(const StreamSink &&)     = delete;
+
+private:
+        /* data */
+        Sink              &sink_;
+        LogFile           &log_;
+        time_t             interval_;
+        FILE              *stats_;
+        const Calibration &calibration_;
+        /*
+         * When the log is flushed next, never later than the two below, in
+         * seconds of the receive stamps.
+         */
+        time_t             due_;
+        time_t             summary_due_;
+        time_t             rotate_due_;
+        uint64_t           lost_;
+        Histogram          delta_;
+        /* Carries the last frame over, so no gap is lost to a summary. */
+        Jitter             jitter_;
+
+        /* Whatever is due at 'now'; the first frame sets the deadlines. */
+        int roll_(const struct timespec &now)
+        {
+                const time_t never = std::numeric_limits<time_t>::max();
+                const time_t age   = static_cast<time_t>(log_.seconds());
+
+                if (0 != due_) {
+                        if (now.tv_sec >= summary_due_) {
+                                summarize_(now);
+                        }
+                        if (now.tv_sec >= rotate_due_ && -1 == rotate_()) {
+                                return -1;
+                        }
+                        /* So a reader of the log lags a second at most. */
+                        if (-1 == sink_.flush()) {
+                                return -1;
+                        }
+                }
+                if (now.tv_sec >= summary_due_) {
+                        summary_due_ = 0 == interval_ ?
+                                       never : now.tv_sec + interval_;
+                }
+                if (now.tv_sec >= rotate_due_) {
+                        rotate_due_ = 0 == age ? never : now.tv_sec + age;
+                }
+                due_ = now.tv_sec + 1;
+                return 0;
+        }
+
+        void summarize_(const struct timespec &now)
+        {
+                timestamp_report(stats_,
+                                 delta_,
+                                 lost_,
+                                 "interval",
+                                 calibration_);
+                timestamp_report_jitter(stats_, jitter_);
+                fprintf(stats_, "%-24s %lld.%09ld\n", "interval.end",
+                        static_cast<long long>(now.tv_sec), now.tv_nsec);
+                fflush(stats_);
+                delta_.clear();
+                jitter_.clear();
+                lost_ = 0U;
+        }
+
+        int rotate_()
+        {
+                if (-1 == sink_.flush()) {
+                        return -1;
+                }
+                sink_.redirect(log_.rotate(), true);
+                return 0;
+        }
+
+        /* Only a file moved away, or truncated, starts with a heading. */
+        int reopen_()
+        {
+                FILE *file = NULL;
+
+                if (-1 == sink_.flush()) {
+                        return -1;
+                }
+                file = log_.reopen();
+                sink_.redirect(file,
+                               0 == std::fseek(file, 0L, SEEK_END) &&
+                               0L == std::ftell(file));
+                return 0;
+        }
+};
+
+/*
+ * Passes every frame on to a 'Sink' while holding it against the
+ * departures of the TrafficModel it was sent by, regenerated from the same
+ * seed: a frame whose length is not the one the model drew for it counts
+ * as a mismatch, and its latency is filed by the load it was offered at,
+ * under burst() if the gap before it was shorter than the long run mean of
+ * the model and under lull() otherwise.
+ */
+template<typename Sink>
+class ModelSink final {
+public:
+        ModelSink()                                     = delete;
+        ModelSink(const ModelSink &)                    = delete;
+        ModelSink(const ModelSink &&)                   = delete;
+        /* Note the class does NOT take ownership of 'sink' or 'model'. */
+        ModelSink(Sink &sink, TrafficModel &model)
+                :
+                sink_(sink),
+                model_(model),
+                mean_{model.mean_interval()},
+                frames_{0U},
+                bytes_{0U},
+                planned_{0U},
+                mismatch_{0U},
+                first_{},
+                last_{},
+                burst_{},
+                lull_{}
+        {
+        }
+
+        int record(const FrameHeader &header, const struct timespec &received)
+        {
+                uint64_t interval = 0U;
+                size_t   pad      = 0U;
+
+                if (!model_.next(&interval, &pad)) {
+                        pad = SIZE_MAX;
+                }
+                if (0U == frames_) {
+                        first_ = received;
+                } else {
+                        planned_ += interval;
+                }
+                last_    = received;
+                bytes_  += sizeof(FrameHeader) + header.length;
+                ++frames_;
+                if (pad != header.length) {
+                        ++mismatch_;
+                }
+                if (0U == (header.flags & FRAME_FLAG_LOST)) {
+                        (static_cast<double>(interval) < mean_ ?
+                         burst_ : lull_).record(
+                                static_cast<int64_t>(
+                                        received.tv_sec -
+                                        header.timespec.tv_sec) *
+                                1000000000 +
+                                (received.tv_nsec - header.timespec.tv_nsec));
+                }
+                return sink_.record(header, received);
+        }
+
+        uint64_t frames() const
+        {
+                return frames_;
+        }
+
+        uint64_t bytes() const
+        {
+                return bytes_;
+        }
+
+        /* From the first departure to the last, in nanoseconds. */
+        uint64_t planned() const
+        {
+                return planned_;
+        }
+
+        /* From the first arrival to the last, in nanoseconds. */
+        int64_t achieved() const
+        {
+                return static_cast<int64_t>(last_.tv_sec - first_.tv_sec) *
+                       1000000000 + (last_.tv_nsec - first_.tv_nsec);
+        }
+
+        uint64_t mismatch() const
+        {
+                return mismatch_;
+        }
+
+        const Histogram &burst() const
+        {
+                return burst_;
+        }
+
+        const Histogram &lull() const
+        {
+                return lull_;
+        }
+
+        ModelSink &operator =(const ModelSink &)        = delete;
+        ModelSink &operator =(const ModelSink &&)       = delete;
+
+private:
+        /* data */
+        Sink              &sink_;
+        TrafficModel      &model_;
+        double             mean_;
+        uint64_t           frames_;
+        uint64_t           bytes_;
+        uint64_t           planned_;
+        uint64_t           mismatch_;
+        struct timespec    first_;
+        struct timespec    last_;
+        Histogram          burst_;
+        Histogram          lull_;
+};
+
+/*
+ * Passes every frame on to a 'Sink' in the order it was sent rather than
+ * the one it arrived in, for links that reorder datagrams: a frame waits in
+ * a window of 'window' slots, keyed by its sequence number and allocated
+ * once, until every frame sent before it went on or the window has to move
+ * past those that did not come; any of them arriving after that goes on at
+ * once, out of order.  Frames keep the stamps they arrived with, so waiting
+ * changes when they are logged but not their latency, and the first frame
+ * handed on is the first one sent, which the NORMALIZED column of the log
+ * starts from.
+ * A frame arriving after one sent later is reordered: how many sequence
+ * numbers it is short of the highest one seen so far goes into distance(),
+ * and how long after that frame it arrived into late(), the reordering
+ * extent and late time offset of RFC 4737.
+ */
+template<typename Sink>
+class ReorderSink final {
+public:
+        ReorderSink()                                   = delete;
+        ReorderSink(const ReorderSink &)                = delete;
+        ReorderSink(const ReorderSink &&)               = delete;
+        /*
+         * 'window' is a power of two.
+         * Note the class does NOT take ownership of 'sink'.
+         */
+        ReorderSink(Sink &sink, size_t window)
+                :
+                sink_(sink),
+                slot_(window),
+                mask_{window - 1U},
+                next_{0U},
+                end_{0U},
+                highest_{0U},
+                highest_at_{},
+                started_{false},
+                reordered_{0U},
+                skipped_{0U},
+                duplicate_{0U},
+                distance_{},
+                late_{}
+        {
+        }
+
+        int record(const FrameHeader &header, const struct timespec &received)
+        {
+                const uint64_t seq  = header.seq;
+                const bool     lost = 0U != (header.flags & FRAME_FLAG_LOST);
+                Slot_         *slot = NULL;
+
+                /* A placeholder stands in for a frame that never arrives. */
+                if (!lost) {
+                        analyze_(seq, received);
+                }
+                /*
+                 * Too late for its place or given up on already; nor does a
+                 * placeholder, whose number may be that of a corrupt frame,
+                 * move the window.
+                 */
+                if (seq < next_ || (lost && seq - next_ > mask_)) {
+                        return sink_.record(header, received);
+                }
+                if (seq - next_ > mask_ && -1 == slide_(seq - mask_)) {
+                        return -1;
+                }
+                slot = &slot_[seq & mask_];
+                if (slot->present) {
+                        ++duplicate_;
+                        return sink_.record(header, received);
+                }
+                slot->header   = header;
+                slot->received = received;
+                slot->present  = true;
+                if (seq >= end_) {
+                        end_ = seq + 1U;
+                }
+                while (slot_[next_ & mask_].present) {
+                        if (-1 == release_()) {
+                                return -1;
+                        }
+                }
+                return 0;
+        }
+
+        /* Hands on the frames still waiting, in order; -1 on failure. */
+        int finish()
+        {
+                return end_ > next_ ? slide_(end_) : 0;
+        }
+
+        size_t window() const
+        {
+                return slot_.size();
+        }
+
+        uint64_t reordered() const
+        {
+                return reordered_;
+        }
+
+        /* Sequence numbers the window moved past without their frame. */
+        uint64_t skipped() const
+        {
+                return skipped_;
+        }
+
+        /* Frames arriving for a slot that was already taken. */
+        uint64_t duplicate() const
+        {
+                return duplicate_;
+        }
+
+        const Histogram &distance() const
+        {
+                return distance_;
+        }
+
+        const Histogram &late() const
+        {
+                return late_;
+        }
+
+        ReorderSink &operator =(const ReorderSink &)    = delete;
+        ReorderSink &operator =(const ReorderSink &&)   = delete;
+
+private:
+        struct Slot_ {
+                FrameHeader     header;
+                struct timespec received;
+                bool            present;
+        };
+
+        /* data */
+        Sink              &sink_;
+        std::vector<Slot_> slot_;
+        uint64_t           mask_;
+        /* The sequence number the window starts at, and past the last. */
+        uint64_t           next_;
+        uint64_t           end_;
+        uint64_t           highest_;
+        struct timespec    highest_at_;
+        bool               started_;
+        uint64_t           reordered_;
+        uint64_t           skipped_;
+        uint64_t           duplicate_;
+        Histogram          distance_;
+        Histogram          late_;
+
+        void analyze_(uint64_t seq, const struct timespec &received)
+        {
+                if (started_ && seq < highest_) {
+                        ++reordered_;
+                        distance_.record(static_cast<int64_t>(highest_ -
+                                                              seq));
+                        late_.record(static_cast<int64_t>(
+                                             received.tv_sec -
+                                             highest_at_.tv_sec) *
+                                     1000000000 +
+                                     (received.tv_nsec -
+                                      highest_at_.tv_nsec));
+                } else if (!started_ || seq > highest_) {
+                        started_    = true;
+                        highest_    = seq;
+                        highest_at_ = received;
+                }
+        }
+
+        /* Hands on the frame the window starts at, if it came. */
+        int release_()
+        {
+                Slot_ &slot = slot_[next_++ & mask_];
+
+                if (!slot.present) {
+                        ++skipped_;
+                        return 0;
+                }
+                slot.present = false;
+                return sink_.record(slot.header, slot.received);
+        }
+
+        /*
+         * Moves the window up to 'start', handing on what it passes; past
+         * one whole window there is nothing left to hand on.
+         */
+        int slide_(uint64_t start)
+        {
+                const uint64_t stop = start - next_ > slot_.size() ?
+                                      next_ + slot_.size() : start;
+
+                while (next_ != stop) {
+                        if (-1 == release_()) {
+                                return -1;
+                        }
+                }
+                skipped_ += start - next_;
+                next_     = start;
+                return 0;
+        }
+};
+
+template<typename Transport, typename Codec, typename Clock>
+class TimeStampEngine final {
+public:
+        TimeStampEngine()                                     = delete;
+        TimeStampEngine(const TimeStampEngine &)              = delete;
+        TimeStampEngine(const TimeStampEngine &&)             = delete;
+        /* 'rate' is in frames per second, 0 for as fast as possible. */
+        TimeStampEngine(Transport &transport, Codec &codec, uint64_t rate)
+                :
+                transport_(transport),
+                codec_(codec),
+                rate_{rate},
+                flushed_{true}
+        {
+        }
+
+        /*
+         * Sends 'count' frames padded with 'pad' bytes from 'payload',
+         * where PAD fixes 'pad' at compile time unless it is
+         * TIMESTAMP_DYNAMIC_PAD, or fewer once cmnutil_interrupted();
+         * returns how many frames were handed to the codec, whether or not
+         * the final finish() then succeeded (see flushed()).
+         */
+        template<size_t PAD>
+        size_t send(size_t count, size_t pad, PayloadGenerator &payload)
+        {
+                FrameHeader     header = { };
+                struct timespec start  = { };
+                size_t          i      = 0U;
+
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                for (i = 0U; i < count && !cmnutil_interrupted(); ++i) {
+                        if (0U != rate_) {
+                                timestamp_pace(start, rate_, i);
+                        }
+                        header.seq = i;
+                        if (!emit<PAD>(&header, pad, payload.next())) {
                                 break;
                         }
-                        if (0 == strftime(tmp_strftime,
-                                          sizeof tmp_strftime,
-                                          "%s",
-                                          &tmp_tm)) {
-                                force_break = true;
+                }
+                finish();
+                return i;
+        }
+
+        /*
+         * Replays up to 'count' records of 'source', a Schedule or a
+         * TrafficModel, each frame leaving at an absolute deadline, the
+         * start of the replay plus the intervals of every record up to its
+         * own, so that one late frame does not push back the rest.  How
+         * late each departure was, in nanoseconds, goes into 'late' and the
+         * deadline of the last one into 'planned'; 'payload' has to cover
+         * the largest padding of the source.  Returns how many frames were
+         * handed to the codec, as send() does.
+         */
+        template<typename Source>
+        size_t replay(Source           &source,
+                      size_t            count,
+                      PayloadGenerator &payload,
+                      Histogram        &late,
+                      uint64_t         *planned)
+        {
+                FrameHeader     header   = { };
+                struct timespec start    = { };
+                struct timespec now      = { };
+                uint64_t        due      = 0U;
+                uint64_t        interval = 0U;
+                size_t          pad      = 0U;
+                size_t          i        = 0U;
+
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                for (i = 0U; i < count && source.next(&interval, &pad);
+                     ++i) {
+                        due += interval;
+                        timestamp_sleep_until(start, due);
+                        clock_gettime(CLOCK_MONOTONIC, &now);
+                        late.record(static_cast<int64_t>(
+                                (now.tv_sec - start.tv_sec) * 1000000000LL +
+                                (now.tv_nsec - start.tv_nsec)) -
+                                    static_cast<int64_t>(due));
+                        header.seq = i;
+                        if (!emit<TIMESTAMP_DYNAMIC_PAD>(&header,
+                                                         pad,
+                                                         payload.next())) {
                                 break;
                         }
-                        fprintf(log_file,
-                                "%s,%ld\n",
-                                tmp_strftime,
-                                current->timespec.tv_nsec);
                 }
+                *planned = due;
+                finish();
+                return i;
         }
 
-        if (NULL != log_file) {
-                fclose(log_file);
+        /*
+         * Stamps 'header' and sends it along with 'pad' bytes of 'padding'
+         * as one frame; finish() has to follow the last one.
+         */
+        template<size_t PAD>
+        bool emit(FrameHeader *header, size_t pad, const char *padding)
+        {
+                const size_t len = TIMESTAMP_DYNAMIC_PAD == PAD ? pad : PAD;
+
+                header->length = static_cast<uint32_t>(len);
+                return -1 != Clock::now(&header->timespec) &&
+                       codec_.encode(transport_, *header, padding, len);
         }
-        free(current);
-        return false == force_break ? rs_count + 1 : rs_count;
-}
+
+        /* Pushes out whatever the codec still holds back. */
+        bool finish()
+        {
+                flushed_ = codec_.flush(transport_);
+                return flushed_;
+        }
+
+        /*
+         * Whether the last finish() got everything out; the last frames
+         * sent before a failed one may not have made it whole.
+         */
+        bool flushed() const
+        {
+                return flushed_;
+        }
+
+        /* Hands up to 'count' frames to 'sink'; returns how many it took. */
+        template<typename Sink>
+        size_t receive(size_t count, Sink &sink)
+        {
+                FrameHeader     header   = { };
+                struct timespec received = { };
+                size_t          i        = 0U;
+
+                for (i = 0U; i < count; ++i) {
+                        /* Stamped after the read, which may well block. */
+                        if (!codec_.decode(transport_, &header) ||
+                            -1 == Clock::now(&received) ||
+                            -1 == sink.record(header, received)) {
+                                break;
+                        }
+                }
+                return i;
+        }
+
+        TimeStampEngine &operator =(const TimeStampEngine &)  = delete;
+        TimeStampEngine &operator =(const TimeStampEngine &&) = delete;
+
+private:
+        /* data */
+        Transport &transport_;
+        Codec     &codec_;
+        uint64_t   rate_;
+        bool       flushed_;
+};
 
 #endif /* TIMESTAMP_TMP_H */
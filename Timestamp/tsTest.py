@@ -41,6 +41,10 @@ REPORTNAME = 1
 TIMESTAMP_ATTRS = {0: "TIMESTAMP_OUTPUT",
                    1: "tsLog.csv"}
 
+# A receiver that hears nothing for this long gives up on the rest of its
+# frames and reports them lost, so one stuck point cannot hang the sweep.
+TS_IDLE_TIMEOUT = "--idle-timeout 10000"
+
 SSH_CMD = 0
 SSHD_PATH = 1
 SSHPASS_CMD = 2
@@ -246,7 +250,8 @@ def tsTestPadMsgSize(padMsgSize, numOfRuns, msgSent):
                                                    SSH_ATTRS[SSH_USER],
                                                    "cold12")
     tcDelCommand = "{0} {1} qdisc del dev {2} root"
-    tsCommand = "{0} ./ts -s -b {2} -c {3} | {1} ./ts -r -b {2} -c {3} "
+    tsCommand = "{0} ./ts -s -b {2} -c {3} | {1} ./ts -r -b {2} -c {3} " +\
+        TS_IDLE_TIMEOUT + " "
     tsOutput = None
 
     print("-" * 79 + "\n")
@@ -314,7 +319,8 @@ def tsTestLoss(lossRate, numOfRuns, msgSent):
     tcDelCommand = "{0} {1} qdisc del dev {2} root"
     tcCommand = "{0} tc qdisc add dev {1} root " +\
         "netem limit 10000000000 loss {2}%"
-    tsCommand = "{0} ./ts -s -c {2} | {1} ./ts -r -c {2} "
+    tsCommand = "{0} ./ts -s -c {2} | {1} ./ts -r -c {2} " +\
+        TS_IDLE_TIMEOUT + " "
     tsOutput = None
     # interfaceName = None
 
@@ -378,7 +384,8 @@ def tsTestRTT(RTT, numOfRuns, msgSent):
     tcDelCommand = "{0} {1} qdisc del dev {2} root"
     tcCommand = "{0} tc qdisc add dev {1} root " +\
         "netem limit 10000000000 delay {2}ms"
-    tsCommand = "{0} ./ts -s -c {2} | {1} ./ts -r -c {2} "
+    tsCommand = "{0} ./ts -s -c {2} | {1} ./ts -r -c {2} " +\
+        TS_IDLE_TIMEOUT + " "
     tsOutput = None
 
     print("-" * 79 + "\n")